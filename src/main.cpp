@@ -18,7 +18,6 @@ int main(int argc, char** argv)
     }
 
     nchip8::nchip8_app app(args);
-    app.run();
 
-    return 0;
+    return app.run();
 }
@@ -0,0 +1,166 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "audio.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace nchip8
+{
+
+void audio_synth::render_frame(const cpu& chip8, std::int16_t* out)
+{
+    if(chip8.get_st() == 0)
+    {
+        std::fill(out, out + samples_per_frame, 0);
+        return;
+    }
+
+    if(chip8.get_quirks() == quirk_profile::xochip)
+    {
+        const auto& pattern = chip8.get_audio_pattern();
+        const double step = 4000.0 * std::pow(2.0, (chip8.get_audio_pitch() - 64) / 48.0) / sample_rate;
+
+        m_phase = std::fmod(m_phase, 128.0);
+
+        for(std::size_t n = 0; n < samples_per_frame; n++)
+        {
+            auto bit = static_cast<std::size_t>(m_phase);
+            bool high = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+
+            out[n] = high ? amplitude : -amplitude;
+
+            m_phase += step;
+            if(m_phase >= 128.0) m_phase -= 128.0;
+        }
+
+        return;
+    }
+
+    constexpr double step = buzzer_hz / sample_rate;
+
+    m_phase = std::fmod(m_phase, 1.0);
+
+    for(std::size_t n = 0; n < samples_per_frame; n++)
+    {
+        out[n] = (m_phase < 0.5) ? amplitude : -amplitude;
+
+        m_phase += step;
+        if(m_phase >= 1.0) m_phase -= 1.0;
+    }
+}
+
+audio_output::~audio_output()
+{
+    stop();
+}
+
+void audio_output::start(std::unique_ptr<audio_sink> sink)
+{
+    stop();
+
+    if(!sink) return;
+
+    m_sink = std::move(sink);
+    m_stop = false;
+    m_thread = std::thread(&audio_output::audio_thread, this);
+
+    // the cpu thread may submit from here on
+    m_started.store(true, std::memory_order_release);
+}
+
+void audio_output::stop()
+{
+    m_started = false;
+    m_stop = true;
+
+    if(m_thread.joinable()) m_thread.join();
+
+    m_sink.reset();
+}
+
+bool audio_output::is_started() const
+{
+    return m_started.load(std::memory_order_acquire);
+}
+
+void audio_output::submit_frame(const cpu& chip8)
+{
+    if(!is_started()) return;
+
+    m_synth.render_frame(chip8, m_frame.data());
+
+    if(m_ring.push(m_frame.data(), m_frame.size()) < m_frame.size()) m_overruns++;
+}
+
+std::size_t audio_output::get_underruns() const
+{
+    return m_underruns;
+}
+
+std::size_t audio_output::get_overruns() const
+{
+    return m_overruns;
+}
+
+std::uint32_t audio_output::get_latency_us() const
+{
+    return m_latency_us;
+}
+
+void audio_output::audio_thread()
+{
+    std::array<std::int16_t, period_samples> period {};
+    std::array<std::int16_t, period_samples> skipped {};
+
+    bool playing = false;
+    double latency_us = 0.0;
+
+    auto next_period = std::chrono::steady_clock::now();
+
+    while(!m_stop)
+    {
+        std::size_t buffered = m_ring.size();
+
+        // the cpu got ahead (e.g. turbo was switched off), the oldest samples are the least wanted
+        while(buffered > max_samples)
+        {
+            buffered -= m_ring.pop(skipped.data(), std::min(buffered - max_samples, skipped.size()));
+        }
+
+        if(!playing && buffered >= prime_samples) playing = true;
+
+        std::size_t got = 0;
+
+        if(playing)
+        {
+            // the sample submitted last comes out after everything buffered before it
+            latency_us += ((buffered * 1000000.0 / audio_synth::sample_rate) - latency_us) / 16.0;
+            m_latency_us = static_cast<std::uint32_t>(latency_us);
+
+            got = m_ring.pop(period.data(), period.size());
+
+            if(got < period.size())
+            {
+                m_underruns++;
+                playing = false;
+            }
+        }
+
+        std::fill(period.begin() + got, period.end(), 0);
+        m_sink->write(period.data(), period.size());
+
+        next_period += std::chrono::microseconds(1000000 * period_samples / audio_synth::sample_rate);
+
+        // a stalled sink (or host) is not caught up with, it would only add latency
+        auto now = std::chrono::steady_clock::now();
+        if(now - next_period > std::chrono::milliseconds(100)) next_period = now;
+
+        std::this_thread::sleep_until(next_period);
+    }
+}
+
+}
@@ -0,0 +1,114 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_AUDIO_HPP
+#define NCHIP8_AUDIO_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "cpu.hpp"
+#include "audio_sink.hpp"
+#include "spsc_queue.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Turns the sound timer into samples, a 60Hz frame at a time
+//! @details While the sound timer runs, CHIP-8 and SUPER-CHIP play a square wave buzzer,
+//!          XO-CHIP plays its 1 bit audio pattern at the rate set by its pitch (see cpu::get_audio_pattern).
+//!          The phase carries over from frame to frame, so a sound held over frames has no seams.
+class audio_synth
+{
+public:
+    static constexpr std::uint32_t sample_rate = 48000;
+
+    //! @brief  Samples of a 60Hz frame
+    static constexpr std::size_t samples_per_frame = sample_rate / 60;
+
+    //! @brief  Frequency of the buzzer
+    static constexpr double buzzer_hz = 440.0;
+
+    //! @brief  Peak of a sample, a quarter of full scale
+    static constexpr std::int16_t amplitude = 8192;
+
+    //! @brief  Renders the frame chip8 just ran (before its timer tick) into samples_per_frame samples
+    void render_frame(const cpu& chip8, std::int16_t* out);
+
+private:
+    //! Position in the waveform: buzzer cycles, or bits of the 128 bit pattern
+    double m_phase = 0.0;
+};
+
+//! @brief  Plays frames on a dedicated audio thread
+//! @details The cpu thread renders each frame into a lock-free ring buffer and never waits: when the ring is full
+//!          the samples are dropped (an overrun). The audio thread takes a period of samples from it every
+//!          period, in real time, and writes them to the sink. When the ring runs dry the period is padded with
+//!          silence (an underrun) and playback waits until prime_samples are buffered again, then carries on.
+//!          More than max_samples buffered (the cpu ran ahead) is skipped, to keep the latency down.
+class audio_output
+{
+public:
+    //! @brief  Samples the audio thread writes at a time, 10ms
+    static constexpr std::size_t period_samples = audio_synth::sample_rate / 100;
+
+    //! @brief  Samples buffered before playback starts (or restarts after an underrun), two frames
+    static constexpr std::size_t prime_samples = 2 * audio_synth::samples_per_frame;
+
+    //! @brief  Samples buffered past which the oldest are skipped, four frames
+    static constexpr std::size_t max_samples = 4 * audio_synth::samples_per_frame;
+
+    audio_output() = default;
+    ~audio_output();
+
+    audio_output(const audio_output&) = delete;
+    audio_output& operator=(const audio_output&) = delete;
+
+    //! @brief  Starts the audio thread writing to sink, nothing is played without one
+    void start(std::unique_ptr<audio_sink> sink);
+
+    //! @brief  Stops the audio thread, the sink is closed
+    void stop();
+
+    bool is_started() const;
+
+    //! @brief  Renders a frame into the ring, cpu thread only (see audio_synth::render_frame)
+    void submit_frame(const cpu& chip8);
+
+    //! @brief  Periods padded with silence because the ring ran dry
+    std::size_t get_underruns() const;
+
+    //! @brief  Frames (partly) dropped because the ring was full
+    std::size_t get_overruns() const;
+
+    //! @brief  Time from a frame being submitted to its first sample reaching the sink, smoothed, in microseconds
+    std::uint32_t get_latency_us() const;
+
+private:
+    audio_synth m_synth;
+    std::array<std::int16_t, audio_synth::samples_per_frame> m_frame {};
+
+    //! About 170ms, far more than max_samples, so only a stalled audio thread fills it
+    spsc_queue<std::int16_t, 8192> m_ring;
+
+    std::unique_ptr<audio_sink> m_sink;
+    std::thread m_thread;
+
+    std::atomic<bool> m_started { false };
+    std::atomic<bool> m_stop { false };
+
+    std::atomic<std::size_t> m_underruns { 0 };
+    std::atomic<std::size_t> m_overruns { 0 };
+    std::atomic<std::uint32_t> m_latency_us { 0 };
+
+    void audio_thread();
+};
+
+}
+
+#endif //NCHIP8_AUDIO_HPP
@@ -0,0 +1,117 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "audio_sink.hpp"
+#include "audio.hpp"
+
+#include <stdexcept>
+
+namespace nchip8
+{
+
+std::unique_ptr<audio_sink> audio_sink::make(const std::string& spec, const std::function<void()>& bell)
+{
+    if(spec == "none") return nullptr;
+
+    if(spec == "bell")
+    {
+        if(!bell) throw std::invalid_argument("The bell sink needs the terminal of the gui!");
+        return std::make_unique<bell_sink>(bell);
+    }
+
+    if(spec.rfind("wav:", 0) == 0) return std::make_unique<file_sink>(spec.substr(4), true);
+    if(spec.rfind("raw:", 0) == 0) return std::make_unique<file_sink>(spec.substr(4), false);
+
+    throw std::invalid_argument("Unknown audio sink " + spec + "! (wav:<path>, raw:<path>, bell or none)");
+}
+
+file_sink::file_sink(const std::string& path, const bool& wav) :
+    m_file(path, std::ios::binary | std::ios::out),
+    m_wav(wav)
+{
+    if(!m_file)
+    {
+        throw std::invalid_argument("Could not open " + path + "!");
+    }
+
+    // sizes of 0 for now, the destructor knows them
+    if(m_wav) write_wav_header();
+}
+
+file_sink::~file_sink()
+{
+    if(!m_wav) return;
+
+    m_file.seekp(0);
+    write_wav_header();
+}
+
+void file_sink::write(const std::int16_t* samples, const std::size_t& count)
+{
+    // little endian whatever the host
+    for(std::size_t n = 0; n < count; n++)
+    {
+        auto sample = static_cast<std::uint16_t>(samples[n]);
+        char bytes[2] = { static_cast<char>(sample & 0xFF), static_cast<char>(sample >> 8) };
+        m_file.write(bytes, 2);
+    }
+
+    m_data_bytes += static_cast<std::uint32_t>(count * 2);
+}
+
+void file_sink::write_wav_header()
+{
+    auto put_u16 = [this](const std::uint16_t& v) { char b[2] = { char(v), char(v >> 8) }; m_file.write(b, 2); };
+    auto put_u32 = [this](const std::uint32_t& v) { char b[4] = { char(v), char(v >> 8), char(v >> 16), char(v >> 24) }; m_file.write(b, 4); };
+
+    m_file.write("RIFF", 4);
+    put_u32(36 + m_data_bytes);
+    m_file.write("WAVE", 4);
+
+    m_file.write("fmt ", 4);
+    put_u32(16);
+    put_u16(1);                                 // PCM
+    put_u16(1);                                 // mono
+    put_u32(audio_synth::sample_rate);
+    put_u32(audio_synth::sample_rate * 2);      // bytes a second
+    put_u16(2);                                 // bytes a sample
+    put_u16(16);                                // bits a sample
+
+    m_file.write("data", 4);
+    put_u32(m_data_bytes);
+}
+
+bell_sink::bell_sink(std::function<void()> ring) :
+    m_ring(std::move(ring)),
+    m_silence(audio_synth::sample_rate)
+{
+}
+
+void bell_sink::write(const std::int16_t* samples, const std::size_t& count)
+{
+    for(std::size_t n = 0; n < count; n++)
+    {
+        if(samples[n] == 0)
+        {
+            m_silence++;
+            continue;
+        }
+
+        // a tenth of a second of silence makes the next sound a new one, a bell is rung at most that often too
+        if(m_silence >= audio_synth::sample_rate / 10)
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            if(now - m_last_ring >= std::chrono::milliseconds(100))
+            {
+                m_ring();
+                m_last_ring = now;
+            }
+        }
+
+        m_silence = 0;
+    }
+}
+
+}
@@ -0,0 +1,79 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_AUDIO_SINK_HPP
+#define NCHIP8_AUDIO_SINK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace nchip8
+{
+
+//! @brief  Where synthesized audio goes: 16 bit signed mono samples at audio_synth::sample_rate
+//! @details A sink is only ever written from one thread (the audio thread, or a headless run),
+//!          it may take its time, the cpu thread never waits on it
+class audio_sink
+{
+public:
+    virtual ~audio_sink() = default;
+
+    //! @brief  Consumes count samples
+    virtual void write(const std::int16_t* samples, const std::size_t& count) = 0;
+
+    //! @brief      Makes a sink from a --audio=<spec> value: wav:<path>, raw:<path>, bell or none
+    //! @param bell Rings the terminal bell, for bell (see bell_sink)
+    //! @returns    nullptr for none
+    //! @throws     std::invalid_argument if the spec is unknown, the file does not open or bell has nothing to ring
+    static std::unique_ptr<audio_sink> make(const std::string& spec, const std::function<void()>& bell = {});
+};
+
+//! @brief  Writes the samples to a file, as a WAV file or as raw PCM (s16le, mono)
+class file_sink : public audio_sink
+{
+public:
+    //! @throws std::invalid_argument if the file does not open
+    file_sink(const std::string& path, const bool& wav);
+
+    //! @brief  Fills in the sizes of the WAV header
+    ~file_sink() override;
+
+    void write(const std::int16_t* samples, const std::size_t& count) override;
+
+private:
+    std::ofstream m_file;
+    bool m_wav;
+    std::uint32_t m_data_bytes = 0;
+
+    void write_wav_header();
+};
+
+//! @brief  Rings the terminal bell when a sound starts, for terminals that have nothing better
+//! @details Only the start of a sound after some silence rings it, a held buzz is one ring
+class bell_sink : public audio_sink
+{
+public:
+    //! @param ring Called on the audio thread when a sound starts, the terminal belongs to the gui thread
+    //!             so it should only pass the ring on to it (see gui::get_bell)
+    explicit bell_sink(std::function<void()> ring);
+
+    void write(const std::int16_t* samples, const std::size_t& count) override;
+
+private:
+    std::function<void()> m_ring;
+
+    //! Samples of silence since the last sound
+    std::size_t m_silence;
+
+    std::chrono::steady_clock::time_point m_last_ring;
+};
+
+}
+
+#endif //NCHIP8_AUDIO_SINK_HPP
@@ -0,0 +1,525 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace nchip8
+{
+
+// The scalar kernels, for hosts without SSE2 (and to check the others against)
+
+static void scalar_set_u8(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) if(mask[i]) dst[i] = value;
+}
+
+static void scalar_add_imm_u8(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) if(mask[i]) dst[i] += value;
+}
+
+static void scalar_logic_u8(std::uint8_t* dst, const std::uint8_t* src, int op, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        if(!mask[i]) continue;
+
+        switch(op)
+        {
+            case 0: dst[i] = src[i]; break;
+            case 1: dst[i] |= src[i]; break;
+            case 2: dst[i] &= src[i]; break;
+            default: dst[i] ^= src[i]; break;
+        }
+    }
+}
+
+static void scalar_add_carry_u8(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag,
+                                const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        if(!mask[i]) continue;
+
+        const unsigned sum = x[i] + y[i];
+        x[i] = sum & 0xFF;
+        flag[i] = sum > 0xFF;
+    }
+}
+
+static void scalar_sub_u8(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag, bool reverse,
+                          const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        if(!mask[i]) continue;
+
+        const std::uint8_t a = reverse ? y[i] : x[i];
+        const std::uint8_t b = reverse ? x[i] : y[i];
+        x[i] = a - b;
+        flag[i] = a > b;
+    }
+}
+
+static void scalar_skip_u16(std::uint16_t* pc, const std::uint8_t* a, const std::uint8_t* b, std::uint8_t value, bool equal,
+                            const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        if(mask[i] && ((a[i] == (b ? b[i] : value)) == equal)) pc[i] += 2;
+    }
+}
+
+static void scalar_set_u16(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) if(mask[i]) dst[i] = value;
+}
+
+static void scalar_add_imm_u16(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) if(mask[i]) dst[i] += value;
+}
+
+static void scalar_add_u8_u16(std::uint16_t* dst, const std::uint8_t* src, const std::uint8_t* mask, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) if(mask[i]) dst[i] += src[i];
+}
+
+static void scalar_sub_sat_u8(std::uint8_t* dst, std::uint8_t value, std::size_t lanes)
+{
+    for(std::size_t i = 0; i < lanes; i++) dst[i] = (dst[i] > value) ? dst[i] - value : 0;
+}
+
+static std::size_t scalar_pending_u16(std::uint8_t* pending, const std::uint16_t* budget, std::size_t lanes)
+{
+    std::size_t count = 0;
+
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        pending[i] = budget[i] ? 0xFF : 0x00;
+        count += budget[i] != 0;
+    }
+
+    return count;
+}
+
+static std::size_t scalar_group_u16(std::uint8_t* mask, std::uint8_t* pending, const std::uint16_t* pc, std::uint16_t value,
+                                    const std::uint8_t* own, std::uint8_t shared, std::size_t lanes)
+{
+    std::size_t count = 0;
+
+    for(std::size_t i = 0; i < lanes; i++)
+    {
+        const bool member = pending[i] && pc[i] == value && shared && !own[i];
+
+        mask[i] = member ? 0xFF : 0x00;
+        if(member) pending[i] = 0x00;
+        count += member;
+    }
+
+    return count;
+}
+
+const batch_kernels* batch_kernels_scalar()
+{
+    static const batch_kernels kernels = {
+        "scalar",
+        &scalar_set_u8, &scalar_add_imm_u8, &scalar_logic_u8, &scalar_add_carry_u8, &scalar_sub_u8,
+        &scalar_skip_u16, &scalar_set_u16, &scalar_add_imm_u16, &scalar_add_u8_u16, &scalar_sub_sat_u8,
+        &scalar_pending_u16, &scalar_group_u16
+    };
+
+    return &kernels;
+}
+
+// the widest kernels the host can run
+static const batch_kernels* best_kernels()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(batch_kernels_avx2() && __builtin_cpu_supports("avx2")) return batch_kernels_avx2();
+#endif
+
+    if(batch_kernels_sse2()) return batch_kernels_sse2();
+
+    return batch_kernels_scalar();
+}
+
+batch::batch(const cpu& start, const std::size_t& lanes) :
+    m_lanes(lanes),
+    m_padded(((std::max<std::size_t>(lanes, 1) + lane_align - 1) / lane_align) * lane_align),
+    m_kernels(best_kernels())
+{
+    m_v.assign(16 * m_padded, 0);
+    m_i.assign(m_padded, 0);
+    m_pc.assign(m_padded, 0);
+    m_dt.assign(m_padded, 0);
+    m_st.assign(m_padded, 0);
+
+    // the padding lanes never run, so no kernel changes them
+    m_running.assign(m_padded, 0);
+    m_own_ram.assign(m_padded, 0);
+    m_budget.assign(m_padded, 0);
+    m_pending.assign(m_padded, 0);
+    m_mask.assign(m_padded, 0);
+
+    m_image = start.fork();
+    m_cpus.reserve(lanes);
+
+    for(std::size_t lane = 0; lane < lanes; lane++)
+    {
+        m_cpus.push_back(start.fork());
+        m_running[lane] = start.is_halted() ? 0x00 : 0xFF;
+        store_lane(lane);
+    }
+
+    // the handlers a kernel replaces, every other handler runs on the lanes' cpus
+    static const std::pair<const char*, kernel> kernel_names[] = {
+        { "LD_VX_KK", kernel::ld_vx_kk }, { "ADD_VX_KK", kernel::add_vx_kk },
+        { "LD_VX_VY", kernel::ld_vx_vy }, { "OR_VX_VY", kernel::or_vx_vy },
+        { "AND_VX_VY", kernel::and_vx_vy }, { "XOR_VX_VY", kernel::xor_vx_vy },
+        { "ADD_VX_VY", kernel::add_vx_vy }, { "SUB_VX_VY", kernel::sub_vx_vy },
+        { "SUBN_VX_VY", kernel::subn_vx_vy },
+        { "SE_VX_KK", kernel::se_vx_kk }, { "SNE_VX_KK", kernel::sne_vx_kk },
+        { "SE_VX_VY", kernel::se_vx_vy }, { "SNE_VX_VY", kernel::sne_vx_vy },
+        { "JP", kernel::jp }, { "LD_I_NNN", kernel::ld_i_nnn }, { "ADD_I_VX", kernel::add_i_vx },
+        { "LD_VX_DT", kernel::ld_vx_dt }, { "LD_DT_VX", kernel::ld_dt_vx }, { "LD_ST_VX", kernel::ld_st_vx }
+    };
+
+    static const char* ram_writers[] = { "LD_B_VX", "LD_imm_I_VX", "LD_imm_I_VX_VY" };
+
+    // XO-CHIP skips over the 4 byte F000 nnnn, that needs the RAM
+    const bool xochip = start.get_quirks() == quirk_profile::xochip;
+
+    const auto& names = start.m_decode->m_names;
+    std::array<bool, 256> writer {};
+
+    for(std::size_t id = 0; id < names.size() && id < m_kernel_of.size(); id++)
+    {
+        for(const auto& name : ram_writers)
+        {
+            if(names[id] == name) writer[id] = true;
+        }
+
+        for(const auto& entry : kernel_names)
+        {
+            if(names[id] != entry.first) continue;
+
+            const bool skip = entry.second >= kernel::se_vx_kk && entry.second <= kernel::sne_vx_vy;
+            m_kernel_of[id] = (skip && xochip) ? kernel::scalar : entry.second;
+        }
+    }
+
+    // from the end of RAM back, a jump ends a streak (where it goes is not known here)
+    m_streak.assign(m_image->m_ram_mask + 1, 0);
+    m_writes_ram.assign(m_streak.size(), false);
+
+    for(std::size_t address = m_streak.size(); address-- > 0; )
+    {
+        const std::uint16_t instruction = m_image->read_u16(static_cast<std::uint16_t>(address));
+        const std::uint8_t id = m_image->m_decode->m_index[instruction];
+        const kernel k = kernel_for(instruction, id);
+
+        m_writes_ram[address] = (id != cpu::no_handler) && writer[id];
+
+        if(k == kernel::scalar) continue;
+
+        const std::size_t next = address + 2;
+        const std::size_t rest = (k == kernel::jp || next >= m_streak.size()) ? 0 : m_streak[next];
+        m_streak[address] = static_cast<std::uint8_t>(std::min<std::size_t>(rest + 1, 0xFF));
+    }
+}
+
+void batch::set_kernels(const batch_kernels* kernels)
+{
+    m_kernels = kernels ? kernels : best_kernels();
+}
+
+const batch_kernels& batch::get_kernels() const
+{
+    return *m_kernels;
+}
+
+std::size_t batch::get_lanes() const
+{
+    return m_lanes;
+}
+
+// the members are read into locals first: stores through a uint8_t pointer could alias any of them,
+// which would reload them between every byte
+void batch::load_lane(const std::size_t& lane)
+{
+    cpu& chip8 = *m_cpus[lane];
+
+    const std::uint8_t* v = m_v.data() + lane;
+    const std::size_t stride = m_padded;
+    std::uint8_t* gpr = chip8.m_gpr.data();
+
+    for(std::size_t r = 0; r < 16; r++) gpr[r] = v[r * stride];
+
+    chip8.m_i = m_i[lane];
+    chip8.m_pc = m_pc[lane];
+    chip8.m_dt = m_dt[lane];
+    chip8.m_st = m_st[lane];
+}
+
+void batch::store_lane(const std::size_t& lane)
+{
+    const cpu& chip8 = *m_cpus[lane];
+
+    std::uint8_t* v = m_v.data() + lane;
+    const std::size_t stride = m_padded;
+    const std::uint8_t* gpr = chip8.m_gpr.data();
+
+    for(std::size_t r = 0; r < 16; r++) v[r * stride] = gpr[r];
+
+    m_i[lane] = chip8.m_i;
+    m_pc[lane] = chip8.m_pc;
+    m_dt[lane] = chip8.m_dt;
+    m_st[lane] = chip8.m_st;
+}
+
+batch::kernel batch::kernel_for(const std::uint16_t& instruction, const std::uint8_t& id) const
+{
+    if(id == cpu::no_handler) return kernel::scalar;
+
+    const kernel k = m_kernel_of[id];
+
+    // the flag instructions with VF as an operand write it twice, leave those to the handlers
+    if(k >= kernel::add_vx_vy && k <= kernel::subn_vx_vy
+       && (((instruction >> 8) & 0xF) == 0xF || ((instruction >> 4) & 0xF) == 0xF))
+    {
+        return kernel::scalar;
+    }
+
+    return k;
+}
+
+void batch::run_scalar(const std::size_t& lane, const bool& regroup)
+{
+    cpu& chip8 = *m_cpus[lane];
+    const std::size_t image_mask = m_streak.size() - 1;
+    const std::uint32_t limit = regroup ? m_budget[lane] : std::min<std::uint32_t>(m_budget[lane], scalar_slice);
+    std::uint32_t executed = 0;
+    bool halted = false;
+    bool writes_ram = false;
+
+    load_lane(lane);
+
+    while(executed < limit)
+    {
+        const std::size_t pc = chip8.m_pc & image_mask;
+
+        // the streaks of the image are a cheap first test (lanes that rewrote their code
+        // might rejoin a little less often, never wrongly: the instruction itself decides)
+        if(regroup && executed > 0 && m_streak[pc] >= min_streak)
+        {
+            const std::uint16_t instruction = chip8.read_u16(chip8.m_pc);
+
+            if(kernel_for(instruction, chip8.m_decode->m_index[instruction]) != kernel::scalar) break;
+        }
+
+        // exact until the lane first writes RAM, up to then it runs the code of the image
+        writes_ram |= m_writes_ram[pc];
+
+        if(!chip8.execute_op_at_pc())
+        {
+            halted = true;
+            break;
+        }
+
+        executed++;
+    }
+
+    if(writes_ram && !m_own_ram[lane])
+    {
+        m_own_ram[lane] = 0xFF;
+        m_own_lanes++;
+    }
+
+    if(halted)
+    {
+        m_running[lane] = 0x00;
+        m_budget[lane] = 0;
+    }
+    else
+    {
+        m_budget[lane] -= executed;
+    }
+
+    m_scalar_instructions += executed;
+
+    store_lane(lane);
+}
+
+void batch::run(const std::uint16_t& instructions)
+{
+    for(std::size_t lane = 0; lane < m_lanes; lane++)
+    {
+        m_budget[lane] = m_running[lane] ? instructions : 0;
+    }
+
+    const batch_kernels& kernels = *m_kernels;
+
+    // every pass executes at least one instruction of every lane with a budget left
+    while(kernels.pending_u16(m_pending.data(), m_budget.data(), m_padded) > 0)
+    {
+        std::size_t groups = 0;
+
+        for(std::size_t leader = 0; leader < m_lanes; leader++)
+        {
+            // the next lane that did not execute in this pass yet
+            const void* next = std::memchr(m_pending.data() + leader, 0xFF, m_lanes - leader);
+            if(!next) break;
+
+            leader = static_cast<const std::uint8_t*>(next) - m_pending.data();
+
+            const cpu& lead = *m_cpus[leader];
+            const std::uint16_t pc = m_pc[leader];
+            const std::uint16_t instruction = lead.read_u16(pc);
+            const kernel k = kernel_for(instruction, lead.m_decode->m_index[instruction]);
+
+            if(k == kernel::scalar || groups == max_groups)
+            {
+                run_scalar(leader, k == kernel::scalar);
+                m_pending[leader] = 0x00;
+                continue;
+            }
+
+            groups++;
+
+            // the group: the pending lanes at the same PC with the same instruction there,
+            // lanes that still have the RAM they started with have the instruction of the image
+            const std::uint8_t shared = (!m_own_ram[leader] || m_image->read_u16(pc) == instruction) ? 0xFF : 0x00;
+
+            std::size_t members = kernels.group_u16(m_mask.data(), m_pending.data(), m_pc.data(), pc,
+                                                    m_own_ram.data(), shared, m_padded);
+
+            if(m_own_lanes > 0)
+            {
+                for(std::size_t lane = leader; lane < m_lanes; lane++)
+                {
+                    if(m_own_ram[lane] && m_pending[lane] && m_pc[lane] == pc
+                       && m_cpus[lane]->read_u16(pc) == instruction)
+                    {
+                        m_mask[lane] = 0xFF;
+                        m_pending[lane] = 0x00;
+                        members++;
+                    }
+                }
+            }
+
+            if(members >= min_group)
+            {
+                run_kernel(k, instruction);
+                kernels.add_imm_u16(m_budget.data(), 0xFFFF, m_mask.data(), m_padded); // -1
+                m_vector_instructions += members;
+            }
+            else
+            {
+                for(std::size_t lane = leader; lane < m_lanes; lane++)
+                {
+                    if(m_mask[lane]) run_scalar(lane, false);
+                }
+            }
+        }
+    }
+}
+
+void batch::step()
+{
+    run(1);
+}
+
+void batch::run_kernel(const kernel& k, const std::uint16_t& instruction)
+{
+    const std::uint8_t x = (instruction >> 8) & 0xF;
+    const std::uint8_t y = (instruction >> 4) & 0xF;
+    const std::uint8_t kk = instruction & 0xFF;
+    const std::uint16_t nnn = instruction & 0x0FFF;
+
+    auto v = [this](const std::size_t& r) { return m_v.data() + r * m_padded; };
+
+    const std::uint8_t* mask = m_mask.data();
+    const std::size_t lanes = m_padded;
+    const batch_kernels& kernels = *m_kernels;
+
+    // like execute_op_at_pc, the PC moves past the instruction before it executes
+    kernels.add_imm_u16(m_pc.data(), 2, mask, lanes);
+
+    switch(k)
+    {
+        case kernel::ld_vx_kk: kernels.set_u8(v(x), kk, mask, lanes); break;
+        case kernel::add_vx_kk: kernels.add_imm_u8(v(x), kk, mask, lanes); break;
+        case kernel::ld_vx_vy: kernels.logic_u8(v(x), v(y), 0, mask, lanes); break;
+        case kernel::or_vx_vy: kernels.logic_u8(v(x), v(y), 1, mask, lanes); break;
+        case kernel::and_vx_vy: kernels.logic_u8(v(x), v(y), 2, mask, lanes); break;
+        case kernel::xor_vx_vy: kernels.logic_u8(v(x), v(y), 3, mask, lanes); break;
+        case kernel::add_vx_vy: kernels.add_carry_u8(v(x), v(y), v(0xF), mask, lanes); break;
+        case kernel::sub_vx_vy: kernels.sub_u8(v(x), v(y), v(0xF), false, mask, lanes); break;
+        case kernel::subn_vx_vy: kernels.sub_u8(v(x), v(y), v(0xF), true, mask, lanes); break;
+        case kernel::se_vx_kk: kernels.skip_u16(m_pc.data(), v(x), nullptr, kk, true, mask, lanes); break;
+        case kernel::sne_vx_kk: kernels.skip_u16(m_pc.data(), v(x), nullptr, kk, false, mask, lanes); break;
+        case kernel::se_vx_vy: kernels.skip_u16(m_pc.data(), v(x), v(y), 0, true, mask, lanes); break;
+        case kernel::sne_vx_vy: kernels.skip_u16(m_pc.data(), v(x), v(y), 0, false, mask, lanes); break;
+        case kernel::jp: kernels.set_u16(m_pc.data(), nnn, mask, lanes); break;
+        case kernel::ld_i_nnn: kernels.set_u16(m_i.data(), nnn, mask, lanes); break;
+        case kernel::add_i_vx: kernels.add_u8_u16(m_i.data(), v(x), mask, lanes); break;
+        case kernel::ld_vx_dt: kernels.logic_u8(v(x), m_dt.data(), 0, mask, lanes); break;
+        case kernel::ld_dt_vx: kernels.logic_u8(m_dt.data(), v(x), 0, mask, lanes); break;
+        case kernel::ld_st_vx: kernels.logic_u8(m_st.data(), v(x), 0, mask, lanes); break;
+        case kernel::scalar: break;
+    }
+}
+
+void batch::run_frame(const std::size_t& cycles)
+{
+    // the budgets are 16 bit
+    for(std::size_t done = 0; done < cycles; )
+    {
+        const std::size_t chunk = std::min<std::size_t>(cycles - done, 0xFFFF);
+        run(static_cast<std::uint16_t>(chunk));
+        done += chunk;
+    }
+
+    // cpu::tick_timers on every lane
+    m_kernels->sub_sat_u8(m_dt.data(), 1, m_padded);
+    m_kernels->sub_sat_u8(m_st.data(), 1, m_padded);
+}
+
+const cpu& batch::get_lane(const std::size_t& lane)
+{
+    load_lane(lane);
+    return *m_cpus[lane];
+}
+
+void batch::set_seed(const std::size_t& lane, const std::uint64_t& seed)
+{
+    m_cpus[lane]->set_seed(seed);
+}
+
+void batch::set_key_down(const std::size_t& lane, const std::uint8_t& key)
+{
+    m_cpus[lane]->set_key_down(key);
+}
+
+void batch::set_key_up(const std::size_t& lane, const std::uint8_t& key)
+{
+    m_cpus[lane]->set_key_up(key);
+}
+
+std::uint64_t batch::get_vector_instructions() const
+{
+    return m_vector_instructions;
+}
+
+std::uint64_t batch::get_scalar_instructions() const
+{
+    return m_scalar_instructions;
+}
+
+}
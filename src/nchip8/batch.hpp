@@ -0,0 +1,216 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_BATCH_HPP
+#define NCHIP8_BATCH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  The lane kernels of a batch, one set per instruction set (see batch::set_kernels)
+//! @details Every array holds one element per lane and is padded to batch::lane_align lanes,
+//!          mask bytes are 0xFF for the lanes an operation applies to and 0x00 for the others.
+struct batch_kernels
+{
+    //! How the kernels were built: "avx2", "sse2" or "scalar"
+    const char* m_name;
+
+    //! dst = value
+    void (*set_u8)(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst += value
+    void (*add_imm_u8)(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst = src, dst |= src, dst &= src, dst ^= src (op 0-3, like 8xy0-8xy3)
+    void (*logic_u8)(std::uint8_t* dst, const std::uint8_t* src, int op, const std::uint8_t* mask, std::size_t lanes);
+
+    //! x += y, flag = carry (8xy4)
+    void (*add_carry_u8)(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag,
+                         const std::uint8_t* mask, std::size_t lanes);
+
+    //! x = x - y, flag = x > y (8xy5), or x = y - x, flag = y > x when reverse (8xy7)
+    void (*sub_u8)(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag, bool reverse,
+                   const std::uint8_t* mask, std::size_t lanes);
+
+    //! pc += 2 where (a == b) == equal, b = nullptr compares against value instead (3xkk, 4xkk, 5xy0, 9xy0)
+    void (*skip_u16)(std::uint16_t* pc, const std::uint8_t* a, const std::uint8_t* b, std::uint8_t value, bool equal,
+                     const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst = value (1nnn, Annn)
+    void (*set_u16)(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst += value
+    void (*add_imm_u16)(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst += src, src zero extended (Fx1E)
+    void (*add_u8_u16)(std::uint16_t* dst, const std::uint8_t* src, const std::uint8_t* mask, std::size_t lanes);
+
+    //! dst = dst > value ? dst - value : 0 on every lane (the timers)
+    void (*sub_sat_u8)(std::uint8_t* dst, std::uint8_t value, std::size_t lanes);
+
+    //! pending = budget != 0 on every lane, returns the number of pending lanes
+    std::size_t (*pending_u16)(std::uint8_t* pending, const std::uint16_t* budget, std::size_t lanes);
+
+    //! mask = pending && pc == value && (shared && !own), then pending &= ~mask on every lane,
+    //! returns the number of lanes in mask (forms a group, see batch)
+    std::size_t (*group_u16)(std::uint8_t* mask, std::uint8_t* pending, const std::uint16_t* pc, std::uint16_t value,
+                             const std::uint8_t* own, std::uint8_t shared, std::size_t lanes);
+};
+
+//! @brief  The kernels of an instruction set, nullptr if it was not built in (see batch_sse2.cpp, batch_avx2.cpp)
+const batch_kernels* batch_kernels_scalar();
+const batch_kernels* batch_kernels_sse2();
+const batch_kernels* batch_kernels_avx2();
+
+//! @brief  Many instances of one ROM executed in lockstep
+//! @details The registers, I, PC and the timers of every instance (lane) are kept as structure of arrays.
+//!          Each pass finds the groups of lanes that are about to execute the same instruction at the same PC:
+//!          the ALU, load, skip and jump instructions of a group run as one SIMD kernel over all lanes (masked
+//!          to the group). Everything else runs on the lane's own cpu, with its registers copied in and out,
+//!          and keeps running there up to the next instruction a kernel could take, where the lanes meet again.
+//!          RAM, the screen, the stack and the keys always live in the cpus, which start as forks of one cpu,
+//!          so lanes share the pages they have not written.
+//!          Lanes are independent, so a lane executes exactly the instructions a lone cpu would, in the same order,
+//!          however far it runs ahead of the others within a frame.
+class batch
+{
+public:
+    //! Lanes are padded to a multiple of this, the widest kernel (AVX2) handles 32 u8 lanes at a time
+    static constexpr std::size_t lane_align = 32;
+
+    //! Groups smaller than this run scalar, the kernel costs about as much as a few scalar instructions
+    static constexpr std::size_t min_group = 4;
+
+    //! A lane running on its own cpu only rejoins the others where at least this many instructions in a row
+    //! run as kernels, copying its registers in and out costs about as much as a few scalar instructions
+    static constexpr std::size_t min_streak = 4;
+
+    //! Groups a pass looks for, each costs a pass over the lanes (lanes that diverged wait for no group)
+    static constexpr std::size_t max_groups = 4;
+
+    //! Instructions a lane that did not make a group runs on its own before it looks for one again
+    static constexpr std::uint32_t scalar_slice = 64;
+
+    //! @param start    Every lane starts as a fork of it
+    //! @param lanes    Number of instances
+    batch(const cpu& start, const std::size_t& lanes);
+
+    //! @brief  Use the kernels of an instruction set instead of the best one the host supports
+    void set_kernels(const batch_kernels* kernels);
+
+    //! @brief  The kernels in use
+    const batch_kernels& get_kernels() const;
+
+    std::size_t get_lanes() const;
+
+    //! @brief  Executes one instruction on every lane that is not halted
+    void step();
+
+    //! @brief  Executes cycles instructions on every lane that is not halted,
+    //!         then ticks the timers once (a 60Hz frame in virtual time)
+    void run_frame(const std::size_t& cycles);
+
+    //! @brief  The cpu of a lane, with the lane's registers copied back into it
+    const cpu& get_lane(const std::size_t& lane);
+
+    //! @brief  Seed RND of a lane (e.g. a seed sweep)
+    void set_seed(const std::size_t& lane, const std::uint64_t& seed);
+
+    //! @brief  Hold or release a key of a lane
+    void set_key_down(const std::size_t& lane, const std::uint8_t& key);
+    void set_key_up(const std::size_t& lane, const std::uint8_t& key);
+
+    //! @brief  Lane instructions executed by the SIMD kernels, and on the lanes' own cpus
+    std::uint64_t get_vector_instructions() const;
+    std::uint64_t get_scalar_instructions() const;
+
+private:
+    //! What a handler of the decode table runs as, see kernel_of
+    enum class kernel : std::uint8_t
+    {
+        scalar,
+        ld_vx_kk, add_vx_kk,
+        ld_vx_vy, or_vx_vy, and_vx_vy, xor_vx_vy, add_vx_vy, sub_vx_vy, subn_vx_vy,
+        se_vx_kk, sne_vx_kk, se_vx_vy, sne_vx_vy,
+        jp, ld_i_nnn, add_i_vx,
+        ld_vx_dt, ld_dt_vx, ld_st_vx
+    };
+
+    std::vector<std::unique_ptr<cpu>> m_cpus;
+    std::size_t m_lanes;
+    std::size_t m_padded;
+
+    //! The RAM every lane started with, lanes that never wrote RAM fetch the same instructions from it
+    std::unique_ptr<cpu> m_image;
+
+    //! Structure of arrays, V0-VF of lane n at m_v[register * m_padded + n]
+    std::vector<std::uint8_t> m_v;
+    std::vector<std::uint16_t> m_i;
+    std::vector<std::uint16_t> m_pc;
+    std::vector<std::uint8_t> m_dt;
+    std::vector<std::uint8_t> m_st;
+
+    //! 0xFF for lanes that are not halted
+    std::vector<std::uint8_t> m_running;
+
+    //! 0xFF for lanes that wrote their RAM, their instructions have to be fetched from their own cpu
+    std::vector<std::uint8_t> m_own_ram;
+
+    //! Instructions each lane has left to execute in the current run
+    std::vector<std::uint16_t> m_budget;
+
+    //! 0xFF for lanes that have a budget and did not execute yet in the current pass
+    std::vector<std::uint8_t> m_pending;
+
+    //! The group a kernel runs on
+    std::vector<std::uint8_t> m_mask;
+
+    //! Instructions the kernels take in a row from each address of the image, up to the first jump (see min_streak)
+    std::vector<std::uint8_t> m_streak;
+
+    //! Kernel of every handler id of the lanes' decode table
+    std::array<kernel, 256> m_kernel_of {};
+
+    //! Addresses of the image that hold an instruction that writes RAM (Fx33, Fx55, 5xy2),
+    //! a lane runs the code of the image until it first writes, after that m_own_ram is set for good
+    std::vector<bool> m_writes_ram;
+
+    //! Lanes with m_own_ram set
+    std::size_t m_own_lanes = 0;
+
+    const batch_kernels* m_kernels;
+
+    std::uint64_t m_vector_instructions = 0;
+    std::uint64_t m_scalar_instructions = 0;
+
+    //! @brief  Copies the registers of a lane into its cpu, and back
+    void load_lane(const std::size_t& lane);
+    void store_lane(const std::size_t& lane);
+
+    //! @brief  What instruction runs as, given its handler id
+    kernel kernel_for(const std::uint16_t& instruction, const std::uint8_t& id) const;
+
+    //! @brief  Executes instructions on every lane that is not halted
+    void run(const std::uint16_t& instructions);
+
+    //! @brief              Executes instructions of a lane on its cpu, at least one and at most its budget
+    //! @param regroup      Stop before the next instruction that starts a streak of min_streak kernels
+    //!                     (so the lane can rejoin a group), otherwise stop after scalar_slice instructions
+    void run_scalar(const std::size_t& lane, const bool& regroup);
+
+    //! @brief  Runs a kernel on the lanes of m_mask, that all execute instruction
+    void run_kernel(const kernel& k, const std::uint16_t& instruction);
+};
+
+}
+
+#endif //NCHIP8_BATCH_HPP
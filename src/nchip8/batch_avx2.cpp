@@ -0,0 +1,88 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "batch_simd.hpp"
+
+// The AVX2 batch kernels, 32 u8 lanes (16 u16 lanes) per register.
+// Only this file is built with -mavx2 (see CMakeLists.txt), batch picks it when the host cpu has AVX2.
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace nchip8
+{
+
+namespace
+{
+
+struct avx2
+{
+    using reg = __m256i;
+    static constexpr std::size_t bytes = 32;
+
+    static reg load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    static void store(void* p, const reg& v) { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+
+    static reg set1_8(const std::uint8_t& v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+    static reg set1_16(const std::uint16_t& v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+    static reg ones() { return _mm256_set1_epi8(-1); }
+    static reg zero() { return _mm256_setzero_si256(); }
+
+    static reg add8(const reg& a, const reg& b) { return _mm256_add_epi8(a, b); }
+    static reg sub8(const reg& a, const reg& b) { return _mm256_sub_epi8(a, b); }
+    static reg add16(const reg& a, const reg& b) { return _mm256_add_epi16(a, b); }
+    static reg and_(const reg& a, const reg& b) { return _mm256_and_si256(a, b); }
+    static reg or_(const reg& a, const reg& b) { return _mm256_or_si256(a, b); }
+    static reg xor_(const reg& a, const reg& b) { return _mm256_xor_si256(a, b); }
+    static reg andnot(const reg& a, const reg& b) { return _mm256_andnot_si256(a, b); }
+    static reg cmpeq8(const reg& a, const reg& b) { return _mm256_cmpeq_epi8(a, b); }
+    static reg cmpeq16(const reg& a, const reg& b) { return _mm256_cmpeq_epi16(a, b); }
+    static reg max8u(const reg& a, const reg& b) { return _mm256_max_epu8(a, b); }
+    static reg subs8u(const reg& a, const reg& b) { return _mm256_subs_epu8(a, b); }
+    static reg blend(const reg& mask, const reg& a, const reg& b) { return _mm256_blendv_epi8(b, a, mask); }
+
+    // the unpacks work within 128 bit halves, the conversions keep the lanes in order:
+    // 0xFF sign extends to 0xFFFF for the masks, values zero extend
+    static reg mask16(const std::uint8_t* p)
+    {
+        return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    static reg widen8(const std::uint8_t* p)
+    {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    // the pack interleaves the 128 bit halves of lo and hi, the permute puts them back in order
+    static reg narrow16(const reg& lo, const reg& hi)
+    {
+        return _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+    }
+
+    static std::uint32_t movemask8(const reg& v) { return static_cast<std::uint32_t>(_mm256_movemask_epi8(v)); }
+};
+
+}
+
+const batch_kernels* batch_kernels_avx2()
+{
+    return simd_kernels<avx2>::table("avx2");
+}
+
+}
+
+#else
+
+namespace nchip8
+{
+
+const batch_kernels* batch_kernels_avx2()
+{
+    return nullptr;
+}
+
+}
+
+#endif
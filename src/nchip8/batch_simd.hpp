@@ -0,0 +1,221 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_BATCH_SIMD_HPP
+#define NCHIP8_BATCH_SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "batch.hpp"
+
+namespace nchip8
+{
+
+//! @brief  The batch_kernels written once over the vector operations of an instruction set
+//! @details V wraps one register type and its intrinsics (see batch_sse2.cpp, batch_avx2.cpp):
+//!          reg, bytes (u8 lanes per register), load, store, set1_8, set1_16, add8, sub8, add16,
+//!          and_, or_, xor_, andnot (~a & b), cmpeq8, cmpeq16, max8u, subs8u, ones, blend (mask ? a : b),
+//!          mask16 (bytes/2 mask bytes widened to u16 masks), widen8 (bytes/2 u8 lanes zero extended to u16),
+//!          narrow16 (two registers of u16 masks packed into u8 masks, in lane order), zero and movemask8.
+//!          Every lane count is a multiple of batch::lane_align, so there are no tails.
+//!          Each instruction set instantiates this in its own translation unit, built with its own flags.
+template<typename V>
+struct simd_kernels
+{
+    using reg = typename V::reg;
+
+    static constexpr std::size_t u8_lanes = V::bytes;
+    static constexpr std::size_t u16_lanes = V::bytes / 2;
+
+    static void set_u8(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg v = V::set1_8(value);
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            V::store(dst + i, V::blend(V::load(mask + i), v, V::load(dst + i)));
+        }
+    }
+
+    static void add_imm_u8(std::uint8_t* dst, std::uint8_t value, const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg v = V::set1_8(value);
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            V::store(dst + i, V::add8(V::load(dst + i), V::and_(V::load(mask + i), v)));
+        }
+    }
+
+    static void logic_u8(std::uint8_t* dst, const std::uint8_t* src, int op, const std::uint8_t* mask, std::size_t lanes)
+    {
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            const reg d = V::load(dst + i);
+            const reg s = V::load(src + i);
+            reg r;
+
+            switch(op)
+            {
+                case 0: r = s; break;
+                case 1: r = V::or_(d, s); break;
+                case 2: r = V::and_(d, s); break;
+                default: r = V::xor_(d, s); break;
+            }
+
+            V::store(dst + i, V::blend(V::load(mask + i), r, d));
+        }
+    }
+
+    static void add_carry_u8(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag,
+                             const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg one = V::set1_8(1);
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            const reg m = V::load(mask + i);
+            const reg a = V::load(x + i);
+            const reg sum = V::add8(a, V::load(y + i));
+
+            // it wrapped if the sum is below x
+            const reg carry = V::andnot(V::cmpeq8(V::max8u(sum, a), sum), V::ones());
+
+            V::store(x + i, V::blend(m, sum, a));
+            V::store(flag + i, V::blend(m, V::and_(carry, one), V::load(flag + i)));
+        }
+    }
+
+    static void sub_u8(std::uint8_t* x, const std::uint8_t* y, std::uint8_t* flag, bool reverse,
+                       const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg one = V::set1_8(1);
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            const reg m = V::load(mask + i);
+            const reg vx = V::load(x + i);
+            const reg vy = V::load(y + i);
+            const reg a = reverse ? vy : vx;
+            const reg b = reverse ? vx : vy;
+
+            // a > b: the larger of the two is a, and they differ
+            const reg greater = V::andnot(V::cmpeq8(a, b), V::cmpeq8(V::max8u(a, b), a));
+
+            V::store(x + i, V::blend(m, V::sub8(a, b), vx));
+            V::store(flag + i, V::blend(m, V::and_(greater, one), V::load(flag + i)));
+        }
+    }
+
+    static void skip_u16(std::uint16_t* pc, const std::uint8_t* a, const std::uint8_t* b, std::uint8_t value, bool equal,
+                         const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg two = V::set1_16(2);
+        const reg imm = V::set1_16(value);
+
+        for(std::size_t i = 0; i < lanes; i += u16_lanes)
+        {
+            const reg eq = V::cmpeq16(V::widen8(a + i), b ? V::widen8(b + i) : imm);
+            const reg cond = equal ? eq : V::andnot(eq, V::ones());
+            const reg step = V::and_(V::and_(cond, V::mask16(mask + i)), two);
+
+            V::store(pc + i, V::add16(V::load(pc + i), step));
+        }
+    }
+
+    static void set_u16(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg v = V::set1_16(value);
+
+        for(std::size_t i = 0; i < lanes; i += u16_lanes)
+        {
+            V::store(dst + i, V::blend(V::mask16(mask + i), v, V::load(dst + i)));
+        }
+    }
+
+    static void add_imm_u16(std::uint16_t* dst, std::uint16_t value, const std::uint8_t* mask, std::size_t lanes)
+    {
+        const reg v = V::set1_16(value);
+
+        for(std::size_t i = 0; i < lanes; i += u16_lanes)
+        {
+            V::store(dst + i, V::add16(V::load(dst + i), V::and_(V::mask16(mask + i), v)));
+        }
+    }
+
+    static void add_u8_u16(std::uint16_t* dst, const std::uint8_t* src, const std::uint8_t* mask, std::size_t lanes)
+    {
+        for(std::size_t i = 0; i < lanes; i += u16_lanes)
+        {
+            const reg add = V::and_(V::mask16(mask + i), V::widen8(src + i));
+            V::store(dst + i, V::add16(V::load(dst + i), add));
+        }
+    }
+
+    static void sub_sat_u8(std::uint8_t* dst, std::uint8_t value, std::size_t lanes)
+    {
+        const reg v = V::set1_8(value);
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            V::store(dst + i, V::subs8u(V::load(dst + i), v));
+        }
+    }
+
+    static std::size_t pending_u16(std::uint8_t* pending, const std::uint16_t* budget, std::size_t lanes)
+    {
+        std::size_t count = 0;
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            const reg done = V::narrow16(V::cmpeq16(V::load(budget + i), V::zero()),
+                                         V::cmpeq16(V::load(budget + i + u16_lanes), V::zero()));
+            const reg p = V::andnot(done, V::ones());
+
+            V::store(pending + i, p);
+            count += __builtin_popcount(V::movemask8(p));
+        }
+
+        return count;
+    }
+
+    static std::size_t group_u16(std::uint8_t* mask, std::uint8_t* pending, const std::uint16_t* pc, std::uint16_t value,
+                                 const std::uint8_t* own, std::uint8_t shared, std::size_t lanes)
+    {
+        const reg v = V::set1_16(value);
+        const reg s = V::set1_8(shared);
+        std::size_t count = 0;
+
+        for(std::size_t i = 0; i < lanes; i += u8_lanes)
+        {
+            const reg at_pc = V::narrow16(V::cmpeq16(V::load(pc + i), v), V::cmpeq16(V::load(pc + i + u16_lanes), v));
+            const reg p = V::load(pending + i);
+            const reg m = V::and_(V::and_(p, at_pc), V::andnot(V::load(own + i), s));
+
+            V::store(mask + i, m);
+            V::store(pending + i, V::andnot(m, p));
+            count += __builtin_popcount(V::movemask8(m));
+        }
+
+        return count;
+    }
+
+    //! @brief  The kernels as a batch_kernels table
+    static const batch_kernels* table(const char* name)
+    {
+        static const batch_kernels kernels = {
+            name,
+            &set_u8, &add_imm_u8, &logic_u8, &add_carry_u8, &sub_u8,
+            &skip_u16, &set_u16, &add_imm_u16, &add_u8_u16, &sub_sat_u8,
+            &pending_u16, &group_u16
+        };
+
+        return &kernels;
+    }
+};
+
+}
+
+#endif //NCHIP8_BATCH_SIMD_HPP
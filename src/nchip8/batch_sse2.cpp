@@ -0,0 +1,85 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "batch_simd.hpp"
+
+// The SSE2 batch kernels, 16 u8 lanes (8 u16 lanes) per register. SSE2 is part of x86-64.
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+namespace nchip8
+{
+
+namespace
+{
+
+struct sse2
+{
+    using reg = __m128i;
+    static constexpr std::size_t bytes = 16;
+
+    static reg load(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+    static void store(void* p, const reg& v) { _mm_storeu_si128(static_cast<__m128i*>(p), v); }
+
+    static reg set1_8(const std::uint8_t& v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static reg set1_16(const std::uint16_t& v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static reg ones() { return _mm_set1_epi8(-1); }
+    static reg zero() { return _mm_setzero_si128(); }
+
+    static reg add8(const reg& a, const reg& b) { return _mm_add_epi8(a, b); }
+    static reg sub8(const reg& a, const reg& b) { return _mm_sub_epi8(a, b); }
+    static reg add16(const reg& a, const reg& b) { return _mm_add_epi16(a, b); }
+    static reg and_(const reg& a, const reg& b) { return _mm_and_si128(a, b); }
+    static reg or_(const reg& a, const reg& b) { return _mm_or_si128(a, b); }
+    static reg xor_(const reg& a, const reg& b) { return _mm_xor_si128(a, b); }
+    static reg andnot(const reg& a, const reg& b) { return _mm_andnot_si128(a, b); }
+    static reg cmpeq8(const reg& a, const reg& b) { return _mm_cmpeq_epi8(a, b); }
+    static reg cmpeq16(const reg& a, const reg& b) { return _mm_cmpeq_epi16(a, b); }
+    static reg max8u(const reg& a, const reg& b) { return _mm_max_epu8(a, b); }
+    static reg subs8u(const reg& a, const reg& b) { return _mm_subs_epu8(a, b); }
+
+    // no blendv before SSE4.1
+    static reg blend(const reg& mask, const reg& a, const reg& b) { return or_(and_(mask, a), andnot(mask, b)); }
+
+    // 8 mask bytes, each doubled into a u16 mask
+    static reg mask16(const std::uint8_t* p)
+    {
+        const reg m = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+        return _mm_unpacklo_epi8(m, m);
+    }
+
+    static reg widen8(const std::uint8_t* p)
+    {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+    }
+
+    // the masks are 0 or -1, the saturating pack keeps them
+    static reg narrow16(const reg& lo, const reg& hi) { return _mm_packs_epi16(lo, hi); }
+    static std::uint32_t movemask8(const reg& v) { return static_cast<std::uint32_t>(_mm_movemask_epi8(v)); }
+};
+
+}
+
+const batch_kernels* batch_kernels_sse2()
+{
+    return simd_kernels<sse2>::table("sse2");
+}
+
+}
+
+#else
+
+namespace nchip8
+{
+
+const batch_kernels* batch_kernels_sse2()
+{
+    return nullptr;
+}
+
+}
+
+#endif
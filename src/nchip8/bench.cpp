@@ -0,0 +1,805 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "bench.hpp"
+#include "batch.hpp"
+#include "gym.hpp"
+#include "cpu.hpp"
+#include "rom_generator.hpp"
+#include "pc_profiler.hpp"
+#include "rewind_buffer.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+namespace nchip8
+{
+
+bench::bench(const std::size_t& frames, const std::size_t& cycles_per_frame, const std::size_t& repeats) :
+    m_frames(frames),
+    m_cycles_per_frame(cycles_per_frame),
+    m_repeats(repeats)
+{
+
+}
+
+void bench::set_profiling(const bool& profiling)
+{
+    m_profiling = profiling;
+}
+
+void bench::set_quirks(const quirk_profile& profile)
+{
+    m_quirks = profile;
+}
+
+void bench::set_seed(const std::uint64_t& seed)
+{
+    m_seed = seed;
+}
+
+// peak resident set size of the process in kilobytes
+static long peak_rss_kb()
+{
+    ::rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+bench::result bench::run_rom(const rom_entry& rom) const
+{
+    // the first run also warms up the caches and the branch predictor,
+    // keeping the fastest run filters out most of the scheduler noise
+    result best = run_rom_once(rom);
+
+    for(std::size_t i = 1; i < m_repeats; i++)
+    {
+        result res = run_rom_once(rom);
+        if(res.m_seconds < best.m_seconds) best = res;
+    }
+
+    return best;
+}
+
+bench::result bench::run_rom_once(const rom_entry& rom) const
+{
+    result res;
+    res.m_name = rom.m_name;
+
+    // cpu is a few kilobytes, keep it off the stack
+    auto chip8 = std::make_unique<cpu>();
+    chip8->set_trace(false);
+    chip8->set_quirks(rom.m_quirks.value_or(m_quirks));
+    chip8->set_seed(m_seed);
+
+    if(!chip8->load_rom(rom.m_data, 0x200))
+    {
+        return res;
+    }
+
+    pc_profiler profiler;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(std::size_t frame = 0; frame < m_frames && !chip8->is_halted(); frame++)
+    {
+        for(std::size_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            if(!chip8->execute_op_at_pc()) break;
+            if(m_profiling) profiler.tick(*chip8);
+            res.m_instructions++;
+        }
+
+        chip8->tick_timers();
+        res.m_frames++;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    res.m_seconds = std::chrono::duration<double>(end - start).count();
+    res.m_peak_rss_kb = peak_rss_kb();
+    res.m_op_stats = chip8->get_op_stats();
+
+    if(m_profiling)
+    {
+        std::stringstream report;
+        profiler.write_report(report, *chip8);
+        res.m_profile_report = report.str();
+    }
+
+    if(res.m_seconds > 0.0)
+    {
+        res.m_mips = (res.m_instructions / res.m_seconds) / 1e6;
+        res.m_fps = res.m_frames / res.m_seconds;
+    }
+
+    if(res.m_instructions > 0)
+    {
+        res.m_ns_per_inst = (res.m_seconds * 1e9) / res.m_instructions;
+    }
+
+    return res;
+}
+
+bench::state_result bench::run_state_rom(const rom_entry& rom) const
+{
+    state_result res;
+    res.m_name = rom.m_name;
+
+    auto chip8 = std::make_unique<cpu>();
+    chip8->set_trace(false);
+    chip8->set_quirks(rom.m_quirks.value_or(m_quirks));
+    chip8->set_seed(m_seed);
+
+    if(!chip8->load_rom(rom.m_data, 0x200))
+    {
+        return res;
+    }
+
+    // get the rom past its setup, so RAM and the screen look like a running program
+    for(std::size_t frame = 0; frame < m_frames && !chip8->is_halted(); frame++)
+    {
+        for(std::size_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            if(!chip8->execute_op_at_pc()) break;
+        }
+
+        chip8->tick_timers();
+    }
+
+    // a round-trip per frame is the intended use, time a few seconds worth of them
+    constexpr std::size_t round_trips = 1000;
+
+    auto time_round_trips = [&chip8](const bool& compress, double& save_ns, double& load_ns)
+    {
+        std::vector<std::uint8_t> state;
+        chip8->save_state(state, compress);
+
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < round_trips; i++) chip8->save_state(state, compress);
+        auto middle = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < round_trips; i++) chip8->load_state(state);
+        auto end = std::chrono::steady_clock::now();
+
+        save_ns = std::chrono::duration<double, std::nano>(middle - start).count() / round_trips;
+        load_ns = std::chrono::duration<double, std::nano>(end - middle).count() / round_trips;
+
+        return state.size();
+    };
+
+    res.m_raw_bytes = time_round_trips(false, res.m_save_ns, res.m_load_ns);
+    res.m_compressed_bytes = time_round_trips(true, res.m_save_compressed_ns, res.m_load_compressed_ns);
+
+    // keep running with a frame of rewind history per frame, with no budget limit
+    rewind_buffer rewind(SIZE_MAX);
+    double push_seconds = 0.0;
+    std::size_t pushes = 0;
+
+    for(std::size_t frame = 0; frame < m_frames && !chip8->is_halted(); frame++)
+    {
+        for(std::size_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            if(!chip8->execute_op_at_pc()) break;
+        }
+
+        chip8->tick_timers();
+
+        auto start = std::chrono::steady_clock::now();
+        rewind.push(*chip8);
+        push_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        pushes++;
+    }
+
+    if(pushes > 0)
+    {
+        res.m_rewind_bytes_per_second = (rewind.get_bytes() * 60.0) / pushes;
+        res.m_rewind_push_ns = (push_seconds * 1e9) / pushes;
+    }
+
+    return res;
+}
+
+bench::fork_result bench::run_fork_rom(const rom_entry& rom, const std::size_t& children) const
+{
+    fork_result res;
+    res.m_name = rom.m_name;
+    res.m_children = children;
+
+    auto parent = std::make_unique<cpu>();
+    parent->set_trace(false);
+    parent->set_quirks(rom.m_quirks.value_or(m_quirks));
+    parent->set_seed(m_seed);
+
+    if(children == 0 || !parent->load_rom(rom.m_data, 0x200))
+    {
+        return res;
+    }
+
+    auto run_frame = [this](cpu& chip8)
+    {
+        for(std::size_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            if(!chip8.execute_op_at_pc()) break;
+        }
+
+        chip8.tick_timers();
+    };
+
+    for(std::size_t frame = 0; frame < m_frames && !parent->is_halted(); frame++)
+    {
+        run_frame(*parent);
+    }
+
+    // make all the children first (that is the cost being measured), then let each one diverge
+    auto branch = [&](const bool& fork, double& ns, double& bytes)
+    {
+        std::vector<std::unique_ptr<cpu>> family;
+        family.reserve(children);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for(std::size_t i = 0; i < children; i++)
+        {
+            family.push_back(fork ? parent->fork() : parent->clone());
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        ns = std::chrono::duration<double, std::nano>(end - start).count() / children;
+
+        std::size_t total = 0;
+
+        for(std::size_t i = 0; i < children; i++)
+        {
+            // a different key per child, so they don't all take the same path
+            family[i]->set_key_down(i & 0xF);
+            run_frame(*family[i]);
+        }
+
+        for(const auto& child : family)
+        {
+            total += sizeof(cpu) + child->get_private_bytes();
+        }
+
+        bytes = static_cast<double>(total) / children;
+    };
+
+    branch(true, res.m_fork_ns, res.m_fork_bytes);
+    branch(false, res.m_clone_ns, res.m_clone_bytes);
+
+    return res;
+}
+
+bench::batch_result bench::run_batch_rom(const rom_entry& rom, const std::size_t& lanes) const
+{
+    batch_result res;
+    res.m_name = rom.m_name;
+    res.m_lanes = lanes;
+
+    cpu start;
+    start.set_trace(false);
+    start.set_quirks(rom.m_quirks.value_or(m_quirks));
+
+    if(lanes == 0 || !start.load_rom(rom.m_data, 0x200))
+    {
+        return res;
+    }
+
+    // the same machines both ways: forks of start, each with its own seed so RND sends them apart
+    std::vector<std::unique_ptr<cpu>> cpus;
+    cpus.reserve(lanes);
+
+    for(std::size_t lane = 0; lane < lanes; lane++)
+    {
+        cpus.push_back(start.fork());
+        cpus.back()->set_seed(m_seed + lane);
+    }
+
+    auto scalar_start = std::chrono::steady_clock::now();
+
+    for(std::size_t frame = 0; frame < m_frames; frame++)
+    {
+        for(auto& chip8 : cpus)
+        {
+            for(std::size_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+            {
+                if(!chip8->execute_op_at_pc()) break;
+                res.m_instructions++;
+            }
+
+            chip8->tick_timers();
+        }
+    }
+
+    auto scalar_end = std::chrono::steady_clock::now();
+
+    batch lockstep(start, lanes);
+
+    for(std::size_t lane = 0; lane < lanes; lane++)
+    {
+        lockstep.set_seed(lane, m_seed + lane);
+    }
+
+    auto batch_start = std::chrono::steady_clock::now();
+
+    for(std::size_t frame = 0; frame < m_frames; frame++)
+    {
+        lockstep.run_frame(m_cycles_per_frame);
+    }
+
+    auto batch_end = std::chrono::steady_clock::now();
+
+    const std::uint64_t batch_instructions = lockstep.get_vector_instructions() + lockstep.get_scalar_instructions();
+
+    if(res.m_instructions > 0)
+    {
+        res.m_scalar_ns = std::chrono::duration<double, std::nano>(scalar_end - scalar_start).count() / res.m_instructions;
+        res.m_batch_ns = std::chrono::duration<double, std::nano>(batch_end - batch_start).count() / res.m_instructions;
+        res.m_vector_percent = (100.0 * lockstep.get_vector_instructions()) / res.m_instructions;
+    }
+
+    res.m_kernels = lockstep.get_kernels().m_name;
+    res.m_match = batch_instructions == res.m_instructions;
+
+    for(std::size_t lane = 0; lane < lanes && res.m_match; lane++)
+    {
+        res.m_match = lockstep.get_lane(lane).save_state() == cpus[lane]->save_state();
+    }
+
+    return res;
+}
+
+bench::gym_result bench::run_gym_rom(const rom_entry& rom, const std::size_t& envs, const std::size_t& threads) const
+{
+    gym_result res;
+    res.m_name = rom.m_name;
+    res.m_envs = envs;
+
+    cpu start;
+    start.set_trace(false);
+    start.set_quirks(rom.m_quirks.value_or(m_quirks));
+
+    if(envs == 0 || !start.load_rom(rom.m_data, 0x200))
+    {
+        return res;
+    }
+
+    gym_vec_env vec(gym_env(start, m_cycles_per_frame, 0), envs, threads);
+    res.m_threads = vec.get_pool_threads();
+
+    std::vector<std::uint64_t> seeds(envs);
+    std::vector<std::uint16_t> keys(envs);
+    std::vector<std::uint8_t> obs(envs * gym_env::obs_bytes);
+    std::vector<float> rewards(envs);
+    std::vector<std::uint8_t> dones(envs);
+
+    for(std::size_t n = 0; n < envs; n++) seeds[n] = m_seed + n;
+
+    vec.reset(seeds.data(), obs.data());
+
+    const std::size_t steps = std::max<std::size_t>(m_frames / gym_step_frames, 1);
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    for(std::size_t step = 0; step < steps; step++)
+    {
+        // a different key for every env and step, like a random agent
+        for(std::size_t n = 0; n < envs; n++) keys[n] = 1 << ((n * 7 + step * 3) & 0xF);
+
+        vec.step(keys.data(), gym_step_frames, obs.data(), rewards.data(), dones.data());
+
+        for(auto done : dones) res.m_episodes += done ? 1 : 0;
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+    res.m_frames = static_cast<std::uint64_t>(steps) * gym_step_frames * envs;
+
+    if(seconds > 0.0)
+    {
+        res.m_frames_per_second = res.m_frames / seconds;
+        res.m_ns_per_frame = (seconds * 1e9) / res.m_frames;
+    }
+
+    return res;
+}
+
+std::vector<bench::result> bench::run(const std::vector<rom_entry>& corpus) const
+{
+    std::vector<result> results;
+
+    for(const auto& rom : corpus)
+    {
+        results.push_back(run_rom(rom));
+    }
+
+    return results;
+}
+
+// the corpus is written as instructions, convert to the big endian rom layout
+static std::vector<std::uint8_t> from_words(const std::vector<std::uint16_t>& words)
+{
+    std::vector<std::uint8_t> rom;
+
+    for(auto word : words)
+    {
+        rom.push_back(word >> 8);
+        rom.push_back(word & 0x00FF);
+    }
+
+    return rom;
+}
+
+std::vector<bench::rom_entry> bench::builtin_corpus()
+{
+    std::vector<rom_entry> corpus = {
+        // register arithmetic and skips in a tight loop
+        { "alu_loop", from_words({
+            0x6001,     // 200: LD V0, 0x01
+            0x6103,     // 202: LD V1, 0x03
+            0x8014,     // 204: ADD V0, V1
+            0x8103,     // 206: XOR V1, V0
+            0x8206,     // 208: SHR V2
+            0x820E,     // 20A: SHL V2
+            0x8012,     // 20C: AND V0, V1
+            0x8011,     // 20E: OR V0, V1
+            0x7201,     // 210: ADD V2, 0x01
+            0x3200,     // 212: SE V2, 0x00
+            0x1204,     // 214: JP 0x204
+            0x1200,     // 216: JP 0x200
+        })},
+
+        // font sprites drawn over the whole screen, every second pass erases them (collisions)
+        { "draw_font", from_words({
+            0x00E0,     // 200: CLS
+            0x6000,     // 202: LD V0, 0x00
+            0x6100,     // 204: LD V1, 0x00
+            0x6200,     // 206: LD V2, 0x00
+            0xF229,     // 208: LD F, V2
+            0xD015,     // 20A: DRW V0, V1, 5
+            0x7005,     // 20C: ADD V0, 0x05
+            0x7201,     // 20E: ADD V2, 0x01
+            0x4210,     // 210: SNE V2, 0x10
+            0x6200,     // 212: LD V2, 0x00
+            0x303C,     // 214: SE V0, 0x3C
+            0x1208,     // 216: JP 0x208
+            0x6000,     // 218: LD V0, 0x00
+            0x7106,     // 21A: ADD V1, 0x06
+            0x311E,     // 21C: SE V1, 0x1E
+            0x1208,     // 21E: JP 0x208
+            0x6100,     // 220: LD V1, 0x00
+            0x1208,     // 222: JP 0x208
+        })},
+
+        // BCD conversion and full register file stores/loads
+        { "bcd_mem", from_words({
+            0xA300,     // 200: LD I, 0x300
+            0x6500,     // 202: LD V5, 0x00
+            0xF533,     // 204: LD B, V5
+            0xFF55,     // 206: LD [I], VF
+            0xFF65,     // 208: LD VF, [I]
+            0x7501,     // 20A: ADD V5, 0x01
+            0x1204,     // 20C: JP 0x204
+        })},
+
+        // nested subroutine calls
+        { "call_ret", from_words({
+            0x2206,     // 200: CALL 0x206
+            0x7001,     // 202: ADD V0, 0x01
+            0x1200,     // 204: JP 0x200
+            0x220A,     // 206: CALL 0x20A
+            0x00EE,     // 208: RET
+            0x220E,     // 20A: CALL 0x20E
+            0x00EE,     // 20C: RET
+            0x7101,     // 20E: ADD V1, 0x01
+            0x00EE,     // 210: RET
+        })},
+
+        // busy waits on the delay timer, like most games do for frame pacing
+        { "timer_wait", from_words({
+            0x6005,     // 200: LD V0, 0x05
+            0xF015,     // 202: LD DT, V0
+            0xF107,     // 204: LD V1, DT
+            0x3100,     // 206: SE V1, 0x00
+            0x1204,     // 208: JP 0x204
+            0x7201,     // 20A: ADD V2, 0x01
+            0x1200,     // 20C: JP 0x200
+        })},
+
+        // random 8x8 boxes
+        { "rnd_draw", from_words({
+            0xC03F,     // 200: RND V0, 0x3F
+            0xC11F,     // 202: RND V1, 0x1F
+            0xA20A,     // 204: LD I, 0x20A
+            0xD018,     // 206: DRW V0, V1, 8
+            0x1200,     // 208: JP 0x200
+            0xFF81,     // 20A: sprite data
+            0x8181,
+            0x8181,
+            0x81FF,
+        })},
+
+        // random 16x16 boxes on the hires screen, the same loop as rnd_draw
+        { "hires_draw", from_words({
+            0x00FF,     // 200: HIGH
+            0xC07F,     // 202: RND V0, 0x7F
+            0xC13F,     // 204: RND V1, 0x3F
+            0xA20C,     // 206: LD I, 0x20C
+            0xD010,     // 208: DRW V0, V1, 0
+            0x1202,     // 20A: JP 0x202
+            0xFFFF,     // 20C: sprite data
+            0x8001, 0x8001, 0x8001, 0x8001, 0x8001, 0x8001, 0x8001,
+            0x8001, 0x8001, 0x8001, 0x8001, 0x8001, 0x8001, 0x8001,
+            0xFFFF,
+        }), quirk_profile::schip },
+
+        // big digits on the hires screen, scrolled down, right and left
+        { "hires_scroll", from_words({
+            0x00FF,     // 200: HIGH
+            0xC07F,     // 202: RND V0, 0x7F
+            0xC13F,     // 204: RND V1, 0x3F
+            0xC20F,     // 206: RND V2, 0x0F
+            0xF230,     // 208: LD HF, V2
+            0xD01A,     // 20A: DRW V0, V1, 10
+            0x00C1,     // 20C: SCD 1
+            0x00FB,     // 20E: SCR
+            0x00FC,     // 210: SCL
+            0x1202,     // 212: JP 0x202
+        }), quirk_profile::schip },
+
+        // XO-CHIP: random 8x8 sprites on both planes from above 4K (a long I load), scrolled up
+        { "xo_draw", from_words({
+            0x00FF,     // 200: HIGH
+            0xF301,     // 202: PLANE 3
+            0xA220,     // 204: LD I, 0x220
+            0x50F3,     // 206: LD V0 - VF, [I]
+            0xF000,     // 208: LD I, long 0x1000
+            0x1000,
+            0x50F2,     // 20C: LD [I], V0 - VF
+            0xC07F,     // 20E: RND V0, 0x7F
+            0xC13F,     // 210: RND V1, 0x3F
+            0x6200,     // 212: LD V2, 0x00
+            0x3200,     // 214: SE V2, 0x00
+            0xF000,     // 216: LD I, long 0x0000 (skipped, 4 bytes)
+            0x0000,
+            0xD018,     // 21A: DRW V0, V1, 8
+            0x00D1,     // 21C: SCU 1
+            0x120E,     // 21E: JP 0x20E
+            0xFF81,     // 220: sprite data, plane 0
+            0x8181,
+            0x8181,
+            0x81FF,
+            0x003C,     // 228: sprite data, plane 1
+            0x3C3C,
+            0x3C3C,
+            0x3C00,
+        }), quirk_profile::xochip },
+    };
+
+    // one generated rom per preset, each stresses a single engine path
+    for(const auto& name : rom_generator::preset_names())
+    {
+        rom_generator::params p = rom_generator::preset(name).value();
+        p.m_seed = 1;
+
+        corpus.push_back({ "gen_" + name, rom_generator(p).generate() });
+    }
+
+    return corpus;
+}
+
+void bench::write_results(std::ostream& out, const std::vector<result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "rom"
+        << std::setw(12) << "insts"
+        << std::setw(8) << "frames"
+        << std::setw(12) << "seconds"
+        << std::setw(10) << "mips"
+        << std::setw(12) << "ns/inst"
+        << std::setw(12) << "fps"
+        << "peak_rss_kb" << '\n';
+
+    for(const auto& res : results)
+    {
+        out << "  " << std::left << std::dec << std::fixed
+            << std::setw(14) << res.m_name
+            << std::setw(12) << res.m_instructions
+            << std::setw(8) << res.m_frames
+            << std::setw(12) << std::setprecision(6) << res.m_seconds
+            << std::setw(10) << std::setprecision(3) << res.m_mips
+            << std::setw(12) << std::setprecision(3) << res.m_ns_per_inst
+            << std::setw(12) << std::setprecision(1) << res.m_fps
+            << res.m_peak_rss_kb << '\n';
+    }
+}
+
+void bench::write_fork_results(std::ostream& out, const std::vector<fork_result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "rom"
+        << std::setw(10) << "children"
+        << std::setw(10) << "fork_ns"
+        << std::setw(10) << "clone_ns"
+        << std::setw(12) << "fork_b"
+        << "clone_b" << '\n';
+
+    for(const auto& res : results)
+    {
+        out << "  " << std::left << std::dec << std::fixed << std::setprecision(1)
+            << std::setw(14) << res.m_name
+            << std::setw(10) << res.m_children
+            << std::setw(10) << res.m_fork_ns
+            << std::setw(10) << res.m_clone_ns
+            << std::setw(12) << res.m_fork_bytes
+            << res.m_clone_bytes << '\n';
+    }
+}
+
+void bench::write_gym_results(std::ostream& out, const std::vector<gym_result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "rom"
+        << std::setw(8) << "envs"
+        << std::setw(10) << "threads"
+        << std::setw(14) << "frames/s"
+        << std::setw(10) << "ns/frame"
+        << "episodes" << '\n';
+
+    for(const auto& res : results)
+    {
+        out << "  " << std::left << std::dec << std::fixed << std::setprecision(1)
+            << std::setw(14) << res.m_name
+            << std::setw(8) << res.m_envs
+            << std::setw(10) << res.m_threads
+            << std::setw(14) << std::setprecision(0) << res.m_frames_per_second
+            << std::setw(10) << std::setprecision(1) << res.m_ns_per_frame
+            << res.m_episodes << '\n';
+    }
+}
+
+void bench::write_batch_results(std::ostream& out, const std::vector<batch_result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "rom"
+        << std::setw(8) << "lanes"
+        << std::setw(12) << "scalar_ns"
+        << std::setw(10) << "batch_ns"
+        << std::setw(10) << "speedup"
+        << std::setw(10) << "vector%"
+        << std::setw(8) << "isa"
+        << "match" << '\n';
+
+    for(const auto& res : results)
+    {
+        const double speedup = res.m_batch_ns > 0.0 ? res.m_scalar_ns / res.m_batch_ns : 0.0;
+
+        out << "  " << std::left << std::dec << std::fixed << std::setprecision(1)
+            << std::setw(14) << res.m_name
+            << std::setw(8) << res.m_lanes
+            << std::setw(12) << res.m_scalar_ns
+            << std::setw(10) << res.m_batch_ns
+            << std::setw(10) << speedup
+            << std::setw(10) << res.m_vector_percent
+            << std::setw(8) << res.m_kernels
+            << (res.m_match ? "yes" : "NO") << '\n';
+    }
+}
+
+void bench::write_state_results(std::ostream& out, const std::vector<state_result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "rom"
+        << std::setw(10) << "raw_b"
+        << std::setw(10) << "rle_b"
+        << std::setw(10) << "save_ns"
+        << std::setw(10) << "load_ns"
+        << std::setw(12) << "rle_save_ns"
+        << std::setw(12) << "rle_load_ns"
+        << std::setw(14) << "rewind_b/s"
+        << "rewind_push_ns" << '\n';
+
+    for(const auto& res : results)
+    {
+        out << "  " << std::left << std::dec << std::fixed << std::setprecision(1)
+            << std::setw(14) << res.m_name
+            << std::setw(10) << res.m_raw_bytes
+            << std::setw(10) << res.m_compressed_bytes
+            << std::setw(10) << res.m_save_ns
+            << std::setw(10) << res.m_load_ns
+            << std::setw(12) << res.m_save_compressed_ns
+            << std::setw(12) << res.m_load_compressed_ns
+            << std::setw(14) << res.m_rewind_bytes_per_second
+            << res.m_rewind_push_ns << '\n';
+    }
+}
+
+std::vector<bench::result> bench::read_results(std::istream& in)
+{
+    std::vector<result> results;
+    std::string line;
+
+    while(std::getline(in, line))
+    {
+        // skip the header and blank lines
+        auto first = line.find_first_not_of(" \t");
+        if(first == std::string::npos || line[first] == '#') continue;
+
+        std::stringstream fields(line);
+        result res;
+
+        if(fields >> res.m_name >> res.m_instructions >> res.m_frames >> res.m_seconds
+                  >> res.m_mips >> res.m_ns_per_inst >> res.m_fps >> res.m_peak_rss_kb)
+        {
+            results.push_back(res);
+        }
+    }
+
+    return results;
+}
+
+// percentage change from old to new
+static double percent_change(const double& old_value, const double& new_value)
+{
+    if(old_value == 0.0) return 0.0;
+    return ((new_value - old_value) / old_value) * 100.0;
+}
+
+std::size_t bench::compare(const std::vector<result>& baseline,
+                           const std::vector<result>& current,
+                           const double& threshold,
+                           std::ostream& out)
+{
+    std::unordered_map<std::string, const result*> baseline_by_name;
+
+    for(const auto& res : baseline)
+    {
+        baseline_by_name[res.m_name] = &res;
+    }
+
+    std::size_t regressions = 0;
+
+    out << std::left << std::fixed << std::setprecision(1)
+        << std::setw(14) << "rom"
+        << std::setw(14) << "ns/inst %"
+        << std::setw(14) << "fps %"
+        << std::setw(14) << "peak_rss %" << '\n';
+
+    for(const auto& res : current)
+    {
+        if(!baseline_by_name.count(res.m_name))
+        {
+            out << std::setw(14) << res.m_name << "not in baseline" << '\n';
+            continue;
+        }
+
+        const result& base = *baseline_by_name.at(res.m_name);
+
+        // higher is worse for time and memory, lower is worse for frame rate
+        double ns_change  = percent_change(base.m_ns_per_inst, res.m_ns_per_inst);
+        double fps_change = percent_change(base.m_fps, res.m_fps);
+        double rss_change = percent_change(base.m_peak_rss_kb, res.m_peak_rss_kb);
+
+        bool regressed = ns_change > threshold || -fps_change > threshold || rss_change > threshold;
+
+        out << std::setw(14) << res.m_name
+            << std::setw(14) << ns_change
+            << std::setw(14) << fps_change
+            << std::setw(14) << rss_change
+            << (regressed ? "REGRESSION" : "ok") << '\n';
+
+        if(regressed) regressions++;
+    }
+
+    return regressions;
+}
+
+}
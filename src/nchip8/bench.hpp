@@ -0,0 +1,180 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_BENCH_HPP
+#define NCHIP8_BENCH_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "op_stats.hpp"
+#include "quirks.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Headless end-to-end throughput benchmark over a corpus of ROMs
+//! @details Every ROM is ran for a fixed number of frames in virtual time,
+//!          i.e. a frame is a fixed amount of instructions followed by one 60Hz timer tick,
+//!          so two runs of the same ROM execute exactly the same instructions
+class bench
+{
+public:
+    //! @brief A named ROM in the corpus
+    struct rom_entry
+    {
+        std::string m_name;
+        std::vector<std::uint8_t> m_data;
+        std::optional<quirk_profile> m_quirks = std::nullopt;   //! Quirks the ROM needs, instead of the ones of set_quirks
+    };
+
+    //! @brief The measurements for one ROM
+    struct result
+    {
+        std::string m_name;
+        std::uint64_t m_instructions = 0;   //! Guest instructions executed
+        std::uint64_t m_frames = 0;         //! Virtual frames ran
+        double m_seconds = 0.0;             //! Host wall time spent executing
+        double m_mips = 0.0;                //! Guest instructions per host second, in millions
+        double m_ns_per_inst = 0.0;         //! Host nanoseconds per guest instruction
+        double m_fps = 0.0;                 //! Virtual frames per host second
+        long m_peak_rss_kb = 0;             //! Peak resident set size of the process after the run
+        op_stats m_op_stats;                //! Instruction counters (only with NCHIP8_OP_STATS)
+        std::string m_profile_report;       //! PC profiler report, when profiling is on
+    };
+
+    //! @brief Save state sizes and round-trip times for one ROM, see cpu::save_state
+    struct state_result
+    {
+        std::string m_name;
+        std::size_t m_raw_bytes = 0;        //! Size of an uncompressed state
+        std::size_t m_compressed_bytes = 0; //! Size of a compressed state
+        double m_save_ns = 0.0;             //! Host nanoseconds per uncompressed save
+        double m_load_ns = 0.0;             //! Host nanoseconds per uncompressed load
+        double m_save_compressed_ns = 0.0;  //! Host nanoseconds per compressed save
+        double m_load_compressed_ns = 0.0;  //! Host nanoseconds per compressed load
+        double m_rewind_bytes_per_second = 0.0; //! rewind_buffer history per second of frames (60 frames)
+        double m_rewind_push_ns = 0.0;      //! Host nanoseconds per rewind_buffer::push
+    };
+
+    //! @brief Cost of branching a running machine with cpu::fork, against a full copy (cpu::clone)
+    struct fork_result
+    {
+        std::string m_name;
+        std::size_t m_children = 0;     //! Children made of each kind
+        double m_fork_ns = 0.0;         //! Host nanoseconds per fork
+        double m_clone_ns = 0.0;        //! Host nanoseconds per full copy
+        double m_fork_bytes = 0.0;      //! Mean bytes per forked child, after it ran one frame
+        double m_clone_bytes = 0.0;     //! Mean bytes per full copy, after it ran one frame
+    };
+
+    //! @brief Lanes of one ROM ran in lockstep by a batch, against as many separate cpus
+    struct batch_result
+    {
+        std::string m_name;
+        std::size_t m_lanes = 0;            //! Instances of the ROM, lane n seeded with the bench seed + n
+        std::uint64_t m_instructions = 0;   //! Guest instructions executed over all the lanes
+        double m_scalar_ns = 0.0;           //! Host nanoseconds per lane instruction, separate cpus
+        double m_batch_ns = 0.0;            //! Host nanoseconds per lane instruction, batch
+        double m_vector_percent = 0.0;      //! Lane instructions the batch ran in SIMD kernels
+        std::string m_kernels;              //! Instruction set of the kernels, see batch_kernels
+        bool m_match = false;               //! Every lane ended in the same state as its cpu
+    };
+
+    //! @brief Environments of one ROM stepped through a gym_vec_env, the way an agent would
+    struct gym_result
+    {
+        std::string m_name;
+        std::size_t m_envs = 0;             //! Environments, env n reset with the bench seed + n
+        std::size_t m_threads = 0;          //! Threads of the pool
+        std::uint64_t m_frames = 0;         //! Environment frames ran over all the environments
+        double m_frames_per_second = 0.0;   //! Environment frames per host second
+        double m_ns_per_frame = 0.0;        //! Host nanoseconds per environment frame
+        std::uint64_t m_episodes = 0;       //! Episodes that ended (the cpu halted)
+    };
+
+    //! @brief                  Constructor
+    //! @param frames           Number of virtual frames to run each ROM for
+    //! @param cycles_per_frame Number of instructions executed in each frame
+    //! @param repeats          Each ROM is ran this many times and the fastest run is kept
+    bench(const std::size_t& frames, const std::size_t& cycles_per_frame, const std::size_t& repeats = 3);
+
+    //! @brief  Sample the PC of every run with a pc_profiler (this costs a little throughput)
+    void set_profiling(const bool& profiling);
+
+    //! @brief  Run every ROM with the op_handlers of a quirk profile (quirk_profile::nchip8 by default)
+    void set_quirks(const quirk_profile& profile);
+
+    //! @brief  Seed RND with seed in every ROM (0 by default), so runs execute the same instructions
+    void set_seed(const std::uint64_t& seed);
+
+    //! @brief  Runs a single ROM headless (the fastest of the repeats)
+    result run_rom(const rom_entry& rom) const;
+
+    //! @brief  Runs every ROM of a corpus, in order
+    std::vector<result> run(const std::vector<rom_entry>& corpus) const;
+
+    //! @brief  Runs a ROM for the configured frames, then times save/load round-trips of its state
+    state_result run_state_rom(const rom_entry& rom) const;
+
+    //! @brief  Runs a ROM for the configured frames, then branches it into children that run one frame each
+    fork_result run_fork_rom(const rom_entry& rom, const std::size_t& children) const;
+
+    //! @brief  Runs lanes instances of a ROM for the configured frames in a batch, and as separate cpus
+    batch_result run_batch_rom(const rom_entry& rom, const std::size_t& lanes) const;
+
+    //! @brief  Steps envs environments of a ROM for the configured frames, gym_step_frames at a time,
+    //!         into one observation buffer
+    gym_result run_gym_rom(const rom_entry& rom, const std::size_t& envs, const std::size_t& threads) const;
+
+    //! @brief  Writes gym results as a human readable table
+    static void write_gym_results(std::ostream& out, const std::vector<gym_result>& results);
+
+    //! @brief  Frames each step of run_gym_rom holds its keys for (the usual frame skip of agents)
+    static constexpr std::uint32_t gym_step_frames = 4;
+
+    //! @brief  Writes batch results as a human readable table
+    static void write_batch_results(std::ostream& out, const std::vector<batch_result>& results);
+
+    //! @brief  Writes fork results as a human readable table
+    static void write_fork_results(std::ostream& out, const std::vector<fork_result>& results);
+
+    //! @brief  Writes save state results as a human readable table
+    static void write_state_results(std::ostream& out, const std::vector<state_result>& results);
+
+    //! @brief  The synthetic ROMs that are bundled with nchip8
+    static std::vector<rom_entry> builtin_corpus();
+
+    //! @brief  Writes results as a human readable table (that read_results can parse back)
+    static void write_results(std::ostream& out, const std::vector<result>& results);
+
+    //! @brief  Parses results previously written with write_results (i.e. a baseline file)
+    static std::vector<result> read_results(std::istream& in);
+
+    //! @brief              Compares results against a baseline
+    //! @param threshold    Percentage a metric can worsen by before it is flagged as a regression
+    //! @returns            The number of regressions found
+    static std::size_t compare(const std::vector<result>& baseline,
+                               const std::vector<result>& current,
+                               const double& threshold,
+                               std::ostream& out);
+
+private:
+    std::size_t m_frames;
+    std::size_t m_cycles_per_frame;
+    std::size_t m_repeats;
+    bool m_profiling = false;
+    quirk_profile m_quirks = quirk_profile::nchip8;
+    std::uint64_t m_seed = 0;
+
+    //! @brief  Runs a single ROM headless once
+    result run_rom_once(const rom_entry& rom) const;
+};
+
+}
+
+#endif //NCHIP8_BENCH_HPP
@@ -0,0 +1,177 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_COW_ARRAY_HPP
+#define NCHIP8_COW_ARRAY_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace nchip8
+{
+
+//! @brief  A fixed size array split in pages that are shared between copies until written (copy-on-write)
+//! @details Copying a cow_array copies Pages pointers, not the data. Writing to a page that another copy
+//!          still references gives this copy its own page first, so a copy only pays for the pages it touches.
+//!          Copies can live on different threads: a shared page is never written in place.
+//!          Copying only reads the source, so any number of threads can copy one array at once.
+template<typename T, std::size_t PageSize, std::size_t Pages>
+class cow_array
+{
+public:
+    using page = std::array<T, PageSize>;
+
+    static constexpr std::size_t page_size = PageSize;
+    static constexpr std::size_t pages = Pages;
+
+    cow_array()
+    {
+        this->fill(T{});
+    }
+
+    //! @brief  Shares every page with other, other is not changed
+    cow_array(const cow_array& other) = default;
+    cow_array& operator=(const cow_array& other) = default;
+
+    //! @brief  Number of elements
+    static constexpr std::size_t size() { return PageSize * Pages; }
+
+    //! @brief  Read an element
+    const T& operator[](const std::size_t& index) const
+    {
+        return (*m_pages[index / PageSize])[index % PageSize];
+    }
+
+    //! @brief  Writable reference to an element, unshares its page
+    T& mut(const std::size_t& index)
+    {
+        return mut_page(index / PageSize)[index % PageSize];
+    }
+
+    //! @brief  Write an element, unshares its page
+    void set(const std::size_t& index, const T& value)
+    {
+        mut(index) = value;
+    }
+
+    //! @brief  A whole page, read only
+    const page& get_page(const std::size_t& p) const
+    {
+        return *m_pages[p];
+    }
+
+    //! @brief  A whole page, writable (unshared first if needed)
+    page& mut_page(const std::size_t& p)
+    {
+        auto& ptr = m_pages[p];
+
+        // a page is owned while no other copy references it, new references to it can only be made
+        // by copying this array, which does not happen while it is being written
+        if(ptr.use_count() != 1)
+        {
+            ptr = std::make_shared<page>(*ptr);
+        }
+        else
+        {
+            // the other owners may have just let go of it on another thread, see their writes first
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+
+        return *ptr;
+    }
+
+    //! @brief  Sets every element of the first used pages, they all share a single page afterwards
+    //! @details The pages past used are released and must not be accessed (see resize)
+    void fill(const T& value, const std::size_t& used = Pages)
+    {
+        auto filled = std::make_shared<page>();
+        filled->fill(value);
+
+        std::fill(m_pages.begin(), m_pages.begin() + used, filled);
+        std::fill(m_pages.begin() + used, m_pages.end(), nullptr);
+    }
+
+    //! @brief  Keeps the first used pages, releases the ones past it or adds the missing ones (filled with T{})
+    //! @details Released pages cost nothing to copy (no reference count), so an array that is usually
+    //!          only partly in use can be sized for the largest case
+    void resize(const std::size_t& used)
+    {
+        std::shared_ptr<page> empty;
+
+        for(std::size_t p = 0; p < Pages; p++)
+        {
+            if(p >= used)
+            {
+                m_pages[p] = nullptr;
+            }
+            else if(!m_pages[p])
+            {
+                if(!empty) empty = std::make_shared<page>(page{});
+                m_pages[p] = empty;
+            }
+        }
+    }
+
+    //! @brief  Copies count elements out, starting at index
+    void read(std::size_t index, T* out, std::size_t count) const
+    {
+        while(count > 0)
+        {
+            std::size_t offset = index % PageSize;
+            std::size_t n = std::min(count, PageSize - offset);
+
+            std::copy_n(m_pages[index / PageSize]->begin() + offset, n, out);
+
+            index += n; out += n; count -= n;
+        }
+    }
+
+    //! @brief  Copies count elements in, starting at index
+    //! @details Pages whose contents would not change are left shared
+    void write(std::size_t index, const T* in, std::size_t count)
+    {
+        while(count > 0)
+        {
+            std::size_t offset = index % PageSize;
+            std::size_t n = std::min(count, PageSize - offset);
+
+            const page& current = *m_pages[index / PageSize];
+
+            if(!std::equal(in, in + n, current.begin() + offset))
+            {
+                std::copy_n(in, n, mut_page(index / PageSize).begin() + offset);
+            }
+
+            index += n; in += n; count -= n;
+        }
+    }
+
+    //! @brief  Gives this copy its own copy of every page (i.e. what a flat array copy costs)
+    void unshare()
+    {
+        for(std::size_t p = 0; p < Pages; p++)
+        {
+            if(m_pages[p]) mut_page(p);
+        }
+    }
+
+    //! @brief  Pages only referenced by this copy
+    std::size_t get_private_pages() const
+    {
+        return std::count_if(m_pages.begin(), m_pages.end(), [](const std::shared_ptr<page>& ptr)
+        {
+            return ptr.use_count() == 1;
+        });
+    }
+
+private:
+    std::array<std::shared_ptr<page>, Pages> m_pages;
+};
+
+}
+
+#endif //NCHIP8_COW_ARRAY_HPP
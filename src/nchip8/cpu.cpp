@@ -13,13 +13,15 @@
 #include <algorithm>
 #include <ncurses.h>
 #include <iterator>
+#include <array>
+#include <type_traits>
 
 namespace nchip8
 {
 
-cpu::cpu()
+cpu::cpu() :
+    m_decode(&get_decode_table(quirk_profile::nchip8))
 {
-    this->setup_op_handlers();
     this->reset();
 }
 
@@ -42,45 +44,114 @@ const std::vector<std::array<std::uint8_t,5>> font = {
     {0xF0, 0x80, 0xF0, 0x80, 0x80}  // F
 };
 
+// SCHIP 8x10 digit sprites (Fx30), with A-F as later interpreters have them
+const std::vector<std::array<std::uint8_t,10>> big_font = {
+    {0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF}, // 0
+    {0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF}, // 1
+    {0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF}, // 2
+    {0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF}, // 3
+    {0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03}, // 4
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF}, // 5
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF}, // 6
+    {0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18}, // 7
+    {0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF}, // 8
+    {0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF}, // 9
+    {0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3}, // A
+    {0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC}, // B
+    {0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C}, // C
+    {0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC}, // D
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF}, // E
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0}  // F
+};
+
 void cpu::reset()
 {
     // clear registers and memory
     m_gpr.fill(0);
-    m_ram.fill(0x00);
+    m_ram.fill(0x00, (m_ram_mask + 1) / decltype(m_ram)::page_size);
 
     m_pc = 0x200;
+    m_i = 0;
+    m_sp = 0;
     m_stack.fill(0x0000); // fill the stack with junk
 
     m_dt = 0;
     m_st = 0;
 
-    // copy each byte of the font sprite into memory,
+    m_screen.fill(0);
+    m_screen_mode = screen_mode::lores_c8;
+
+    m_halted = false;
+
+    m_planes = 0x1;
+    m_audio_pattern.fill(0);
+    m_audio_pitch = 64;
+
+    m_random.seed(m_seed);
+
+#ifdef NCHIP8_OP_STATS
+    m_op_stats.reset();
+#endif
+
+    // copy each byte of the font sprites into memory,
     // these are loaded sequentially
-    std::uint32_t i = 0;
+    std::uint32_t i = font_address;
     for(std::array<uint8_t,5> character_data : font) {
-        std::copy_n(character_data.begin(), character_data.size(), m_ram.begin() + i);
-        i++;
+        m_ram.write(i, character_data.data(), character_data.size());
+        i += character_data.size();
+    }
+
+    i = big_font_address;
+    for(const auto& character_data : big_font) {
+        m_ram.write(i, character_data.data(), character_data.size());
+        i += character_data.size();
     }
 
-    m_keys_down.fill(false);
+    m_keys_down = 0;
+    m_last_key_down = no_key;
+}
+
+std::unique_ptr<cpu> cpu::fork() const
+{
+    // copying shares the pages, see cow_array
+    auto child = std::make_unique<cpu>(*this);
+
+    // the heatmap belongs to whoever attached it to the parent
+    child->m_heatmap = nullptr;
+
+    return child;
+}
+
+std::unique_ptr<cpu> cpu::clone() const
+{
+    auto copy = this->fork();
+    copy->m_ram.unshare();
+    copy->m_screen.unshare();
+
+    return copy;
+}
+
+std::size_t cpu::get_private_bytes() const
+{
+    return (m_ram.get_private_pages() * sizeof(decltype(m_ram)::page))
+           + (m_screen.get_private_pages() * sizeof(framebuffer::page));
 }
 
 bool cpu::load_rom(const std::vector<std::uint8_t> &rom, const uint16_t& load_addr)
 {
-    // Make sure the rom does not exceed typical loading size
-    // Make sure it'l fit into the remainder of memory from it's load point
-    if (rom.size() < 0xE00 && (load_addr + rom.size()) < 0x1000)
+    // Make sure it'l fit into the remainder of memory from it's load point (4K, 64K for XO-CHIP)
+    if ((load_addr + rom.size()) <= std::size_t(m_ram_mask) + 1)
     {
-        std::copy_n(rom.begin(), rom.size(), m_ram.begin() + load_addr);
+        m_ram.write(load_addr, rom.data(), rom.size());
         return true;
     }
 
     return false;
 }
 
-bool cpu::add_op_handler(const cpu::op_handler &handler)
+bool cpu::add_op_handler(op_tree& tree, decode_table& table, const cpu::op_handler &handler)
 {
-    auto& root = m_op_tree;
+    auto& root = tree;
 
     // add a node to the tree if we don't have one
     // see: https://en.cppreference.com/w/cpp/container/unordered_map/try_emplace
@@ -90,55 +161,88 @@ bool cpu::add_op_handler(const cpu::op_handler &handler)
     auto [node_1_iter, node_1_success] = node_0_iter->second.try_emplace(handler.m_encoding[1]);
     auto [node_2_iter, node_2_success] = node_1_iter->second.try_emplace(handler.m_encoding[2]);
 
-    auto [iter, success] = node_2_iter->second.try_emplace(handler.m_encoding[3], handler);
+    // give the handler an id, so instrumentation can index by it
+    op_handler registered = handler;
+    registered.m_id = table.m_handlers.size();
+
+    auto [iter, success] = node_2_iter->second.try_emplace(handler.m_encoding[3], registered);
+
+    if(success)
+    {
+        table.m_handlers.push_back(registered);
+        table.m_names.emplace_back(handler.m_name);
+    }
 
     return success;
 }
 
-void cpu::setup_op_handlers()
-{
-    add_op_handler(CLS);
-    add_op_handler(RET);
-    // add_op_handler(SYS);
-    add_op_handler(JP);
-    add_op_handler(CALL);
-    add_op_handler(SE_VX_KK);
-    add_op_handler(SNE_VX_KK);
-    add_op_handler(SE_VX_VY);
-    add_op_handler(LD_VX_KK);
-    add_op_handler(ADD_VX_KK);
-    add_op_handler(LD_VX_VY);
-    add_op_handler(OR_VX_VY);
-    add_op_handler(AND_VX_VY);
-    add_op_handler(XOR_VX_VY);
-    add_op_handler(ADD_VX_VY);
-    add_op_handler(SUB_VX_VY);
-    add_op_handler(SHR_VX_VY);
-    add_op_handler(SUBN_VX_VY);
-    add_op_handler(SHL_VX_VY);
-    add_op_handler(SNE_VX_VY);
-    add_op_handler(LD_I_NNN);
-    add_op_handler(JP_V0_NNN);
-    add_op_handler(RND_VX_KK);
-    add_op_handler(DRW_VX_VY_N);
-    add_op_handler(SKP_VX);
-    add_op_handler(SKNP_VX);
-    add_op_handler(LD_VX_DT);
-    add_op_handler(LD_VX_K);
-    add_op_handler(LD_DT_VX);
-    add_op_handler(LD_ST_VX);
-    add_op_handler(ADD_I_VX);
-    add_op_handler(LD_F_VX);
-    add_op_handler(LD_B_VX);
-    add_op_handler(LD_imm_I_VX);
-    add_op_handler(LD_VX_imm_I);
-}
-
-std::optional<cpu::op_handler> cpu::get_op_handler_for_instruction(const std::uint16_t& instruction) const
-{
-    // alias, not really relevant
-    const std::uint16_t &op = instruction;
+template<typename Quirks>
+void cpu::setup_op_handlers(op_tree& tree, decode_table& table)
+{
+    add_op_handler(tree, table, CLS<Quirks>);
+    add_op_handler(tree, table, RET);
+    // add_op_handler(tree, table, SYS);
+    add_op_handler(tree, table, JP);
+    add_op_handler(tree, table, CALL);
+    add_op_handler(tree, table, SE_VX_KK<Quirks>);
+    add_op_handler(tree, table, SNE_VX_KK<Quirks>);
+    add_op_handler(tree, table, SE_VX_VY<Quirks>);
+    add_op_handler(tree, table, LD_VX_KK);
+    add_op_handler(tree, table, ADD_VX_KK);
+    add_op_handler(tree, table, LD_VX_VY);
+    add_op_handler(tree, table, OR_VX_VY);
+    add_op_handler(tree, table, AND_VX_VY);
+    add_op_handler(tree, table, XOR_VX_VY);
+    add_op_handler(tree, table, ADD_VX_VY);
+    add_op_handler(tree, table, SUB_VX_VY);
+    add_op_handler(tree, table, SHR_VX_VY<Quirks>);
+    add_op_handler(tree, table, SUBN_VX_VY);
+    add_op_handler(tree, table, SHL_VX_VY<Quirks>);
+    add_op_handler(tree, table, SNE_VX_VY<Quirks>);
+    add_op_handler(tree, table, LD_I_NNN);
+    add_op_handler(tree, table, JP_V0_NNN<Quirks>);
+    add_op_handler(tree, table, RND_VX_KK);
+    add_op_handler(tree, table, DRW_VX_VY_N<Quirks>);
+    add_op_handler(tree, table, SKP_VX<Quirks>);
+    add_op_handler(tree, table, SKNP_VX<Quirks>);
+    add_op_handler(tree, table, LD_VX_DT);
+    add_op_handler(tree, table, LD_VX_K);
+    add_op_handler(tree, table, LD_DT_VX);
+    add_op_handler(tree, table, LD_ST_VX);
+    add_op_handler(tree, table, ADD_I_VX);
+    add_op_handler(tree, table, LD_F_VX);
+    add_op_handler(tree, table, LD_B_VX);
+    add_op_handler(tree, table, LD_imm_I_VX<Quirks>);
+    add_op_handler(tree, table, LD_VX_imm_I<Quirks>);
+
+    // a profile without them logs the SCHIP instructions as unhandled, like any other unknown instruction
+    if constexpr (Quirks::schip_mode)
+    {
+        add_op_handler(tree, table, SCD_N);
+        add_op_handler(tree, table, SCR);
+        add_op_handler(tree, table, SCL);
+        add_op_handler(tree, table, EXIT);
+        add_op_handler(tree, table, LOW);
+        add_op_handler(tree, table, HIGH);
+        add_op_handler(tree, table, LD_HF_VX);
+        add_op_handler(tree, table, LD_R_VX);
+        add_op_handler(tree, table, LD_VX_R);
+    }
 
+    if constexpr (Quirks::xochip_mode)
+    {
+        add_op_handler(tree, table, SCU_N);
+        add_op_handler(tree, table, LD_imm_I_VX_VY);
+        add_op_handler(tree, table, LD_VX_VY_imm_I);
+        add_op_handler(tree, table, LD_I_LONG);
+        add_op_handler(tree, table, PLANE_N);
+        add_op_handler(tree, table, AUDIO);
+        add_op_handler(tree, table, PITCH_VX);
+    }
+}
+
+const cpu::op_handler* cpu::find_op_handler(const op_tree& root, const std::uint16_t& op)
+{
     // for an instruction 0xABCD
     // we get each nibble, so nibble0 = 0xA, nibble1 = 0xB
     std::uint8_t n3 = (op & 0x000F);
@@ -146,32 +250,110 @@ std::optional<cpu::op_handler> cpu::get_op_handler_for_instruction(const std::ui
     std::uint8_t n1 = (op & 0x0F00) >> 8;
     std::uint8_t n0 = (op & 0xF000) >> 12;
 
-    const auto &root = m_op_tree;
+    if (root.count(n0) == 0)
+    {
+        // no handler found, invalid instruction :(
+        return nullptr;
+    }
 
-    if (root.count(n0) > 0)
+    // each nibble is matched as itself first, then as operand data (optional type),
+    // so F000 (LD I, long) and Fx07 (LD Vx, DT) both decode although F007 could start down either branch
+    auto child = [](const auto& node, const std::uint8_t& nibble)
     {
-        auto &node0 = m_op_tree.at(n0);
+        std::array<const std::remove_reference_t<decltype(node.begin()->second)>*, 2> children {};
 
-        // if we cant find a node that contains the next nibble
-        // and cant find operand data (optional type), there is no handler, return nothing
-        if (!node0.count(n1) && !node0.count(std::nullopt)) return std::nullopt;
+        if (node.count(nibble)) children[0] = &node.at(nibble);
+        if (node.count(std::nullopt)) children[1] = &node.at(std::nullopt);
 
-        // our next node is either indexed by an instruction nibble or an operand data (optional type)
-        auto &node1 = (node0.count(n1) ? node0.at(n1) : node0.at(std::nullopt));
+        return children;
+    };
 
-        // repeat for next node
-        if (!node1.count(n2) && !node1.count(std::nullopt)) return std::nullopt;
-        auto &node2 = (node1.count(n2) ? node1.at(n2) : node1.at(std::nullopt));
+    for (auto* node1 : child(root.at(n0), n1))
+    {
+        if (!node1) continue;
 
-        // repeat for next node
-        if (!node2.count(n3) && !node2.count(std::nullopt)) return std::nullopt;
-        auto &node3 = (node2.count(n3) ? node2.at(n3) : node2.at(std::nullopt));
+        for (auto* node2 : child(*node1, n2))
+        {
+            if (!node2) continue;
 
-        return node3; // the op_handler at the lowest leaf of the tree
+            for (auto* node3 : child(*node2, n3))
+            {
+                if (node3) return node3; // the op_handler at the lowest leaf of the tree
+            }
+        }
     }
 
-    // no handler found, invalid instruction :(
-    return std::nullopt;
+    return nullptr;
+}
+
+template<typename Quirks>
+void cpu::build_decode_table(decode_table& table)
+{
+    op_tree tree;
+    setup_op_handlers<Quirks>(tree, table);
+
+    // walk the tree once for every instruction, executing only ever looks at the index
+    for(std::uint32_t instruction = 0; instruction < table.m_index.size(); instruction++)
+    {
+        const op_handler* handler = find_op_handler(tree, instruction);
+        table.m_index[instruction] = handler ? handler->m_id : no_handler;
+    }
+}
+
+const cpu::decode_table& cpu::get_decode_table(const quirk_profile& profile)
+{
+    // built by whichever thread asks first, the others wait for it (static initialization)
+    auto build = [](auto policy)
+    {
+        auto table = std::make_unique<decode_table>();
+        build_decode_table<decltype(policy)>(*table);
+        return table;
+    };
+
+    switch(profile)
+    {
+        case quirk_profile::chip8: { static const auto table = build(quirks::chip8{}); return *table; }
+        case quirk_profile::schip: { static const auto table = build(quirks::schip{}); return *table; }
+        case quirk_profile::xochip: { static const auto table = build(quirks::xochip{}); return *table; }
+        default: { static const auto table = build(quirks::nchip8{}); return *table; }
+    }
+}
+
+void cpu::set_quirks(const quirk_profile& profile)
+{
+    m_decode = &get_decode_table(profile);
+
+    m_ram_mask = (profile == quirk_profile::xochip) ? 0xFFFF : ram_mask;
+
+    // only the pages under the mask are kept, so forks of a 4K cpu do not copy 64K worth of pages
+    m_ram.resize((m_ram_mask + 1) / decltype(m_ram)::page_size);
+
+    if(m_heatmap) m_heatmap->m_mask = m_ram_mask;
+
+    m_quirks = profile;
+}
+
+const quirk_profile& cpu::get_quirks() const
+{
+    return m_quirks;
+}
+
+void cpu::set_seed(const std::uint64_t& seed)
+{
+    m_seed = seed;
+    m_random.seed(seed);
+}
+
+const std::uint64_t& cpu::get_seed() const
+{
+    return m_seed;
+}
+
+const cpu::op_handler* cpu::get_op_handler_for_instruction(const std::uint16_t& instruction) const
+{
+    const std::uint8_t id = m_decode->m_index[instruction];
+
+    return (id == no_handler) ? nullptr : &m_decode->m_handlers[id];
 }
 
 cpu::operand_data cpu::get_operand_data_from_instruction(const std::uint16_t& instruction) const
@@ -186,111 +368,153 @@ cpu::operand_data cpu::get_operand_data_from_instruction(const std::uint16_t& in
     return operands;
 }
 
-void cpu::execute_op_at_pc()
+bool cpu::execute_op_at_pc()
 {
-    static auto last_clock = std::chrono::high_resolution_clock::now();
-    static bool kill_next_execute = false;
-
     // used to end execution if an error occurs
-    if(kill_next_execute) return;
+    if(m_halted) return false;
 
     // read the encoded instruction
     std::uint16_t instruction = this->read_u16(this->m_pc);
 
+    if(m_heatmap)
+    {
+        m_heatmap->execute(m_pc);
+        m_heatmap->execute(m_pc + 1);
+    }
+
     // get an operation handler for the instruction at PC
-    std::optional<op_handler> handler = get_op_handler_for_instruction(instruction);
+    const op_handler* handler = get_op_handler_for_instruction(instruction);
 
     // if its a valid operation
-    if (handler.has_value())
+    if (handler)
     {
-        // update the delay timer and sleep timer while we're at it
-        // let's check how much time has passed since the last cpu execution
-        auto delta_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::high_resolution_clock::now() - last_clock
-        ).count();
-
-        // if more than a 60th of a second has passed
-        if(delta_duration_ms > (1000/60)) {
-
-            // discover the number of ticks that have passed, aka how many 60ths of a second have passed
-            unsigned long ticks = delta_duration_ms / (1000/60);
+        // now extract the vars from the instruction in order to supply to the handlers
+        operand_data operands = get_operand_data_from_instruction(instruction);
 
-            // update the clock
-            last_clock = std::chrono::high_resolution_clock::now();
+        // disassemble and print to log
+        if(m_trace)
+        {
+            nchip8::log << nchip8::nnn << this->m_pc << ' ';
+            nchip8::log << " " << nchip8::inst << instruction << " ";
+            handler->m_dasm_op(operands,nchip8::log);
+            nchip8::log << std::endl;
+        }
 
-            if(ticks >= m_dt) { m_dt = 0; } else { m_dt -= ticks; }
-            if(ticks >= m_st) { m_st = 0; } else { m_st -= ticks; }
+        // move to the next instruction before executing,
+        // jumps overwrite the program counter and skips add another 2 to it
+        // (this way a jump to itself is a valid infinite loop)
+        this->m_pc += 2;
 
-        }
+#ifdef NCHIP8_OP_STATS
+        m_op_stats.m_counts[handler->m_id]++;
 
-        // if the sound timer is non-zero sound a buzz
-        if(m_st > 0) {
-            // TODO: sound buzz on non-zero sound timer
-        }
+        // only time one in every sample_period instructions, reading the clock costs more than most instructions
+        if(--m_op_stats.m_sample_countdown == 0)
+        {
+            m_op_stats.m_sample_countdown = op_stats::sample_period;
 
-        // save the program counter,
-        // we will compare it after execution to see if a jump was performed
-        std::uint16_t saved_pc = this->m_pc;
+            auto start = std::chrono::steady_clock::now();
+            handler->m_execute_op(*this,operands);
+            auto end = std::chrono::steady_clock::now();
 
-        // now extract the vars from the instruction in order to supply to the handlers
-        operand_data operands = get_operand_data_from_instruction(instruction);
+            m_op_stats.record_time(instruction >> 12,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
 
-        // disassemble and print to log
-        nchip8::log << nchip8::nnn << this->m_pc << ' ';
-        nchip8::log << " " << nchip8::inst << instruction << " ";
-        handler.value().m_dasm_op(operands,nchip8::log);
-        nchip8::log << std::endl;
+            return true;
+        }
+#endif
 
         // execute the operation
-        handler.value().m_execute_op(*this,operands);
+        handler->m_execute_op(*this,operands);
 
-        // if pc wasnt modified by the operation
-        if(saved_pc == this->m_pc)
+        return true;
+    }
+    else {
+        if(m_log)
         {
-            // go to the next instruction
-            this->m_pc+=2;
+            nchip8::log << "unhandled instruction: " << std::hex << instruction << std::endl;
         }
 
-        return;
-    }
-    else {
-        nchip8::log << "unhandled instruction: " << std::hex << instruction << std::endl;
-        kill_next_execute = true;
+        m_halted = true;
     }
+
+    return false;
+}
+
+void cpu::tick_timers(const std::uint32_t& ticks)
+{
+    if(ticks >= m_dt) { m_dt = 0; } else { m_dt -= ticks; }
+    if(ticks >= m_st) { m_st = 0; } else { m_st -= ticks; }
+}
+
+bool cpu::is_halted() const
+{
+    return m_halted;
+}
+
+const op_stats& cpu::get_op_stats() const
+{
+#ifdef NCHIP8_OP_STATS
+    return m_op_stats;
+#else
+    static const op_stats empty;
+    return empty;
+#endif
+}
+
+const std::vector<std::string>& cpu::get_op_names() const
+{
+    return m_decode->m_names;
+}
+
+void cpu::set_ram_heatmap(ram_heatmap* heatmap)
+{
+    m_heatmap = heatmap;
+
+    // the heatmap covers as much RAM as there is
+    if(m_heatmap) m_heatmap->m_mask = m_ram_mask;
+}
+
+void cpu::set_trace(const bool& trace)
+{
+    m_trace = trace;
+}
+
+void cpu::set_log(const bool& log)
+{
+    m_log = log;
 }
 
 std::optional<std::string> cpu::dasm_op(const std::uint16_t& address) const
 {
-//    std::uint16_t instruction = this->read_u16(address);
-//
-//    // get an operation handler for the instruction at PC
-//    std::optional<op_handler> handler = get_op_handler_for_instruction(instruction);
-//
-//    if (handler != std::nullopt)
-//    {
-//        // now extract the vars from the instruction in order to supply to the handlers
-//        operand_data operands = get_operand_data_from_instruction(instruction);
-//
-//        static std::stringstream dasm;
-//        dasm.clear();
-//
-//        handler.value().m_dasm_op(operands, dasm);
-//        dasm << '\'
-//
-//        return dasm.str();
-//    }
+    std::uint16_t instruction = this->read_u16(address);
+
+    // get an operation handler for the instruction at the address
+    const op_handler* handler = get_op_handler_for_instruction(instruction);
+
+    if (handler)
+    {
+        // now extract the vars from the instruction in order to supply to the handlers
+        operand_data operands = get_operand_data_from_instruction(instruction);
+
+        std::stringstream dasm;
+        handler->m_dasm_op(operands, dasm);
+
+        return dasm.str();
+    }
+
     return std::nullopt;
 }
 
 std::uint16_t cpu::read_u16(const std::uint16_t &addr) const
 {
-    return (m_ram[addr] << 8 | m_ram[addr + 1]);
+    return (m_ram[addr & m_ram_mask] << 8 | m_ram[(addr + 1) & m_ram_mask]);
 }
 
 void cpu::set_u16(const std::uint16_t &addr, const std::uint16_t &val)
 {
-    m_ram[addr] = val >> 8;
-    m_ram[addr + 1] = val & 0x00FF;
+    m_ram.set(addr & m_ram_mask, val >> 8);
+    m_ram.set((addr + 1) & m_ram_mask, val & 0x00FF);
 }
 
 const cpu::screen_mode &cpu::get_screen_mode() const
@@ -298,44 +522,108 @@ const cpu::screen_mode &cpu::get_screen_mode() const
     return m_screen_mode;
 }
 
-const std::array<bool, 128*64>& cpu::get_screen_framebuffer() const
+const cpu::framebuffer& cpu::get_screen_framebuffer() const
 {
     return m_screen;
 }
 
 void cpu::set_screen_mode(const cpu::screen_mode &mode)
 {
+    // lores and hires rows are laid out differently, nothing on screen carries over
     m_screen_mode = mode;
+    m_screen.fill(0);
+}
+
+bool cpu::get_framebuffer_xy(const framebuffer& screen, const std::uint8_t &x, const std::uint8_t &y)
+{
+    return get_framebuffer_color(screen, x, y) != 0;
+}
+
+std::uint8_t cpu::get_framebuffer_color(const framebuffer& screen, const std::uint8_t &x, const std::uint8_t &y)
+{
+    // row y is page y whatever the mode, see framebuffer
+    const auto& row = screen.get_page(y & 0x3F);
+    const std::size_t word = (x >> 6) & 0x1;
+    const std::size_t shift = 63 - (x & 0x3F);
+
+    return ((row[word] >> shift) & 0x1) | (((row[plane_words + word] >> shift) & 0x1) << 1);
 }
 
 bool cpu::get_screen_xy(const std::uint8_t &x, const std::uint8_t &y) const
 {
-     // https://stackoverflow.com/a/2151141 : width * row + col
-    auto width = (get_screen_mode() == screen_mode::hires_sc8) ? 128 : 64;
+    return get_framebuffer_xy(m_screen, x, y);
+}
+
+const std::array<std::uint8_t, 16>& cpu::get_audio_pattern() const
+{
+    return m_audio_pattern;
+}
 
-    return m_screen[width*y+x];
+std::uint8_t cpu::get_audio_pitch() const
+{
+    return m_audio_pitch;
 }
 
 void cpu::set_screen_xy(const std::uint8_t &x, const std::uint8_t &y, const bool &set)
 {
-    // https://stackoverflow.com/a/2151141 : width * row + col
-    auto width = (get_screen_mode() == screen_mode::hires_sc8) ? 128 : 64;
+    std::uint64_t& word = m_screen.mut_page(y & 0x3F)[(x >> 6) & 0x1];
+    std::uint64_t bit = std::uint64_t(1) << (63 - (x & 0x3F));
+
+    word = set ? (word | bit) : (word & ~bit);
+}
+
+const std::array<std::uint8_t, 16>& cpu::get_gpr() const
+{
+    return m_gpr;
+}
+
+std::uint16_t cpu::get_i() const
+{
+    return m_i;
+}
+
+std::uint16_t cpu::get_pc() const
+{
+    return m_pc;
+}
+
+std::uint8_t cpu::get_sp() const
+{
+    return m_sp;
+}
 
-    m_screen[width*y+x] = set;
+std::uint8_t cpu::get_dt() const
+{
+    return m_dt;
+}
+
+std::uint8_t cpu::get_st() const
+{
+    return m_st;
+}
+
+std::uint8_t cpu::read_u8(const std::uint16_t &address) const
+{
+    return m_ram[address & m_ram_mask];
+}
+
+std::uint16_t cpu::get_ram_mask() const
+{
+    return m_ram_mask;
 }
 
 void cpu::set_key_down(const std::uint8_t &key)
 {
-    m_keys_down.at(key) = true;
-    m_last_key_down = key;
+    m_keys_down |= 1 << (key & 0xF);
+    m_last_key_down = key & 0xF;
 }
 
 void cpu::set_key_up(const std::uint8_t &key)
 {
-    m_keys_down.at(key) = false;
+    m_keys_down &= ~(1 << (key & 0xF));
 
-    if(key == m_last_key_down) {
-        m_last_key_down = std::nullopt;
+    if((key & 0xF) == m_last_key_down) {
+        m_last_key_down = no_key;
     }
 }
 
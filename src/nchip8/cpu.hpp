@@ -13,6 +13,12 @@
 #include <optional>
 #include <vector>
 
+#include "cow_array.hpp"
+#include "op_stats.hpp"
+#include "prng.hpp"
+#include "quirks.hpp"
+#include "ram_heatmap.hpp"
+
 namespace nchip8
 {
 
@@ -22,7 +28,17 @@ class cpu
 public:
     cpu();
 
-    virtual ~cpu() noexcept = default;
+    //! @brief      Branches the machine, the child continues from the exact same state
+    //! @details    RAM pages and framebuffer rows are shared with the parent (and any other child)
+    //!             until one of them writes to them, so a child costs sizeof(cpu) plus what it touches.
+    //!             The child has no RAM heatmap attached, and may run on another thread than the parent.
+    std::unique_ptr<cpu> fork() const;
+
+    //! @brief      A copy that shares no pages, i.e. what copying the whole cpu used to cost
+    std::unique_ptr<cpu> clone() const;
+
+    //! @brief      Bytes of RAM pages and framebuffer rows that only this cpu references
+    std::size_t get_private_bytes() const;
 
     //! @brief  Clears RAM, registers, the stack, screen etc...
     void reset();
@@ -34,7 +50,51 @@ public:
     bool load_rom(const std::vector<std::uint8_t> &rom, const std::uint16_t& address);
 
     //! @brief Executes the current instruction at PC, (PC may jump or increment afterwards)
-    void execute_op_at_pc();
+    //! @returns    true if an instruction was executed, false if the cpu is halted
+    bool execute_op_at_pc();
+
+    //! @brief      Advances the delay and sound timers by a number of 60Hz ticks
+    //! @details    The cpu has no notion of wall-clock time, whoever drives it decides
+    //!             when a tick has passed (cpu_daemon uses the real clock, bench uses frames)
+    void tick_timers(const std::uint32_t& ticks = 1);
+
+    //! @brief      Returns true if an unhandled instruction (or a SCHIP EXIT) stopped execution
+    bool is_halted() const;
+
+    //! @brief      Per op_handler execution counts and host-time histograms
+    //! @details    Stays empty unless built with NCHIP8_OP_STATS
+    const op_stats& get_op_stats() const;
+
+    //! @brief      Names of the op_handlers, indexed like op_stats::m_counts
+    const std::vector<std::string>& get_op_names() const;
+
+    //! @brief          Attach RAM access counters, nullptr detaches them
+    //! @param heatmap  Must outlive the cpu (or be detached first)
+    void set_ram_heatmap(ram_heatmap* heatmap);
+
+    //! @brief      Switch to the op_handlers of a quirk profile (see quirks.hpp), the machine state is kept
+    //! @details    Rebuilds the handler tree, forks made afterwards share the new one
+    void set_quirks(const quirk_profile& profile);
+
+    //! @brief      The quirk profile the cpu executes with, quirk_profile::nchip8 unless set
+    const quirk_profile& get_quirks() const;
+
+    //! @brief      Seed the RND generator, reset() restarts the same sequence (0 unless set)
+    //! @details    The generator state is part of save states and is copied by fork,
+    //!             so a ROM driven by the same seed and inputs replays exactly
+    void set_seed(const std::uint64_t& seed);
+
+    //! @brief      The seed the RND generator restarts from on reset()
+    const std::uint64_t& get_seed() const;
+
+    //! @brief      Enable/disable logging the disassembly of every executed instruction
+    //! @details    Off by default, headless runs should never pay for this
+    void set_trace(const bool& trace);
+
+    //! @brief      Enable/disable logging unhandled instructions to nchip8::log
+    //! @details    Off by default, nchip8::log is not synchronised so only the cpu_daemon's cpu logs,
+    //!             the explorer, gym, session and regress cpus just halt
+    void set_log(const bool& log);
 
     //! @brief          Returns a disassembly of the instruction at the supplied address
     //! @param address  The address of the instruction, must be correctly aligned
@@ -42,7 +102,7 @@ public:
     std::optional<std::string> dasm_op(const std::uint16_t &address) const;
 
     //! @brief The current resolution mode of the screen
-    enum screen_mode {
+    enum screen_mode : std::uint8_t {
         lores_c8,   //! CHIP-8 64*32
         hires_sc8   //! SCHIP-8 128*64
     };
@@ -51,46 +111,83 @@ public:
     //! @see cpu::screen_mode
     const screen_mode& get_screen_mode() const;
 
+    //! @brief The screen, one bit per pixel and plane, one 128 pixel row of both planes per copy-on-write page
+    //! @details Each row is two words per plane (plane 0 first), the leftmost pixel is the MSB of the first word.
+    //!          A lores row only uses the first word of each plane, of rows 0-31.
+    //!          Only XO-CHIP draws to plane 1
+    using framebuffer = cow_array<std::uint64_t, 4, 64>;
+
+    //! @brief Words of a plane in a framebuffer row
+    static constexpr std::size_t plane_words = 2;
+
     //! @brief      Returns a reference to screen data
-    //! @returns    Const vector reference that contains the screen data
-    //!             (where true = pixel on, false = pixel off)
+    //! @returns    Const reference that contains the screen data
+    //!             (where a set bit = pixel on)
     //! @details    Screen array is ALWAYS the hires size, even if cpu is lores mode
-    const std::array<bool, 128*64>& get_screen_framebuffer() const;
+    const framebuffer& get_screen_framebuffer() const;
+
+    //! @brief Get's the status of a pixel of a framebuffer (on in any plane/off), in the coordinates of any screen mode
+    static bool get_framebuffer_xy(const framebuffer& screen, const std::uint8_t& x, const std::uint8_t& y);
+
+    //! @brief Get's the color of a pixel of a framebuffer, bit n = on in plane n
+    static std::uint8_t get_framebuffer_color(const framebuffer& screen, const std::uint8_t& x, const std::uint8_t& y);
 
     //! @brief Get's the status of a pixel on the screen (on/off)
     bool get_screen_xy(const std::uint8_t&x , const std::uint8_t& y) const;
 
+    //! @brief XO-CHIP audio: the 128 bit pattern played (MSB first) and its pitch, set by F002 and Fx3A
+    //! @details The pattern plays at 4000 * 2^((pitch - 64) / 48) bits a second while the sound timer runs
+    const std::array<std::uint8_t, 16>& get_audio_pattern() const;
+    std::uint8_t get_audio_pitch() const;
+
+    //! @brief Read only view of the registers and RAM, for tools that inspect a cpu (e.g. explorer predicates)
+    const std::array<std::uint8_t, 16>& get_gpr() const;
+    std::uint16_t get_i() const;
+    std::uint16_t get_pc() const;
+    std::uint8_t get_sp() const;
+    std::uint8_t get_dt() const;
+    std::uint8_t get_st() const;
+    std::uint8_t read_u8(const std::uint16_t& address) const;
+
+    //! @brief  Mask of the guest addresses, 0x0FFF or 0xFFFF for XO-CHIP (see m_ram_mask)
+    std::uint16_t get_ram_mask() const;
+
     //! @brief Set the supplied key as down
     void set_key_down(const std::uint8_t& key);
 
     //! @brief Set key up
     void set_key_up(const std::uint8_t& key);
 
-    friend class cpu_daemon; //! We allow the daemon watcher to access data in the CPU
+    //! @brief          Serializes the full machine state (RAM, registers, stack, timers, screen, keys)
+    //! @param out      Overwritten with the state, reusing its capacity so per-frame saves don't allocate
+    //! @param compress Run-length encode the payload, RAM and the framebuffer are mostly runs
+    //! @see            cpu_state.cpp for the layout
+    void save_state(std::vector<std::uint8_t>& out, const bool& compress = false) const;
 
-private:
-    //! @brief The last key that was down
-    std::optional<std::uint8_t> m_last_key_down;
+    //! @brief          Serializes the full machine state into a new vector
+    std::vector<std::uint8_t> save_state(const bool& compress = false) const;
 
-    //! @brief array indexed by key code (0x0-0xF),
-    std::array<bool,16> m_keys_down;
+    //! @brief          Restores a state made by save_state
+    //! @returns        false if the data is not a valid state of this version, the cpu is left untouched
+    bool load_state(const std::vector<std::uint8_t>& data);
 
-    //! Screen
-    std::array<bool, 128*64> m_screen;
-    screen_mode m_screen_mode;
+    //! @brief          64-bit hash of a save state (or any bytes), equal states hash equal on every host
+    static std::uint64_t hash_state(const std::vector<std::uint8_t>& state);
 
-    //! @brief Set screen mode of CPU
-    void set_screen_mode(const screen_mode& mode);
+    friend class cpu_daemon; //! We allow the daemon watcher to access data in the CPU
+    friend class rom_generator; //! The generator builds programs from the op_handler encodings
+    friend class pc_profiler; //! The profiler samples the PC and stack
+    friend class batch; //! Lanes of a batch keep their registers outside the cpu, see batch
 
-    //! @brief Set's the status of a pixel on the screen
-    void set_screen_xy(const std::uint8_t& x, const std::uint8_t& y, const bool& set);
+private:
+    // The state is laid out hot to cold: the registers and flags nearly every instruction touches share
+    // the first cache line of the cpu, the stack the next one, and the rarely used state, the framebuffer
+    // page pointers and the RAM page pointers (most of the size of a cpu) come after them.
 
-    //! RAM
-    std::array<std::uint8_t, 0x1000> m_ram;
+    struct decode_table;
 
     //! General Purpose Registers
-    std::array<std::uint8_t, 16> m_gpr;
-
+    alignas(64) std::array<std::uint8_t, 16> m_gpr;
 
     //! I register, for storing addresses for some special instructions
     std::uint16_t m_i;
@@ -107,8 +204,73 @@ private:
     //! Sound Timer, when this is non-zero, we must subtract 1 from it @ 60Hz while playing a buzzer
     std::uint8_t m_st;
 
+    //! @brief Bit n set while key n (0x0-0xF) is down
+    std::uint16_t m_keys_down = 0;
+
+    //! @brief The last key that was down, no_key if none
+    std::uint8_t m_last_key_down = no_key;
+    static constexpr std::uint8_t no_key = 0xFF;
+
+    //! @brief  The planes DRW, CLS and the scrolls act on, bit n = plane n (XO-CHIP Fn01)
+    std::uint8_t m_planes = 0x1;
+
+    //! @brief Set when an unhandled instruction (or 00FD) is hit, no further instructions are executed
+    bool m_halted = false;
+
+    //! @brief Log the disassembly of every executed instruction to nchip8::log
+    bool m_trace = false;
+
+    //! @brief Log unhandled instructions to nchip8::log
+    bool m_log = false;
+
+    screen_mode m_screen_mode;
+
+    //! @brief  Every guest address is masked with this before touching m_ram,
+    //!         so a ROM (or a generated/fuzzed program) can never reach past the RAM of its profile.
+    //!         ram_mask unless the quirk profile is XO-CHIP, 0xFFFF then
+    std::uint16_t m_ram_mask = ram_mask;
+
+    //! @brief  The 4K address space of CHIP-8 and SCHIP, what the profilers and the heatmap cover
+    static constexpr std::uint16_t ram_mask = 0x0FFF;
+
+    //! @brief The decoded handlers of the quirk profile, shared by every cpu (see get_decode_table)
+    const decode_table* m_decode = nullptr;
+
+    //! @brief RAM access counters, only updated when one is attached
+    ram_heatmap* m_heatmap = nullptr;
+
     //! The Stack
-    std::array<std::uint16_t, 16> m_stack;
+    alignas(64) std::array<std::uint16_t, 16> m_stack;
+
+    //! @brief See set_quirks
+    quirk_profile m_quirks = quirk_profile::nchip8;
+
+    //! @brief SCHIP RPL user flags (Fx75/Fx85), like on the HP48 they survive a reset
+    std::array<std::uint8_t, 8> m_rpl_flags {};
+
+    //! See get_audio_pattern
+    std::array<std::uint8_t, 16> m_audio_pattern {};
+    std::uint8_t m_audio_pitch = 64;
+
+    //! RND's generator, and the seed reset() restarts it from
+    prng m_random;
+    std::uint64_t m_seed = 0;
+
+    //! Screen
+    framebuffer m_screen;
+
+    //! RAM, in 256 byte copy-on-write pages (see fork), 64K for XO-CHIP. The pages past m_ram_mask are released
+    cow_array<std::uint8_t, 0x100, 0x100> m_ram;
+
+    //! @brief Set screen mode of CPU, clears the screen
+    void set_screen_mode(const screen_mode& mode);
+
+    //! @brief Where the 4x5 and the SCHIP 8x10 hex digit sprites are loaded (Fx29, Fx30)
+    static constexpr std::uint16_t font_address = 0x000;
+    static constexpr std::uint16_t big_font_address = 0x050;
+
+    //! @brief Set's the status of a pixel on the screen
+    void set_screen_xy(const std::uint8_t& x, const std::uint8_t& y, const bool& set);
 
     //! @brief          Reads a 16-bit value at the specified address
     //! @param address  The address
@@ -158,6 +320,9 @@ private:
     //!        both an execution and a disassembly routine
     struct op_handler
     {
+        //! Name of the handler, matches its static member name (e.g. "ADD_VX_VY")
+        const char* m_name;
+
         //! An array specifying the instruction encoding, operand data is indexed by std::nullopt
         //! e.g. 0x1NNN - { 0x1, std::nullopt, std::nullopt, std::nullopt }
         std::array<std::optional<std::uint8_t>, 4> m_encoding;
@@ -167,44 +332,93 @@ private:
 
         //! @see func_dasm_op
         func_dasm_op m_dasm_op;
+
+        //! Index of the handler in registration order, set by add_op_handler
+        std::uint8_t m_id = 0;
     };
 
+#ifdef NCHIP8_OP_STATS
+    //! @brief Instrumentation, only part of the cpu when built with NCHIP8_OP_STATS
+    //!        (it is most of the size of a cpu otherwise, which every fork would pay for)
+    op_stats m_op_stats;
+#endif
+
     friend class op_handler; //! We allow operations to access data in CPU (i.e its private members)
 
-    //! @brief      The operation handler tree
+    //! @brief      The operation handler tree, what the decode tables are built from
     //!             4 nested maps, indexed by each nibble of the instruction
     //!             e.g. 0xABCD, m_op_tree[A][B][C][D]
     //!
     //! @details    4bit nibbles in this case are using an 8bit type
     //!             Operand data is indexed as optional (std::nullopt)
-    std::unordered_map<std::optional<std::uint8_t>,
+    using op_tree = std::unordered_map<std::optional<std::uint8_t>,
             std::unordered_map<std::optional<std::uint8_t>,
                     std::unordered_map<std::optional<std::uint8_t>,
                             std::unordered_map<std::optional<std::uint8_t>,
-                                    op_handler>>>> m_op_tree;
+                                    op_handler>>>>;
+
+    //! @brief      The handlers of a quirk profile and the handler of every one of the 64K instructions
+    //! @details    Decoding is a single load instead of four hash lookups. Built once per profile,
+    //!             on first use, and never changed, so every cpu (and fork, on any thread) shares it
+    struct decode_table
+    {
+        //! Indexed by op_handler::m_id (registration order)
+        std::vector<op_handler> m_handlers;
+
+        //! Names of m_handlers
+        std::vector<std::string> m_names;
+
+        //! op_handler::m_id of each instruction, no_handler if it is invalid
+        std::array<std::uint8_t, 0x10000> m_index;
+    };
+
+    static constexpr std::uint8_t no_handler = 0xFF;
+
+    //! @brief  The shared decode table of a quirk profile, built on the first call
+    static const decode_table& get_decode_table(const quirk_profile& profile);
+
+    //! @brief  Builds the decode table of a quirk policy
+    template<typename Quirks>
+    static void build_decode_table(decode_table& table);
 
     //! @brief          Returns the operation handler for an instruction
     //! @param address  The encoded instruction (i.e 0X1200 - JP 200)
-    //! @returns        Optional of operation handler if successful, std::nullopt if false
-    std::optional<op_handler> get_op_handler_for_instruction(const std::uint16_t &instruction) const;
+    //! @returns        The handler, nullptr if the instruction is invalid
+    const op_handler* get_op_handler_for_instruction(const std::uint16_t &instruction) const;
 
-    //! @brief          Add an operation handler for an instruction into the handler tree
+    //! @brief          Add an operation handler for an instruction into a handler tree
     //! @param handler  Handler structure, containing an execute and disassembly function
-    bool add_op_handler(const op_handler &handler);
+    static bool add_op_handler(op_tree& tree, decode_table& table, const op_handler &handler);
+
+    //! @brief          The handler of an instruction in a handler tree, nullptr if there is none
+    static const op_handler* find_op_handler(const op_tree& tree, const std::uint16_t& instruction);
 
     /* Begin operation handlers
        Why are these not stored inside an array? We want to alias them.
        Rationale: Easier to write unit tests
                   if we can simply call instructions by name
                   as the instruction name will match the test name */
+    static op_handler SCD_N;        // 00Cn - SCD nibble (SCHIP)
+    static op_handler SCU_N;        // 00Dn - SCU nibble (XO-CHIP)
+    template<typename Quirks>
     static op_handler CLS;          // 00E0 - CLS
     static op_handler RET;          // 00EE - RET
+    static op_handler SCR;          // 00FB - SCR (SCHIP)
+    static op_handler SCL;          // 00FC - SCL (SCHIP)
+    static op_handler EXIT;         // 00FD - EXIT (SCHIP)
+    static op_handler LOW;          // 00FE - LOW (SCHIP)
+    static op_handler HIGH;         // 00FF - HIGH (SCHIP)
     static op_handler SYS;          // 0nnn - SYS addr
     static op_handler JP;           // 1nnn - JP addr
     static op_handler CALL;         // 2nnn - CALL addr
+    template<typename Quirks>
     static op_handler SE_VX_KK;     // 3xkk - SE Vx, byte
+    template<typename Quirks>
     static op_handler SNE_VX_KK;    // 4xkk - SNE Vx, byte
+    template<typename Quirks>
     static op_handler SE_VX_VY;     // 5xy0 - SE Vx, Vy
+    static op_handler LD_imm_I_VX_VY; // 5xy2 - LD [I], Vx - Vy (XO-CHIP)
+    static op_handler LD_VX_VY_imm_I; // 5xy3 - LD Vx - Vy, [I] (XO-CHIP)
     static op_handler LD_VX_KK;     // 6xkk - LD Vx, byte
     static op_handler ADD_VX_KK;    // 7xkk - ADD Vx, byte
     static op_handler LD_VX_VY;     // 8xy0 - LD Vx, Vy
@@ -213,29 +427,52 @@ private:
     static op_handler XOR_VX_VY;    // 8xy3 - XOR Vx, Vy
     static op_handler ADD_VX_VY;    // 8xy4 - ADD Vx, Vy
     static op_handler SUB_VX_VY;    // 8xy5 - SUB Vx, Vy
+    template<typename Quirks>
     static op_handler SHR_VX_VY;    // 8xy6 - SHR Vx {, Vy}
     static op_handler SUBN_VX_VY;   // 8xy7 - SUBN Vx, Vy
+    template<typename Quirks>
     static op_handler SHL_VX_VY;    // 8xyE - SHL Vx {, Vy}
+    template<typename Quirks>
     static op_handler SNE_VX_VY;    // 9xy0 - SNE Vx, Vy
     static op_handler LD_I_NNN;     // Annn - LD I, addr
-    static op_handler JP_V0_NNN;    // Bnnn - JP V0, addr
+    template<typename Quirks>
+    static op_handler JP_V0_NNN;    // Bnnn - JP V0, addr (Bxnn - JP Vx, addr)
     static op_handler RND_VX_KK;    // Cxkk - RND Vx, byte
-    static op_handler DRW_VX_VY_N;  // Dxyn - DRW Vx, Vy, nibble
+    template<typename Quirks>
+    static op_handler DRW_VX_VY_N;  // Dxyn - DRW Vx, Vy, nibble (Dxy0 - 16x16 sprite, SCHIP)
+    template<typename Quirks>
     static op_handler SKP_VX;       // Ex9E - SKP Vx
+    template<typename Quirks>
     static op_handler SKNP_VX;      // ExA1 - SKNP Vx
+    static op_handler LD_I_LONG;    // F000 nnnn - LD I, long (XO-CHIP)
+    static op_handler PLANE_N;      // Fn01 - PLANE n (XO-CHIP)
+    static op_handler AUDIO;        // F002 - AUDIO (XO-CHIP)
     static op_handler LD_VX_DT;     // Fx07 - LD Vx, DT
     static op_handler LD_VX_K;      // Fx0A - LD Vx, K
     static op_handler LD_DT_VX;     // Fx15 - LD DT, Vx
     static op_handler LD_ST_VX;     // Fx18 - LD ST, Vx
     static op_handler ADD_I_VX;     // Fx1E - ADD I, Vx
     static op_handler LD_F_VX;      // Fx29 - LD F, Vx
+    static op_handler LD_HF_VX;     // Fx30 - LD HF, Vx (SCHIP)
     static op_handler LD_B_VX;      // Fx33 - LD B, Vx
+    static op_handler PITCH_VX;     // Fx3A - PITCH Vx (XO-CHIP)
+    template<typename Quirks>
     static op_handler LD_imm_I_VX;  // Fx55 - LD [I], Vx
-    static op_handler LD_VX_imm_I;  // Fx65 - LD Vx,
-    /* End operation handlers */
-
-    //! @brief Add all the CHIP-8 operation handlers to the operation tree
-    void setup_op_handlers();
+    template<typename Quirks>
+    static op_handler LD_VX_imm_I;  // Fx65 - LD Vx, [I]
+    static op_handler LD_R_VX;      // Fx75 - LD R, Vx (SCHIP)
+    static op_handler LD_VX_R;      // Fx85 - LD Vx, R (SCHIP)
+    /* End operation handlers
+       The templated handlers depend on a quirk policy (see quirks.hpp),
+       they are instantiated for every policy in op_handlers.cpp */
+
+    //! @brief Add all the CHIP-8 operation handlers of a quirk policy to an operation tree
+    template<typename Quirks>
+    static void setup_op_handlers(op_tree& tree, decode_table& table);
+
+    //! @brief Skips the next instruction, XO-CHIP skips the 4 bytes of F000 nnnn whole
+    template<typename Quirks>
+    void skip_next();
 
 };
 
@@ -5,6 +5,13 @@
 #include "cpu_daemon.hpp"
 #include "io.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 namespace nchip8
 {
 
@@ -14,9 +21,18 @@ cpu_daemon::cpu_daemon() :
     // create enough space to hold the handlers for each type
     m_message_handlers.resize(cpu_message_type::_last);
 
+    m_frame_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(m_frame_event_fd < 0)
+    {
+        throw std::runtime_error("Could not create the frame eventfd!");
+    }
+
     // handle rom loads
     this->register_message_handler(cpu_message_type::LoadROM, [this](const cpu_message &msg)
     {
+        stop_movie();
+
         nchip8::log << "[cpu_daemon] received rom: " << msg.m_data.size() << " bytes " << '\n';
 
         // load rom in
@@ -36,12 +52,173 @@ cpu_daemon::cpu_daemon() :
     {
         nchip8::log << "[cpu_daemon] reset cpu " << '\n';
 
+        stop_movie();
+
         // reset cpu
         m_cpu.reset();
+        m_cycle = 0;
+        m_pc_profiler.reset();
+        m_ram_heatmap.reset();
+        m_rewind.clear();
+        m_rewind_frames = 0;
+        m_key_pressed_at.fill(std::nullopt);
+        m_keys_pending = 0;
+        m_photon_trace.reset();
+        m_input_latency.reset();
+        msg.m_callback();
+
+    });
+
+    // snapshots are taken between instructions, so they never tear an instruction
+    this->register_message_handler(cpu_message_type::SaveState, [this](const cpu_message &msg)
+    {
+        bool compress = !msg.m_data.empty() && msg.m_data[0] != 0;
+
+        msg.m_on_data(m_cpu.save_state(compress));
+        msg.m_callback();
+    });
+
+    this->register_message_handler(cpu_message_type::LoadState, [this](const cpu_message &msg)
+    {
+        stop_movie();
+
+        if(m_cpu.load_state(msg.m_data))
+        {
+            m_cycle = 0;
+            msg.m_callback();
+            return;
+        }
+
+        nchip8::log << "[cpu_daemon] invalid save state: " << msg.m_data.size() << " bytes" << '\n';
+        msg.m_on_error();
+    });
+
+    this->register_message_handler(cpu_message_type::Rewind, [this](const cpu_message &msg)
+    {
+        if(msg.m_data.size() < 2)
+        {
+            msg.m_on_error();
+            return;
+        }
+
+        std::size_t frames = msg.m_data[0] | (msg.m_data[1] << 8);
+
+        // nothing to go back to, the cpu (and a movie) carry on as they were
+        if(m_rewind.get_frames() == 0)
+        {
+            msg.m_callback();
+            return;
+        }
+
+        std::size_t rewound = m_rewind.rewind(m_cpu, frames);
+        m_rewind_frames = m_rewind.get_frames();
+
+        // the cpu is at the end of a frame again, a movie follows it back (the buffer starts with it)
+        m_cycle = 0;
+
+        if(m_movie_mode == movie_mode::recording)
+        {
+            m_movie.truncate(m_movie.get_frames() - static_cast<std::uint32_t>(rewound));
+        }
+        else if(m_movie_mode == movie_mode::playing)
+        {
+            m_movie_frame -= static_cast<std::uint32_t>(rewound);
+            m_movie_event = m_movie.seek(m_movie_frame);
+        }
+
+        nchip8::log << "[cpu_daemon] rewound " << std::dec << rewound << " frames" << '\n';
         msg.m_callback();
+    });
+
+    this->register_message_handler(cpu_message_type::SetQuirks, [this](const cpu_message &msg)
+    {
+        if(msg.m_data.empty() || msg.m_data[0] >= static_cast<std::uint8_t>(quirk_profile::_last))
+        {
+            msg.m_on_error();
+            return;
+        }
+
+        stop_movie();
 
+        auto profile = static_cast<quirk_profile>(msg.m_data[0]);
+        m_cpu.set_quirks(profile);
+
+        // a rewind would switch back to the old quirks, behind the back of whoever set these
+        m_rewind.clear();
+        m_rewind_frames = 0;
+
+        nchip8::log << "[cpu_daemon] quirks: " << quirk_profile_name(profile) << '\n';
+        msg.m_callback();
     });
 
+    this->register_message_handler(cpu_message_type::SetSeed, [this](const cpu_message &msg)
+    {
+        if(msg.m_data.size() < 8)
+        {
+            msg.m_on_error();
+            return;
+        }
+
+        stop_movie();
+
+        std::uint64_t seed = 0;
+        for(int byte = 7; byte >= 0; byte--) seed = (seed << 8) | msg.m_data[byte];
+
+        m_cpu.set_seed(seed);
+
+        nchip8::log << "[cpu_daemon] seed: " << std::dec << seed << '\n';
+        msg.m_callback();
+    });
+
+    this->register_message_handler(cpu_message_type::RecordMovie, [this](const cpu_message &msg)
+    {
+        stop_movie();
+
+        m_movie = movie(m_cpu, msg.m_data, static_cast<std::uint32_t>(get_cycles_per_frame()));
+        m_movie_mode = movie_mode::recording;
+        m_on_movie = msg.m_on_data;
+        m_cycle = 0;
+
+        // a rewind may not go back past the start of the movie
+        m_rewind.clear();
+        m_rewind_frames = 0;
+
+        nchip8::log << "[cpu_daemon] recording movie, " << std::dec << m_movie.get_cycles_per_frame()
+                    << " cycles per frame" << '\n';
+        msg.m_callback();
+    });
+
+    this->register_message_handler(cpu_message_type::PlayMovie, [this](const cpu_message &msg)
+    {
+        stop_movie();
+
+        if(!m_movie.load(msg.m_data))
+        {
+            nchip8::log << "[cpu_daemon] invalid movie: " << msg.m_data.size() << " bytes" << '\n';
+            msg.m_on_error();
+            return;
+        }
+
+        m_movie_mode = movie_mode::playing;
+        m_movie_frame = 0;
+        m_movie_event = 0;
+        m_movie_checked = 0;
+        m_movie_mismatches = 0;
+        m_cycle = 0;
+
+        m_rewind.clear();
+        m_rewind_frames = 0;
+
+        nchip8::log << "[cpu_daemon] playing movie, " << std::dec << m_movie.get_frames() << " frames, "
+                    << m_movie.get_events().size() << " key events" << '\n';
+        msg.m_callback();
+    });
+
+
+    // the gui shows the disassembly of what we execute, and where in RAM it is
+    m_cpu.set_trace(true);
+    m_cpu.set_log(true);
+    m_cpu.set_ram_heatmap(&m_ram_heatmap);
 
     nchip8::log << "[cpu_daemon] starting cpu thread" << '\n';
     m_cpu_thread = std::thread(&cpu_daemon::cpu_thread, this);
@@ -49,7 +226,15 @@ cpu_daemon::cpu_daemon() :
 
 cpu_daemon::~cpu_daemon()
 {
-    m_cpu_thread.join();
+    stop();
+
+    ::close(m_frame_event_fd);
+}
+
+void cpu_daemon::stop()
+{
+    m_die = true;
+    if(m_cpu_thread.joinable()) m_cpu_thread.join();
 }
 
 cpu_daemon::cpu_state cpu_daemon::get_cpu_state() const
@@ -65,17 +250,51 @@ void cpu_daemon::set_cpu_state(const cpu_daemon::cpu_state &state)
 
 void cpu_daemon::cpu_thread()
 {
-    bool die = false;
+    // when the next instruction is due in real time
+    auto next_cycle = std::chrono::steady_clock::now();
 
-    while(!die)
+    while(!m_die)
     {
-        if(m_cpu_state == cpu_state::running)
+        // the disassembly trace is far too slow to keep up with turbo
+        m_cpu.set_trace(!m_turbo);
+
+        if(m_cpu_state == cpu_state::running && m_turbo)
         {
-            m_cpu.execute_op_at_pc();
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000 / m_clock_speed));
+            run_turbo_frame();
+
+            // carry on in real time from here when turbo is switched off
+            next_cycle = std::chrono::steady_clock::now();
+        }
+        else if(m_cpu_state == cpu_state::running)
+        {
+            auto start = std::chrono::steady_clock::now();
+            step();
+            m_real_time += std::chrono::steady_clock::now() - start;
+
+            // the timers tick after every frame of instructions, in real time a frame of them takes 1/60s
+            std::size_t cycles_per_frame = get_cycles_per_frame();
+
+            if(++m_cycle >= cycles_per_frame) end_frame();
+
+            next_cycle += std::chrono::microseconds(1000000/60) / cycles_per_frame;
+
+            // too far behind to catch up (paused, a slow host), start again from now instead of rushing
+            auto now = std::chrono::steady_clock::now();
+            if(now - next_cycle > std::chrono::milliseconds(100)) next_cycle = now;
+
+            std::this_thread::sleep_until(next_cycle);
+        }
+        else if(!m_key_events.empty())
+        {
+            // keep the keys current while paused, the queue is small
+            apply_key_events();
         }
 
         std::unique_lock<std::mutex> lock(m_cpu_thread_mutex);
+
+        // a reset, ROM load, rewind, ... changes the screen without a tick, e.g. while paused
+        bool screen_changed = !m_unhandled_messages.empty();
+
         while(!m_unhandled_messages.empty())
         {
             // get front of queue
@@ -95,7 +314,294 @@ void cpu_daemon::cpu_thread()
 
             m_unhandled_messages.pop();
         }
+
+        if(screen_changed) publish_frame();
     }
+
+    // a recording still running is handed over
+    stop_movie();
+}
+
+std::size_t cpu_daemon::get_cycles_per_frame() const
+{
+    if(m_movie_mode == movie_mode::playing) return m_movie.get_cycles_per_frame();
+
+    return std::max<std::size_t>(m_clock_speed / 60, 1);
+}
+
+void cpu_daemon::step()
+{
+    // keys change between instructions, never during one
+    if(m_movie_mode == movie_mode::playing)
+    {
+        m_movie_event = m_movie.apply(m_cpu, m_movie_frame, static_cast<std::uint32_t>(m_cycle), m_movie_event);
+    }
+
+    if(!m_key_events.empty()) apply_key_events();
+
+    std::uint16_t pc = m_cpu.get_pc();
+    std::uint16_t opcode = (m_keys_pending > 0) ? ((m_cpu.read_u8(pc) << 8) | m_cpu.read_u8(pc + 1)) : 0;
+
+    if(m_cpu.execute_op_at_pc())
+    {
+        m_pc_profiler.tick(m_cpu);
+    }
+
+    if(m_photon_trace.has_value()) observe_screen();
+    if(m_keys_pending > 0) observe_key_presses(opcode, pc);
+}
+
+void cpu_daemon::run_turbo_frame()
+{
+    complete_frame();
+
+    // nothing left to run fast, don't spin
+    if(m_cpu.is_halted()) std::this_thread::sleep_for(std::chrono::microseconds(1000000/60));
+}
+
+void cpu_daemon::complete_frame()
+{
+    // a halted cpu still spends its cycles, frames are the same length whatever ran in them
+    for(std::size_t cycles_per_frame = get_cycles_per_frame(); m_cycle < cycles_per_frame; m_cycle++)
+    {
+        step();
+    }
+
+    end_frame();
+}
+
+void cpu_daemon::end_frame()
+{
+    // the sound of the frame that ran, before the tick that may end it (turbo has no real time to play it in)
+    if(!m_turbo) m_audio.submit_frame(m_cpu);
+
+    // a frame in virtual time
+    m_cpu.tick_timers();
+    m_cycle = 0;
+    count_ticks(1);
+
+    // one rewind frame per tick (a few microseconds)
+    m_rewind.push(m_cpu);
+    m_rewind_frames = m_rewind.get_frames();
+
+    if(m_movie_mode != movie_mode::none) end_movie_frame();
+
+    if(!m_turbo)
+    {
+        publish_frame();
+        return;
+    }
+
+    // only as many frames as a frontend can show, the rest are skipped
+    auto now = std::chrono::steady_clock::now();
+
+    if(now - m_last_turbo_publish >= std::chrono::microseconds(1000000/60))
+    {
+        m_last_turbo_publish = now;
+        publish_frame();
+    }
+}
+
+void cpu_daemon::end_movie_frame()
+{
+    if(m_movie_mode == movie_mode::recording)
+    {
+        m_movie.record_frame(m_cpu);
+        return;
+    }
+
+    m_movie_frame++;
+
+    if(auto matches = m_movie.check(m_cpu, m_movie_frame))
+    {
+        m_movie_checked++;
+
+        if(!matches.value())
+        {
+            // the first one is where it went a different way, the rest follow from it
+            if(m_movie_mismatches++ == 0)
+            {
+                nchip8::log << "[cpu_daemon] movie desynced at frame " << std::dec << m_movie_frame << '\n';
+            }
+        }
+    }
+
+    if(m_movie_frame >= m_movie.get_frames())
+    {
+        nchip8::log << "[cpu_daemon] movie ended, " << std::dec << m_movie_checked << " checkpoints, "
+                    << m_movie_mismatches << " mismatched" << '\n';
+
+        // the keys are the frontend's again
+        m_movie_mode = movie_mode::none;
+    }
+}
+
+void cpu_daemon::stop_movie()
+{
+    if(m_movie_mode == movie_mode::recording)
+    {
+        // a movie is whole frames, the keys recorded in this one were already applied
+        if(m_cycle > 0) complete_frame();
+
+        m_movie.finish(m_cpu);
+
+        nchip8::log << "[cpu_daemon] recorded movie, " << std::dec << m_movie.get_frames() << " frames, "
+                    << m_movie.get_events().size() << " key events" << '\n';
+
+        if(m_on_movie) m_on_movie(m_movie.save());
+        m_on_movie = nullptr;
+    }
+
+    m_movie_mode = movie_mode::none;
+}
+
+void cpu_daemon::count_ticks(const std::size_t& ticks)
+{
+    m_speed_ticks += ticks;
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - m_speed_since;
+
+    if(elapsed >= std::chrono::seconds(1))
+    {
+        m_speed = m_speed_ticks / (60.0 * elapsed.count());
+        m_speed_ticks = 0;
+        m_speed_since = now;
+    }
+}
+
+void cpu_daemon::set_turbo(const bool& turbo)
+{
+    nchip8::log << "[cpu_daemon] turbo " << (turbo ? "on" : "off") << '\n';
+    m_turbo = turbo;
+}
+
+bool cpu_daemon::get_turbo() const
+{
+    return m_turbo;
+}
+
+double cpu_daemon::get_speed() const
+{
+    return m_speed;
+}
+
+void cpu_daemon::publish_frame()
+{
+    // running ahead of a cpu that runs ahead anyway is just slower
+    std::size_t run_ahead = m_turbo ? 0 : m_run_ahead.load();
+
+    // the pages it shares are only ever replaced in m_cpu, never written, so other threads can read it
+    std::shared_ptr<const cpu> snapshot = m_cpu.fork();
+
+    if(run_ahead == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_frame_mutex);
+        m_frame.m_screen = m_cpu.get_screen_framebuffer();
+        m_frame.m_screen_mode = m_cpu.get_screen_mode();
+        m_frame.m_cpu = std::move(snapshot);
+        m_frame.m_number++;
+    }
+    else
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // a fork is a save state that shares its pages, throwing it away restores the real cpu
+        auto ahead = m_cpu.fork();
+        ahead->set_trace(false);
+        ahead->set_log(false);
+
+        std::size_t cycles_per_frame = get_cycles_per_frame();
+
+        for(std::size_t frame = 0; frame < run_ahead && !ahead->is_halted(); frame++)
+        {
+            for(std::size_t cycle = 0; cycle < cycles_per_frame; cycle++)
+            {
+                if(!ahead->execute_op_at_pc()) break;
+            }
+
+            ahead->tick_timers();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_frame_mutex);
+            m_frame.m_screen = ahead->get_screen_framebuffer();
+            m_frame.m_screen_mode = ahead->get_screen_mode();
+            m_frame.m_cpu = std::move(snapshot);
+            m_frame.m_number++;
+        }
+
+        m_ahead_time += std::chrono::steady_clock::now() - start;
+    }
+
+    // the change a traced key press made is on screen now
+    if(m_photon_trace.has_value() && m_photon_trace->m_drawn != std::chrono::steady_clock::time_point())
+    {
+        m_photon_trace->m_published = std::chrono::steady_clock::now();
+        m_photon_trace->m_frame = m_frame.m_number;
+
+        m_photon_latency.published(m_photon_trace.value());
+        m_photon_trace.reset();
+    }
+
+    // wake up the frontend (after the trace is handed over, it may present the frame right away),
+    // the counter just adds up if it hasn't read it yet
+    std::uint64_t one = 1;
+    if(::write(m_frame_event_fd, &one, sizeof(one)) < 0) { /* counter full, it is awake anyway */ }
+
+    if(++m_cost_frames >= 60)
+    {
+        m_run_ahead_cost = (m_real_time.count() > 0)
+                           ? static_cast<double>(m_ahead_time.count()) / m_real_time.count()
+                           : 0.0;
+
+        m_real_time = {};
+        m_ahead_time = {};
+        m_cost_frames = 0;
+    }
+}
+
+std::uint64_t cpu_daemon::get_frame_number() const
+{
+    std::lock_guard<std::mutex> lock(m_frame_mutex);
+    return m_frame.m_number;
+}
+
+int cpu_daemon::get_frame_event_fd() const
+{
+    return m_frame_event_fd;
+}
+
+cpu_daemon::frame cpu_daemon::get_frame() const
+{
+    std::lock_guard<std::mutex> lock(m_frame_mutex);
+    return m_frame;
+}
+
+bool cpu_daemon::frame::get_xy(const std::uint8_t &x, const std::uint8_t &y) const
+{
+    return cpu::get_framebuffer_xy(m_screen, x, y);
+}
+
+std::uint8_t cpu_daemon::frame::get_color(const std::uint8_t &x, const std::uint8_t &y) const
+{
+    return cpu::get_framebuffer_color(m_screen, x, y);
+}
+
+void cpu_daemon::set_run_ahead(const std::size_t &frames)
+{
+    nchip8::log << "[cpu_daemon] run-ahead " << std::dec << frames << " frames" << '\n';
+    m_run_ahead = frames;
+}
+
+std::size_t cpu_daemon::get_run_ahead() const
+{
+    return m_run_ahead;
+}
+
+double cpu_daemon::get_run_ahead_cost() const
+{
+    return m_run_ahead_cost;
 }
 
 void cpu_daemon::send_message(const cpu_message &message)
@@ -117,7 +623,7 @@ const cpu::screen_mode &cpu_daemon::get_screen_mode() const
     return m_cpu.get_screen_mode();
 }
 
-const std::array<bool, 128 * 64> &cpu_daemon::get_screen_framebuffer() const
+const cpu::framebuffer &cpu_daemon::get_screen_framebuffer() const
 {
     return m_cpu.get_screen_framebuffer();
 }
@@ -152,6 +658,36 @@ const std::array<std::uint16_t, 16> cpu_daemon::get_stack() const
     return m_cpu.m_stack;
 }
 
+const op_stats& cpu_daemon::get_op_stats() const
+{
+    return m_cpu.get_op_stats();
+}
+
+const std::vector<std::string>& cpu_daemon::get_op_names() const
+{
+    return m_cpu.get_op_names();
+}
+
+const pc_profiler& cpu_daemon::get_pc_profiler() const
+{
+    return m_pc_profiler;
+}
+
+const ram_heatmap& cpu_daemon::get_ram_heatmap() const
+{
+    return m_ram_heatmap;
+}
+
+void cpu_daemon::write_profile_report(std::ostream& out) const
+{
+    m_pc_profiler.write_report(out, m_cpu);
+}
+
+std::size_t cpu_daemon::get_rewind_frames() const
+{
+    return m_rewind_frames;
+}
+
 const std::uint8_t cpu_daemon::get_dt() const
 {
     return m_cpu.m_dt;
@@ -164,12 +700,151 @@ const std::uint8_t cpu_daemon::get_st() const
 
 void cpu_daemon::set_key_down(const std::uint8_t &key)
 {
-    m_cpu.set_key_down(key);
+    if(!m_key_events.push({ static_cast<std::uint8_t>(key & 0xF), true, std::chrono::steady_clock::now() }))
+    {
+        nchip8::log << "[cpu_daemon] key queue full, dropped key " << std::hex << static_cast<int>(key) << '\n';
+    }
 }
 
 void cpu_daemon::set_key_up(const std::uint8_t &key)
 {
-    m_cpu.set_key_up(key);
+    if(!m_key_events.push({ static_cast<std::uint8_t>(key & 0xF), false, std::chrono::steady_clock::now() }))
+    {
+        nchip8::log << "[cpu_daemon] key queue full, dropped key " << std::hex << static_cast<int>(key) << '\n';
+    }
+}
+
+void cpu_daemon::apply_key_events()
+{
+    key_event event;
+
+    while(m_key_events.pop(event))
+    {
+        // a movie plays its own keys
+        if(m_movie_mode == movie_mode::playing) continue;
+
+        if(m_movie_mode == movie_mode::recording)
+        {
+            m_movie.record_key(static_cast<std::uint32_t>(m_cycle), event.m_key, event.m_down);
+        }
+
+        auto& pressed_at = m_key_pressed_at[event.m_key];
+
+        if(event.m_down)
+        {
+            m_cpu.set_key_down(event.m_key);
+
+            if(!pressed_at.has_value()) m_keys_pending++;
+            pressed_at = pending_press { event.m_time, std::chrono::steady_clock::now() };
+        }
+        else
+        {
+            m_cpu.set_key_up(event.m_key);
+
+            // released before anything looked at it, there is no latency to measure
+            if(pressed_at.has_value()) m_keys_pending--;
+            pressed_at.reset();
+        }
+    }
+}
+
+void cpu_daemon::observe_key_presses(const std::uint16_t &opcode, const std::uint16_t &pc)
+{
+    std::uint8_t x = (opcode >> 8) & 0xF;
+    std::optional<std::uint8_t> key;
+
+    switch(opcode & 0xF0FF)
+    {
+        case 0xE09E: // SKP Vx
+        case 0xE0A1: // SKNP Vx
+            key = m_cpu.get_gpr()[x] & 0xF;
+            break;
+
+        case 0xF00A: // LD Vx, K, it executes again (same pc) until a key is down
+            if(m_cpu.get_pc() != pc) key = m_cpu.get_gpr()[x] & 0xF;
+            break;
+
+        default:
+            return;
+    }
+
+    auto& pressed_at = m_key_pressed_at[key.value()];
+    if(!pressed_at.has_value()) return;
+
+    auto now = std::chrono::steady_clock::now();
+
+    m_input_latency.record(now - pressed_at->m_arrival);
+
+    // follow it to the screen, unless an earlier press still is
+    if(!m_photon_trace.has_value())
+    {
+        photon_latency::trace t;
+        t.m_arrival = pressed_at->m_arrival;
+        t.m_applied = pressed_at->m_applied;
+        t.m_consumed = now;
+
+        m_photon_trace = t;
+        m_photon_screen = m_cpu.get_screen_framebuffer();
+    }
+
+    pressed_at.reset();
+    m_keys_pending--;
+}
+
+void cpu_daemon::observe_screen()
+{
+    auto& t = m_photon_trace.value();
+
+    // drawn, waiting for the next frame to be published
+    if(t.m_drawn != std::chrono::steady_clock::time_point()) return;
+
+    const auto& screen = m_cpu.get_screen_framebuffer();
+    bool written = false;
+
+    // the pages are still shared with m_photon_screen unless they were written
+    for(std::size_t p = 0; p < cpu::framebuffer::pages; p++)
+    {
+        if(&screen.get_page(p) == &m_photon_screen.get_page(p)) continue;
+
+        written = true;
+
+        if(screen.get_page(p) != m_photon_screen.get_page(p))
+        {
+            t.m_drawn = std::chrono::steady_clock::now();
+            return;
+        }
+    }
+
+    // pixels written back to what they were (e.g. drawn and erased), compare against the screen now
+    if(written) m_photon_screen = screen;
+
+    if(std::chrono::steady_clock::now() - t.m_consumed > photon_timeout) m_photon_trace.reset();
+}
+
+const photon_latency& cpu_daemon::get_photon_latency() const
+{
+    return m_photon_latency;
+}
+
+void cpu_daemon::frame_presented(const std::uint64_t &number)
+{
+    m_photon_latency.presented(number, std::chrono::steady_clock::now());
+}
+
+const latency_histogram& cpu_daemon::get_input_latency() const
+{
+    return m_input_latency;
+}
+
+void cpu_daemon::set_audio_sink(std::unique_ptr<audio_sink> sink)
+{
+    nchip8::log << "[cpu_daemon] audio " << (sink ? "on" : "off") << '\n';
+    m_audio.start(std::move(sink));
+}
+
+const audio_output& cpu_daemon::get_audio() const
+{
+    return m_audio;
 }
 
 void cpu_daemon::set_cpu_clockspeed(const size_t &speed)
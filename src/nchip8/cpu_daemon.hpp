@@ -13,9 +13,18 @@
 #include <queue>
 #include <functional>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 
+#include "audio.hpp"
 #include "cpu.hpp"
 #include "cpu_message.hpp"
+#include "latency_histogram.hpp"
+#include "movie.hpp"
+#include "pc_profiler.hpp"
+#include "photon_latency.hpp"
+#include "rewind_buffer.hpp"
+#include "spsc_queue.hpp"
 
 namespace nchip8
 {
@@ -32,6 +41,10 @@ public:
     //! @brief Destructor
     virtual ~cpu_daemon();
 
+    //! @brief  Ends the cpu thread (handing over a recording movie), the counters and the cpu stay readable
+    //! @details The reports of the profilers, the heatmap and the op stats are only consistent after this
+    void stop();
+
     //! @brief          Send a message to the cpu thread
     //! @param message  The cpu_message structure
     void send_message(const cpu_message &);
@@ -57,6 +70,12 @@ public:
 
     void set_cpu_clockspeed(const size_t&);
 
+    //! @brief  Plays the sound timer into sink from the next frame on (not in turbo), nullptr for silence
+    void set_audio_sink(std::unique_ptr<audio_sink> sink);
+
+    //! @brief  Underruns and latency of the audio
+    const audio_output& get_audio() const;
+
     //! @brief Returns current screen mode
     //! @see cpu::screen_mode
     const cpu::screen_mode& get_screen_mode() const;
@@ -65,14 +84,83 @@ public:
     //! @returns    Const vector reference that contains the screen data
     //!             (where true = pixel on, false = pixel off)
     //! @details    Screen array is ALWAYS the hires size, even if cpu is
-    const std::array<bool, 128*64>& get_screen_framebuffer() const;
+    const cpu::framebuffer& get_screen_framebuffer() const;
 
     //! @brief Get's the status of a pixel on the screen (on/off)
     bool get_screen_xy(const std::uint8_t&x , const std::uint8_t& y) const;
 
+    //! @brief  A screen published by the cpu thread once per frame (60Hz timer tick), what frontends present
+    struct frame
+    {
+        cpu::framebuffer m_screen;
+        cpu::screen_mode m_screen_mode = cpu::screen_mode::lores_c8;
+        std::uint64_t m_number = 0; //! Frames published so far
+
+        //! A fork of the cpu when the frame was published (not the run-ahead one), for reading its RAM
+        //! off the cpu thread: the live cpu replaces its pages at any time. nullptr before the first frame
+        std::shared_ptr<const cpu> m_cpu;
+
+        //! @brief Get's the status of a pixel of the frame (on/off)
+        bool get_xy(const std::uint8_t& x, const std::uint8_t& y) const;
+
+        //! @brief Get's the color of a pixel of the frame (bit n set: on in plane n, see cpu::get_framebuffer_color)
+        std::uint8_t get_color(const std::uint8_t& x, const std::uint8_t& y) const;
+    };
+
+    //! @brief  Returns the last published frame (a cheap copy, the pages are shared)
+    frame get_frame() const;
+
+    //! @brief  frame::m_number of the last published frame, without copying it
+    std::uint64_t get_frame_number() const;
+
+    //! @brief  An eventfd the cpu thread signals every time it publishes a frame, for frontends to poll
+    int get_frame_event_fd() const;
+
+    //! @brief          Present the screen a number of frames in the future (0 = off)
+    //! @details        Every frame the cpu is forked and the fork runs ahead with the current input,
+    //!                 its screen is published and it is thrown away. This hides up to that many frames
+    //!                 of input lag, at the cost of running that many extra frames per frame
+    void set_run_ahead(const std::size_t& frames);
+
+    //! @brief Frames of run-ahead
+    std::size_t get_run_ahead() const;
+
+    //! @brief      Turbo (fast-forward): run without the clock throttle
+    //! @details    Frames are only published as often as a frontend can show them.
+    //!             The timers always tick every clock_speed/60 instructions (virtual time), with or without turbo,
+    //!             so a run does the same whatever speed it ran at (see movie)
+    void set_turbo(const bool& turbo);
+    bool get_turbo() const;
+
+    //! @brief Emulated time relative to real time over the last second, e.g. 1.0 normally
+    double get_speed() const;
+
+    //! @brief Host time spent running ahead relative to the time spent on the real frames (1.0 = +100%)
+    double get_run_ahead_cost() const;
+
+    //! @brief  A key going down or up, and when the frontend saw it
+    struct key_event
+    {
+        std::uint8_t m_key = 0;
+        bool m_down = false;
+        std::chrono::steady_clock::time_point m_time;
+    };
+
+    //! @brief      Queue a key press for the cpu thread, applied before the next instruction
+    //! @details    Key events go through a lock-free queue with a single producer, only call these
+    //!             (and set_key_up) from one thread, i.e. the frontend's
     void set_key_down(const std::uint8_t& key);
     void set_key_up(const std::uint8_t &key);
 
+    //! @brief  Time from a key press to the first instruction that saw it (Ex9E/ExA1 testing it, Fx0A returning it)
+    const latency_histogram& get_input_latency() const;
+
+    //! @brief  Time from a key press to its effect on the terminal, by stage
+    const photon_latency& get_photon_latency() const;
+
+    //! @brief  The frontend finished writing a published frame (frame::m_number) to the terminal
+    void frame_presented(const std::uint64_t& number);
+
     //! @brief Returns a reference to the general purpose cpu registers (i.e V0-V15)
     const std::array<std::uint8_t, 16>& get_gpr() const;
 
@@ -94,6 +182,24 @@ public:
     //! @brief Get stack
     const std::array<std::uint16_t, 16> get_stack() const;
 
+    //! @brief Get instruction counters/timings (empty unless built with NCHIP8_OP_STATS)
+    const op_stats& get_op_stats() const;
+
+    //! @brief Get the op_handler names that op_stats is indexed by
+    const std::vector<std::string>& get_op_names() const;
+
+    //! @brief Get the PC sampling profiler of the cpu thread
+    const pc_profiler& get_pc_profiler() const;
+
+    //! @brief Get the RAM access counters of the cpu
+    const ram_heatmap& get_ram_heatmap() const;
+
+    //! @brief Writes the hotspot report of the PC profiler
+    void write_profile_report(std::ostream& out) const;
+
+    //! @brief Frames of rewind history, one frame per 60Hz timer tick
+    std::size_t get_rewind_frames() const;
+
 
     
 private:
@@ -103,12 +209,146 @@ private:
     //! CPU instance
     cpu m_cpu;
 
+    //! Samples the PC of m_cpu, a small period is cheap at the clock speeds the daemon runs at
+    pc_profiler m_pc_profiler { 16 };
+
+    //! RAM access counters, attached to m_cpu
+    ram_heatmap m_ram_heatmap;
+
+    //! A state of m_cpu every timer tick (1/60s), for the Rewind message
+    rewind_buffer m_rewind;
+
+    //! m_rewind.get_frames(), readable from other threads
+    std::atomic<std::size_t> m_rewind_frames { 0 };
+
     //! Current cpu state, e.g. paused, running
     cpu_state m_cpu_state;
 
+    //! The last published frame, guarded by m_frame_mutex
+    frame m_frame;
+    mutable std::mutex m_frame_mutex;
+
+    //! See get_frame_event_fd
+    int m_frame_event_fd = -1;
+
+    //! Frames of run-ahead, see set_run_ahead
+    std::atomic<std::size_t> m_run_ahead { 0 };
+
+    //! See get_run_ahead_cost, updated every second
+    std::atomic<double> m_run_ahead_cost { 0.0 };
+
+    //! Host time spent on real and run-ahead instructions since m_run_ahead_cost was last updated
+    std::chrono::steady_clock::duration m_real_time {};
+    std::chrono::steady_clock::duration m_ahead_time {};
+    std::size_t m_cost_frames = 0;
+
+    //! Key events from the frontend, drained by the cpu thread between instructions
+    spsc_queue<key_event, 256> m_key_events;
+
+    //! A key press no instruction has seen yet
+    struct pending_press
+    {
+        std::chrono::steady_clock::time_point m_arrival;    //! key_event::m_time
+        std::chrono::steady_clock::time_point m_applied;    //! When the cpu thread applied it
+    };
+
+    //! Presses by key, until an instruction sees the press (or the key goes up)
+    std::array<std::optional<pending_press>, 16> m_key_pressed_at;
+    std::size_t m_keys_pending = 0;
+
+    //! See get_input_latency
+    latency_histogram m_input_latency;
+
+    //! See get_photon_latency
+    photon_latency m_photon_latency;
+
+    //! See set_audio_sink, fed at the end of every frame
+    audio_output m_audio;
+
+    //! The press being followed to the screen (one at a time), and the screen when it was consumed
+    std::optional<photon_latency::trace> m_photon_trace;
+    cpu::framebuffer m_photon_screen;
+
+    //! A consumed press that changes no pixels in this long is dropped
+    static constexpr std::chrono::seconds photon_timeout { 1 };
+
+    //! @brief  Checks if the screen changed since the press of m_photon_trace was consumed
+    void observe_screen();
+
+    //! @brief  Applies the queued key events to the cpu, called by the cpu thread between instructions
+    void apply_key_events();
+
+    //! @brief              Records the latency of the pending press an instruction just saw, if any
+    //! @param opcode       The instruction executed
+    //! @param pc           Where it was executed
+    void observe_key_presses(const std::uint16_t& opcode, const std::uint16_t& pc);
+
+    //! See set_turbo
+    std::atomic<bool> m_turbo { false };
+    std::chrono::steady_clock::time_point m_last_turbo_publish;
+
+    //! See get_speed, timer ticks counted since m_speed_since
+    std::atomic<double> m_speed { 0.0 };
+    std::size_t m_speed_ticks = 0;
+    std::chrono::steady_clock::time_point m_speed_since = std::chrono::steady_clock::now();
+
+    //! Instructions executed in the current frame
+    std::size_t m_cycle = 0;
+
+    //! What m_movie is doing
+    enum class movie_mode
+    {
+        none,
+        recording,  //! Key events are added to it
+        playing     //! Its key events are applied instead of the frontend's
+    };
+
+    movie_mode m_movie_mode = movie_mode::none;
+    movie m_movie;
+
+    //! RecordMovie's m_on_data, called with the movie when the recording ends
+    std::function<void(std::vector<std::uint8_t>)> m_on_movie;
+
+    //! Playback: frames played, the next event, and the state hashes compared and mismatched
+    std::uint32_t m_movie_frame = 0;
+    std::size_t m_movie_event = 0;
+    std::size_t m_movie_checked = 0;
+    std::size_t m_movie_mismatches = 0;
+
+    //! @brief  Instructions per frame, clock_speed/60 or the movie's
+    std::size_t get_cycles_per_frame() const;
+
+    //! @brief  Runs one instruction, with the key events before it and the latency observers after it
+    void step();
+
+    //! @brief  Runs the rest of the frame without waiting for real time, see set_turbo
+    void run_turbo_frame();
+
+    //! @brief  Runs the instructions left in the current frame, then ends it
+    void complete_frame();
+
+    //! @brief  Ticks the timers, records the frame (rewind, movie) and publishes it
+    void end_frame();
+
+    //! @brief  Records or checks the frame that just ended against the movie
+    void end_movie_frame();
+
+    //! @brief  Ends the recording (handing it to m_on_movie) or the playback, if any
+    //! @details A recording ends on a frame boundary, the rest of the current frame is ran first
+    void stop_movie();
+
+    //! @brief  Counts timer ticks for get_speed
+    void count_ticks(const std::size_t& ticks);
+
+    //! @brief  Runs ahead (if enabled) and publishes the frame, called by the cpu thread at every tick
+    void publish_frame();
+
     //! Thread object for void cpu_thread()
     std::thread m_cpu_thread;
 
+    //! Set by the destructor to end the cpu thread
+    std::atomic<bool> m_die { false };
+
     //! Each instruction we execute using the cpu class is ran in here
     void cpu_thread();
 
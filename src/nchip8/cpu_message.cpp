@@ -11,7 +11,8 @@ cpu_message::cpu_message(const cpu_message_type& type) :
 m_type(type),
 m_data({}),
 m_callback([](){}),
-m_on_error([](){})
+m_on_error([](){}),
+m_on_data([](std::vector<std::uint8_t>){})
 {
 
 };
@@ -21,7 +22,8 @@ cpu_message::cpu_message(const cpu_message_type& type,
 m_type(type),
 m_data(std::move(data)),
 m_callback([](){}),
-m_on_error([](){})
+m_on_error([](){}),
+m_on_data([](std::vector<std::uint8_t>){})
 {
 
 };
@@ -32,7 +34,8 @@ cpu_message::cpu_message(const cpu_message_type& type,
 m_type(type),
 m_data(std::move(data)),
 m_callback(std::move(callback)),
-m_on_error([](){})
+m_on_error([](){}),
+m_on_data([](std::vector<std::uint8_t>){})
 {
 
 };
@@ -44,7 +47,20 @@ cpu_message::cpu_message(const cpu_message_type& type,
 m_type(type),
 m_data(std::move(data)),
 m_callback(std::move(callback)),
-m_on_error(std::move(error))
+m_on_error(std::move(error)),
+m_on_data([](std::vector<std::uint8_t>){})
+{
+
+};
+
+cpu_message::cpu_message(const cpu_message_type& type,
+            std::vector<std::uint8_t> data,
+            std::function<void(std::vector<std::uint8_t>)> on_data) :
+m_type(type),
+m_data(std::move(data)),
+m_callback([](){}),
+m_on_error([](){}),
+m_on_data(std::move(on_data))
 {
 
 };
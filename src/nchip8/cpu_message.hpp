@@ -5,6 +5,7 @@
 #ifndef NCHIP8_CPU_MESSAGE_HPP
 #define NCHIP8_CPU_MESSAGE_HPP
 
+#include <cstdint>
 #include <functional>
 #include <vector>
 
@@ -16,6 +17,15 @@ enum cpu_message_type : std::uint8_t
 {
     Reset,              //! Resets the cpu. Clear registers & ram, PC = 0x200   m_data: none
     LoadROM,            //! Writes a rom to cpu memory.                         m_data: vector of ROM binary
+    SaveState,          //! Snapshots the cpu, passed to m_on_data.             m_data: none, or { 1 } to compress
+    LoadState,          //! Restores a snapshot, m_on_error if it is invalid.   m_data: vector made by SaveState
+    Rewind,             //! Goes back in the rewind history.                    m_data: frames to go back (u16, little endian)
+    SetQuirks,          //! Switches the quirk profile, m_on_error if unknown.  m_data: { quirk_profile }
+    SetSeed,            //! Seeds RND, kept across resets.                      m_data: seed (u64, little endian)
+    RecordMovie,        //! Records the key input from here (see movie), the
+                        //! movie is passed to m_on_data when it ends.          m_data: the ROM loaded
+    PlayMovie,          //! Plays a movie back instead of the keys, the cpu
+                        //! has to be at its start, m_on_error if invalid.      m_data: vector made by movie::save
     _last               // Used to find amount of messages, keep at end of enum
 };
 
@@ -51,6 +61,13 @@ public:
                 std::function<void(void)> callback,
                 std::function<void(void)> error);
 
+    //! @brief          Construct a message that produces data (e.g SaveState)
+    //! @param data     See cpu_message_type for info on what data can be passed
+    //! @param on_data  lamdba, receives the produced data
+    cpu_message(const cpu_message_type& type,
+                std::vector<std::uint8_t> data,
+                std::function<void(std::vector<std::uint8_t>)> on_data);
+
     //! @see cpu_message_type
     cpu_message_type m_type;
 
@@ -63,6 +80,10 @@ public:
 
     //! This callback is called when an error occurs, see message type
     std::function<void(void)> m_on_error;
+
+    //! Called with the data produced by the message, before m_callback
+    //! (this is also called in the cpu_thread!)
+    std::function<void(std::vector<std::uint8_t>)> m_on_data;
 };
 
 //! A function of this type is called when the CPU receives a message
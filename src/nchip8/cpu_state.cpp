@@ -0,0 +1,233 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "cpu.hpp"
+#include "rle.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// This file includes the save state (de)serialization of cpu::
+
+namespace nchip8
+{
+
+//! @brief  Save state layout, version 4
+//! @details Header (10 bytes):
+//!              "NC8S", u8 version, u8 flags (bit 0: payload compressed), u32 raw payload size (little endian)
+//!          Payload (raw_size bytes, or run-length encoded when compressed):
+//!              RAM                     4096 (65536 with XO-CHIP)
+//!              V0-VF                   16
+//!              I, PC (u16 LE)          4
+//!              SP, DT, ST              3
+//!              screen mode, halted     2
+//!              stack (16 * u16 LE)     32
+//!              framebuffer             2048  (2 planes of 128*64 bits, MSB first, row-major, see cpu::framebuffer)
+//!              keys down (u16 LE)      2     (bit n = key n)
+//!              last key down           1     (0xFF = none)
+//!              RPL user flags          8
+//!              planes                  1
+//!              audio pattern, pitch    17
+//!              RND generator state     32    (4 * u64 LE, see prng)
+//!          Version 1 laid out lores rows two to a 128 pixel row, and had no RPL flags,
+//!          version 2 had a u16 raw size, one plane and no XO-CHIP state, version 3 no RND generator state
+static constexpr char state_magic[4] = { 'N', 'C', '8', 'S' };
+static constexpr std::uint8_t state_version = 4;
+static constexpr std::uint8_t state_flag_compressed = 0x1;
+static constexpr std::size_t state_header_size = 10;
+
+// everything but the RAM, which is 4K or 64K depending on the quirks
+static constexpr std::size_t state_fixed_size = 16 + 4 + 3 + 2 + 32 + 2048 + 2 + 1 + 8 + 1 + 16 + 1 + 32;
+
+//! @brief  A buffer of at least size bytes for this thread, kept between calls rather than ~68 kilobytes of stack each
+static std::uint8_t* state_scratch(const std::size_t& size)
+{
+    thread_local std::vector<std::uint8_t> scratch;
+    if(scratch.size() < size) scratch.resize(size);
+    return scratch.data();
+}
+
+// the words of every row, big endian (so the bytes are the pixels MSB first, left to right)
+static void pack_screen(const cpu::framebuffer& screen, std::uint8_t* out)
+{
+    for(std::size_t i = 0; i < screen.size(); i++)
+    {
+        for(int shift = 56; shift >= 0; shift -= 8) *out++ = screen[i] >> shift;
+    }
+}
+
+static void unpack_screen(const std::uint8_t* in, std::array<std::uint64_t, cpu::framebuffer::size()>& screen)
+{
+    for(auto& word : screen)
+    {
+        word = 0;
+        for(int byte = 0; byte < 8; byte++) word = (word << 8) | *in++;
+    }
+}
+
+void cpu::save_state(std::vector<std::uint8_t>& out, const bool& compress) const
+{
+    // uncompressed states are written straight into out, compressed ones go through the scratch buffer
+    const std::size_t ram_size = m_ram_mask + 1;
+    const std::size_t raw_size = ram_size + state_fixed_size;
+
+    out.resize(state_header_size + (compress ? 0 : raw_size));
+
+    std::uint8_t* header = out.data();
+    std::memcpy(header, state_magic, sizeof(state_magic));
+    header[4] = state_version;
+    header[5] = compress ? state_flag_compressed : 0;
+    for(int byte = 0; byte < 4; byte++) header[6 + byte] = (raw_size >> (byte * 8)) & 0xFF;
+
+    std::uint8_t* raw = compress ? state_scratch(raw_size) : out.data() + state_header_size;
+    std::uint8_t* p = raw;
+
+    auto put_u8 = [&p](const std::uint8_t& v) { *p++ = v; };
+    auto put_u16 = [&p](const std::uint16_t& v) { *p++ = v & 0xFF; *p++ = v >> 8; };
+
+    m_ram.read(0, p, ram_size); p += ram_size;
+    std::memcpy(p, m_gpr.data(), m_gpr.size()); p += m_gpr.size();
+
+    put_u16(m_i);
+    put_u16(m_pc);
+    put_u8(m_sp);
+    put_u8(m_dt);
+    put_u8(m_st);
+    put_u8(static_cast<std::uint8_t>(m_screen_mode));
+    put_u8(m_halted ? 1 : 0);
+
+    for(auto address : m_stack) put_u16(address);
+
+    pack_screen(m_screen, p); p += m_screen.size() * sizeof(std::uint64_t);
+
+    put_u16(m_keys_down);
+    put_u8(m_last_key_down);
+
+    std::memcpy(p, m_rpl_flags.data(), m_rpl_flags.size()); p += m_rpl_flags.size();
+
+    put_u8(m_planes);
+    std::memcpy(p, m_audio_pattern.data(), m_audio_pattern.size()); p += m_audio_pattern.size();
+    put_u8(m_audio_pitch);
+
+    for(auto word : m_random.get_state())
+    {
+        for(int byte = 0; byte < 8; byte++) put_u8(word >> (byte * 8));
+    }
+
+    if(compress)
+    {
+        rle_encode(raw, raw_size, out);
+    }
+}
+
+std::vector<std::uint8_t> cpu::save_state(const bool& compress) const
+{
+    std::vector<std::uint8_t> out;
+    out.reserve(state_header_size + m_ram_mask + 1 + state_fixed_size);
+    save_state(out, compress);
+    return out;
+}
+
+bool cpu::load_state(const std::vector<std::uint8_t>& data)
+{
+    if(data.size() < state_header_size) return false;
+    if(!std::equal(std::begin(state_magic), std::end(state_magic), data.begin())) return false;
+    if(data[4] != state_version) return false;
+
+    const std::size_t ram_size = m_ram_mask + 1;
+    std::size_t raw_size = 0;
+    for(int byte = 3; byte >= 0; byte--) raw_size = (raw_size << 8) | data[6 + byte];
+
+    // the RAM size is given by the quirks, a state of a cpu with other quirks does not fit
+    if(raw_size != ram_size + state_fixed_size) return false;
+
+    const std::uint8_t* payload = data.data() + state_header_size;
+    std::size_t payload_size = data.size() - state_header_size;
+
+    // compressed states are decoded into the scratch buffer first, so a bad state leaves the cpu untouched
+    const std::uint8_t* p = payload;
+
+    if(data[5] & state_flag_compressed)
+    {
+        std::uint8_t* scratch = state_scratch(raw_size);
+        if(!rle_decode(payload, payload_size, scratch, raw_size)) return false;
+        p = scratch;
+    }
+    else if(payload_size != raw_size)
+    {
+        return false;
+    }
+
+    auto get_u8 = [&p]() { return *p++; };
+    auto get_u16 = [&p]() { std::uint16_t v = p[0] | (p[1] << 8); p += 2; return v; };
+
+    // pages that already hold the right bytes stay shared with forks
+    m_ram.write(0, p, ram_size); p += ram_size;
+    std::memcpy(m_gpr.data(), p, m_gpr.size()); p += m_gpr.size();
+
+    m_i = get_u16();
+    m_pc = get_u16();
+    m_sp = get_u8();
+    m_dt = get_u8();
+    m_st = get_u8();
+    m_screen_mode = (get_u8() == screen_mode::hires_sc8) ? screen_mode::hires_sc8 : screen_mode::lores_c8;
+    m_halted = get_u8() != 0;
+
+    for(auto& address : m_stack) address = get_u16();
+
+    std::array<std::uint64_t, framebuffer::size()> screen;
+    unpack_screen(p, screen); p += screen.size() * sizeof(std::uint64_t);
+    m_screen.write(0, screen.data(), screen.size());
+
+    m_keys_down = get_u16();
+
+    std::uint8_t last_key = get_u8();
+    m_last_key_down = (last_key < 0x10) ? last_key : no_key;
+
+    std::memcpy(m_rpl_flags.data(), p, m_rpl_flags.size()); p += m_rpl_flags.size();
+
+    m_planes = get_u8() & 0x3;
+    std::memcpy(m_audio_pattern.data(), p, m_audio_pattern.size()); p += m_audio_pattern.size();
+    m_audio_pitch = get_u8();
+
+    prng::state_type random;
+    for(auto& word : random)
+    {
+        word = 0;
+        for(int byte = 0; byte < 8; byte++) word |= static_cast<std::uint64_t>(get_u8()) << (byte * 8);
+    }
+    m_random.set_state(random);
+
+    return true;
+}
+
+std::uint64_t cpu::hash_state(const std::vector<std::uint8_t>& state)
+{
+    std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ state.size();
+    std::size_t i = 0;
+
+    auto mix = [&h](std::uint64_t v)
+    {
+        v *= 0xBF58476D1CE4E5B9ULL;
+        v ^= v >> 31;
+        h = (h ^ v) * 0x94D049BB133111EBULL;
+        h ^= h >> 29;
+    };
+
+    // 8 bytes at a time, little endian regardless of the host so hashes can be compared across machines
+    for(; i + 8 <= state.size(); i += 8)
+    {
+        std::uint64_t v = 0;
+        for(int byte = 7; byte >= 0; byte--) v = (v << 8) | state[i + byte];
+        mix(v);
+    }
+
+    std::uint64_t tail = 0;
+    for(std::size_t byte = state.size(); byte > i; byte--) tail = (tail << 8) | state[byte - 1];
+    mix(tail);
+
+    return h;
+}
+
+}
@@ -0,0 +1,349 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "explorer.hpp"
+#include "io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace nchip8
+{
+
+explorer::explorer(params p) :
+    m_params(std::move(p))
+{
+    if(m_params.m_keys.empty())
+    {
+        for(std::uint8_t key = 0; key < 16; key++) m_params.m_keys.push_back(key);
+    }
+}
+
+void explorer::run_step(cpu& chip8, const std::int8_t& input, std::bitset<0x10000>& executed) const
+{
+    if(input != no_key) chip8.set_key_down(input);
+
+    for(std::size_t frame = 0; frame < m_params.m_frames_per_step && !chip8.is_halted(); frame++)
+    {
+        for(std::size_t cycle = 0; cycle < m_params.m_cycles_per_frame; cycle++)
+        {
+            executed[chip8.get_pc() & chip8.get_ram_mask()] = true;
+            if(!chip8.execute_op_at_pc()) break;
+        }
+
+        chip8.tick_timers();
+    }
+
+    // released before hashing, so the same machine state hashes the same whatever key got it there
+    if(input != no_key) chip8.set_key_up(input);
+}
+
+explorer::report explorer::run(const cpu& start) const
+{
+    report r;
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::int8_t> inputs { no_key };
+    for(auto key : m_params.m_keys) inputs.push_back(key & 0xF);
+
+    std::size_t threads = m_params.m_threads ? m_params.m_threads : std::thread::hardware_concurrency();
+    threads = std::max<std::size_t>(threads, 1);
+
+    struct node
+    {
+        std::unique_ptr<cpu> m_cpu;
+        path m_path;
+        double m_score = 0.0;
+    };
+
+    // every state seen so far, by hash, with the level and work index that first reached it.
+    // within a level the lowest work index wins, so the result does not depend on thread timing
+    struct seen_entry
+    {
+        std::size_t m_level;
+        std::size_t m_index;
+    };
+
+    struct shard
+    {
+        std::mutex m_mutex;
+        std::unordered_map<std::uint64_t, seen_entry> m_states;
+    };
+
+    constexpr std::size_t shard_count = 64;
+    std::vector<shard> seen(shard_count);
+
+    {
+        std::vector<std::uint8_t> state;
+        start.save_state(state);
+        seen[0].m_states.emplace(cpu::hash_state(state), seen_entry { 0, 0 });
+    }
+
+    auto score_of = [this](const cpu& chip8)
+    {
+        return m_params.m_score ? m_params.m_score(chip8) : 0.0;
+    };
+
+    std::vector<node> frontier;
+    frontier.push_back({ start.fork(), {}, score_of(start) });
+
+    for(std::size_t level = 1; level <= m_params.m_depth && !frontier.empty(); level++)
+    {
+        std::size_t work = frontier.size() * inputs.size();
+
+        // one slot per (parent, input), emptied when another child of this level reached the same state
+        std::vector<std::unique_ptr<cpu>> slots(work);
+        std::vector<std::bitset<0x10000>> executed(threads);
+        std::atomic<std::size_t> next { 0 };
+
+        // a thread takes all the inputs of a parent, so the parent's pages stay in its cache
+        auto worker = [&](const std::size_t& thread_index)
+        {
+            std::vector<std::uint8_t> state;
+
+            for(std::size_t parent = next++; parent < frontier.size(); parent = next++)
+            {
+                for(std::size_t input = 0; input < inputs.size(); input++)
+                {
+                    std::size_t w = (parent * inputs.size()) + input;
+
+                    auto child = frontier[parent].m_cpu->fork();
+                    run_step(*child, inputs[input], executed[thread_index]);
+
+                    child->save_state(state);
+                    std::uint64_t hash = cpu::hash_state(state);
+
+                    slots[w] = std::move(child);
+
+                    shard& s = seen[hash % shard_count];
+                    std::lock_guard<std::mutex> lock(s.m_mutex);
+
+                    auto [it, inserted] = s.m_states.try_emplace(hash, seen_entry { level, w });
+
+                    if(inserted) continue;
+
+                    if(it->second.m_level == level && it->second.m_index > w)
+                    {
+                        // we got there with an earlier input, take the state over
+                        slots[it->second.m_index].reset();
+                        it->second.m_index = w;
+                        continue;
+                    }
+
+                    slots[w].reset();
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for(std::size_t t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for(auto& thread : pool) thread.join();
+
+        for(const auto& e : executed) r.m_executed |= e;
+        r.m_expanded += work;
+
+        // sort out the survivors in work order
+        std::vector<node> children;
+
+        for(std::size_t w = 0; w < work; w++)
+        {
+            if(!slots[w]) continue;
+
+            r.m_unique++;
+
+            path p = frontier[w / inputs.size()].m_path;
+            p.push_back(inputs[w % inputs.size()]);
+
+            if(slots[w]->is_halted())
+            {
+                r.m_halts.push_back(p);
+                continue;
+            }
+
+            if(m_params.m_goal && m_params.m_goal(*slots[w]))
+            {
+                r.m_goals.push_back(p);
+                continue;
+            }
+
+            double score = score_of(*slots[w]);
+
+            if(m_params.m_score && (!r.m_best.has_value() || score > r.m_best_score))
+            {
+                r.m_best = p;
+                r.m_best_score = score;
+            }
+
+            children.push_back({ std::move(slots[w]), std::move(p), score });
+        }
+
+        // best first, earlier inputs first among equals
+        std::size_t keep = (m_params.m_strategy == strategy::beam) ? m_params.m_beam_width : m_params.m_max_frontier;
+
+        if(children.size() > keep)
+        {
+            std::stable_sort(children.begin(), children.end(), [](const node& a, const node& b)
+            {
+                return a.m_score > b.m_score;
+            });
+
+            children.resize(keep);
+        }
+
+        frontier = std::move(children);
+        r.m_steps = level;
+    }
+
+    r.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    return r;
+}
+
+std::string explorer::format_path(const path& p)
+{
+    std::stringstream ss;
+
+    for(std::size_t i = 0; i < p.size(); i++)
+    {
+        if(i > 0) ss << ' ';
+
+        if(p[i] == no_key) ss << '-';
+        else ss << std::hex << std::uppercase << static_cast<int>(p[i]);
+    }
+
+    return ss.str();
+}
+
+void explorer::write_report(std::ostream& out, const report& r,
+                            const std::uint32_t& code_start, const std::uint32_t& code_end)
+{
+    constexpr std::size_t max_paths = 20;
+
+    auto write_paths = [&out](const std::vector<path>& paths)
+    {
+        for(std::size_t i = 0; i < paths.size() && i < max_paths; i++)
+        {
+            out << "  " << format_path(paths[i]) << '\n';
+        }
+
+        if(paths.size() > max_paths) out << "  ... " << (paths.size() - max_paths) << " more\n";
+    };
+
+    out << std::dec << "# explored " << r.m_steps << " steps: " << r.m_expanded << " children, "
+        << r.m_unique << " unique states, " << std::fixed << std::setprecision(2) << r.m_seconds << "s\n";
+    out << "# inputs are one per step, - = no key, 0-F = key held\n";
+
+    out << "\n# halts (" << r.m_halts.size() << ")\n";
+    write_paths(r.m_halts);
+
+    out << "\n# goals (" << r.m_goals.size() << ")\n";
+    write_paths(r.m_goals);
+
+    if(r.m_best.has_value())
+    {
+        out << "\n# best score " << r.m_best_score << "\n  " << format_path(r.m_best.value()) << '\n';
+    }
+
+    // a byte is covered when an instruction starting on it or the byte before was executed
+    auto covered = [&r](const std::uint32_t& address)
+    {
+        return r.m_executed[address & 0xFFFF] || (address > 0 && r.m_executed[(address - 1) & 0xFFFF]);
+    };
+
+    std::size_t uncovered = 0;
+    for(std::uint32_t address = code_start; address < code_end; address++)
+    {
+        if(!covered(address)) uncovered++;
+    }
+
+    out << "\n# never executed (code or data) in " << nchip8::nnn << code_start << '-' << nchip8::nnn << code_end
+        << std::dec << std::setfill(' ') << ": " << uncovered << " bytes\n";
+
+    for(std::uint32_t address = code_start; address < code_end; )
+    {
+        if(covered(address)) { address++; continue; }
+
+        std::uint32_t end = address;
+        while(end < code_end && !covered(end)) end++;
+
+        out << "  " << nchip8::nnn << address << '-' << nchip8::nnn << (end - 1)
+            << std::dec << std::setfill(' ') << "  " << (end - address) << " bytes\n";
+
+        address = end;
+    }
+}
+
+std::optional<std::function<int(const cpu&)>> explorer::parse_probe(const std::string& name)
+{
+    if(name.size() == 2 && (name[0] == 'v' || name[0] == 'V') && std::isxdigit(name[1]))
+    {
+        std::size_t x = std::stoul(name.substr(1), nullptr, 16);
+        return [x](const cpu& chip8) { return static_cast<int>(chip8.get_gpr()[x]); };
+    }
+
+    if(name == "i") return [](const cpu& chip8) { return static_cast<int>(chip8.get_i()); };
+    if(name == "pc") return [](const cpu& chip8) { return static_cast<int>(chip8.get_pc()); };
+    if(name == "sp") return [](const cpu& chip8) { return static_cast<int>(chip8.get_sp()); };
+    if(name == "dt") return [](const cpu& chip8) { return static_cast<int>(chip8.get_dt()); };
+    if(name == "st") return [](const cpu& chip8) { return static_cast<int>(chip8.get_st()); };
+
+    if(name.rfind("ram:", 0) == 0)
+    {
+        try
+        {
+            // read_u8 masks it to the RAM of the cpu's profile (64K under XO-CHIP)
+            std::uint16_t address = std::stoul(name.substr(4), nullptr, 0) & 0xFFFF;
+            return [address](const cpu& chip8) { return static_cast<int>(chip8.read_u8(address)); };
+        }
+        catch(const std::exception&)
+        {
+            return std::nullopt;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::function<bool(const cpu&)>> explorer::parse_goal(const std::string& goal)
+{
+    // longest operators first, so <= isn't read as <
+    for(const std::string op : { "==", "!=", "<=", ">=", "<", ">" })
+    {
+        auto at = goal.find(op);
+        if(at == std::string::npos) continue;
+
+        auto probe = parse_probe(goal.substr(0, at));
+        if(!probe.has_value()) return std::nullopt;
+
+        int value = 0;
+
+        try
+        {
+            value = std::stoi(goal.substr(at + op.size()), nullptr, 0);
+        }
+        catch(const std::exception&)
+        {
+            return std::nullopt;
+        }
+
+        auto get = probe.value();
+
+        if(op == "==") return [get, value](const cpu& chip8) { return get(chip8) == value; };
+        if(op == "!=") return [get, value](const cpu& chip8) { return get(chip8) != value; };
+        if(op == "<=") return [get, value](const cpu& chip8) { return get(chip8) <= value; };
+        if(op == ">=") return [get, value](const cpu& chip8) { return get(chip8) >= value; };
+        if(op == "<") return [get, value](const cpu& chip8) { return get(chip8) < value; };
+        return [get, value](const cpu& chip8) { return get(chip8) > value; };
+    }
+
+    return std::nullopt;
+}
+
+}
@@ -0,0 +1,103 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_EXPLORER_HPP
+#define NCHIP8_EXPLORER_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Searches the key inputs of a ROM, headless and on every core
+//! @details Starting from one machine state, every step forks each state of the frontier once per input
+//!          (no key, or one of the allowed keys held) and runs the children for a few frames in virtual time.
+//!          Children that end up in a state already seen (by hash) are dropped. Breadth-first keeps every
+//!          new state, beam search only the best scoring ones. Along the way it records the inputs that
+//!          halt the cpu, the first inputs that satisfy the goal, and which addresses were ever executed.
+class explorer
+{
+public:
+    //! @brief The input held during a step, no_key or a key 0x0-0xF
+    static constexpr std::int8_t no_key = -1;
+
+    enum class strategy
+    {
+        bfs,    //! Keep every new state (up to m_max_frontier)
+        beam    //! Keep the m_beam_width best scoring new states
+    };
+
+    struct params
+    {
+        strategy m_strategy = strategy::bfs;
+        std::size_t m_depth = 8;                //! Steps (inputs) per path
+        std::size_t m_beam_width = 256;
+        std::size_t m_max_frontier = 100000;    //! Breadth-first keeps the best scoring ones past this
+        std::size_t m_frames_per_step = 6;      //! How long each input is held, 60Hz frames
+        std::size_t m_cycles_per_frame = 12;
+        std::size_t m_threads = 0;              //! 0 = every core
+        std::vector<std::uint8_t> m_keys;       //! Keys to try besides no key, empty = all 16
+
+        //! Higher is better, ranks states for beam search (and the frontier cap), may be empty
+        std::function<double(const cpu&)> m_score;
+
+        //! A state that satisfies this ends its path (and is reported), may be empty
+        std::function<bool(const cpu&)> m_goal;
+    };
+
+    //! @brief A sequence of inputs from the start state, one per step
+    using path = std::vector<std::int8_t>;
+
+    struct report
+    {
+        std::size_t m_steps = 0;            //! Steps actually searched
+        std::uint64_t m_expanded = 0;       //! Children ran
+        std::uint64_t m_unique = 0;         //! Children in a state never seen before
+        std::vector<path> m_halts;          //! Inputs that halt the cpu (one per distinct halted state)
+        std::vector<path> m_goals;          //! Inputs that reach the goal (one per distinct goal state)
+        std::optional<path> m_best;         //! Inputs of the best scoring state
+        double m_best_score = 0.0;
+        std::bitset<0x10000> m_executed;    //! Addresses executed by any child, the whole 64K of XO-CHIP
+        double m_seconds = 0.0;
+    };
+
+    explicit explorer(params p);
+
+    //! @brief  Searches from a state, the start cpu is not modified
+    report run(const cpu& start) const;
+
+    //! @brief              Writes a report, with the never executed instructions in [code_start, code_end)
+    static void write_report(std::ostream& out, const report& r,
+                             const std::uint32_t& code_start, const std::uint32_t& code_end);
+
+    //! @brief      Parses a probe of the machine state: v0-vF, i, pc, sp, dt, st or ram:<address>
+    //! @returns    std::nullopt if the name is not a probe
+    static std::optional<std::function<int(const cpu&)>> parse_probe(const std::string& name);
+
+    //! @brief      Parses a goal, <probe><op><value> with op one of == != <= >= < >
+    //! @returns    std::nullopt if it is malformed
+    static std::optional<std::function<bool(const cpu&)>> parse_goal(const std::string& goal);
+
+    //! @brief      Formats a path, e.g. "- 5 5 A" (- = no key)
+    static std::string format_path(const path& p);
+
+private:
+    params m_params;
+
+    //! @brief  Runs one step of a child with an input held, marking the executed addresses
+    void run_step(cpu& chip8, const std::int8_t& input, std::bitset<0x10000>& executed) const;
+};
+
+}
+
+#endif //NCHIP8_EXPLORER_HPP
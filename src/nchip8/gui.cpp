@@ -8,21 +8,75 @@
 #include <curses.h>
 #include <clocale>
 #include <cstdio>
+#include <csignal>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <array>
+#include <cerrno>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace nchip8
 {
 
+//! First color pair used by the heatmap
+static constexpr short heatmap_pair_base = 16;
+
+//! Number of heat codes, see heat_code
+static constexpr short heat_codes = 14;
+
+//! 256 color palette entry of each heat code:
+//! none, execute (greens), write (reds), read (blues), execute+write (magenta)
+static const short heat_color[heat_codes] = {
+    -1,
+    22, 28, 34, 46,
+    52, 88, 160, 196,
+    17, 19, 21, 33,
+    201
+};
+
+//! First color pair used by the XO-CHIP planes, pair plane_pair_base + (fg - 1) * 4 + bg (see plane_color)
+static constexpr short plane_pair_base = 2;
+
+//! Color of each XO-CHIP pixel value (bit n set: on in plane n): background, plane 0, plane 1, both
+static const short plane_color[4] = { -1, COLOR_WHITE, COLOR_RED, COLOR_YELLOW };
+
+//! Self-pipe the SIGWINCH handler writes to, so loop() can poll for terminal resizes
+static int resize_pipe[2] = { -1, -1 };
+
+static void on_sigwinch(int)
+{
+    // only async-signal-safe calls in here
+    char c = 0;
+    if(::write(resize_pipe[1], &c, 1) < 0) { /* pipe full, a resize is pending already */ }
+}
+
 gui::gui(std::shared_ptr<cpu_daemon>& cpu) :
     m_cpu_daemon(cpu)
 {
     this->rebuild_windows();
+    getmaxyx(m_window.get(), m_window_h, m_window_w);
+
+    if(::pipe2(resize_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        throw std::runtime_error("Could not create the resize pipe!");
+    }
+
+    // replaces the handler of ncurses, handle_resize() does its work
+    struct sigaction action {};
+    action.sa_handler = on_sigwinch;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGWINCH, &action, nullptr);
 }
 
 gui::~gui()
@@ -37,6 +91,10 @@ gui::~gui()
 
     // kill window
     ::endwin();
+
+    ::signal(SIGWINCH, SIG_DFL);
+    ::close(resize_pipe[0]);
+    ::close(resize_pipe[1]);
 }
 
 void gui::rebuild_windows()
@@ -60,6 +118,9 @@ void gui::rebuild_windows()
     // disable cursor
     ::curs_set(0);
 
+    // Esc quits, don't wait a whole second to tell it apart from an escape sequence
+    ::set_escdelay(25);
+
     // non blocking input
     ::cbreak();
     ::nodelay(m_window.get(), TRUE);
@@ -78,6 +139,37 @@ void gui::rebuild_windows()
     // set up a pair using the current bg color
     init_pair(1,COLOR_WHITE,term_bg);
 
+    // heatmap cells are drawn as ▀, the top cell is the fg color and the bottom cell the bg color,
+    // so there is a pair for every combination of the two (see heat_color)
+    m_heatmap_colors = (COLORS >= 256 && COLOR_PAIRS >= heatmap_pair_base + heat_codes * heat_codes);
+
+    if(m_heatmap_colors)
+    {
+        for(short top = 0; top < heat_codes; top++)
+        {
+            for(short bottom = 0; bottom < heat_codes; bottom++)
+            {
+                init_pair(heatmap_pair_base + top * heat_codes + bottom,
+                          top ? heat_color[top] : term_bg, bottom ? heat_color[bottom] : term_bg);
+            }
+        }
+    }
+
+    // XO-CHIP pixels are drawn as the half block of a lores cell in the fg color of the one
+    // and the bg color of the other, so there is a pair for every two different colors
+    m_plane_colors = ::has_colors() && COLOR_PAIRS >= plane_pair_base + 12;
+
+    if(m_plane_colors)
+    {
+        for(short fg = 1; fg < 4; fg++)
+        {
+            for(short bg = 0; bg < 4; bg++)
+            {
+                init_pair(plane_pair_base + (fg - 1) * 4 + bg, plane_color[fg], bg ? plane_color[bg] : term_bg);
+            }
+        }
+    }
+
     // 66 x 18 (64x16 excluding border)
     m_screen_window = std::shared_ptr<::WINDOW>(::newwin(18, 66, 0, 0), ::wdelch);
     wattron(m_screen_window.get(),A_BOLD); // make whiter
@@ -91,23 +183,37 @@ void gui::rebuild_windows()
     wattron(m_reg_window.get(), A_BOLD);
     wattron(m_reg_window.get(), COLOR_PAIR(0));
 
+    this->create_side_window();
+
 }
 
-void gui::update_windows_on_resize()
+void gui::create_side_window()
 {
-    // get current terminal size
-    static int new_term_w = 0;
-    static int new_term_h = 0;
-    getmaxyx(m_window.get(), new_term_h, new_term_w);
+    // the heatmap is 64 cells wide, and 64 cells tall at two cells per line
+    int h = (m_side_pane == side_pane::heatmap) ? 34 : 28;
+    int w = (m_side_pane == side_pane::heatmap) ? 66 : 34;
 
-    // resize the window if it's changed its size within the past update
-    if (new_term_w != m_window_w || new_term_h != m_window_h)
-    {
-        m_window_w = new_term_w;
-        m_window_h = new_term_h;
-        this->update_log_window();
-        this->rebuild_windows();
-    }
+    m_side_window = std::shared_ptr<::WINDOW>(::newwin(h, w, 0, 80), ::wdelch);
+    wattron(m_side_window.get(), A_BOLD);
+    wattron(m_side_window.get(), COLOR_PAIR(0));
+}
+
+void gui::handle_resize()
+{
+    char c;
+    while(::read(resize_pipe[0], &c, 1) > 0) { }
+
+    // tell ncurses about the new size, its own SIGWINCH handler would have done this
+    struct winsize size {};
+    if(::ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) < 0) return;
+
+    ::resize_term(size.ws_row, size.ws_col);
+    nchip8::log << "[gui] terminal resized to " << std::dec << size.ws_col << "x" << size.ws_row << '\n';
+
+    m_window_w = size.ws_col;
+    m_window_h = size.ws_row;
+    this->update_log_window();
+    this->rebuild_windows();
 }
 
 /**
@@ -128,21 +234,81 @@ const std::unordered_map<int, std::uint8_t> gui::key_mapping =
     {'z',0xA}, {'x',0x0}, {'c',0xB}, {'v', 0xF},
 };
 
+void gui::set_frame_rate_cap(const std::size_t& fps)
+{
+    m_frame_rate_cap = fps;
+}
+
+std::function<void()> gui::get_bell() const
+{
+    return [bell = m_bell]() { bell->store(true, std::memory_order_relaxed); };
+}
+
 void gui::loop()
 {
-    bool die = false;
+    std::array<::pollfd, 3> fds {{
+        { STDIN_FILENO, POLLIN, 0 },
+        { resize_pipe[0], POLLIN, 0 },
+        { m_cpu_daemon->get_frame_event_fd(), POLLIN, 0 }
+    }};
 
-    while (!die)
+    auto last_render = std::chrono::steady_clock::time_point();
+    std::uint64_t rendered_frame = 0;
+    bool first = true;
+
+    while (!m_quit)
     {
-        // do gui tasks
-        update_keys();
-        update_windows_on_resize();
+        auto now = std::chrono::steady_clock::now();
+        auto wake = now + idle_timeout;
+
+        // a frame held back by the cap, or a key to release
+        bool frame_waiting = m_cpu_daemon->get_frame_number() != rendered_frame;
+        std::chrono::steady_clock::duration min_interval = std::chrono::steady_clock::duration::zero();
+        if(m_frame_rate_cap) min_interval = std::chrono::seconds(1) / static_cast<std::int64_t>(m_frame_rate_cap);
+
+        if(frame_waiting) wake = std::min(wake, last_render + min_interval);
+
+        for(const auto& [key, seen] : m_keys) wake = std::min(wake, seen + key_hold);
+
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+
+        if(::poll(fds.data(), fds.size(), first ? 0 : static_cast<int>(std::max<std::int64_t>(timeout, 0))) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll failed!");
+        }
+
+        if(fds[0].revents & POLLIN) update_keys();
+        if(fds[1].revents & POLLIN) handle_resize();
+
+        if(fds[2].revents & POLLIN)
+        {
+            std::uint64_t frames;
+            if(::read(fds[2].fd, &frames, sizeof(frames)) < 0) { /* already drained */ }
+        }
+
+        release_keys();
         update_log_on_global_log_change();
-        update_screen_window();
-        update_reg_window();
 
-        // gui aims to be at 60fps
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000/60));
+        // the bell of the audio thread, rung here as curses owns the terminal
+        if(m_bell->exchange(false, std::memory_order_relaxed)) ::beep();
+
+        // at most once per published frame, the registers and side pane are redrawn along with it
+        // (or every idle_timeout while nothing is published, e.g. paused)
+        now = std::chrono::steady_clock::now();
+        std::uint64_t frame = m_cpu_daemon->get_frame_number();
+
+        bool due = (frame != rendered_frame && now >= last_render + min_interval) || now >= last_render + idle_timeout;
+
+        if(first || due)
+        {
+            update_screen_window();
+            update_reg_window();
+            update_side_window();
+
+            rendered_frame = frame;
+            last_render = now;
+            first = false;
+        }
     }
 }
 
@@ -195,38 +361,60 @@ void gui::update_log_window()
     ::wrefresh(m_log_window.get());
 }
 
-// interpolates a screen string from the current frame to the previous one
-static void interp_screen(std::wstring& this_scr, std::wstring& prev_scr)
+// interpolates the cells of the current frame with the previous one
+static void interp_screen(std::vector<std::uint8_t>& this_scr, const std::vector<std::uint8_t>& prev_scr)
 {
     // we need to interpolate the new screen with the previous one
     // to prevent the flicker typically caused by unbuffered chip8
     // we basically combine the previous frames pixels to this frame
-    for(std::size_t i = 0; i < this_scr.length(); i++)
+    for(std::size_t i = 0; i < this_scr.size() && i < prev_scr.size(); i++)
     {
-        auto last_scr_char = prev_scr[i];
-        auto this_scr_char = this_scr[i];
+        this_scr[i] |= prev_scr[i];
+    }
+}
 
-        if(last_scr_char == L' '){ continue; } // nothing to interpolate
+// the character of a cell of the screen window, from the pixels it covers (see update_screen_window)
+static wchar_t screen_glyph(const cpu::screen_mode& mode, const std::uint8_t& cell)
+{
+    // ▀ to represent the top pixel on, ▄ the bottom one, █ both
+    static const wchar_t half_blocks[4] = { L' ', L'▀', L'▄', L'█' };
 
+    if(cell == 0) return L' ';
+    if(mode == cpu::screen_mode::lores_c8) return half_blocks[cell & 0x3];
 
-        if(last_scr_char == L'█')
-        {
-            this_scr[i] = L'█';
-            continue;
-        }
+    // the cell bits are the braille dot bits
+    return static_cast<wchar_t>(0x2800 + cell);
+}
 
-        if((last_scr_char == L'▀' && this_scr_char == L'▄') ||
-                (last_scr_char == L'▄' && this_scr_char == L'▀'))
-        {
-            this_scr[i] = L'█';
-            continue;
-        }
-        else
+//! @brief  How a screen cell is drawn with the colors of the XO-CHIP planes
+struct plane_cell_style
+{
+    wchar_t m_glyph = L' ';
+    short m_pair = 1;
+};
+
+// the style of every (top, bottom) pair of lores pixel colors, indexed by top | bottom << 2:
+// ▀ in the top color over the bottom one, or ▄/█ when the top one is the background or the same color
+static const std::array<plane_cell_style, 16> lores_plane_styles = []()
+{
+    std::array<plane_cell_style, 16> styles {};
+
+    for(short code = 0; code < 16; code++)
+    {
+        const short top = code & 0x3;
+        const short bottom = code >> 2;
+
+        if(top == 0 && bottom == 0) styles[code] = { L' ', 1 };
+        else if(top == 0) styles[code] = { L'▄', static_cast<short>(plane_pair_base + (bottom - 1) * 4) };
+        else if(top == bottom || bottom == 0)
         {
-            this_scr[i] = last_scr_char;
+            styles[code] = { top == bottom ? L'█' : L'▀', static_cast<short>(plane_pair_base + (top - 1) * 4) };
         }
+        else styles[code] = { L'▀', static_cast<short>(plane_pair_base + (top - 1) * 4 + bottom) };
     }
-}
+
+    return styles;
+}();
 
 void gui::update_screen_window()
 {
@@ -235,67 +423,152 @@ void gui::update_screen_window()
         return;
     }
 
-    auto mode = m_cpu_daemon->get_screen_mode();
+    // present the published frame, not the screen the cpu thread is drawing to
+    auto frame = m_cpu_daemon->get_frame();
+    auto mode = frame.m_screen_mode;
 
     // We need to convert screen pixels to block level elements
     // It's important to realise that we are not simply representing a pixel by 1 block
-    // We are compressing the 2 rows of pixels into 1 line of characters
-    // ▄ to represent the top pixel being off, the bottom on
-
-    // ▀ to represent the bottom pixel being off, the top on
-    // █ to represent 2 pixels above each-other
+    // Both modes fit in a 64x16 window:
+    // in lores we are compressing the 2 rows of pixels into 1 line of characters (half blocks),
+    // in hires 2x4 pixels into 1 braille character
 
-    // to prevent flickering we get the string that had been previously drawn on the screen
+    // to prevent flickering we keep the cells that had been previously drawn on the screen
     // and interpolate the new screen
+    static constexpr unsigned int cols = 64;
+    static constexpr unsigned int lines = 16;
 
-    static std::wstring prev_scr{std::wstring(L' ',128*32)};
+    static std::vector<std::uint8_t> prev_scr(cols*lines, 0);
+    static std::vector<std::uint8_t> prev_colors(cols*lines, 0);
+    static cpu::screen_mode prev_mode = cpu::screen_mode::lores_c8;
 
-    unsigned int width = (mode == cpu::screen_mode::hires_sc8 ? 128 : 64);
-    unsigned int height = (mode == cpu::screen_mode::lores_c8 ? 64 : 32);
+    // the previous frame has nothing to add after a mode switch
+    if(mode != prev_mode)
+    {
+        std::fill(prev_scr.begin(), prev_scr.end(), 0);
+        std::fill(prev_colors.begin(), prev_colors.end(), 0);
+    }
+    prev_mode = mode;
 
-    // calculate current screen
-    std::wstring this_scr;
-    for (unsigned int y = 0; y < (height); y+=2)
+    // calculate current screen, the pixels each cell covers and their colors:
+    // top | bottom << 2 in lores, the OR of every dot in hires
+    std::vector<std::uint8_t> this_scr(cols*lines, 0);
+    std::vector<std::uint8_t> this_colors(cols*lines, 0);
+    bool plane1 = false;
+
+    for (unsigned int line = 0; line < lines; line++)
     {
-        for (unsigned int x = 0; x < width; x++)
+        for (unsigned int col = 0; col < cols; col++)
         {
-            bool set_top = m_cpu_daemon->get_screen_xy(x, y);
+            std::uint8_t& cell = this_scr[line*cols + col];
+            std::uint8_t& colors = this_colors[line*cols + col];
 
-            // check the row of pixels below and see if we can get a group of two vertical pixels
-            bool set_bottom = m_cpu_daemon->get_screen_xy(x, y + 1);
+            if(mode == cpu::screen_mode::lores_c8)
+            {
+                // check the row of pixels below and see if we can get a group of two vertical pixels
+                std::uint8_t top = frame.get_color(col, line*2);
+                std::uint8_t bottom = frame.get_color(col, line*2 + 1);
+
+                cell = (top ? 0x1 : 0) | (bottom ? 0x2 : 0);
+                colors = top | (bottom << 2);
+                plane1 |= (colors & 0xA) != 0;
+                continue;
+            }
 
-            if (set_top && set_bottom)
-            { this_scr += L"█"; /* █ */ continue; }
+            // braille dots 1-3 and 7 are the left column top to bottom, 4-6 and 8 the right one
+            static const std::uint8_t dots[4][2] = { {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80} };
 
-            if (set_top)
-            { this_scr += L"▀"; /* ▀ */ continue; }
+            for(unsigned int dy = 0; dy < 4; dy++)
+            {
+                for(unsigned int dx = 0; dx < 2; dx++)
+                {
+                    std::uint8_t color = frame.get_color(col*2 + dx, line*4 + dy);
+                    if(color) cell |= dots[dy][dx];
+                    colors |= color;
+                }
+            }
 
-            if (set_bottom)
-            { this_scr += L"▄"; /* ▄ */ continue; }
-            
-            this_scr += L' ';
+            plane1 |= (colors & 0x2) != 0;
         }
-        this_scr += L'\n';
-
-        // ncurses will wrap the next line to the first char (x = 0)
-        // of the next line, (this is where the border is)
-        // pad it by 1 space
-        // (this char will then be overidden by the border redraw below)
-        this_scr += L' ';
     }
 
     // save a copy of the current screen
-    std::wstring this_scr_no_interp = this_scr;
+    std::vector<std::uint8_t> this_scr_no_interp = this_scr;
+    std::vector<std::uint8_t> this_colors_no_interp = this_colors;
 
     interp_screen(this_scr,prev_scr);
+    interp_screen(this_colors,prev_colors);
 
     // set prev frame for the next screen update
     prev_scr = this_scr_no_interp;
+    prev_colors = this_colors_no_interp;
+
+    // frames with plane 1 pixels (XO-CHIP) are composited through the plane styles,
+    // a run of cells of the same color pair at a time
+    if(m_plane_colors && plane1)
+    {
+        for (unsigned int line = 0; line < lines; line++)
+        {
+            unsigned int col = 0;
+            while(col < cols)
+            {
+                const unsigned int start = col;
+                std::wstring run;
+                short pair = 1;
+
+                while(col < cols)
+                {
+                    const std::uint8_t colors = this_colors[line*cols + col];
+                    plane_cell_style style = lores_plane_styles[colors & 0xF];
+
+                    if(mode != cpu::screen_mode::lores_c8)
+                    {
+                        style.m_glyph = screen_glyph(mode, this_scr[line*cols + col]);
+                        style.m_pair = colors ? static_cast<short>(plane_pair_base + ((colors & 0x3) - 1) * 4) : 1;
+                    }
+
+                    if(col > start && style.m_pair != pair) break;
+
+                    pair = style.m_pair;
+                    run += style.m_glyph;
+                    col++;
+                }
+
+                ::wcolor_set(m_screen_window.get(), pair, nullptr);
+                mvwaddwstr(m_screen_window.get(), 1 + line, 1 + start, run.c_str());
+            }
+        }
 
-    mvwaddwstr(m_screen_window.get(), 1, 1, this_scr.c_str());
+        ::wcolor_set(m_screen_window.get(), 1, nullptr);
+        ::wborder(m_screen_window.get(), 0, 0, 0, 0, 0, 0, 0, 0);
+        ::wrefresh(m_screen_window.get());
+
+        m_cpu_daemon->frame_presented(frame.m_number);
+        return;
+    }
+
+    std::wstring text;
+    for (unsigned int line = 0; line < lines; line++)
+    {
+        for (unsigned int col = 0; col < cols; col++)
+        {
+            text += screen_glyph(mode, this_scr[line*cols + col]);
+        }
+        text += L'\n';
+
+        // ncurses will wrap the next line to the first char (x = 0)
+        // of the next line, (this is where the border is)
+        // pad it by 1 space
+        // (this char will then be overidden by the border redraw below)
+        text += L' ';
+    }
+
+    mvwaddwstr(m_screen_window.get(), 1, 1, text.c_str());
     ::wborder(m_screen_window.get(), 0, 0, 0, 0, 0, 0, 0, 0);
     ::wrefresh(m_screen_window.get());
 
+    // the write to the terminal returned, as far as we can see the frame is on screen
+    m_cpu_daemon->frame_presented(frame.m_number);
 }
 
 void gui::update_reg_window()
@@ -312,6 +585,35 @@ void gui::update_reg_window()
 
     // TODO: write a function for this spam
 
+    // emulated time over real time, T in turbo
+    {
+        std::stringstream speed;
+        speed << std::fixed << std::setprecision(1) << m_cpu_daemon->get_speed();
+        row << "x" << std::setfill(' ') << std::left << std::setw(8) << speed.str() << std::right
+            << (m_cpu_daemon->get_turbo() ? " T" : "  ");
+    }
+    mvwaddstr(m_reg_window.get(), 17, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    // audio latency and underruns
+    const auto& audio = m_cpu_daemon->get_audio();
+    row << "AU " << std::setw(9) << std::left;
+
+    if(audio.is_started())
+    {
+        std::stringstream au;
+        au << (audio.get_latency_us() / 1000) << "ms u" << audio.get_underruns();
+        row << au.str();
+    }
+    else
+    {
+        row << "-";
+    }
+
+    row << std::right;
+    mvwaddstr(m_reg_window.get(), 18, 1, row.str().c_str());
+    row.str(""); row.clear();
+
     row << "PC " << nchip8::nnn << (std::uint16_t)m_cpu_daemon->get_pc();
     mvwaddstr(m_reg_window.get(), 19, 1, row.str().c_str());
     row.str(""); row.clear();
@@ -332,36 +634,327 @@ void gui::update_reg_window()
     mvwaddstr(m_reg_window.get(), 23, 1, row.str().c_str());
     row.str(""); row.clear();
 
+    // seconds of rewind history
+    row << "RW " << std::setfill(' ') << std::left << std::setw(9)
+        << (std::to_string(m_cpu_daemon->get_rewind_frames() / 60) + "s") << std::right;
+    mvwaddstr(m_reg_window.get(), 25, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    // run-ahead frames and what they cost on top of the real frames
+    row << "RA " << std::dec << m_cpu_daemon->get_run_ahead() << " +"
+        << std::setw(5) << std::left << (std::to_string(static_cast<int>(m_cpu_daemon->get_run_ahead_cost() * 100)) + "%")
+        << std::right;
+    mvwaddstr(m_reg_window.get(), 26, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    // median time from a key press to the ROM seeing it
+    const auto& input_latency = m_cpu_daemon->get_input_latency();
+    row << "IN " << std::setw(9) << std::left;
+
+    if(input_latency.get_count() > 0)
+    {
+        std::stringstream ms;
+        ms << std::fixed << std::setprecision(1) << (input_latency.get_percentile(0.5) / 1000.0) << "ms";
+        row << ms.str();
+    }
+    else
+    {
+        row << "-";
+    }
+
+    row << std::right;
+    mvwaddstr(m_reg_window.get(), 24, 1, row.str().c_str());
+    row.str(""); row.clear();
+
     ::wborder(m_reg_window.get(), 0, 0, 0, 0, 0, 0, 0, 0);
     ::wrefresh(m_reg_window.get());
 }
 
-void gui::update_keys()
+void gui::next_side_pane()
 {
-    // key chars are stored lowercase,
-    // tolower will pass thru non-characters as-well (e.g. 0->0)
-    int c = getch();
-    int char_lowered = std::tolower(c);
+    m_side_pane = static_cast<side_pane>((static_cast<int>(m_side_pane) + 1) % static_cast<int>(side_pane::_last));
 
-    // if we didnt get a bad char and there is a valid mapping
-    // tell the cpu the key is down
-    if(c != ERR && key_mapping.count(char_lowered))
+#ifndef NCHIP8_OP_STATS
+    // nothing to show without the instrumentation
+    if(m_side_pane == side_pane::op_stats) { next_side_pane(); return; }
+#endif
+
+    // panes have different sizes, wipe what the previous one left on the terminal
+    if(m_side_window)
     {
-        // tell the cpu the key is down
-        m_cpu_daemon->set_key_down(key_mapping.at(char_lowered));
+        ::werase(m_side_window.get());
+        ::wrefresh(m_side_window.get());
+    }
+
+    this->create_side_window();
+}
+
+void gui::update_side_window()
+{
+    if(!m_cpu_daemon || !m_side_window){ return; }
+
+    ::werase(m_side_window.get());
+
+    switch(m_side_pane)
+    {
+        case side_pane::top:      update_top_pane(); break;
+        case side_pane::heatmap:  update_heatmap_pane(); break;
+        case side_pane::op_stats: update_op_stats_pane(); break;
+        case side_pane::latency:  update_latency_pane(); break;
+        default: break;
+    }
+
+    ::wborder(m_side_window.get(), 0, 0, 0, 0, 0, 0, 0, 0);
+
+    if(m_side_pane == side_pane::heatmap)
+    {
+        mvwaddstr(m_side_window.get(), 0, 2, " ram: exec write read exec+write ");
+    }
+
+    ::wrefresh(m_side_window.get());
+}
+
+// heat code of a cell (bytes bytes from address), 0 when it was never touched,
+// otherwise the kind of access it sees most and a level (1-4) on a log scale relative to max_log2
+static int heat_code(const ram_heatmap& heatmap, const std::size_t& address, const std::size_t& bytes,
+                     const int& max_log2)
+{
+    std::uint32_t executes = 0;
+    std::uint32_t writes = 0;
+    std::uint32_t reads = 0;
+
+    for(std::size_t i = address; i < address + bytes; i++)
+    {
+        // code that is also written to: self modifying code or data overlapping code
+        if(heatmap.m_executes[i] && heatmap.m_writes[i]) return 13;
+
+        executes = std::max(executes, heatmap.m_executes[i]);
+        writes = std::max(writes, heatmap.m_writes[i]);
+        reads = std::max(reads, heatmap.m_reads[i]);
+    }
+
+    std::uint32_t count = std::max({ executes, writes, reads });
+    if(count == 0) return 0;
+
+    int count_log2 = 0;
+    for(std::uint32_t v = count; v > 1; v >>= 1) count_log2++;
+
+    int level = std::min(3, (count_log2 * 4) / (max_log2 + 1));
+
+    if(count == executes) return 1 + level;
+    if(count == writes) return 5 + level;
+    return 9 + level;
+}
+
+void gui::update_heatmap_pane()
+{
+    const ram_heatmap& heatmap = m_cpu_daemon->get_ram_heatmap();
+
+    // 64x64 cells, a byte each for 4K of RAM and 16 bytes each for the 64K of XO-CHIP
+    const std::size_t cell_bytes = heatmap.get_size() / (64 * 64);
+
+    std::uint32_t max = 1;
+    for(std::size_t address = 0; address < heatmap.get_size(); address++)
+    {
+        max = std::max({ max, heatmap.m_executes[address], heatmap.m_writes[address], heatmap.m_reads[address] });
+    }
+
+    int max_log2 = 0;
+    for(std::uint32_t v = max; v > 1; v >>= 1) max_log2++;
+
+    // without colors, a character per pair of cells: the hotter one of the two decides it
+    static const char* ascii_levels = " .:*#";
+
+    for(int y = 0; y < 32; y++)
+    {
+        for(int x = 0; x < 64; x++)
+        {
+            int top = heat_code(heatmap, ((y * 2) * 64 + x) * cell_bytes, cell_bytes, max_log2);
+            int bottom = heat_code(heatmap, ((y * 2 + 1) * 64 + x) * cell_bytes, cell_bytes, max_log2);
+
+            if(!m_heatmap_colors)
+            {
+                char c = (top == 13 || bottom == 13) ? 'X' : ascii_levels[std::max(top ? (top - 1) % 4 + 1 : 0,
+                                                                                     bottom ? (bottom - 1) % 4 + 1 : 0)];
+                mvwaddch(m_side_window.get(), y + 1, x + 1, c);
+                continue;
+            }
+
+            if(!top && !bottom) continue;
+
+            wattron(m_side_window.get(), COLOR_PAIR(heatmap_pair_base + top * heat_codes + bottom));
+            mvwaddwstr(m_side_window.get(), y + 1, x + 1, L"▀");
+            wattroff(m_side_window.get(), COLOR_PAIR(heatmap_pair_base + top * heat_codes + bottom));
+        }
+    }
+}
+
+void gui::update_top_pane()
+{
+    const pc_profiler& profiler = m_cpu_daemon->get_pc_profiler();
+    std::uint64_t samples = profiler.get_samples();
+
+    // the RAM is read from the cpu of the last frame, never the one the cpu thread is running
+    const auto chip8 = m_cpu_daemon->get_frame().m_cpu;
+    if(!chip8) return;
+
+    auto percent = [samples](const std::uint64_t& count)
+    {
+        return samples ? (count * 100.0) / samples : 0.0;
+    };
+
+    std::stringstream row;
+
+    // prints "addr   % disassembly" on a line of the window
+    auto print_spot = [&](const int& y, const std::uint16_t& address, const std::uint64_t& count)
+    {
+        row << nchip8::nnn << address << std::dec << std::setfill(' ') << std::fixed << std::setprecision(1)
+            << std::setw(6) << percent(count) << ' ' << chip8->dasm_op(address).value_or("???");
+        mvwaddnstr(m_side_window.get(), y, 1, row.str().c_str(), 32);
+        row.str(""); row.clear();
+    };
+
+    row << "top " << std::dec << samples << " samples";
+    mvwaddstr(m_side_window.get(), 1, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    int y = 2;
+    for(const auto& spot : profiler.top_addresses(13))
+    {
+        print_spot(y++, spot.m_address, spot.m_samples);
+    }
+
+    mvwaddstr(m_side_window.get(), 16, 1, "loops");
+
+    y = 17;
+    for(const auto& l : profiler.top_loops(*chip8, 5))
+    {
+        row << nchip8::nnn << l.m_start << '-' << nchip8::nnn << l.m_end << std::dec << std::setfill(' ')
+            << std::fixed << std::setprecision(1) << std::setw(6) << percent(l.m_samples);
+        mvwaddstr(m_side_window.get(), y++, 1, row.str().c_str());
+        row.str(""); row.clear();
+    }
+
+    mvwaddstr(m_side_window.get(), 22, 1, "call sites");
+
+    // return addresses point after the CALL
+    y = 23;
+    for(const auto& spot : profiler.top_call_sites(4))
+    {
+        print_spot(y++, (spot.m_address - 2) & chip8->get_ram_mask(), spot.m_samples);
+    }
+}
+
+void gui::update_latency_pane()
+{
+    const photon_latency& latency = m_cpu_daemon->get_photon_latency();
+    std::stringstream row;
+
+    // microseconds as milliseconds, "-" without samples
+    auto ms = [](const latency_histogram& h, const double& p)
+    {
+        std::stringstream ss;
+        if(h.get_count() == 0) ss << '-';
+        else ss << std::fixed << std::setprecision(2) << (h.get_percentile(p) / 1000.0);
+        return ss.str();
+    };
+
+    mvwaddstr(m_side_window.get(), 1, 1, "input-to-photon latency");
+    mvwaddstr(m_side_window.get(), 3, 1, "stage       p50 ms   p99 ms");
+
+    for(int s = 0; s < photon_latency::_last; s++)
+    {
+        const auto& h = latency.get_stage(static_cast<photon_latency::stage>(s));
+
+        row << std::left << std::setfill(' ') << std::setw(10) << photon_latency::stage_name(static_cast<photon_latency::stage>(s))
+            << std::right << std::setw(8) << ms(h, 0.5) << std::setw(9) << ms(h, 0.99);
+        mvwaddstr(m_side_window.get(), 4 + s + (s == photon_latency::total ? 1 : 0), 1, row.str().c_str());
+        row.str(""); row.clear();
     }
 
-    // curses does not have a method of knowing if multiple keys are pressed
-    // we achieve multiple key inputs by giving each key a score
-    // every frame we decrement the score
-    // if the score is zero, the key is no longer considered pressed
-    m_keys[char_lowered] = 3;
+    row << "presses " << std::dec << latency.get_stage(photon_latency::total).get_count();
+    mvwaddstr(m_side_window.get(), 12, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    // presses the ROM saw, whether or not they changed the screen
+    const latency_histogram& input = m_cpu_daemon->get_input_latency();
+
+    row << "key seen  " << std::setw(8) << ms(input, 0.5) << std::setw(9) << ms(input, 0.99);
+    mvwaddstr(m_side_window.get(), 14, 1, row.str().c_str());
+    row.str(""); row.clear();
+
+    row << "presses " << std::dec << input.get_count();
+    mvwaddstr(m_side_window.get(), 15, 1, row.str().c_str());
+    row.str(""); row.clear();
+}
+
+void gui::update_op_stats_pane()
+{
+    const op_stats& stats = m_cpu_daemon->get_op_stats();
+    const auto& names = m_cpu_daemon->get_op_names();
+
+    // sort the handlers by how often they were executed
+    std::vector<std::size_t> ids(names.size());
+    for(std::size_t id = 0; id < ids.size(); id++) ids[id] = id;
 
-    for(auto& [key, key_score] : m_keys)
+    std::sort(ids.begin(), ids.end(), [&stats](std::size_t a, std::size_t b)
+    {
+        return stats.m_counts[a] > stats.m_counts[b];
+    });
+
+    std::uint64_t total = stats.total();
+    std::stringstream row;
+
+    mvwaddstr(m_side_window.get(), 1, 1, "op            count       %");
+
+    // top 16 handlers
+    for(std::size_t i = 0; i < ids.size() && i < 16; i++)
+    {
+        std::uint64_t count = stats.m_counts[ids[i]];
+        double percent = total ? (count * 100.0) / total : 0.0;
+
+        row << std::left << std::setfill(' ') << std::dec << std::setw(12) << names[ids[i]]
+            << std::right << std::setw(11) << count
+            << std::fixed << std::setprecision(1) << std::setw(7) << percent;
+        mvwaddstr(m_side_window.get(), i+2, 1, row.str().c_str());
+        row.str(""); row.clear();
+    }
+
+    // median host time of each opcode family, two per row
+    mvwaddstr(m_side_window.get(), 18, 1, "family p50 ns");
+
+    for(std::uint8_t family = 0; family < op_stats::families; family++)
+    {
+        row << std::hex << std::uppercase << (int)family << "xxx " << std::dec << std::left
+            << std::setfill(' ') << std::setw(10) << stats.median_ns(family);
+        mvwaddstr(m_side_window.get(), 19 + family / 2, 1 + (family % 2) * 16, row.str().c_str());
+        row.str(""); row.clear();
+    }
+}
+
+void gui::update_keys()
+{
+    // drain everything the terminal has queued,
+    // one key a frame falls further and further behind during key repeat
+    for(int c = getch(); c != ERR; c = getch())
     {
-        if(key_score > 0)
+        handle_key(c);
+    }
+}
+
+void gui::release_keys()
+{
+    // curses does not have a method of knowing if multiple keys are pressed (or released)
+    // we achieve multiple key inputs by treating a key as held until key_hold passes without it
+    auto now = std::chrono::steady_clock::now();
+
+    for(auto it = m_keys.begin(); it != m_keys.end(); )
+    {
+        auto& [key, seen] = *it;
+
+        if(now - seen < key_hold)
         {
-            key_score--;
+            it++;
         }
         else // key press has departed
         {
@@ -371,10 +964,62 @@ void gui::update_keys()
                 m_cpu_daemon->set_key_up(key_mapping.at(key));
             }
 
-            // erase from tracker
-            m_keys.erase(key);
+            // erase from tracker (erasing invalidates the iterator, continue from the next one)
+            it = m_keys.erase(it);
         }
     }
 }
 
+void gui::handle_key(const int& c)
+{
+    // key chars are stored lowercase,
+    // tolower will pass thru non-characters as-well (e.g. 0->0)
+    int char_lowered = std::tolower(c);
+
+    // Esc
+    if(c == 27)
+    {
+        m_quit = true;
+    }
+
+    if(c == '\t')
+    {
+        next_side_pane();
+    }
+
+    // turbo (fast-forward)
+    if(c == 't')
+    {
+        m_cpu_daemon->set_turbo(!m_cpu_daemon->get_turbo());
+    }
+
+    // run-ahead frames
+    if(c == '[' && m_cpu_daemon->get_run_ahead() > 0)
+    {
+        m_cpu_daemon->set_run_ahead(m_cpu_daemon->get_run_ahead() - 1);
+    }
+
+    if(c == ']' && m_cpu_daemon->get_run_ahead() < max_run_ahead)
+    {
+        m_cpu_daemon->set_run_ahead(m_cpu_daemon->get_run_ahead() + 1);
+    }
+
+    // Backspace, terminals send any of these
+    if(c == KEY_BACKSPACE || c == 127 || c == '\b')
+    {
+        m_cpu_daemon->send_message(cpu_message(
+            cpu_message_type::Rewind,
+            { rewind_step & 0xFF, rewind_step >> 8 }
+        ));
+    }
+
+    // a mapped key that isn't held yet goes down, key repeat only keeps it held
+    if(key_mapping.count(char_lowered) && !m_keys.count(char_lowered))
+    {
+        m_cpu_daemon->set_key_down(key_mapping.at(char_lowered));
+    }
+
+    m_keys[char_lowered] = std::chrono::steady_clock::now();
+}
+
 }
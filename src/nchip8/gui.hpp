@@ -6,6 +6,9 @@
 #define CHIP8_NCURSES_GUI_HPP
 
 #include <curses.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <sstream>
 #include <vector>
 #include <memory>
@@ -28,8 +31,18 @@ public:
     virtual ~gui();
 
     //! @brief Start the GUI logic thread, this will block input and the main thread!
+    //! @details Sleeps in poll() on stdin, terminal resizes (SIGWINCH) and the frame eventfd of the cpu_daemon,
+    //!          and renders at most once per published frame
     void loop();
 
+    //! @brief  Render at most this many frames a second (0 = every published frame)
+    void set_frame_rate_cap(const std::size_t& fps);
+
+    //! @brief  A function that rings the terminal bell from any thread (e.g. the audio thread, see bell_sink)
+    //! @details It only raises a flag, the gui thread rings the bell with curses beep() so nothing but
+    //!          curses writes to the terminal. The flag outlives the gui, so the function is always safe to call
+    std::function<void()> get_bell() const;
+
 private:
     std::shared_ptr<cpu_daemon> m_cpu_daemon;
 
@@ -44,9 +57,34 @@ private:
     std::shared_ptr<::WINDOW> m_screen_window   = nullptr;
     std::shared_ptr<::WINDOW> m_log_window      = nullptr;
     std::shared_ptr<::WINDOW> m_reg_window      = nullptr;
+    std::shared_ptr<::WINDOW> m_side_window     = nullptr;
+
+    //! What the side window shows, Tab cycles through these
+    enum class side_pane
+    {
+        top,        //! Hottest addresses, loops and call sites of the PC profiler
+        heatmap,    //! RAM reads/writes/executes as a 64x64 grid
+        op_stats,   //! Instruction counters (only with NCHIP8_OP_STATS)
+        latency,    //! Input-to-photon latency by stage
+        _last       // keep at end of enum
+    };
+
+    side_pane m_side_pane = side_pane::top;
+
+    //! Set when the quit key (Esc) is pressed, ends loop()
+    bool m_quit = false;
+
+    //! Raised by get_bell's function, rung and lowered by loop()
+    std::shared_ptr<std::atomic<bool>> m_bell = std::make_shared<std::atomic<bool>>(false);
 
-    //! @brief  Rebuilds window when a size change is detected
-    void update_windows_on_resize();
+    //! @brief  Resizes ncurses to the terminal and rebuilds the windows, after a SIGWINCH
+    void handle_resize();
+
+    //! See set_frame_rate_cap
+    std::size_t m_frame_rate_cap = 0;
+
+    //! @brief  Longest loop() sleeps without an event, the log and registers still update (e.g. while paused)
+    static constexpr std::chrono::milliseconds idle_timeout { 250 };
 
     //! The local, gui log (the one drawn by the gui)
     std::vector<std::string> m_gui_log;
@@ -64,21 +102,66 @@ private:
     //! @brief  Update the register preview window, showing all the values of the CPU registers
     void update_reg_window();
 
+    //! @brief  Draws the current pane of the side window
+    void update_side_window();
+
+    //! @brief  Draws the instruction counts and median host time per opcode family
+    void update_op_stats_pane();
+
+    //! @brief  Draws p50/p99 of every stage of the input-to-photon latency
+    void update_latency_pane();
+
+    //! @brief  Draws the hottest addresses, loops and call sites with their disassembly
+    void update_top_pane();
+
+    //! @brief  Draws the RAM access heatmap, one cell per byte, two rows of cells per line
+    void update_heatmap_pane();
+
+    //! @brief  Switch the side window to the next available pane
+    void next_side_pane();
+
+    //! @brief  (Re)creates the side window at the size of the current pane
+    void create_side_window();
+
+    //! True when the terminal has enough colors for the heatmap gradient,
+    //! otherwise it is drawn with characters
+    bool m_heatmap_colors = false;
+
+    //! True when the terminal has the colors of the XO-CHIP planes (see plane_color),
+    //! otherwise every pixel of a plane is drawn the same
+    bool m_plane_colors = false;
+
     //! @brief Redraw's all the windows to the current terminal height and width
     void rebuild_windows();
 
-    //! @brief Update keys
+    //! @brief Update keys, every key the terminal has queued is handled
     void update_keys();
 
+    //! @brief Bring up the keys the terminal hasn't repeated for key_hold
+    void release_keys();
+
+    //! @brief  How long a key counts as held after the terminal last sent it
+    static constexpr std::chrono::milliseconds key_hold { 3 * 1000 / 60 };
+
+    //! @brief Handle one key from the terminal
+    void handle_key(const int& c);
+
+    //! @brief  Frames each press of the rewind key (Backspace) goes back,
+    //!         holding it rewinds at the terminal's key repeat rate
+    static constexpr std::uint16_t rewind_step = 15;
+
+    //! @brief  Most frames of run-ahead the [ and ] keys go up to
+    static constexpr std::size_t max_run_ahead = 8;
+
     //! @brief  Map what ncurses chracters to what keypad key
     static const std::unordered_map<int, std::uint8_t> key_mapping;
 
     //! @brief The current keys that have been pressed
     //! @details  Because ncurses only tells us the current key that is pushed
     //!           and we want to have multi-key input into the cpu
-    //!           we assign each pushed key a score of 100 that is decremented at 60Hz
-    //!           when this reaches 0 the key is considered no longer pushed
-    std::unordered_map<int, std::uint8_t> m_keys;
+    //!           we remember when each pushed key was last sent,
+    //!           after key_hold without it the key is considered no longer pushed
+    std::unordered_map<int, std::chrono::steady_clock::time_point> m_keys;
 
 };
 
@@ -0,0 +1,486 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "gym.hpp"
+#include "gym.h"
+#include "explorer.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace nchip8
+{
+
+gym_env::gym_env(const cpu& start, const std::uint32_t& cycles_per_frame, const std::uint32_t& max_frames) :
+    m_start(start.fork()),
+    m_cycles_per_frame(cycles_per_frame),
+    m_max_frames(max_frames)
+{
+    reset(0);
+}
+
+gym_env::gym_env(const gym_env& prototype) :
+    m_start(prototype.m_start->fork()),
+    m_cycles_per_frame(prototype.m_cycles_per_frame),
+    m_max_frames(prototype.m_max_frames),
+    m_rewards(prototype.m_rewards),
+    m_dones(prototype.m_dones),
+    m_before(prototype.m_before)
+{
+    reset(0);
+}
+
+bool gym_env::add_reward(const std::string& probe, const float& scale)
+{
+    auto get = explorer::parse_probe(probe);
+    if(!get.has_value()) return false;
+
+    m_rewards.push_back({ get.value(), scale });
+    m_before.push_back(0);
+    return true;
+}
+
+bool gym_env::add_done(const std::string& condition)
+{
+    auto goal = explorer::parse_goal(condition);
+    if(!goal.has_value()) return false;
+
+    m_dones.push_back(goal.value());
+    return true;
+}
+
+void gym_env::reset(const std::uint64_t& seed)
+{
+    // a fork shares every page of the start state, an episode only pays for what it writes
+    m_cpu = m_start->fork();
+    m_cpu->set_seed(seed);
+
+    m_keys = 0;
+    m_frames = 0;
+    m_done = 0;
+    m_seed = seed;
+}
+
+std::uint8_t gym_env::step(const std::uint16_t& keys, const std::uint32_t& frames, float& reward)
+{
+    reward = 0.0f;
+
+    if(m_done) return m_done;
+
+    // only the keys that changed, a key held over several steps stays down (Fx0A waits for a release)
+    const std::uint16_t changed = keys ^ m_keys;
+
+    for(std::uint8_t key = 0; key < 16; key++)
+    {
+        if(!((changed >> key) & 1)) continue;
+
+        if((keys >> key) & 1) m_cpu->set_key_down(key);
+        else m_cpu->set_key_up(key);
+    }
+
+    m_keys = keys;
+
+    for(std::size_t r = 0; r < m_rewards.size(); r++)
+    {
+        m_before[r] = m_rewards[r].m_probe(*m_cpu);
+    }
+
+    for(std::uint32_t frame = 0; frame < frames && !m_done; frame++)
+    {
+        for(std::uint32_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            if(!m_cpu->execute_op_at_pc()) break;
+        }
+
+        m_cpu->tick_timers();
+        m_frames++;
+
+        if(m_cpu->is_halted() || std::any_of(m_dones.begin(), m_dones.end(),
+                                             [this](const auto& done) { return done(*m_cpu); }))
+        {
+            m_done |= NCHIP8_DONE_TERMINATED;
+        }
+
+        if(m_max_frames && m_frames >= m_max_frames)
+        {
+            m_done |= NCHIP8_DONE_TRUNCATED;
+        }
+    }
+
+    for(std::size_t r = 0; r < m_rewards.size(); r++)
+    {
+        reward += m_rewards[r].m_scale * static_cast<float>(m_rewards[r].m_probe(*m_cpu) - m_before[r]);
+    }
+
+    return m_done;
+}
+
+void gym_env::observe(std::uint8_t* obs) const
+{
+    const cpu::framebuffer& screen = m_cpu->get_screen_framebuffer();
+
+    // the words big endian, like the save states, so the bytes are the pixels MSB first, left to right
+    for(std::size_t row = 0; row < cpu::framebuffer::pages; row++)
+    {
+        for(auto word : screen.get_page(row))
+        {
+            for(int shift = 56; shift >= 0; shift -= 8) *obs++ = word >> shift;
+        }
+    }
+}
+
+std::uint8_t gym_env::get_done() const
+{
+    return m_done;
+}
+
+std::uint64_t gym_env::get_seed() const
+{
+    return m_seed;
+}
+
+const cpu& gym_env::get_cpu() const
+{
+    return *m_cpu;
+}
+
+gym_pool::gym_pool(std::size_t threads) :
+    m_threads(std::max<std::size_t>(threads ? threads : std::thread::hardware_concurrency(), 1))
+{
+    for(std::size_t worker = 1; worker < m_threads; worker++)
+    {
+        m_workers.emplace_back(&gym_pool::work, this, worker);
+    }
+}
+
+gym_pool::~gym_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+
+    for(auto& worker : m_workers) worker.join();
+}
+
+std::size_t gym_pool::get_threads() const
+{
+    return m_threads;
+}
+
+void gym_pool::run(const std::function<void(const std::size_t&)>& job)
+{
+    if(m_workers.empty())
+    {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_busy = m_workers.size();
+        m_error = nullptr;
+        m_generation++;
+    }
+
+    m_wake.notify_all();
+
+    // the workers use job until they are done, so it is waited for whatever worker 0 does
+    std::exception_ptr error;
+
+    try
+    {
+        job(0);
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]() { return m_busy == 0; });
+
+    m_job = nullptr;
+    if(!error) error = m_error;
+
+    if(error) std::rethrow_exception(error);
+}
+
+void gym_pool::work(const std::size_t& worker)
+{
+    std::uint64_t generation = 0;
+
+    while(true)
+    {
+        const std::function<void(const std::size_t&)>* job;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, &generation]() { return m_stop || m_generation != generation; });
+
+            if(m_stop) return;
+
+            generation = m_generation;
+            job = m_job;
+        }
+
+        std::exception_ptr error;
+
+        try
+        {
+            (*job)(worker);
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(error && !m_error) m_error = error;
+        if(--m_busy == 0) m_finished.notify_one();
+    }
+}
+
+gym_vec_env::gym_vec_env(const gym_env& prototype, const std::size_t& envs, const std::size_t& threads) :
+    m_pool(std::min(threads ? threads : std::thread::hardware_concurrency(), envs))
+{
+    m_envs.reserve(envs);
+
+    for(std::size_t n = 0; n < envs; n++)
+    {
+        m_envs.emplace_back(prototype);
+    }
+}
+
+std::size_t gym_vec_env::get_size() const
+{
+    return m_envs.size();
+}
+
+std::size_t gym_vec_env::get_pool_threads() const
+{
+    return m_pool.get_threads();
+}
+
+const gym_env& gym_vec_env::get_env(const std::size_t& n) const
+{
+    return m_envs[n];
+}
+
+void gym_vec_env::for_each(const std::function<void(const std::size_t&)>& job)
+{
+    const std::size_t envs = m_envs.size();
+    const std::size_t threads = m_pool.get_threads();
+
+    m_pool.run([&](const std::size_t& worker)
+    {
+        const std::size_t end = envs * (worker + 1) / threads;
+
+        for(std::size_t n = envs * worker / threads; n < end; n++) job(n);
+    });
+}
+
+void gym_vec_env::reset(const std::uint64_t* seeds, std::uint8_t* obs)
+{
+    for_each([&](const std::size_t& n)
+    {
+        m_envs[n].reset(seeds ? seeds[n] : 0);
+        if(obs) m_envs[n].observe(obs + n * gym_env::obs_bytes);
+    });
+}
+
+void gym_vec_env::step(const std::uint16_t* keys, const std::uint32_t& frames,
+                       std::uint8_t* obs, float* rewards, std::uint8_t* dones)
+{
+    for_each([&](const std::size_t& n)
+    {
+        gym_env& env = m_envs[n];
+        float reward = 0.0f;
+        std::uint8_t done = 0;
+
+        // next step autoreset: the step after the one that ended an episode starts the next one
+        if(env.get_done()) env.reset(env.get_seed() + m_envs.size());
+        else done = env.step(keys ? keys[n] : 0, frames, reward);
+
+        if(obs) env.observe(obs + n * gym_env::obs_bytes);
+        if(rewards) rewards[n] = reward;
+        if(dones) dones[n] = done;
+    });
+}
+
+}
+
+// The C ABI, the handles are the C++ objects. Nothing may throw across it
+
+using nchip8::gym_env;
+using nchip8::gym_vec_env;
+
+static_assert(gym_env::obs_bytes == NCHIP8_OBS_BYTES, "observations are the framebuffer");
+
+static gym_env* to_env(nchip8_env* env) { return reinterpret_cast<gym_env*>(env); }
+static const gym_env* to_env(const nchip8_env* env) { return reinterpret_cast<const gym_env*>(env); }
+static gym_vec_env* to_vec(nchip8_vec_env* vec) { return reinterpret_cast<gym_vec_env*>(vec); }
+static const gym_vec_env* to_vec(const nchip8_vec_env* vec) { return reinterpret_cast<const gym_vec_env*>(vec); }
+
+nchip8_env* nchip8_env_create(const nchip8_env_config* config)
+{
+    if(!config || (!config->rom && config->rom_size > 0)) return nullptr;
+
+    try
+    {
+        nchip8::quirk_profile profile = nchip8::quirk_profile::nchip8;
+
+        if(config->quirks)
+        {
+            auto parsed = nchip8::parse_quirk_profile(config->quirks);
+            if(!parsed.has_value()) return nullptr;
+            profile = parsed.value();
+        }
+
+        nchip8::cpu start;
+        start.set_trace(false);
+        start.set_quirks(profile);
+
+        if(!start.load_rom(std::vector<std::uint8_t>(config->rom, config->rom + config->rom_size), 0x200))
+        {
+            return nullptr;
+        }
+
+        const std::uint32_t cycles = config->cycles_per_frame ? config->cycles_per_frame
+                                                              : gym_env::default_cycles_per_frame;
+
+        return reinterpret_cast<nchip8_env*>(new gym_env(start, cycles, config->max_frames));
+    }
+    catch(const std::exception&)
+    {
+        return nullptr;
+    }
+}
+
+void nchip8_env_destroy(nchip8_env* env)
+{
+    delete to_env(env);
+}
+
+int nchip8_env_add_reward(nchip8_env* env, const char* probe, float scale)
+{
+    try
+    {
+        return (probe && to_env(env)->add_reward(probe, scale)) ? 0 : -1;
+    }
+    catch(const std::exception&)
+    {
+        return -1;
+    }
+}
+
+int nchip8_env_add_done(nchip8_env* env, const char* condition)
+{
+    try
+    {
+        return (condition && to_env(env)->add_done(condition)) ? 0 : -1;
+    }
+    catch(const std::exception&)
+    {
+        return -1;
+    }
+}
+
+int nchip8_env_reset(nchip8_env* env, uint64_t seed, uint8_t* obs)
+{
+    try
+    {
+        to_env(env)->reset(seed);
+        if(obs) to_env(env)->observe(obs);
+
+        return 0;
+    }
+    catch(const std::exception&)
+    {
+        return -1;
+    }
+}
+
+uint8_t nchip8_env_step(nchip8_env* env, uint16_t keys, uint32_t frames, uint8_t* obs, float* reward)
+{
+    try
+    {
+        float r = 0.0f;
+        const std::uint8_t done = to_env(env)->step(keys, frames, r);
+
+        if(obs) to_env(env)->observe(obs);
+        if(reward) *reward = r;
+
+        return done;
+    }
+    catch(const std::exception&)
+    {
+        if(reward) *reward = 0.0f;
+        return NCHIP8_DONE_ERROR;
+    }
+}
+
+uint8_t nchip8_env_peek(const nchip8_env* env, uint16_t address)
+{
+    return to_env(env)->get_cpu().read_u8(address);
+}
+
+nchip8_vec_env* nchip8_vec_env_create(const nchip8_env* prototype, size_t envs, size_t threads)
+{
+    if(!prototype || envs == 0) return nullptr;
+
+    try
+    {
+        return reinterpret_cast<nchip8_vec_env*>(new gym_vec_env(*to_env(prototype), envs, threads));
+    }
+    catch(const std::exception&)
+    {
+        return nullptr;
+    }
+}
+
+void nchip8_vec_env_destroy(nchip8_vec_env* vec)
+{
+    delete to_vec(vec);
+}
+
+size_t nchip8_vec_env_size(const nchip8_vec_env* vec)
+{
+    return to_vec(vec)->get_size();
+}
+
+int nchip8_vec_env_reset(nchip8_vec_env* vec, const uint64_t* seeds, uint8_t* obs)
+{
+    try
+    {
+        to_vec(vec)->reset(seeds, obs);
+        return 0;
+    }
+    catch(const std::exception&)
+    {
+        return -1;
+    }
+}
+
+int nchip8_vec_env_step(nchip8_vec_env* vec, const uint16_t* keys, uint32_t frames,
+                        uint8_t* obs, float* rewards, uint8_t* dones)
+{
+    try
+    {
+        to_vec(vec)->step(keys, frames, obs, rewards, dones);
+        return 0;
+    }
+    catch(const std::exception&)
+    {
+        return -1;
+    }
+}
+
+const nchip8_env* nchip8_vec_env_get(const nchip8_vec_env* vec, size_t n)
+{
+    return reinterpret_cast<const nchip8_env*>(&to_vec(vec)->get_env(n));
+}
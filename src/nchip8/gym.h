@@ -0,0 +1,113 @@
+/*
+ * Created by agent on 19/10/26.
+ */
+
+#ifndef NCHIP8_GYM_H
+#define NCHIP8_GYM_H
+
+/*
+ * A C ABI over the core for training agents on CHIP-8 games (libnchip8_gym).
+ *
+ * An environment is a ROM loaded into a cpu. reset(seed) restarts it from the loaded ROM with RND seeded,
+ * step(keys, frames) holds a set of keys for a number of 60Hz frames (in virtual time, see cpu::tick_timers)
+ * and returns the framebuffer, the reward of the step and done flags. Rewards and done conditions are probes
+ * of the machine state, usually RAM addresses where the game keeps its score or its lives.
+ *
+ * A vector environment steps many copies of one environment across a thread pool, straight into the
+ * caller's contiguous buffers. Every environment only touches its own slice of them.
+ *
+ * Nothing here throws or prints, failures are reported through the return values.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define NCHIP8_GYM_API __declspec(dllexport)
+#else
+#define NCHIP8_GYM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bytes of an observation, the packed framebuffer: 64 rows of 32 bytes, a row is 128 pixels of plane 0
+ * then 128 pixels of plane 1, one bit per pixel, MSB first (numpy.unpackbits gives them left to right).
+ * Lores (64*32) screens use the first 8 bytes of each plane in rows 0-31, only XO-CHIP draws to plane 1.
+ * This is the framebuffer layout of save states.
+ */
+#define NCHIP8_OBS_BYTES 2048
+
+/* Bits of the done flags of a step */
+#define NCHIP8_DONE_TERMINATED 0x1  /* the cpu halted, or a done condition held at the end of a frame */
+#define NCHIP8_DONE_TRUNCATED 0x2   /* the episode ran max_frames frames */
+#define NCHIP8_DONE_ERROR 0x4       /* the step failed (out of memory), the environment has to be reset */
+
+typedef struct nchip8_env_config
+{
+    const uint8_t* rom;
+    size_t rom_size;
+    const char* quirks;         /* quirk profile name (nchip8, chip8, schip, xochip), NULL for nchip8 */
+    uint32_t cycles_per_frame;  /* instructions per 60Hz frame, 0 for 8 (about the 500Hz of the GUI) */
+    uint32_t max_frames;        /* frames after which an episode is truncated, 0 for never */
+} nchip8_env_config;
+
+typedef struct nchip8_env nchip8_env;
+typedef struct nchip8_vec_env nchip8_vec_env;
+
+/* Loads a ROM into a new environment, reset with seed 0.
+   NULL if the ROM does not fit or the quirk profile is unknown */
+NCHIP8_GYM_API nchip8_env* nchip8_env_create(const nchip8_env_config* config);
+NCHIP8_GYM_API void nchip8_env_destroy(nchip8_env* env);
+
+/* Adds scale * (value after - value before) of a probe to the reward of every step.
+   Probes: v0-vF, i, pc, sp, dt, st or ram:<address> (e.g. "ram:0x2F0"), all read as u8/u16 values,
+   a score kept as BCD digits is one probe per digit, scaled 100, 10 and 1.
+   Returns 0, or -1 if the probe is malformed */
+NCHIP8_GYM_API int nchip8_env_add_reward(nchip8_env* env, const char* probe, float scale);
+
+/* Ends an episode (terminated) at the end of the first frame a condition holds,
+   <probe><op><value> with op one of == != <= >= < > (e.g. "ram:0x2F1==0").
+   Returns 0, or -1 if the condition is malformed */
+NCHIP8_GYM_API int nchip8_env_add_done(nchip8_env* env, const char* condition);
+
+/* Restarts the episode from the loaded ROM with RND seeded with seed, obs (NCHIP8_OBS_BYTES) may be NULL.
+   Returns 0, or -1 if it failed (out of memory) */
+NCHIP8_GYM_API int nchip8_env_reset(nchip8_env* env, uint64_t seed, uint8_t* obs);
+
+/* Holds keys (bit n = key n) for frames frames, or until the episode ends.
+   obs (NCHIP8_OBS_BYTES) and reward may be NULL. Returns the done flags, a done episode stays done
+   (with a reward of 0) until it is reset. A step that failed returns NCHIP8_DONE_ERROR */
+NCHIP8_GYM_API uint8_t nchip8_env_step(nchip8_env* env, uint16_t keys, uint32_t frames, uint8_t* obs, float* reward);
+
+/* Reads a byte of the RAM of an environment */
+NCHIP8_GYM_API uint8_t nchip8_env_peek(const nchip8_env* env, uint16_t address);
+
+/* Copies of an environment (its ROM, rewards and done conditions) stepped on threads threads,
+   0 for every core. Returns NULL if envs is 0 */
+NCHIP8_GYM_API nchip8_vec_env* nchip8_vec_env_create(const nchip8_env* prototype, size_t envs, size_t threads);
+NCHIP8_GYM_API void nchip8_vec_env_destroy(nchip8_vec_env* vec);
+
+NCHIP8_GYM_API size_t nchip8_vec_env_size(const nchip8_vec_env* vec);
+
+/* Resets environment n with seeds[n], obs holds envs * NCHIP8_OBS_BYTES bytes and may be NULL.
+   Returns 0, or -1 if it failed (out of memory) */
+NCHIP8_GYM_API int nchip8_vec_env_reset(nchip8_vec_env* vec, const uint64_t* seeds, uint8_t* obs);
+
+/* Steps environment n with keys[n] for frames frames, into obs + n * NCHIP8_OBS_BYTES, rewards[n] and dones[n].
+   An environment that was done after the previous step is reset instead (with its last seed + envs),
+   it returns the first observation of the new episode, a reward of 0 and no done flags.
+   Returns 0, or -1 if it failed (out of memory): some environments may not have been stepped, reset them all */
+NCHIP8_GYM_API int nchip8_vec_env_step(nchip8_vec_env* vec, const uint16_t* keys, uint32_t frames,
+                                       uint8_t* obs, float* rewards, uint8_t* dones);
+
+/* The environment n of a vector environment (e.g. to peek at it between steps) */
+NCHIP8_GYM_API const nchip8_env* nchip8_vec_env_get(const nchip8_vec_env* vec, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NCHIP8_GYM_H */
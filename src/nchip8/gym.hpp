@@ -0,0 +1,165 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_GYM_HPP
+#define NCHIP8_GYM_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  An environment for agents: a ROM that is reset, then stepped with a set of keys held (see gym.h)
+class gym_env
+{
+public:
+    //! @brief  Instructions per frame when none are given, about the GUI's 500Hz
+    static constexpr std::uint32_t default_cycles_per_frame = 8;
+
+    //! @brief  Bytes of an observation, see observe
+    static constexpr std::size_t obs_bytes = cpu::framebuffer::size() * sizeof(std::uint64_t);
+
+    //! @param start            The state every episode starts from (a cpu with the ROM loaded), it is forked
+    //! @param cycles_per_frame Instructions per 60Hz frame
+    //! @param max_frames       Frames after which an episode is truncated, 0 for never
+    gym_env(const cpu& start, const std::uint32_t& cycles_per_frame, const std::uint32_t& max_frames);
+
+    //! @brief  Same ROM, rewards and done conditions, in a state of its own reset with seed 0
+    gym_env(const gym_env& prototype);
+
+    //! @brief  Adds scale * the change of a probe (see explorer::parse_probe) to the reward of every step
+    //! @returns false if the probe is malformed
+    bool add_reward(const std::string& probe, const float& scale);
+
+    //! @brief  Terminates the episode at the end of the first frame a goal (see explorer::parse_goal) holds
+    //! @returns false if the goal is malformed
+    bool add_done(const std::string& condition);
+
+    //! @brief  Restarts from the start state with RND seeded with seed
+    void reset(const std::uint64_t& seed);
+
+    //! @brief  Holds keys (bit n = key n) for frames frames, or until the episode ends
+    //! @returns The done flags (NCHIP8_DONE_*), the reward of the step is in reward
+    std::uint8_t step(const std::uint16_t& keys, const std::uint32_t& frames, float& reward);
+
+    //! @brief  Writes the framebuffer into obs_bytes bytes, rows of plane 0 then plane 1, pixels MSB first
+    void observe(std::uint8_t* obs) const;
+
+    //! @brief  The done flags of the episode, 0 while it runs
+    std::uint8_t get_done() const;
+
+    //! @brief  The seed of the last reset
+    std::uint64_t get_seed() const;
+
+    const cpu& get_cpu() const;
+
+private:
+    struct reward
+    {
+        std::function<int(const cpu&)> m_probe;
+        float m_scale;
+    };
+
+    //! Forked (never run), each env keeps its own so resets on different threads never touch the same cpu
+    std::unique_ptr<cpu> m_start;
+    std::unique_ptr<cpu> m_cpu;
+
+    std::uint32_t m_cycles_per_frame;
+    std::uint32_t m_max_frames;
+
+    std::vector<reward> m_rewards;
+    std::vector<std::function<bool(const cpu&)>> m_dones;
+
+    std::uint16_t m_keys = 0;
+    std::uint32_t m_frames = 0;
+    std::uint8_t m_done = 0;
+    std::uint64_t m_seed = 0;
+
+    //! Probe values at the start of a step
+    std::vector<int> m_before;
+};
+
+//! @brief  A fixed set of threads that run one job at a time, the threads wait between jobs
+//!         (a step is too short to start threads for, see explorer which does for each level)
+class gym_pool
+{
+public:
+    //! @param threads  Threads including the caller's, 0 for every core
+    explicit gym_pool(std::size_t threads);
+    ~gym_pool();
+
+    gym_pool(const gym_pool&) = delete;
+    gym_pool& operator=(const gym_pool&) = delete;
+
+    std::size_t get_threads() const;
+
+    //! @brief  Runs job(worker) for every worker 0 to get_threads() - 1 and waits for all of them,
+    //!         the calling thread is worker 0
+    //! @throws The first exception a job threw, once every worker is done (the pool stays usable)
+    void run(const std::function<void(const std::size_t&)>& job);
+
+private:
+    std::size_t m_threads;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+
+    const std::function<void(const std::size_t&)>* m_job = nullptr;
+    std::uint64_t m_generation = 0;
+    std::size_t m_busy = 0;
+    bool m_stop = false;
+
+    //! The first exception a job of the current run threw, guarded by m_mutex
+    std::exception_ptr m_error;
+
+    void work(const std::size_t& worker);
+};
+
+//! @brief  Copies of an environment stepped together across a gym_pool, into contiguous buffers (see gym.h)
+//! @details Worker w steps the same contiguous range of environments every time,
+//!          so an environment stays on one thread and the results do not depend on the number of threads
+class gym_vec_env
+{
+public:
+    gym_vec_env(const gym_env& prototype, const std::size_t& envs, const std::size_t& threads);
+
+    std::size_t get_size() const;
+
+    //! @brief  Threads the environments are stepped on
+    std::size_t get_pool_threads() const;
+
+    const gym_env& get_env(const std::size_t& n) const;
+
+    //! @brief  Resets env n with seeds[n], obs may be nullptr
+    void reset(const std::uint64_t* seeds, std::uint8_t* obs);
+
+    //! @brief  Steps env n with keys[n], an env that was done is reset with its seed + get_size() instead,
+    //!         obs, rewards and dones may be nullptr
+    void step(const std::uint16_t* keys, const std::uint32_t& frames,
+              std::uint8_t* obs, float* rewards, std::uint8_t* dones);
+
+private:
+    std::vector<gym_env> m_envs;
+    gym_pool m_pool;
+
+    //! @brief  Runs job(n) for every env, each worker over its range
+    void for_each(const std::function<void(const std::size_t&)>& job);
+};
+
+}
+
+#endif //NCHIP8_GYM_HPP
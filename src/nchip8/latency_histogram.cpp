@@ -0,0 +1,97 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nchip8
+{
+
+void latency_histogram::reset()
+{
+    for(auto& bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+std::size_t latency_histogram::bucket_of(const std::uint64_t& us)
+{
+    if(us < linear_buckets) return us;
+
+    // the top bit picks the power of two, the 3 bits below it the sub bucket
+    std::size_t exponent = 63 - __builtin_clzll(us);
+    std::size_t sub = (us >> (exponent - 3)) & (sub_buckets - 1);
+
+    return linear_buckets + ((exponent - 4) * sub_buckets) + sub;
+}
+
+std::uint64_t latency_histogram::bucket_max(const std::size_t& bucket)
+{
+    if(bucket < linear_buckets) return bucket;
+
+    std::size_t exponent = ((bucket - linear_buckets) / sub_buckets) + 4;
+    std::size_t sub = (bucket - linear_buckets) % sub_buckets;
+
+    std::uint64_t low = (1ULL << exponent) | (static_cast<std::uint64_t>(sub) << (exponent - 3));
+    return low + (1ULL << (exponent - 3)) - 1;
+}
+
+void latency_histogram::record(const std::chrono::steady_clock::duration& latency)
+{
+    auto us = static_cast<std::uint64_t>(
+        std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0)
+    );
+
+    m_buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(us, std::memory_order_relaxed);
+
+    if(us > m_max.load(std::memory_order_relaxed)) m_max.store(us, std::memory_order_relaxed);
+
+    // last, so a reader that sees the count sees the buckets it counts
+    m_count.fetch_add(1, std::memory_order_release);
+}
+
+std::uint64_t latency_histogram::get_count() const
+{
+    return m_count.load(std::memory_order_acquire);
+}
+
+double latency_histogram::get_mean() const
+{
+    std::uint64_t count = get_count();
+
+    return count ? static_cast<double>(m_total.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+std::uint64_t latency_histogram::get_max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+std::uint64_t latency_histogram::get_percentile(const double& p) const
+{
+    std::uint64_t count = get_count();
+    if(count == 0) return 0;
+
+    // the sample at the rank, 1 based, e.g. p50 of 10 samples is the 5th
+    auto rank = static_cast<std::uint64_t>(std::ceil(p * count));
+    rank = std::max<std::uint64_t>(rank, 1);
+
+    std::uint64_t seen = 0;
+
+    for(std::size_t bucket = 0; bucket < buckets; bucket++)
+    {
+        seen += m_buckets[bucket].load(std::memory_order_relaxed);
+
+        if(seen >= rank) return std::min(bucket_max(bucket), get_max());
+    }
+
+    return get_max();
+}
+
+}
@@ -0,0 +1,59 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_LATENCY_HISTOGRAM_HPP
+#define NCHIP8_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace nchip8
+{
+
+//! @brief  A histogram of latencies in microseconds, with percentiles
+//! @details Below 16us every microsecond has a bucket, above that every power of two is split in 8 buckets,
+//!          so a percentile is within 12.5% of the real value. One thread records, any thread can read.
+class latency_histogram
+{
+public:
+    //! @brief Clear all samples (not thread safe with record)
+    void reset();
+
+    //! @brief Add a sample
+    void record(const std::chrono::steady_clock::duration& latency);
+
+    //! @brief Number of samples
+    std::uint64_t get_count() const;
+
+    //! @brief Mean latency, in microseconds
+    double get_mean() const;
+
+    //! @brief Highest latency, in microseconds
+    std::uint64_t get_max() const;
+
+    //! @brief          Latency that p of the samples are at or below, in microseconds (0 without samples)
+    //! @param p        0.0 - 1.0, e.g. 0.99
+    std::uint64_t get_percentile(const double& p) const;
+
+private:
+    static constexpr std::size_t linear_buckets = 16;
+    static constexpr std::size_t sub_buckets = 8;
+    static constexpr std::size_t buckets = linear_buckets + (64 - 4) * sub_buckets;
+
+    static std::size_t bucket_of(const std::uint64_t& us);
+
+    //! @brief Highest latency that falls in a bucket
+    static std::uint64_t bucket_max(const std::size_t& bucket);
+
+    std::array<std::atomic<std::uint32_t>, buckets> m_buckets {};
+    std::atomic<std::uint64_t> m_count { 0 };
+    std::atomic<std::uint64_t> m_total { 0 };
+    std::atomic<std::uint64_t> m_max { 0 };
+};
+
+}
+
+#endif //NCHIP8_LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,304 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "movie.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace nchip8
+{
+
+static constexpr char movie_magic[4] = { 'N', 'C', '8', 'M' };
+static constexpr std::uint8_t movie_version = 1;
+static constexpr std::size_t movie_header_size = 4 + 1 + 1 + 4 + 8 + 8 + 4 + 4 + 8 + 4;
+
+movie::movie(const cpu& start, const std::vector<std::uint8_t>& rom, const std::uint32_t& cycles_per_frame,
+             const std::uint32_t& hash_interval) :
+    m_quirks(start.get_quirks()),
+    m_cycles_per_frame(std::max<std::uint32_t>(cycles_per_frame, 1)),
+    m_seed(start.get_seed()),
+    m_rom_hash(cpu::hash_state(rom)),
+    m_hash_interval(std::max<std::uint32_t>(hash_interval, 1))
+{
+}
+
+void movie::record_key(const std::uint32_t& cycle, const std::uint8_t& key, const bool& down)
+{
+    m_events.push_back({ m_frames, cycle, static_cast<std::uint8_t>(key & 0xF), down });
+}
+
+void movie::record_frame(const cpu& chip8)
+{
+    m_frames++;
+
+    if(m_frames % m_hash_interval == 0) m_hashes.push_back(hash(chip8));
+}
+
+void movie::finish(const cpu& chip8)
+{
+    m_final_hash = hash(chip8);
+}
+
+void movie::truncate(const std::uint32_t& frames)
+{
+    if(frames > m_frames) return;
+
+    m_frames = frames;
+    m_hashes.resize(m_frames / m_hash_interval);
+
+    // events are in frame order, the ones of the frames gone are at the end
+    m_events.erase(m_events.begin() + seek(m_frames), m_events.end());
+}
+
+bool movie::is_rom(const std::vector<std::uint8_t>& rom) const
+{
+    return cpu::hash_state(rom) == m_rom_hash;
+}
+
+bool movie::start(cpu& chip8, const std::vector<std::uint8_t>& rom) const
+{
+    if(!is_rom(rom)) return false;
+
+    chip8.set_quirks(m_quirks);
+    chip8.set_seed(m_seed);
+    chip8.reset();
+
+    return chip8.load_rom(rom, 0x200);
+}
+
+std::size_t movie::apply(cpu& chip8, const std::uint32_t& frame, const std::uint32_t& cycle, std::size_t next) const
+{
+    for(; next < m_events.size(); next++)
+    {
+        const event& e = m_events[next];
+        if(e.m_frame != frame || e.m_cycle != cycle) break;
+
+        if(e.m_down) chip8.set_key_down(e.m_key);
+        else chip8.set_key_up(e.m_key);
+    }
+
+    return next;
+}
+
+std::size_t movie::seek(const std::uint32_t& frame) const
+{
+    return std::lower_bound(m_events.begin(), m_events.end(), frame,
+                            [](const event& e, const std::uint32_t& f) { return e.m_frame < f; }) - m_events.begin();
+}
+
+std::optional<bool> movie::check(const cpu& chip8, const std::uint32_t& frames) const
+{
+    if(frames == m_frames) return hash(chip8) == m_final_hash;
+
+    if(frames == 0 || frames % m_hash_interval != 0 || frames / m_hash_interval > m_hashes.size())
+    {
+        return std::nullopt;
+    }
+
+    return hash(chip8) == m_hashes[frames / m_hash_interval - 1];
+}
+
+movie::replay_result movie::replay(cpu& chip8, const std::function<void(const cpu&)>& on_frame) const
+{
+    replay_result res;
+    std::size_t next = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // the same frames the daemon ran: every cycle of a frame, halted or not, then one tick
+    for(std::uint32_t frame = 0; frame < m_frames; frame++)
+    {
+        for(std::uint32_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+        {
+            next = apply(chip8, frame, cycle, next);
+            if(chip8.execute_op_at_pc()) res.m_instructions++;
+        }
+
+        if(on_frame) on_frame(chip8);
+
+        chip8.tick_timers();
+        res.m_frames = frame + 1;
+
+        if(auto matches = check(chip8, res.m_frames))
+        {
+            res.m_checked++;
+
+            if(!matches.value())
+            {
+                res.m_mismatch = res.m_frames;
+                break;
+            }
+        }
+    }
+
+    // a movie of no frames is only its start state
+    if(m_frames == 0)
+    {
+        res.m_checked++;
+        if(!check(chip8, 0).value_or(true)) res.m_mismatch = 0;
+    }
+
+    res.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    return res;
+}
+
+// LEB128, 7 bits a byte, low bits first
+static void put_varint(std::vector<std::uint8_t>& out, std::uint32_t v)
+{
+    while(v >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+static bool get_varint(const std::uint8_t*& p, const std::uint8_t* end, std::uint32_t& v)
+{
+    v = 0;
+
+    for(int shift = 0; shift < 35; shift += 7)
+    {
+        if(p == end) return false;
+
+        std::uint8_t byte = *p++;
+        v |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+
+        if(!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+std::vector<std::uint8_t> movie::save() const
+{
+    std::vector<std::uint8_t> out;
+    out.reserve(movie_header_size + m_events.size() * 3 + m_hashes.size() * 8);
+
+    auto put_u8 = [&out](const std::uint8_t& v) { out.push_back(v); };
+    auto put_u32 = [&out](const std::uint32_t& v) { for(int byte = 0; byte < 4; byte++) out.push_back(v >> (byte * 8)); };
+    auto put_u64 = [&out](const std::uint64_t& v) { for(int byte = 0; byte < 8; byte++) out.push_back(v >> (byte * 8)); };
+
+    for(char c : movie_magic) put_u8(static_cast<std::uint8_t>(c));
+    put_u8(movie_version);
+    put_u8(static_cast<std::uint8_t>(m_quirks));
+    put_u32(m_cycles_per_frame);
+    put_u64(m_seed);
+    put_u64(m_rom_hash);
+    put_u32(m_frames);
+    put_u32(m_hash_interval);
+    put_u64(m_final_hash);
+    put_u32(static_cast<std::uint32_t>(m_events.size()));
+
+    std::uint32_t frame = 0;
+
+    for(const auto& e : m_events)
+    {
+        put_varint(out, e.m_frame - frame);
+        put_varint(out, e.m_cycle);
+        put_u8(e.m_key | (e.m_down ? 0x80 : 0x00));
+
+        frame = e.m_frame;
+    }
+
+    for(auto h : m_hashes) put_u64(h);
+
+    return out;
+}
+
+bool movie::load(const std::vector<std::uint8_t>& data)
+{
+    if(data.size() < movie_header_size) return false;
+    if(!std::equal(std::begin(movie_magic), std::end(movie_magic), data.begin())) return false;
+    if(data[4] != movie_version) return false;
+    if(data[5] >= static_cast<std::uint8_t>(quirk_profile::_last)) return false;
+
+    const std::uint8_t* p = data.data() + 6;
+    const std::uint8_t* end = data.data() + data.size();
+
+    auto get_u32 = [&p]() { std::uint32_t v = 0; for(int byte = 3; byte >= 0; byte--) v = (v << 8) | p[byte]; p += 4; return v; };
+    auto get_u64 = [&p]() { std::uint64_t v = 0; for(int byte = 7; byte >= 0; byte--) v = (v << 8) | p[byte]; p += 8; return v; };
+
+    // parsed into a new movie first, so a bad file leaves this one untouched
+    movie m;
+    m.m_quirks = static_cast<quirk_profile>(data[5]);
+    m.m_cycles_per_frame = get_u32();
+    m.m_seed = get_u64();
+    m.m_rom_hash = get_u64();
+    m.m_frames = get_u32();
+    m.m_hash_interval = get_u32();
+    m.m_final_hash = get_u64();
+    std::uint32_t events = get_u32();
+
+    if(m.m_cycles_per_frame == 0 || m.m_hash_interval == 0) return false;
+
+    // at least 3 bytes an event
+    if(events > static_cast<std::size_t>(end - p) / 3) return false;
+
+    m.m_events.reserve(events);
+    std::uint32_t frame = 0;
+    std::uint32_t last_cycle = 0;
+
+    for(std::uint32_t n = 0; n < events; n++)
+    {
+        std::uint32_t delta, cycle;
+
+        if(!get_varint(p, end, delta) || !get_varint(p, end, cycle) || p == end) return false;
+
+        // playback walks the events in order, (frame, cycle) may never go back
+        if(delta > m.m_frames - frame || cycle >= m.m_cycles_per_frame) return false;
+        if(delta == 0 && n > 0 && cycle < last_cycle) return false;
+
+        frame += delta;
+        last_cycle = cycle;
+        std::uint8_t key = *p++;
+
+        m.m_events.push_back({ frame, cycle, static_cast<std::uint8_t>(key & 0xF), (key & 0x80) != 0 });
+    }
+
+    const std::size_t hashes = m.m_frames / m.m_hash_interval;
+    if(static_cast<std::size_t>(end - p) != hashes * 8) return false;
+
+    m.m_hashes.resize(hashes);
+    for(auto& h : m.m_hashes) h = get_u64();
+
+    *this = std::move(m);
+    return true;
+}
+
+std::uint32_t movie::get_frames() const
+{
+    return m_frames;
+}
+
+std::uint32_t movie::get_cycles_per_frame() const
+{
+    return m_cycles_per_frame;
+}
+
+std::uint64_t movie::get_seed() const
+{
+    return m_seed;
+}
+
+const quirk_profile& movie::get_quirks() const
+{
+    return m_quirks;
+}
+
+const std::vector<movie::event>& movie::get_events() const
+{
+    return m_events;
+}
+
+std::uint64_t movie::hash(const cpu& chip8) const
+{
+    chip8.save_state(m_state);
+    return cpu::hash_state(m_state);
+}
+
+}
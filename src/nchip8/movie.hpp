@@ -0,0 +1,144 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_MOVIE_HPP
+#define NCHIP8_MOVIE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  The key input of a run, to replay it exactly
+//! @details A movie starts from a cpu that was reset with a seed and loaded a ROM. From there a run only
+//!          depends on the key events and when they were applied, counted in virtual time: frames of
+//!          cycles_per_frame instructions, each followed by one timer tick. An event is stored with the frame
+//!          and the cycle (the instruction of the frame) it was applied before, so playing it back at the same
+//!          frame and cycle gives a bit identical run at any speed, headless or not.
+//!          A hash of the state is kept every hash_interval frames, and one of the last frame,
+//!          playback checks them to find the first frame that went a different way.
+//!
+//!          File layout (little endian), version 1:
+//!              "NC8M", u8 version, u8 quirk profile, u32 cycles per frame, u64 seed, u64 ROM hash,
+//!              u32 frames, u32 hash interval, u64 hash of the last frame, u32 events
+//!              events: varint frames since the previous event, varint cycle, u8 key | 0x80 if down
+//!              hashes: u64, of frames hash_interval, 2 * hash_interval, ... up to frames
+//!          An event is 3 bytes while the frames between events are under 128.
+class movie
+{
+public:
+    //! @brief A key going down or up before an instruction
+    struct event
+    {
+        std::uint32_t m_frame = 0;
+        std::uint32_t m_cycle = 0;
+        std::uint8_t m_key = 0;
+        bool m_down = false;
+    };
+
+    //! @brief Frames between two state hashes (one a second)
+    static constexpr std::uint32_t default_hash_interval = 60;
+
+    movie() = default;
+
+    //! @brief                  A new recording
+    //! @param start            The cpu it starts from, just reset and loaded with rom (its quirks and seed are kept)
+    //! @param rom              The ROM, only its hash is kept
+    //! @param cycles_per_frame Instructions per frame
+    movie(const cpu& start, const std::vector<std::uint8_t>& rom, const std::uint32_t& cycles_per_frame,
+          const std::uint32_t& hash_interval = default_hash_interval);
+
+    //! @brief  Records a key event before instruction cycle of the frame being ran (get_frames())
+    void record_key(const std::uint32_t& cycle, const std::uint8_t& key, const bool& down);
+
+    //! @brief  Records the end of a frame, chip8 is the state after its timer tick
+    void record_frame(const cpu& chip8);
+
+    //! @brief  Records the end of the run (the hash of its last frame), chip8 is the state after it
+    void finish(const cpu& chip8);
+
+    //! @brief  Drops everything from frame frames on (e.g. the frames a rewind went back over)
+    void truncate(const std::uint32_t& frames);
+
+    //! @brief  Whether rom is the ROM the movie was recorded with
+    bool is_rom(const std::vector<std::uint8_t>& rom) const;
+
+    //! @brief  Puts a cpu in the state the movie starts from: quirks, seed, reset and the ROM
+    //! @returns false if rom is not the ROM the movie was recorded with (or it does not load)
+    bool start(cpu& chip8, const std::vector<std::uint8_t>& rom) const;
+
+    //! @brief      Applies the events before instruction cycle of frame, from event next on
+    //! @returns    The index of the first event after them
+    std::size_t apply(cpu& chip8, const std::uint32_t& frame, const std::uint32_t& cycle, std::size_t next) const;
+
+    //! @brief  Index of the first event of frame or after it
+    std::size_t seek(const std::uint32_t& frame) const;
+
+    //! @brief      Checks chip8 against the hash of the state after frames frames
+    //! @returns    std::nullopt if the movie keeps no hash of that frame, otherwise whether it matches
+    std::optional<bool> check(const cpu& chip8, const std::uint32_t& frames) const;
+
+    //! @brief The result of a headless playback
+    struct replay_result
+    {
+        std::uint32_t m_frames = 0;         //! Frames played
+        std::uint64_t m_instructions = 0;   //! Instructions executed
+        std::size_t m_checked = 0;          //! State hashes compared
+        std::optional<std::uint32_t> m_mismatch;   //! The first frame whose hash did not match
+        double m_seconds = 0.0;             //! Host time of the playback
+    };
+
+    //! @brief  Plays the movie as fast as it runs, chip8 must be at the start (see start)
+    //! @details Stops at the first frame that does not match its hash
+    //! @param on_frame Called after the instructions of every frame, before its timer tick (e.g. to render audio)
+    replay_result replay(cpu& chip8, const std::function<void(const cpu&)>& on_frame = {}) const;
+
+    //! @brief  Serializes the movie (see the layout above)
+    std::vector<std::uint8_t> save() const;
+
+    //! @brief  Restores a movie made by save
+    //! @returns false if the data is not a valid movie, the movie is left untouched
+    bool load(const std::vector<std::uint8_t>& data);
+
+    std::uint32_t get_frames() const;
+    std::uint32_t get_cycles_per_frame() const;
+    std::uint64_t get_seed() const;
+    const quirk_profile& get_quirks() const;
+    const std::vector<event>& get_events() const;
+
+private:
+    quirk_profile m_quirks = quirk_profile::nchip8;
+    std::uint32_t m_cycles_per_frame = 1;
+    std::uint64_t m_seed = 0;
+    std::uint64_t m_rom_hash = 0;
+
+    //! Frames recorded
+    std::uint32_t m_frames = 0;
+
+    std::uint32_t m_hash_interval = default_hash_interval;
+
+    //! Hash of the state after frame n * m_hash_interval, n from 1
+    std::vector<std::uint64_t> m_hashes;
+
+    //! Hash of the state after the last frame, set by finish
+    std::uint64_t m_final_hash = 0;
+
+    //! In the order they were applied
+    std::vector<event> m_events;
+
+    //! Scratch save state for hashing, kept so hashing a frame does not allocate
+    mutable std::vector<std::uint8_t> m_state;
+
+    //! @brief  Hash of the state of chip8
+    std::uint64_t hash(const cpu& chip8) const;
+};
+
+}
+
+#endif //NCHIP8_MOVIE_HPP
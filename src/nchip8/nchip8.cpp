@@ -6,36 +6,93 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <random>
 #include <stdexcept>
 #include <string>
 
 #include "nchip8.hpp"
 #include "io.hpp"
 #include "cpu_message.hpp"
+#include "bench.hpp"
+#include "rom_generator.hpp"
+#include "explorer.hpp"
+#include "gym.hpp"
+#include "movie.hpp"
+#include "audio.hpp"
 
 namespace nchip8
 {
 
-nchip8_app::nchip8_app(const std::vector<std::string> &args) :
-    m_args(args)
+nchip8_app::nchip8_app(const std::vector<std::string> &args)
 {
+    // the first argument can be a mode (e.g. --bench), any other argument starting with --
+    // is an option, --name=value or just --name
+    for(std::size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+
+        if(i > 1 && arg.rfind("--", 0) == 0)
+        {
+            auto equals = arg.find('=');
+
+            if(equals == std::string::npos)
+            {
+                m_options[arg.substr(2)] = "";
+            }
+            else
+            {
+                m_options[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+            }
+
+            continue;
+        }
+
+        m_args.push_back(arg);
+    }
+
     nchip8::log << "[nchip8] start" << '\n';
 }
 
-int nchip8_app::run()
+std::optional<std::string> nchip8_app::get_option(const std::string& name) const
 {
-    // complain if they don't supply a file
-    //
-    if (m_args.size() < 2) // args should contain [executable,first_argument]
+    if(!m_options.count(name)) return std::nullopt;
+
+    return m_options.at(name);
+}
+
+quirk_profile nchip8_app::get_quirks() const
+{
+    auto name = get_option("quirks");
+
+    if(!name.has_value()) return quirk_profile::nchip8;
+
+    auto profile = parse_quirk_profile(name.value());
+
+    if(!profile.has_value())
     {
-        throw std::invalid_argument("No ROM! (Usage: nchip8 <path to rom>");
+        throw std::invalid_argument("Unknown quirks " + name.value() + "! (nchip8, chip8, schip or xochip)");
     }
 
+    return profile.value();
+}
+
+std::optional<std::uint64_t> nchip8_app::get_seed() const
+{
+    auto seed = get_option("seed");
+
+    if(!seed.has_value()) return std::nullopt;
+
+    return std::stoull(seed.value(), nullptr, 0);
+}
+
+// reads a whole rom file into memory
+static std::vector<std::uint8_t> read_rom_file(const std::string& path)
+{
     // try to read in the supplied rom file
-    std::ifstream input_file(m_args[1], std::ios::binary | std::ios::in);
+    std::ifstream input_file(path, std::ios::binary | std::ios::in);
 
     if (!input_file) {
-        throw std::invalid_argument("Could not open " + m_args[1] + "!");
+        throw std::invalid_argument("Could not open " + path + "!");
     }
 
     // read in file
@@ -55,6 +112,64 @@ int nchip8_app::run()
         input_file.read((char*)&input_data[0], size);
     }
 
+    return input_data;
+}
+
+int nchip8_app::run()
+{
+    // complain if they don't supply a file
+    //
+    if (m_args.size() < 2) // args should contain [executable,first_argument]
+    {
+        throw std::invalid_argument("No ROM! (Usage: nchip8 <path to rom>");
+    }
+
+    if (m_args[1] == "--bench")
+    {
+        return run_bench();
+    }
+
+    if (m_args[1] == "--bench-state")
+    {
+        return run_bench_state();
+    }
+
+    if (m_args[1] == "--bench-fork")
+    {
+        return run_bench_fork();
+    }
+
+    if (m_args[1] == "--bench-batch")
+    {
+        return run_bench_batch();
+    }
+
+    if (m_args[1] == "--bench-gym")
+    {
+        return run_bench_gym();
+    }
+
+    if (m_args[1] == "--explore")
+    {
+        return run_explore();
+    }
+
+    if (m_args[1] == "--bench-compare")
+    {
+        return run_bench_compare();
+    }
+
+    if (m_args[1] == "--generate")
+    {
+        return run_generate();
+    }
+
+    if (m_args[1] == "--replay")
+    {
+        return run_replay();
+    }
+
+    std::vector<std::uint8_t> input_data = read_rom_file(m_args[1]);
 
     m_cpu_daemon = std::make_shared<cpu_daemon>();
     m_gui = std::make_unique<gui>(m_cpu_daemon);
@@ -64,6 +179,58 @@ int nchip8_app::run()
         m_cpu_daemon->set_cpu_clockspeed(std::stoi(m_args.at(2)));
     }
 
+    if(get_option("turbo"))
+    {
+        m_cpu_daemon->set_turbo(true);
+    }
+
+    if(auto fps = get_option("fps-cap"))
+    {
+        m_gui->set_frame_rate_cap(std::stoul(fps.value()));
+    }
+
+    if(auto frames = get_option("run-ahead"))
+    {
+        m_cpu_daemon->set_run_ahead(std::stoul(frames.value()));
+    }
+
+    // silent unless asked, the bell is rung by the gui thread
+    m_cpu_daemon->set_audio_sink(audio_sink::make(get_option("audio").value_or("none"), m_gui->get_bell()));
+
+    // --play=<movie>, the movie decides the quirks, the seed and the speed
+    std::optional<movie> playing;
+
+    if(auto path = get_option("play"))
+    {
+        playing.emplace();
+
+        if(!playing->load(read_rom_file(path.value())))
+        {
+            throw std::invalid_argument(path.value() + " is not a movie!");
+        }
+
+        if(!playing->is_rom(input_data))
+        {
+            throw std::invalid_argument(path.value() + " was not recorded with " + m_args[1] + "!");
+        }
+
+        m_cpu_daemon->set_cpu_clockspeed(playing->get_cycles_per_frame() * 60);
+    }
+
+    m_cpu_daemon->send_message(cpu_message(
+        cpu_message_type::SetQuirks,
+        { static_cast<std::uint8_t>(playing ? playing->get_quirks() : get_quirks()) }
+    ));
+
+    // a new game every run unless a seed is given, the log shows it so a run can be replayed
+    std::uint64_t seed = playing ? playing->get_seed()
+                                 : get_seed().value_or((static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}());
+
+    std::vector<std::uint8_t> seed_data(8);
+    for(int byte = 0; byte < 8; byte++) seed_data[byte] = (seed >> (byte * 8)) & 0xFF;
+
+    m_cpu_daemon->send_message(cpu_message(cpu_message_type::SetSeed, seed_data));
+
     // reset the cpu
     m_cpu_daemon->send_message(cpu_message(cpu_message_type::Reset));
 
@@ -82,10 +249,541 @@ int nchip8_app::run()
         }
     ));
 
+    // the keys from the start of the rom, until the emulator closes (or it is reset)
+    if(auto path = get_option("record"))
+    {
+        std::string movie_path = path.value();
+
+        m_cpu_daemon->send_message(cpu_message(
+            cpu_message_type::RecordMovie,
+            input_data,
+            [movie_path](std::vector<std::uint8_t> data)
+            {
+                // called on the cpu thread
+                std::ofstream output_file(movie_path, std::ios::binary | std::ios::out);
+                output_file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+                nchip8::log << "[nchip8] movie written to " << movie_path << '\n';
+            }
+        ));
+    }
+    else if(auto path = get_option("play"))
+    {
+        m_cpu_daemon->send_message(cpu_message(
+            cpu_message_type::PlayMovie,
+            read_rom_file(path.value()),
+            []() {},
+            []() {
+                nchip8::log << "[nchip8] movie playback failed" << '\n';
+            }
+        ));
+    }
+
     // start gui, note: blocking
     m_gui->loop();
 
+    // the reports read the cpu's RAM and counters, which the cpu thread must not be changing meanwhile
+    m_cpu_daemon->stop();
+
+    write_op_stats();
+    write_profile();
+    write_heatmap();
+    write_latency();
+
+    return 0;
+}
+
+void nchip8_app::write_op_stats() const
+{
+    auto path = get_option("op-stats");
+
+    if(!path.has_value() || !m_cpu_daemon) return;
+
+    std::ofstream output_file(path.value());
+
+    if(!output_file)
+    {
+        throw std::invalid_argument("Could not open " + path.value() + "!");
+    }
+
+    m_cpu_daemon->get_op_stats().write_json(output_file, m_cpu_daemon->get_op_names());
+}
+
+void nchip8_app::write_profile() const
+{
+    auto path = get_option("profile");
+
+    if(!path.has_value() || !m_cpu_daemon) return;
+
+    std::ofstream output_file(path.value());
+
+    if(!output_file)
+    {
+        throw std::invalid_argument("Could not open " + path.value() + "!");
+    }
+
+    m_cpu_daemon->write_profile_report(output_file);
+}
+
+void nchip8_app::write_latency() const
+{
+    auto path = get_option("latency");
+
+    if(!path.has_value() || !m_cpu_daemon) return;
+
+    std::ofstream output_file(path.value());
+
+    if(!output_file)
+    {
+        throw std::invalid_argument("Could not open " + path.value() + "!");
+    }
+
+    m_cpu_daemon->get_photon_latency().write_json(output_file);
+}
+
+void nchip8_app::write_heatmap() const
+{
+    auto path = get_option("heatmap");
+
+    if(!path.has_value() || !m_cpu_daemon) return;
+
+    std::ofstream output_file(path.value(), std::ios::binary | std::ios::out);
+
+    if(!output_file)
+    {
+        throw std::invalid_argument("Could not open " + path.value() + "!");
+    }
+
+    m_cpu_daemon->get_ram_heatmap().write_dump(output_file);
+}
+
+int nchip8_app::run_bench()
+{
+    // nchip8 --bench [frames] [cycles per frame] [rom paths...] [--op-stats=<path>] [--profile=<path>]
+    std::size_t frames = 600;
+    std::size_t cycles_per_frame = 1000;
+
+    if(m_args.size() > 2) frames = std::stoul(m_args[2]);
+    if(m_args.size() > 3) cycles_per_frame = std::stoul(m_args[3]);
+
+    // bench the supplied roms, or the bundled corpus if there are none
+    std::vector<bench::rom_entry> corpus;
+
+    for(std::size_t i = 4; i < m_args.size(); i++)
+    {
+        corpus.push_back({ m_args[i], read_rom_file(m_args[i]) });
+    }
+
+    if(corpus.empty())
+    {
+        corpus = bench::builtin_corpus();
+    }
+
+    bench runner(frames, cycles_per_frame);
+    runner.set_quirks(get_quirks());
+    runner.set_seed(get_seed().value_or(0));
+    runner.set_profiling(get_option("profile").has_value());
+
+    auto results = runner.run(corpus);
+    bench::write_results(std::cout, results);
+
+    // --op-stats=<path>, one object per rom
+    if(auto path = get_option("op-stats"))
+    {
+        std::ofstream output_file(path.value());
+
+        if(!output_file)
+        {
+            throw std::invalid_argument("Could not open " + path.value() + "!");
+        }
+
+        const auto names = cpu().get_op_names();
+
+        output_file << "{\n";
+        for(std::size_t i = 0; i < results.size(); i++)
+        {
+            output_file << "\"" << results[i].m_name << "\": ";
+            results[i].m_op_stats.write_json(output_file, names);
+            if(i + 1 < results.size()) output_file << ",";
+        }
+        output_file << "}\n";
+    }
+
+    // --profile=<path>, the reports of each rom one after another
+    if(auto path = get_option("profile"))
+    {
+        std::ofstream output_file(path.value());
+
+        if(!output_file)
+        {
+            throw std::invalid_argument("Could not open " + path.value() + "!");
+        }
+
+        for(const auto& res : results)
+        {
+            output_file << "### " << res.m_name << "\n" << res.m_profile_report << "\n";
+        }
+    }
+
+    return 0;
+}
+
+int nchip8_app::run_bench_state()
+{
+    // nchip8 --bench-state [frames] [cycles per frame] [rom paths...]
+    std::size_t frames = 60;
+    std::size_t cycles_per_frame = 1000;
+
+    if(m_args.size() > 2) frames = std::stoul(m_args[2]);
+    if(m_args.size() > 3) cycles_per_frame = std::stoul(m_args[3]);
+
+    std::vector<bench::rom_entry> corpus;
+
+    for(std::size_t i = 4; i < m_args.size(); i++)
+    {
+        corpus.push_back({ m_args[i], read_rom_file(m_args[i]) });
+    }
+
+    if(corpus.empty())
+    {
+        corpus = bench::builtin_corpus();
+    }
+
+    bench runner(frames, cycles_per_frame);
+    runner.set_quirks(get_quirks());
+    runner.set_seed(get_seed().value_or(0));
+
+    std::vector<bench::state_result> results;
+
+    for(const auto& rom : corpus)
+    {
+        results.push_back(runner.run_state_rom(rom));
+    }
+
+    bench::write_state_results(std::cout, results);
+
+    return 0;
+}
+
+int nchip8_app::run_bench_fork()
+{
+    // nchip8 --bench-fork [children] [frames] [cycles per frame] [rom paths...]
+    std::size_t children = 1000;
+    std::size_t frames = 60;
+    std::size_t cycles_per_frame = 1000;
+
+    if(m_args.size() > 2) children = std::stoul(m_args[2]);
+    if(m_args.size() > 3) frames = std::stoul(m_args[3]);
+    if(m_args.size() > 4) cycles_per_frame = std::stoul(m_args[4]);
+
+    std::vector<bench::rom_entry> corpus;
+
+    for(std::size_t i = 5; i < m_args.size(); i++)
+    {
+        corpus.push_back({ m_args[i], read_rom_file(m_args[i]) });
+    }
+
+    if(corpus.empty())
+    {
+        corpus = bench::builtin_corpus();
+    }
+
+    bench runner(frames, cycles_per_frame);
+    runner.set_quirks(get_quirks());
+    runner.set_seed(get_seed().value_or(0));
+
+    std::vector<bench::fork_result> results;
+
+    for(const auto& rom : corpus)
+    {
+        results.push_back(runner.run_fork_rom(rom, children));
+    }
+
+    bench::write_fork_results(std::cout, results);
+
+    return 0;
+}
+
+int nchip8_app::run_bench_batch()
+{
+    // nchip8 --bench-batch [lanes] [frames] [cycles per frame] [rom paths...]
+    std::size_t lanes = 256;
+    std::size_t frames = 10;
+    std::size_t cycles_per_frame = 1000;
+
+    if(m_args.size() > 2) lanes = std::stoul(m_args[2]);
+    if(m_args.size() > 3) frames = std::stoul(m_args[3]);
+    if(m_args.size() > 4) cycles_per_frame = std::stoul(m_args[4]);
+
+    std::vector<bench::rom_entry> corpus;
+
+    for(std::size_t i = 5; i < m_args.size(); i++)
+    {
+        corpus.push_back({ m_args[i], read_rom_file(m_args[i]) });
+    }
+
+    if(corpus.empty())
+    {
+        corpus = bench::builtin_corpus();
+    }
+
+    bench runner(frames, cycles_per_frame);
+    runner.set_quirks(get_quirks());
+    runner.set_seed(get_seed().value_or(0));
+
+    std::vector<bench::batch_result> results;
+    bool match = true;
+
+    for(const auto& rom : corpus)
+    {
+        results.push_back(runner.run_batch_rom(rom, lanes));
+        match = match && results.back().m_match;
+    }
+
+    bench::write_batch_results(std::cout, results);
+
+    // a lane that ended up somewhere its own cpu did not is a bug in the batch
+    return match ? 0 : 1;
+}
+
+int nchip8_app::run_bench_gym()
+{
+    // nchip8 --bench-gym [envs] [threads] [frames] [cycles per frame] [rom paths...]
+    std::size_t envs = 256;
+    std::size_t threads = 0;
+    std::size_t frames = 600;
+    std::size_t cycles_per_frame = gym_env::default_cycles_per_frame;
+
+    if(m_args.size() > 2) envs = std::stoul(m_args[2]);
+    if(m_args.size() > 3) threads = std::stoul(m_args[3]);
+    if(m_args.size() > 4) frames = std::stoul(m_args[4]);
+    if(m_args.size() > 5) cycles_per_frame = std::stoul(m_args[5]);
+
+    std::vector<bench::rom_entry> corpus;
+
+    for(std::size_t i = 6; i < m_args.size(); i++)
+    {
+        corpus.push_back({ m_args[i], read_rom_file(m_args[i]) });
+    }
+
+    if(corpus.empty())
+    {
+        corpus = bench::builtin_corpus();
+    }
+
+    bench runner(frames, cycles_per_frame);
+    runner.set_quirks(get_quirks());
+    runner.set_seed(get_seed().value_or(0));
+
+    std::vector<bench::gym_result> results;
+
+    for(const auto& rom : corpus)
+    {
+        results.push_back(runner.run_gym_rom(rom, envs, threads));
+    }
+
+    bench::write_gym_results(std::cout, results);
+
+    return 0;
+}
+
+int nchip8_app::run_explore()
+{
+    // nchip8 --explore <rom or save state> [depth] [--strategy=bfs|beam] [--beam=<width>] [--frames=<per step>]
+    //                  [--cycles=<per frame>] [--threads=<n>] [--keys=<hex digits>] [--score=<probe>] [--goal=<expr>]
+    if(m_args.size() < 3)
+    {
+        throw std::invalid_argument("Usage: nchip8 --explore <rom or save state> [depth] [--options...]");
+    }
+
+    std::vector<std::uint8_t> input_data = read_rom_file(m_args[2]);
+
+    // a save state or a rom, save states know their own format
+    cpu start;
+    start.set_trace(false);
+    start.set_quirks(get_quirks());
+    start.set_seed(get_seed().value_or(0));
+
+    std::uint32_t code_end = 0x200;
+
+    if(start.load_state(input_data))
+    {
+        // no rom size in a state, take everything up to the last non-zero byte as code
+        for(std::uint32_t address = 0x200; address <= start.get_ram_mask(); address++)
+        {
+            if(start.read_u8(address) != 0) code_end = address + 1;
+        }
+    }
+    else if(start.load_rom(input_data, 0x200))
+    {
+        code_end = 0x200 + input_data.size();
+    }
+    else
+    {
+        throw std::invalid_argument(m_args[2] + " is neither a rom nor a save state!");
+    }
+
+    explorer::params params;
+
+    if(m_args.size() > 3) params.m_depth = std::stoul(m_args[3]);
+
+    if(auto strategy = get_option("strategy"))
+    {
+        if(strategy.value() == "beam") params.m_strategy = explorer::strategy::beam;
+        else if(strategy.value() != "bfs") throw std::invalid_argument("Unknown strategy " + strategy.value() + "!");
+    }
+
+    if(auto width = get_option("beam")) params.m_beam_width = std::stoul(width.value());
+    if(auto frames = get_option("frames")) params.m_frames_per_step = std::stoul(frames.value());
+    if(auto cycles = get_option("cycles")) params.m_cycles_per_frame = std::stoul(cycles.value());
+    if(auto threads = get_option("threads")) params.m_threads = std::stoul(threads.value());
+    if(auto max = get_option("max-frontier")) params.m_max_frontier = std::stoul(max.value());
+
+    if(auto keys = get_option("keys"))
+    {
+        for(char c : keys.value())
+        {
+            if(!std::isxdigit(c)) throw std::invalid_argument("Keys are hex digits, got " + keys.value() + "!");
+            params.m_keys.push_back(std::stoul(std::string(1, c), nullptr, 16));
+        }
+    }
+
+    if(auto score = get_option("score"))
+    {
+        auto probe = explorer::parse_probe(score.value());
+        if(!probe.has_value()) throw std::invalid_argument("Unknown probe " + score.value() + "!");
+
+        auto get = probe.value();
+        params.m_score = [get](const cpu& chip8) { return static_cast<double>(get(chip8)); };
+    }
+
+    if(auto goal = get_option("goal"))
+    {
+        auto predicate = explorer::parse_goal(goal.value());
+        if(!predicate.has_value()) throw std::invalid_argument("Malformed goal " + goal.value() + "!");
+
+        params.m_goal = predicate.value();
+    }
+
+    auto report = explorer(params).run(start);
+    explorer::write_report(std::cout, report, 0x200, code_end);
+
+    // non-zero exit code when an input crashes the rom, so QA scripts can fail on it
+    return report.m_halts.empty() ? 0 : 1;
+}
+
+int nchip8_app::run_replay()
+{
+    // nchip8 --replay <movie> <rom> [--audio=wav:<path>]
+    if(m_args.size() < 4)
+    {
+        throw std::invalid_argument("Usage: nchip8 --replay <movie> <rom>");
+    }
+
+    movie m;
+
+    if(!m.load(read_rom_file(m_args[2])))
+    {
+        throw std::invalid_argument(m_args[2] + " is not a movie!");
+    }
+
+    cpu chip8;
+    chip8.set_trace(false);
+
+    if(!m.start(chip8, read_rom_file(m_args[3])))
+    {
+        std::cerr << m_args[2] << " was not recorded with " << m_args[3] << std::endl;
+        return 1;
+    }
+
+    // the sound of every frame straight into the sink, in virtual time
+    std::unique_ptr<audio_sink> sink;
+    if(auto spec = get_option("audio")) sink = audio_sink::make(spec.value());
+
+    audio_synth synth;
+    std::array<std::int16_t, audio_synth::samples_per_frame> samples;
+
+    auto result = m.replay(chip8, [&](const cpu& frame)
+    {
+        if(!sink) return;
+
+        synth.render_frame(frame, samples.data());
+        sink->write(samples.data(), samples.size());
+    });
+
+    std::cout << "frames:       " << result.m_frames << " of " << m.get_frames() << '\n'
+              << "instructions: " << result.m_instructions << '\n'
+              << "seconds:      " << result.m_seconds << '\n'
+              << "frames/s:     " << (result.m_seconds > 0 ? result.m_frames / result.m_seconds : 0.0) << '\n'
+              << "checkpoints:  " << result.m_checked << (result.m_mismatch ? ", mismatch at frame " : ", ok");
+
+    if(result.m_mismatch) std::cout << result.m_mismatch.value();
+    std::cout << std::endl;
+
+    // non-zero when the run went a different way, so it can gate changes to the core
+    return result.m_mismatch ? 1 : 0;
+}
+
+int nchip8_app::run_bench_compare()
+{
+    // nchip8 --bench-compare <baseline file> <results file> [threshold %]
+    if(m_args.size() < 4)
+    {
+        throw std::invalid_argument("Usage: nchip8 --bench-compare <baseline> <results> [threshold %]");
+    }
+
+    std::ifstream baseline_file(m_args[2]);
+    std::ifstream results_file(m_args[3]);
+
+    if(!baseline_file || !results_file)
+    {
+        throw std::invalid_argument("Could not open " + m_args[2] + " or " + m_args[3] + "!");
+    }
+
+    double threshold = (m_args.size() > 4) ? std::stod(m_args[4]) : 10.0;
+
+    auto regressions = bench::compare(bench::read_results(baseline_file),
+                                      bench::read_results(results_file),
+                                      threshold, std::cout);
+
+    std::cout << std::dec << regressions << " regression(s) beyond " << threshold << "%" << '\n';
+
+    // non-zero exit code when something regressed, so scripts can fail on it
+    return regressions > 0 ? 1 : 0;
+}
+
+int nchip8_app::run_generate()
+{
+    // nchip8 --generate <preset> <seed> <output path>
+    if(m_args.size() < 5)
+    {
+        std::string presets;
+        for(const auto& name : rom_generator::preset_names()) presets += " " + name;
+
+        throw std::invalid_argument("Usage: nchip8 --generate <preset> <seed> <output path> (presets:" + presets + ")");
+    }
+
+    auto params = rom_generator::preset(m_args[2]);
+
+    if(!params.has_value())
+    {
+        throw std::invalid_argument("Unknown preset " + m_args[2] + "!");
+    }
+
+    params->m_seed = std::stoul(m_args[3]);
+
+    std::vector<std::uint8_t> rom = rom_generator(params.value()).generate();
+
+    std::ofstream output_file(m_args[4], std::ios::binary | std::ios::out);
+
+    if(!output_file)
+    {
+        throw std::invalid_argument("Could not open " + m_args[4] + "!");
+    }
+
+    output_file.write((const char*)rom.data(), rom.size());
+
     return 0;
 }
 
-}
\ No newline at end of file
+}
@@ -6,6 +6,9 @@
 #define CHIP8_NCURSES_NCHIP8_HPP
 
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <bits/stdc++.h>
@@ -31,8 +34,70 @@ public:
     //! @returns    The return code for the process/application
     int run();
 private:
+    //! @brief      Returns the value of an --name=value option (or "" for a bare --name)
+    //! @returns    std::nullopt if the option was not supplied
+    std::optional<std::string> get_option(const std::string& name) const;
+
+    //! @brief      The quirk profile supplied with --quirks=<profile>, quirk_profile::nchip8 if none
+    quirk_profile get_quirks() const;
+
+    //! @brief      The RND seed supplied with --seed=<n> (decimal or 0x hex), std::nullopt if none
+    std::optional<std::uint64_t> get_seed() const;
+
+    //! @brief      Writes the cpu op stats to the file supplied with --op-stats=<path>, if any
+    void write_op_stats() const;
+
+    //! @brief      Writes the PC profiler report to the file supplied with --profile=<path>, if any
+    void write_profile() const;
+
+    //! @brief      Writes the RAM heatmap dump to the file supplied with --heatmap=<path>, if any
+    void write_heatmap() const;
+
+    //! @brief      Writes the input-to-photon latency JSON to the file supplied with --latency=<path>, if any
+    void write_latency() const;
+
+    //! @brief      Runs the headless benchmark, see bench.hpp
+    //! @returns    The return code for the process
+    int run_bench();
+
+    //! @brief      Measures save state sizes and round-trip times over the benchmark corpus
+    //! @returns    The return code for the process
+    int run_bench_state();
+
+    //! @brief      Measures cpu::fork against full copies over the benchmark corpus
+    //! @returns    The return code for the process
+    int run_bench_fork();
+
+    //! @brief      Measures a lockstep batch against separate cpus over the benchmark corpus
+    //! @returns    Non-zero if a lane of the batch did not end in the state of its cpu
+    int run_bench_batch();
+
+    //! @brief      Measures the environment frames per second of the gym vector environments over the corpus
+    //! @returns    The return code for the process
+    int run_bench_gym();
+
+    //! @brief      Searches the key inputs of a ROM or save state, see explorer.hpp
+    //! @returns    Non-zero if an input sequence halts the cpu
+    int run_explore();
+
+    //! @brief      Plays a movie headless as fast as it runs and checks its state hashes, see movie.hpp
+    //! @returns    Non-zero if the movie does not replay identically
+    int run_replay();
+
+    //! @brief      Compares two benchmark result files
+    //! @returns    Non-zero if a regression was found
+    int run_bench_compare();
+
+    //! @brief      Writes a synthetic rom, see rom_generator.hpp
+    //! @returns    The return code for the process
+    int run_generate();
+
+    //! Positional arguments, options are removed from these
     std::vector<std::string> m_args;
 
+    //! --name=value options, by name
+    std::unordered_map<std::string, std::string> m_options;
+
     std::unique_ptr<gui> m_gui;
     std::shared_ptr<cpu_daemon> m_cpu_daemon;
 };
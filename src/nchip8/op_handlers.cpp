@@ -8,7 +8,7 @@
 #include <sstream>
 #include <iostream>
 #include <bitset>
-#include <random>
+#include <cstdlib>
 
 #include "cpu.hpp"
 #include "io.hpp"
@@ -24,11 +24,105 @@ namespace nchip8
 //! for the purposes of space and readability, we are aliasing this to DATA
 static constexpr std::nullopt_t DATA = std::nullopt;
 
+// Rows and words of a plane of the screen in the current mode, see cpu::framebuffer
+static int screen_height(const cpu::screen_mode& mode) { return mode == cpu::screen_mode::hires_sc8 ? 64 : 32; }
+static int screen_words(const cpu::screen_mode& mode) { return mode == cpu::screen_mode::hires_sc8 ? 2 : 1; }
+
+// The words of the selected planes of a screen row (all of them when every plane is selected)
+static cpu::framebuffer::page plane_mask(const std::uint8_t& planes)
+{
+    const std::uint64_t p0 = (planes & 0x1) ? ~std::uint64_t(0) : 0;
+    const std::uint64_t p1 = (planes & 0x2) ? ~std::uint64_t(0) : 0;
+
+    return { p0, p0, p1, p1 };
+}
+
+// Scrolls the rows of the selected planes up (rows < 0) or down by whole rows, the rows scrolled in are blank
+static void scroll_rows(cpu::framebuffer& screen, const int& height, const std::uint8_t& planes, const int& rows)
+{
+    const auto mask = plane_mask(planes);
+    const cpu::framebuffer::page blank {};
+
+    auto scroll_row = [&](const int& y)
+    {
+        const int from = y - rows;
+        const auto& src = (from >= 0 && from < height) ? screen.get_page(from) : blank;
+
+        // a copy, the source row may be this row's page
+        cpu::framebuffer::page row = screen.get_page(y);
+        for(std::size_t i = 0; i < row.size(); i++) row[i] = (row[i] & ~mask[i]) | (src[i] & mask[i]);
+
+        // pages that already hold the right row stay shared
+        screen.write(y * cpu::framebuffer::page_size, row.data(), row.size());
+    };
+
+    // the rows are copied in the direction that never overwrites a row before it was read
+    if(rows > 0) for(int y = height - 1; y >= 0; y--) scroll_row(y);
+    else for(int y = 0; y < height; y++) scroll_row(y);
+}
+
+// 00Cn - SCD nibble (SCHIP)
+// Scroll the screen down n pixels, the rows at the top are cleared.
+//
+// Rows are copied whole, XO-CHIP scrolls the selected planes only.
+cpu::op_handler cpu::SCD_N
+{
+    "SCD_N",
+    {0x0, 0x0, 0xC, DATA},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        scroll_rows(cpu.m_screen, screen_height(cpu.m_screen_mode), cpu.m_planes, operands.m_n);
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "SCD " << nchip8::n << operands.m_n;
+    }
+};
+
+// 00Dn - SCU nibble (XO-CHIP)
+// Scroll the screen up n pixels, the rows at the bottom are cleared.
+cpu::op_handler cpu::SCU_N
+{
+    "SCU_N",
+    {0x0, 0x0, 0xD, DATA},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        scroll_rows(cpu.m_screen, screen_height(cpu.m_screen_mode), cpu.m_planes, -operands.m_n);
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "SCU " << nchip8::n << operands.m_n;
+    }
+};
+
+// 00E0 - CLS
+// Clear the screen, XO-CHIP clears the selected planes only.
+template<typename Quirks>
 cpu::op_handler cpu::CLS
 {
+    "CLS",
     {0x0, 0x0, 0xE, 0x0},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
+        if constexpr (Quirks::xochip_mode)
+        {
+            if(cpu.m_planes != 0x3)
+            {
+                const auto mask = plane_mask(cpu.m_planes);
+
+                for(std::size_t y = 0; y < framebuffer::pages; y++)
+                {
+                    framebuffer::page row = cpu.m_screen.get_page(y);
+                    for(std::size_t i = 0; i < row.size(); i++) row[i] &= ~mask[i];
+                    cpu.m_screen.write(y * framebuffer::page_size, row.data(), row.size());
+                }
+
+                return;
+            }
+        }
+
         cpu.m_screen.fill(0);
     },
 
@@ -41,11 +135,12 @@ cpu::op_handler cpu::CLS
 
 cpu::op_handler cpu::RET
 {
+    "RET",
     {0x0, 0x0, 0xE, 0xE},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        cpu.m_pc = cpu.m_stack[cpu.m_sp];
-        cpu.m_sp--;
+        cpu.m_pc = cpu.m_stack[cpu.m_sp & 0xF];
+        cpu.m_sp = (cpu.m_sp - 1) & 0xF; // wrap instead of walking off the stack
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -54,8 +149,134 @@ cpu::op_handler cpu::RET
     }
 };
 
+// 00FB - SCR (SCHIP)
+// Scroll the screen right 4 pixels.
+//
+// Each row is shifted a word at a time, the pixels leaving the first word carry into the second.
+cpu::op_handler cpu::SCR
+{
+    "SCR",
+    {0x0, 0x0, 0xF, 0xB},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        const int height = screen_height(cpu.m_screen_mode);
+        const bool hires = screen_words(cpu.m_screen_mode) == 2;
+
+        for(int y = 0; y < height; y++)
+        {
+            for(std::size_t plane = 0; plane < 2; plane++)
+            {
+                if(!((cpu.m_planes >> plane) & 0x1)) continue;
+
+                const std::size_t w = plane * plane_words;
+                const framebuffer::page& row = cpu.m_screen.get_page(y);
+                if(row[w] == 0 && row[w + 1] == 0) continue;
+
+                framebuffer::page& out = cpu.m_screen.mut_page(y);
+                if(hires) out[w + 1] = (out[w + 1] >> 4) | (out[w] << 60);
+                out[w] >>= 4;
+            }
+        }
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "SCR";
+    }
+};
+
+// 00FC - SCL (SCHIP)
+// Scroll the screen left 4 pixels.
+cpu::op_handler cpu::SCL
+{
+    "SCL",
+    {0x0, 0x0, 0xF, 0xC},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        const int height = screen_height(cpu.m_screen_mode);
+        const bool hires = screen_words(cpu.m_screen_mode) == 2;
+
+        for(int y = 0; y < height; y++)
+        {
+            for(std::size_t plane = 0; plane < 2; plane++)
+            {
+                if(!((cpu.m_planes >> plane) & 0x1)) continue;
+
+                const std::size_t w = plane * plane_words;
+                const framebuffer::page& row = cpu.m_screen.get_page(y);
+                if(row[w] == 0 && row[w + 1] == 0) continue;
+
+                framebuffer::page& out = cpu.m_screen.mut_page(y);
+                out[w] <<= 4;
+                if(hires)
+                {
+                    out[w] |= out[w + 1] >> 60;
+                    out[w + 1] <<= 4;
+                }
+            }
+        }
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "SCL";
+    }
+};
+
+// 00FD - EXIT (SCHIP)
+// Exit the interpreter, the cpu halts.
+cpu::op_handler cpu::EXIT
+{
+    "EXIT",
+    {0x0, 0x0, 0xF, 0xD},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.m_halted = true;
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "EXIT";
+    }
+};
+
+// 00FE - LOW (SCHIP)
+// Switch to the 64x32 screen.
+cpu::op_handler cpu::LOW
+{
+    "LOW",
+    {0x0, 0x0, 0xF, 0xE},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.set_screen_mode(screen_mode::lores_c8);
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "LOW";
+    }
+};
+
+// 00FF - HIGH (SCHIP)
+// Switch to the 128x64 screen.
+cpu::op_handler cpu::HIGH
+{
+    "HIGH",
+    {0x0, 0x0, 0xF, 0xF},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.set_screen_mode(screen_mode::hires_sc8);
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "HIGH";
+    }
+};
+
 cpu::op_handler cpu::JP
 {
+    "JP",
     {0x1, DATA, DATA, DATA},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -70,13 +291,14 @@ cpu::op_handler cpu::JP
 
 cpu::op_handler cpu::CALL
 {
+    "CALL",
     { 0x2, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        cpu.m_sp++; // get space on the stack to store return value
+        cpu.m_sp = (cpu.m_sp + 1) & 0xF; // get space on the stack to store return value
 
-        // store return address (which is the instruction after current PC)
-        cpu.m_stack[cpu.m_sp] = cpu.m_pc + 0x2;
+        // store return address (PC already points at the instruction after the CALL)
+        cpu.m_stack[cpu.m_sp] = cpu.m_pc;
 
         // jump
         cpu.m_pc = operands.m_nnn;
@@ -88,16 +310,34 @@ cpu::op_handler cpu::CALL
     }
 };
 
+template<typename Quirks>
+void cpu::skip_next()
+{
+    // F000 nnnn is the only 4 byte instruction
+    if constexpr (Quirks::xochip_mode)
+    {
+        if(read_u16(m_pc) == 0xF000)
+        {
+            m_pc += 0x4;
+            return;
+        }
+    }
+
+    m_pc += 0x2;
+}
+
 // 0x3xkk - SE Vx, byte
 // Skip next instruction if Vx = kk.
+template<typename Quirks>
 cpu::op_handler cpu::SE_VX_KK
 {
+    "SE_VX_KK",
     { 0x3, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
 
         if(cpu.m_gpr[operands.m_x] == operands.m_kk) {
-            cpu.m_pc += 0x4;
+            cpu.skip_next<Quirks>();
         }
     },
 
@@ -109,12 +349,14 @@ cpu::op_handler cpu::SE_VX_KK
 
 // 0x4xkk - SNE Vx, byte
 // Skip next instruction if Vx != kk.
+template<typename Quirks>
 cpu::op_handler cpu::SNE_VX_KK
 {
+    "SNE_VX_KK",
     { 0x4, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        if(cpu.m_gpr[operands.m_x] != operands.m_kk) cpu.m_pc += 0x4;
+        if(cpu.m_gpr[operands.m_x] != operands.m_kk) cpu.skip_next<Quirks>();
     },
 
     [](const cpu::operand_data& operands, std::stringstream& ss)
@@ -125,12 +367,14 @@ cpu::op_handler cpu::SNE_VX_KK
 
 // 0x5xy0 - SE Vx, Vy
 // Skip next instruction if Vx == Vy.
+template<typename Quirks>
 cpu::op_handler cpu::SE_VX_VY
 {
+    "SE_VX_VY",
     { 0x5, DATA, DATA, 0x0 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        if(cpu.m_gpr[operands.m_x] == cpu.m_gpr[operands.m_y]) cpu.m_pc += 0x4;
+        if(cpu.m_gpr[operands.m_x] == cpu.m_gpr[operands.m_y]) cpu.skip_next<Quirks>();
     },
 
     [](const cpu::operand_data& operands, std::stringstream& ss)
@@ -139,10 +383,59 @@ cpu::op_handler cpu::SE_VX_VY
     }
 };
 
+// 0x5xy2 - LD [I], Vx - Vy (XO-CHIP)
+// Store Vx through Vy (in either direction) in memory starting at location I, I is left unchanged.
+cpu::op_handler cpu::LD_imm_I_VX_VY
+{
+    "LD_imm_I_VX_VY",
+    { 0x5, DATA, DATA, 0x2 },
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        const int step = operands.m_x <= operands.m_y ? 1 : -1;
+        const int count = std::abs(operands.m_y - operands.m_x) + 1;
+
+        for(int i = 0; i < count; ++i)
+        {
+            cpu.m_ram.set((cpu.m_i + i) & cpu.m_ram_mask, cpu.m_gpr[operands.m_x + i * step]);
+            if(cpu.m_heatmap) cpu.m_heatmap->write(cpu.m_i + i);
+        }
+    },
+
+    [](const cpu::operand_data& operands, std::stringstream& ss)
+    {
+        ss << "LD [I], " << nchip8::V << operands.m_x << " - " << nchip8::V << operands.m_y;
+    }
+};
+
+// 0x5xy3 - LD Vx - Vy, [I] (XO-CHIP)
+// Read Vx through Vy (in either direction) from memory starting at location I, I is left unchanged.
+cpu::op_handler cpu::LD_VX_VY_imm_I
+{
+    "LD_VX_VY_imm_I",
+    { 0x5, DATA, DATA, 0x3 },
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        const int step = operands.m_x <= operands.m_y ? 1 : -1;
+        const int count = std::abs(operands.m_y - operands.m_x) + 1;
+
+        for(int i = 0; i < count; ++i)
+        {
+            cpu.m_gpr[operands.m_x + i * step] = cpu.m_ram[(cpu.m_i + i) & cpu.m_ram_mask];
+            if(cpu.m_heatmap) cpu.m_heatmap->read(cpu.m_i + i);
+        }
+    },
+
+    [](const cpu::operand_data& operands, std::stringstream& ss)
+    {
+        ss << "LD " << nchip8::V << operands.m_x << " - " << nchip8::V << operands.m_y << ", [I]";
+    }
+};
+
 // 0x6xkk - LD Vx, byte
 // Set Vx = kk.
 cpu::op_handler cpu::LD_VX_KK
 {
+    "LD_VX_KK",
     { 0x6, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -160,6 +453,7 @@ cpu::op_handler cpu::LD_VX_KK
 // Set Vx = Vx + kk
 cpu::op_handler cpu::ADD_VX_KK
 {
+    "ADD_VX_KK",
     { 0x7, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -176,6 +470,7 @@ cpu::op_handler cpu::ADD_VX_KK
 // Set Vx = Vy.
 cpu::op_handler cpu::LD_VX_VY
 {
+    "LD_VX_VY",
     { 0x8, DATA, DATA, 0x0 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -192,6 +487,7 @@ cpu::op_handler cpu::LD_VX_VY
 // Set Vx = Vx OR Vy.
 cpu::op_handler cpu::OR_VX_VY
 {
+    "OR_VX_VY",
     { 0x8, DATA, DATA, 0x1 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -208,6 +504,7 @@ cpu::op_handler cpu::OR_VX_VY
 // Set Vx = Vx AND Vy.
 cpu::op_handler cpu::AND_VX_VY
 {
+    "AND_VX_VY",
     { 0x8, DATA, DATA, 0x2 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -224,6 +521,7 @@ cpu::op_handler cpu::AND_VX_VY
 // Set Vx = Vx XOR Vy.
 cpu::op_handler cpu::XOR_VX_VY
 {
+    "XOR_VX_VY",
     { 0x8, DATA, DATA, 0x3 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -241,6 +539,7 @@ cpu::op_handler cpu::XOR_VX_VY
 // If the result is greater than 8 bits (i.e., > 255,) VF (carry) is set to 1, other
 cpu::op_handler cpu::ADD_VX_VY
 {
+    "ADD_VX_VY",
     { 0x8, DATA, DATA, 0x4 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -264,6 +563,7 @@ cpu::op_handler cpu::ADD_VX_VY
 // If Vx > Vy, then VF is set to 1, otherwise 0. Then Vy is subtracted from Vx, and the results stored in Vx.
 cpu::op_handler cpu::SUB_VX_VY
 {
+    "SUB_VX_VY",
     { 0x8, DATA, DATA, 0x5 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -280,22 +580,25 @@ cpu::op_handler cpu::SUB_VX_VY
 };
 
 // 0x8xy6 - SHR Vx,Vy
-// Set Vx = Vx SHR 1.
+// Set Vx = Vx SHR 1 (Vy SHR 1 with Quirks::shift_vy).
 //
-// Before this, if the least-significant bit of Vx (before shift) is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
+// VF is set to the least-significant bit of the value before the shift, after Vx is written (so VF SHR 1 leaves the flag in VF).
+template<typename Quirks>
 cpu::op_handler cpu::SHR_VX_VY
 {
+    "SHR_VX_VY",
     { 0x8, DATA, DATA, 0x6 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        cpu.m_gpr[0xF] = cpu.m_gpr[operands.m_x] & 0x1;
-        cpu.m_gpr[operands.m_x] >>= 1;
-
+        std::uint8_t value = cpu.m_gpr[Quirks::shift_vy ? operands.m_y : operands.m_x];
+        cpu.m_gpr[operands.m_x] = value >> 1;
+        cpu.m_gpr[0xF] = value & 0x1;
     },
 
     [](const cpu::operand_data& operands, std::stringstream& ss)
     {
-        ss << "SHR " << nchip8::V << operands.m_x; // << ", " << nchip8::V << operands.m_y;
+        ss << "SHR " << nchip8::V << operands.m_x;
+        if constexpr (Quirks::shift_vy) ss << ", " << nchip8::V << operands.m_y;
     }
 };
 
@@ -305,6 +608,7 @@ cpu::op_handler cpu::SHR_VX_VY
 // If Vy > Vx, then VF is set to 1, otherwise 0. Then Vx is subtracted from Vy, and the results stored in Vx.
 cpu::op_handler cpu::SUBN_VX_VY
 {
+    "SUBN_VX_VY",
     { 0x8, DATA, DATA, 0x7 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -322,22 +626,25 @@ cpu::op_handler cpu::SUBN_VX_VY
 };
 
 // 0x8xyE - SHL Vx {,Vy }
-// Set Vx = Vx SHR 1.
+// Set Vx = Vx SHL 1 (Vy SHL 1 with Quirks::shift_vy).
 //
-// Before this, if the most-significant bit of Vx (before shift) is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
+// VF is set to the most-significant bit of the value before the shift, after Vx is written. Then Vx is multiplied by 2.
+template<typename Quirks>
 cpu::op_handler cpu::SHL_VX_VY
 {
+    "SHL_VX_VY",
     { 0x8, DATA, DATA, 0xE },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        cpu.m_gpr[0xF] = cpu.m_gpr[operands.m_x] >> 7; // MSB
-        cpu.m_gpr[operands.m_y] <<= 1;
-
+        std::uint8_t value = cpu.m_gpr[Quirks::shift_vy ? operands.m_y : operands.m_x];
+        cpu.m_gpr[operands.m_x] = value << 1;
+        cpu.m_gpr[0xF] = value >> 7; // MSB
     },
 
     [](const cpu::operand_data& operands, std::stringstream& ss)
     {
-        ss << "SHL " << nchip8::V << operands.m_x; // << ", " << nchip8::V << operands.m_y;
+        ss << "SHL " << nchip8::V << operands.m_x;
+        if constexpr (Quirks::shift_vy) ss << ", " << nchip8::V << operands.m_y;
     }
 };
 
@@ -345,13 +652,15 @@ cpu::op_handler cpu::SHL_VX_VY
 // Skip next instruction if Vx != Vy.
 //
 // The values of Vx and Vy are compared, and if they are not equal, the program counter is increased by 2.
+template<typename Quirks>
 cpu::op_handler cpu::SNE_VX_VY
 {
+    "SNE_VX_VY",
     { 0x9, DATA, DATA, 0x0 },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        if(cpu.m_gpr[operands.m_x] != cpu.m_gpr[operands.m_y]) cpu.m_pc += 0x4;
-        // skip current and go to 1 after
+        if(cpu.m_gpr[operands.m_x] != cpu.m_gpr[operands.m_y]) cpu.skip_next<Quirks>();
+        // skip the next instruction
     },
 
     [](const cpu::operand_data& operands, std::stringstream& ss)
@@ -364,6 +673,7 @@ cpu::op_handler cpu::SNE_VX_VY
 // Set I = nnn.
 cpu::op_handler cpu::LD_I_NNN
 {
+    "LD_I_NNN",
     {0xA, DATA, DATA, DATA},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -378,17 +688,21 @@ cpu::op_handler cpu::LD_I_NNN
 
 // Bnnn - JP V0, addr
 // Jump to location nnn + V0.
+//
+// With Quirks::jump_vx this is Bxnn - JP Vx, addr, a jump to location xnn + Vx.
+template<typename Quirks>
 cpu::op_handler cpu::JP_V0_NNN
 {
+    "JP_V0_NNN",
     {0xB, DATA, DATA, DATA},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        cpu.m_pc = operands.m_nnn + cpu.m_gpr[0x0];
+        cpu.m_pc = operands.m_nnn + cpu.m_gpr[Quirks::jump_vx ? operands.m_x : 0x0];
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
     {
-        ss << "JP V0, " << nchip8::nnn << operands.m_nnn;
+        ss << "JP " << nchip8::V << (Quirks::jump_vx ? operands.m_x : 0x0) << ", " << nchip8::nnn << operands.m_nnn;
     }
 };
 
@@ -396,54 +710,140 @@ cpu::op_handler cpu::JP_V0_NNN
 // Set Vx = random byte AND kk.
 cpu::op_handler cpu::RND_VX_KK
 {
+    "RND_VX_KK",
     {0xC, DATA, DATA, DATA},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        std::default_random_engine random(std::random_device{}());
-        std::uniform_int_distribution<std::uint8_t> dist{ 0, 255 };
-
-        cpu.m_gpr[operands.m_x] = (dist(random) & operands.m_kk);
+        cpu.m_gpr[operands.m_x] = cpu.m_random.next_u8() & operands.m_kk;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
     {
-        ss << "RND " << nchip8::V << operands.m_x << ", " << nchip8::V << operands.m_y;
+        ss << "RND " << nchip8::V << operands.m_x << ", " << nchip8::kk << operands.m_kk;
     }
 };
 
+// A row of a sprite (width bits, MSB first) placed at column x of a screen row of 1 or 2 words a plane,
+// the pixels past the right edge wrap around to the left edge, or are dropped when Clip is set
+template<bool Clip>
+static std::array<std::uint64_t, cpu::plane_words> place_sprite_row(std::uint64_t bits, const int& width,
+                                                                   const int& x, const int& words)
+{
+    std::array<std::uint64_t, cpu::plane_words> row {};
+    bits <<= 64 - width; // leftmost pixel in the MSB
+
+    if(words == 1)
+    {
+        row[0] = bits >> x;
+        if(!Clip && x + width > 64) row[0] |= bits << (64 - x);
+    }
+    else if(x < 64)
+    {
+        row[0] = bits >> x;
+        if(x > 0) row[1] = bits << (64 - x);
+    }
+    else
+    {
+        row[1] = bits >> (x - 64);
+        if(!Clip && x + width > 128) row[0] = bits << (128 - x);
+    }
+
+    return row;
+}
+
 // Dxyn - DRW Vx, Vy, nibble
 // Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+// Dxy0 displays a 16x16 sprite (2 bytes a row) instead (SCHIP), without Quirks::schip_mode it draws nothing.
+// XO-CHIP draws to every selected plane, the sprite of plane 1 follows the one of plane 0 in memory.
+//
+// The start position always wraps around the screen, the pixels past an edge wrap around too,
+// or are not drawn with Quirks::clip_sprites.
+// The sprite rows of both planes are shifted into place as whole words, then XORed into the screen row
+// and tested for collisions as one 4 word operation, so hires sprites cost the same as lores ones.
+template<typename Quirks>
 cpu::op_handler cpu::DRW_VX_VY_N
 {
+    "DRW_VX_VY_N",
     { 0xD, DATA, DATA, DATA },
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        int x = cpu.m_gpr[operands.m_x];
-        int y = cpu.m_gpr[operands.m_y];
-        cpu.m_gpr[0xF] = 0;
-        for(int n = 0; n < operands.m_n; n++)
+        const int words = screen_words(cpu.m_screen_mode);
+        const int height = screen_height(cpu.m_screen_mode);
+        const std::uint8_t planes = Quirks::xochip_mode ? cpu.m_planes : 0x1;
+
+        const bool big = Quirks::schip_mode && operands.m_n == 0;
+        const int rows = big ? 16 : operands.m_n;
+        const int sprite_width = big ? 16 : 8;
+        const int row_bytes = big ? 2 : 1;
+
+        const int x = cpu.m_gpr[operands.m_x] % (words * 64);
+        int y = cpu.m_gpr[operands.m_y] % height;
+
+        int collided_rows = 0;
+        for(int n = 0; n < rows; n++)
         {
-            std::uint8_t line = cpu.m_ram.at(cpu.m_i + n);
-            std::bitset<8> sprite_byte(line);
+            framebuffer::page sprite {};
+            std::uint16_t address = cpu.m_i + n * row_bytes;
+
+            for(std::size_t plane = 0; plane < 2; plane++)
+            {
+                if(!((planes >> plane) & 0x1)) continue;
+
+                std::uint64_t bits = cpu.m_ram[address & cpu.m_ram_mask];
+                if(cpu.m_heatmap) cpu.m_heatmap->read(address);
+
+                if(big)
+                {
+                    bits = (bits << 8) | cpu.m_ram[(address + 1) & cpu.m_ram_mask];
+                    if(cpu.m_heatmap) cpu.m_heatmap->read(address + 1);
+                }
 
-            for(int i = 0; i < 8 ; i++)
+                auto placed = place_sprite_row<Quirks::clip_sprites>(bits, sprite_width, x, words);
+                sprite[plane * plane_words] = placed[0];
+                sprite[plane * plane_words + 1] = placed[1];
+
+                // the next plane's sprite
+                address += rows * row_bytes;
+            }
+
+            if(sprite[0] | sprite[1] | sprite[2] | sprite[3])
             {
-                bool set_on_sprite = sprite_byte[7-i];
+                auto& row = cpu.m_screen.mut_page(y);
 
-                if(set_on_sprite) {
-                    auto on = cpu.get_screen_xy(x, y);
-                    if(on) { cpu.m_gpr[0xF] = 1; }
-                    cpu.set_screen_xy(x, y, on ^ sprite_byte[7-i]);
+                std::uint64_t collision = 0;
+                for(std::size_t i = 0; i < row.size(); i++)
+                {
+                    collision |= row[i] & sprite[i];
+                    row[i] ^= sprite[i];
                 }
 
-                x += 1;
-                x %= 64;
+                if(collision) collided_rows++;
             }
-            x = cpu.m_gpr[operands.m_x];
+
             y++;
-            y %= 32;
 
+            if constexpr (Quirks::clip_sprites)
+            {
+                if(y == height)
+                {
+                    // SCHIP counts the rows that fell off the bottom as collisions
+                    if constexpr (Quirks::count_collision_rows) collided_rows += rows - n - 1;
+                    break;
+                }
+            }
+            else y %= height;
+        }
+
+        if constexpr (Quirks::count_collision_rows)
+        {
+            if(words == 2)
+            {
+                cpu.m_gpr[0xF] = collided_rows;
+                return;
+            }
         }
+
+        cpu.m_gpr[0xF] = collided_rows > 0 ? 1 : 0;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -454,14 +854,16 @@ cpu::op_handler cpu::DRW_VX_VY_N
 
 // Ex9E - SKP Vx
 // Skip next instruction if key with the value of Vx is pressed.
+template<typename Quirks>
 cpu::op_handler cpu::SKP_VX
 {
+    "SKP_VX",
     {0xE, DATA, 0x9, 0xE},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        if(cpu.m_keys_down.at(cpu.m_gpr[operands.m_x]))
+        if((cpu.m_keys_down >> (cpu.m_gpr[operands.m_x] & 0xF)) & 0x1)
         {
-            cpu.m_pc += 0x4;
+            cpu.skip_next<Quirks>();
         }
     },
 
@@ -473,14 +875,16 @@ cpu::op_handler cpu::SKP_VX
 
 // ExA1 - SKNP Vx
 // Skip next instruction if key with the value of Vx is not pressed.
+template<typename Quirks>
 cpu::op_handler cpu::SKNP_VX
 {
+    "SKNP_VX",
     {0xE, DATA, 0xA, 0x1},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-        if(!cpu.m_keys_down.at(cpu.m_gpr[operands.m_x]))
+        if(!((cpu.m_keys_down >> (cpu.m_gpr[operands.m_x] & 0xF)) & 0x1))
         {
-            cpu.m_pc += 0x4;
+            cpu.skip_next<Quirks>();
         }
     },
 
@@ -490,10 +894,68 @@ cpu::op_handler cpu::SKNP_VX
     }
 };
 
+// F000 nnnn - LD I, long (XO-CHIP)
+// Set I = the 16 bit address in the next two bytes, which are skipped.
+// Only F000 is defined, the other Fx00 stay unhandled.
+cpu::op_handler cpu::LD_I_LONG
+{
+    "LD_I_LONG",
+    {0xF, 0x0, 0x0, 0x0},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.m_i = cpu.read_u16(cpu.m_pc);
+        cpu.m_pc += 0x2;
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "LD I, long";
+    }
+};
+
+// Fn01 - PLANE n (XO-CHIP)
+// Select the bitplanes (bit 0: plane 0, bit 1: plane 1) that CLS, DRW and the scrolls work on.
+cpu::op_handler cpu::PLANE_N
+{
+    "PLANE_N",
+    {0xF, DATA, 0x0, 0x1},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.m_planes = operands.m_x & 0x3;
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "PLANE " << nchip8::n << operands.m_x;
+    }
+};
+
+// F002 - AUDIO (XO-CHIP)
+// Load the 16 byte (128 sample, 1 bit each) audio pattern buffer from memory starting at location I.
+cpu::op_handler cpu::AUDIO
+{
+    "AUDIO",
+    {0xF, 0x0, 0x0, 0x2},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        for(std::size_t i = 0; i < cpu.m_audio_pattern.size(); ++i)
+        {
+            cpu.m_audio_pattern[i] = cpu.m_ram[(cpu.m_i + i) & cpu.m_ram_mask];
+            if(cpu.m_heatmap) cpu.m_heatmap->read(cpu.m_i + i);
+        }
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "AUDIO";
+    }
+};
+
 // Fx07 - LD Vx, DT
 // Set Vx = delay timer value.
 cpu::op_handler cpu::LD_VX_DT
 {
+    "LD_VX_DT",
     {0xF, DATA, 0x0, 0x7},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -510,19 +972,19 @@ cpu::op_handler cpu::LD_VX_DT
 // Wait for a key press, store the value of the key in Vx.
 cpu::op_handler cpu::LD_VX_K
 {
+    "LD_VX_K",
     {0xF, DATA, 0x0, 0xA},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
-         // wait for the value of key to change to valid
-        while(cpu.m_last_key_down == std::nullopt)
+        // wait for a key by executing this instruction again,
+        // spinning in here would stall the cpu thread (and a headless run forever)
+        if(cpu.m_last_key_down == cpu::no_key)
         {
-
+            cpu.m_pc -= 0x2;
+            return;
         }
 
-        if(cpu.m_last_key_down.has_value())
-        {
-            cpu.m_gpr[operands.m_x] = cpu.m_last_key_down.value();
-        }
+        cpu.m_gpr[operands.m_x] = cpu.m_last_key_down;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -535,6 +997,7 @@ cpu::op_handler cpu::LD_VX_K
 // Set delay timer = Vx.
 cpu::op_handler cpu::LD_DT_VX
 {
+    "LD_DT_VX",
     {0xF, DATA, 0x1, 0x5},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -551,6 +1014,7 @@ cpu::op_handler cpu::LD_DT_VX
 // Set sound timer = Vx.
 cpu::op_handler cpu::LD_ST_VX
 {
+    "LD_ST_VX",
     {0xF, DATA, 0x1, 0x8},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -569,6 +1033,7 @@ cpu::op_handler cpu::LD_ST_VX
 // The values of I and Vx are added, and the results are stored in I.
 cpu::op_handler cpu::ADD_I_VX
 {
+    "ADD_I_VX",
     {0xF, DATA, 0x1, 0xE},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
@@ -586,12 +1051,13 @@ cpu::op_handler cpu::ADD_I_VX
 // Set I = location of sprite for digit Vx.
 cpu::op_handler cpu::LD_F_VX
 {
+    "LD_F_VX",
     {0xF, DATA, 0x2, 0x9},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
         // previously we copied the font to the base of memory
         // each fonts char data has a width of 5 bytes, and is stored sequentially
-        cpu.m_i = cpu.m_gpr[operands.m_x]*0x5;
+        cpu.m_i = cpu::font_address + (cpu.m_gpr[operands.m_x] & 0xF)*0x5;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -600,17 +1066,57 @@ cpu::op_handler cpu::LD_F_VX
     }
 };
 
+// Fx30 - LD HF, Vx (SCHIP)
+// Set I = location of the 8x10 sprite for digit Vx.
+cpu::op_handler cpu::LD_HF_VX
+{
+    "LD_HF_VX",
+    {0xF, DATA, 0x3, 0x0},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.m_i = cpu::big_font_address + (cpu.m_gpr[operands.m_x] & 0xF) * 10;
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "LD HF, " << nchip8::V << operands.m_x;
+    }
+};
+
+// Fx3A - PITCH Vx (XO-CHIP)
+// Set the playback rate of the audio pattern to 4000 * 2 ^ ((Vx - 64) / 48) samples a second.
+cpu::op_handler cpu::PITCH_VX
+{
+    "PITCH_VX",
+    {0xF, DATA, 0x3, 0xA},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        cpu.m_audio_pitch = cpu.m_gpr[operands.m_x];
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "PITCH " << nchip8::V << operands.m_x;
+    }
+};
+
 // Fx33 - LD B, Vx
 // stores BCD representation of VX in I, I+1, I+2
 cpu::op_handler cpu::LD_B_VX
 {
+    "LD_B_VX",
     {0xF, DATA, 0x3, 0x3},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
         std::uint8_t& val = cpu.m_gpr[operands.m_x];
-        cpu.m_ram[cpu.m_i + 2] = val % 10;          // ones digit
-        cpu.m_ram[cpu.m_i + 1] = (val / 10) % 10;   // tens digit
-        cpu.m_ram[cpu.m_i]     = (val / 100);       // hundreds digit
+        cpu.m_ram.set((cpu.m_i + 2) & cpu.m_ram_mask, val % 10);          // ones digit
+        cpu.m_ram.set((cpu.m_i + 1) & cpu.m_ram_mask, (val / 10) % 10);   // tens digit
+        cpu.m_ram.set(cpu.m_i & cpu.m_ram_mask, (val / 100));             // hundreds digit
+
+        if(cpu.m_heatmap)
+        {
+            for(int i = 0; i < 3; ++i) cpu.m_heatmap->write(cpu.m_i + i);
+        }
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -623,17 +1129,21 @@ cpu::op_handler cpu::LD_B_VX
 //Store registers V0 through Vx in memory starting at location I.
 //
 //The interpreter copies the values of registers V0 through Vx into memory, starting at the address in I.
+//With Quirks::load_store_increment_i, I is left at I + x + 1.
+template<typename Quirks>
 cpu::op_handler cpu::LD_imm_I_VX
 {
+    "LD_imm_I_VX",
     {0xF, DATA, 0x5, 0x5},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
         for(int i = 0; i <= operands.m_x; ++i)
         {
-            cpu.m_ram[cpu.m_i + i] = cpu.m_gpr[i];
+            cpu.m_ram.set((cpu.m_i + i) & cpu.m_ram_mask, cpu.m_gpr[i]);
+            if(cpu.m_heatmap) cpu.m_heatmap->write(cpu.m_i + i);
         }
 
-        //cpu.m_i += operands.m_x + 1;
+        if constexpr (Quirks::load_store_increment_i) cpu.m_i += operands.m_x + 1;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -646,17 +1156,21 @@ cpu::op_handler cpu::LD_imm_I_VX
 //Read registers V0 through Vx from memory starting at location I.
 //
 //The interpreter reads values from memory starting at location I into registers V0 through Vx.
+//With Quirks::load_store_increment_i, I is left at I + x + 1.
+template<typename Quirks>
 cpu::op_handler cpu::LD_VX_imm_I
 {
+    "LD_VX_imm_I",
     {0xF, DATA, 0x6, 0x5},
     [](cpu &cpu, const cpu::operand_data &operands)
     {
         for(int i = 0; i <= operands.m_x; ++i)
         {
-            cpu.m_gpr[i] = cpu.m_ram[cpu.m_i + i];
+            cpu.m_gpr[i] = cpu.m_ram[(cpu.m_i + i) & cpu.m_ram_mask];
+            if(cpu.m_heatmap) cpu.m_heatmap->read(cpu.m_i + i);
         }
 
-        //cpu.m_i += operands.m_x + 1;
+        if constexpr (Quirks::load_store_increment_i) cpu.m_i += operands.m_x + 1;
     },
 
     [](const cpu::operand_data &operands, std::stringstream &ss)
@@ -665,5 +1179,62 @@ cpu::op_handler cpu::LD_VX_imm_I
     }
 };
 
+// Fx75 - LD R, Vx (SCHIP)
+// Store V0 through Vx in the RPL user flags (x <= 7).
+cpu::op_handler cpu::LD_R_VX
+{
+    "LD_R_VX",
+    {0xF, DATA, 0x7, 0x5},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        for(int i = 0; i <= operands.m_x && i < 8; ++i) cpu.m_rpl_flags[i] = cpu.m_gpr[i];
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "LD R, " << nchip8::V << operands.m_x;
+    }
+};
+
+// Fx85 - LD Vx, R (SCHIP)
+// Read V0 through Vx from the RPL user flags (x <= 7).
+cpu::op_handler cpu::LD_VX_R
+{
+    "LD_VX_R",
+    {0xF, DATA, 0x8, 0x5},
+    [](cpu &cpu, const cpu::operand_data &operands)
+    {
+        for(int i = 0; i <= operands.m_x && i < 8; ++i) cpu.m_gpr[i] = cpu.m_rpl_flags[i];
+    },
+
+    [](const cpu::operand_data &operands, std::stringstream &ss)
+    {
+        ss << "LD " << nchip8::V << operands.m_x << ", R";
+    }
+};
+
+// the handlers of every quirk policy, see cpu::set_quirks
+#define NCHIP8_INSTANTIATE_QUIRK_HANDLERS(Quirks)                   \
+    template cpu::op_handler cpu::SHR_VX_VY<Quirks>;                \
+    template cpu::op_handler cpu::SHL_VX_VY<Quirks>;                \
+    template cpu::op_handler cpu::JP_V0_NNN<Quirks>;                \
+    template cpu::op_handler cpu::DRW_VX_VY_N<Quirks>;              \
+    template cpu::op_handler cpu::LD_imm_I_VX<Quirks>;              \
+    template cpu::op_handler cpu::LD_VX_imm_I<Quirks>;              \
+    template cpu::op_handler cpu::CLS<Quirks>;                      \
+    template cpu::op_handler cpu::SE_VX_KK<Quirks>;                 \
+    template cpu::op_handler cpu::SNE_VX_KK<Quirks>;                \
+    template cpu::op_handler cpu::SE_VX_VY<Quirks>;                 \
+    template cpu::op_handler cpu::SNE_VX_VY<Quirks>;                \
+    template cpu::op_handler cpu::SKP_VX<Quirks>;                   \
+    template cpu::op_handler cpu::SKNP_VX<Quirks>;
+
+NCHIP8_INSTANTIATE_QUIRK_HANDLERS(quirks::nchip8)
+NCHIP8_INSTANTIATE_QUIRK_HANDLERS(quirks::chip8)
+NCHIP8_INSTANTIATE_QUIRK_HANDLERS(quirks::schip)
+NCHIP8_INSTANTIATE_QUIRK_HANDLERS(quirks::xochip)
+
+#undef NCHIP8_INSTANTIATE_QUIRK_HANDLERS
+
 }
 #endif //NCHIP8_OP_HANDLERS_HPP
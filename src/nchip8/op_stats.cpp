@@ -0,0 +1,91 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "op_stats.hpp"
+
+#include <numeric>
+
+namespace nchip8
+{
+
+void op_stats::reset()
+{
+    m_counts.fill(0);
+
+    for(auto& histogram : m_histograms)
+    {
+        histogram.fill(0);
+    }
+
+    m_sample_countdown = sample_period;
+}
+
+void op_stats::record_time(const std::uint8_t& family, const std::uint64_t& ns)
+{
+    // log2 bucket, the number of significant bits of ns
+    std::size_t bucket = 0;
+    for(std::uint64_t v = ns; v != 0; v >>= 1) bucket++;
+
+    if(bucket >= histogram_buckets) bucket = histogram_buckets - 1;
+
+    m_histograms[family & 0xF][bucket]++;
+}
+
+std::uint64_t op_stats::total() const
+{
+    return std::accumulate(m_counts.begin(), m_counts.end(), std::uint64_t(0));
+}
+
+std::uint64_t op_stats::median_ns(const std::uint8_t& family) const
+{
+    const auto& histogram = m_histograms[family & 0xF];
+    std::uint64_t samples = std::accumulate(histogram.begin(), histogram.end(), std::uint64_t(0));
+
+    if(samples == 0) return 0;
+
+    std::uint64_t seen = 0;
+
+    for(std::size_t bucket = 0; bucket < histogram_buckets; bucket++)
+    {
+        seen += histogram[bucket];
+        if(seen * 2 >= samples) return std::uint64_t(1) << bucket;
+    }
+
+    return std::uint64_t(1) << (histogram_buckets - 1);
+}
+
+void op_stats::write_json(std::ostream& out, const std::vector<std::string>& names) const
+{
+    out << std::dec << "{\n";
+    out << "  \"sample_period\": " << sample_period << ",\n";
+    out << "  \"total\": " << total() << ",\n";
+
+    out << "  \"ops\": [\n";
+    for(std::size_t id = 0; id < names.size() && id < max_ops; id++)
+    {
+        out << "    { \"name\": \"" << names[id] << "\", \"count\": " << m_counts[id] << " }"
+            << (id + 1 < names.size() ? "," : "") << '\n';
+    }
+    out << "  ],\n";
+
+    // bucket i holds samples in [2^(i-1), 2^i) ns
+    out << "  \"families\": [\n";
+    for(std::size_t family = 0; family < families; family++)
+    {
+        out << "    { \"family\": \"" << std::hex << std::uppercase << family << std::dec
+            << "xxx\", \"histogram_ns_log2\": [";
+
+        for(std::size_t bucket = 0; bucket < histogram_buckets; bucket++)
+        {
+            out << m_histograms[family][bucket] << (bucket + 1 < histogram_buckets ? ", " : "");
+        }
+
+        out << "] }" << (family + 1 < families ? "," : "") << '\n';
+    }
+    out << "  ]\n";
+
+    out << "}\n";
+}
+
+}
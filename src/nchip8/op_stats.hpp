@@ -0,0 +1,67 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_OP_STATS_HPP
+#define NCHIP8_OP_STATS_HPP
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace nchip8
+{
+
+//! @brief  Per op_handler execution counters and per opcode family host-time histograms
+//! @details Only filled in when built with NCHIP8_OP_STATS (cmake -DNCHIP8_OP_STATS=ON),
+//!          otherwise the cpu never touches it and the instrumentation is compiled out.
+//!          Counting is a single increment per instruction,
+//!          host time is only measured for one in every sample_period instructions.
+struct op_stats
+{
+    //! Upper bound of op_handlers the cpu can register
+    static constexpr std::size_t max_ops = 64;
+
+    //! Opcode families, i.e. the high nibble of the instruction
+    static constexpr std::size_t families = 16;
+
+    //! Bucket 0 holds samples under 1ns, bucket i holds [2^(i-1), 2^i) ns
+    static constexpr std::size_t histogram_buckets = 32;
+
+    //! One in this many instructions has its host time sampled
+    static constexpr std::uint32_t sample_period = 64;
+
+    //! Executions, indexed by op_handler id
+    std::array<std::uint64_t, max_ops> m_counts {};
+
+    //! Host time histograms, indexed by family then bucket
+    std::array<std::array<std::uint64_t, histogram_buckets>, families> m_histograms {};
+
+    //! Instructions left until the next sample
+    std::uint32_t m_sample_countdown = sample_period;
+
+    //! @brief Zero all counters
+    void reset();
+
+    //! @brief          Adds a host time sample to the histogram of a family
+    //! @param family   High nibble of the instruction
+    //! @param ns       Host time the instruction took
+    void record_time(const std::uint8_t& family, const std::uint64_t& ns);
+
+    //! @brief      Total instructions counted
+    std::uint64_t total() const;
+
+    //! @brief      Approximate median host time of a family, in ns (upper bound of the median bucket)
+    //! @returns    0 if the family has no samples
+    std::uint64_t median_ns(const std::uint8_t& family) const;
+
+    //! @brief          Writes the counters and histograms as JSON
+    //! @param names    Name of each op_handler, indexed by id
+    void write_json(std::ostream& out, const std::vector<std::string>& names) const;
+};
+
+}
+
+#endif //NCHIP8_OP_STATS_HPP
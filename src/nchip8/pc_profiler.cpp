@@ -0,0 +1,183 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "pc_profiler.hpp"
+#include "io.hpp"
+
+#include <algorithm>
+
+namespace nchip8
+{
+
+pc_profiler::pc_profiler(const std::uint32_t& period) :
+    m_period(std::max<std::uint32_t>(period, 1))
+{
+    this->reset();
+}
+
+void pc_profiler::reset()
+{
+    std::fill(m_pc_samples.begin(), m_pc_samples.end(), 0);
+    std::fill(m_stack_samples.begin(), m_stack_samples.end(), 0);
+    m_samples = 0;
+    next_countdown();
+}
+
+void pc_profiler::next_countdown()
+{
+    if(m_period < 2)
+    {
+        m_countdown = 1;
+        return;
+    }
+
+    m_jitter ^= m_jitter << 13;
+    m_jitter ^= m_jitter >> 17;
+    m_jitter ^= m_jitter << 5;
+
+    m_countdown = (m_period / 2) + (m_jitter % m_period);
+}
+
+void pc_profiler::sample(const cpu& chip8)
+{
+    m_pc_samples[chip8.m_pc & chip8.m_ram_mask]++;
+
+    // slot 0 is never used by CALL, the stack starts at 1
+    for(std::uint8_t i = 1; i <= (chip8.m_sp & 0xF); i++)
+    {
+        m_stack_samples[chip8.m_stack[i] & chip8.m_ram_mask]++;
+    }
+
+    m_samples++;
+    next_countdown();
+}
+
+std::uint64_t pc_profiler::get_samples() const
+{
+    return m_samples;
+}
+
+// the n biggest non-zero entries of a histogram
+static std::vector<pc_profiler::hotspot> top_of(const std::vector<std::uint32_t>& histogram, const std::size_t& n)
+{
+    std::vector<pc_profiler::hotspot> spots;
+
+    for(std::uint32_t address = 0; address < histogram.size(); address++)
+    {
+        if(histogram[address] > 0) spots.push_back({ static_cast<std::uint16_t>(address), histogram[address] });
+    }
+
+    auto hottest = [](const pc_profiler::hotspot& a, const pc_profiler::hotspot& b)
+    {
+        return a.m_samples > b.m_samples;
+    };
+
+    if(spots.size() > n)
+    {
+        std::partial_sort(spots.begin(), spots.begin() + n, spots.end(), hottest);
+        spots.resize(n);
+    }
+    else
+    {
+        std::sort(spots.begin(), spots.end(), hottest);
+    }
+
+    return spots;
+}
+
+std::vector<pc_profiler::hotspot> pc_profiler::top_addresses(const std::size_t& n) const
+{
+    return top_of(m_pc_samples, n);
+}
+
+std::vector<pc_profiler::hotspot> pc_profiler::top_call_sites(const std::size_t& n) const
+{
+    return top_of(m_stack_samples, n);
+}
+
+std::vector<pc_profiler::loop> pc_profiler::top_loops(const cpu& chip8, const std::size_t& n) const
+{
+    std::vector<loop> loops;
+
+    // every sampled JP that goes backwards (or to itself) closes a loop
+    for(std::uint32_t address = 0; address < m_pc_samples.size(); address += 1)
+    {
+        if(m_pc_samples[address] == 0) continue;
+
+        std::uint16_t instruction = chip8.read_u16(address);
+        if((instruction & 0xF000) != 0x1000) continue;
+
+        std::uint16_t target = instruction & 0x0FFF;
+        if(target > address) continue;
+
+        loop l { target, static_cast<std::uint16_t>(address), 0 };
+        for(std::uint32_t i = target; i <= address; i++) l.m_samples += m_pc_samples[i];
+
+        loops.push_back(l);
+    }
+
+    std::sort(loops.begin(), loops.end(), [](const loop& a, const loop& b)
+    {
+        return a.m_samples > b.m_samples;
+    });
+
+    if(loops.size() > n) loops.resize(n);
+
+    return loops;
+}
+
+void pc_profiler::write_report(std::ostream& out, const cpu& chip8, const std::size_t& n) const
+{
+    auto percent = [this](const std::uint64_t& samples)
+    {
+        return m_samples ? (samples * 100.0) / m_samples : 0.0;
+    };
+
+    auto dasm = [&chip8](const std::uint16_t& address)
+    {
+        return chip8.dasm_op(address).value_or("???");
+    };
+
+    out << std::dec << "# pc profile, " << m_samples << " samples\n\n";
+
+    out << "# hottest addresses\n";
+    out << "#  addr        %    samples  instruction\n";
+    for(const auto& spot : top_addresses(n))
+    {
+        out << "   " << nchip8::nnn << spot.m_address << std::dec << std::setfill(' ')
+            << std::fixed << std::setprecision(2) << std::setw(9) << percent(spot.m_samples)
+            << std::setw(11) << spot.m_samples << "  "
+            << nchip8::inst << chip8.read_u16(spot.m_address) << ' ' << dasm(spot.m_address) << '\n';
+    }
+
+    out << "\n# hottest loops (backward jumps)\n";
+    out << "#  start  end           %    samples\n";
+    for(const auto& l : top_loops(chip8, n))
+    {
+        out << "   " << nchip8::nnn << l.m_start << "  " << nchip8::nnn << l.m_end
+            << std::dec << std::setfill(' ') << std::fixed << std::setprecision(2)
+            << std::setw(11) << percent(l.m_samples) << std::setw(11) << l.m_samples << '\n';
+
+        // the body of the loop, with the share of each instruction
+        for(std::uint32_t address = l.m_start; address <= l.m_end; address += 2)
+        {
+            out << "     " << nchip8::nnn << address << std::dec << std::setfill(' ')
+                << std::setw(9) << percent(m_pc_samples[address]) << "  " << dasm(address) << '\n';
+        }
+    }
+
+    // return addresses are the instruction after the CALL
+    out << "\n# hottest call sites (time spent below the CALL)\n";
+    out << "#  call        %    samples  instruction\n";
+    for(const auto& spot : top_call_sites(n))
+    {
+        std::uint16_t call = (spot.m_address - 2) & chip8.m_ram_mask;
+
+        out << "   " << nchip8::nnn << call << std::dec << std::setfill(' ')
+            << std::fixed << std::setprecision(2) << std::setw(9) << percent(spot.m_samples)
+            << std::setw(11) << spot.m_samples << "  " << dasm(call) << '\n';
+    }
+}
+
+}
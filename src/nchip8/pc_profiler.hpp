@@ -0,0 +1,95 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_PC_PROFILER_HPP
+#define NCHIP8_PC_PROFILER_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Sampling profiler of the guest program counter
+//! @details Every ~period instructions the PC is added to a histogram over the address space (4K, 64K with XO-CHIP),
+//!          and every return address on the stack to a second one (so hot call sites show up too).
+//!          The period is jittered so it can't lock onto a loop of the same length.
+class pc_profiler
+{
+public:
+    //! @brief          Constructor
+    //! @param period   Mean number of instructions between samples
+    explicit pc_profiler(const std::uint32_t& period = 64);
+
+    //! @brief A sampled address
+    struct hotspot
+    {
+        std::uint16_t m_address;
+        std::uint32_t m_samples;
+    };
+
+    //! @brief A loop, i.e. a backward jump from m_end to m_start
+    struct loop
+    {
+        std::uint16_t m_start;
+        std::uint16_t m_end;
+        std::uint64_t m_samples;    //! Samples of every address in [m_start, m_end]
+    };
+
+    //! @brief Clear all samples
+    void reset();
+
+    //! @brief Call once per executed instruction, samples when the countdown runs out
+    void tick(const cpu& chip8)
+    {
+        if(--m_countdown == 0) sample(chip8);
+    }
+
+    //! @brief Takes a sample of the PC and the stack now
+    void sample(const cpu& chip8);
+
+    //! @brief Total samples taken
+    std::uint64_t get_samples() const;
+
+    //! @brief The addresses with the most PC samples, hottest first
+    std::vector<hotspot> top_addresses(const std::size_t& n) const;
+
+    //! @brief The return addresses seen most on the stack, hottest first
+    std::vector<hotspot> top_call_sites(const std::size_t& n) const;
+
+    //! @brief          The loops with the most samples, found from the backward jumps in RAM
+    //! @param chip8    The cpu that was profiled (its RAM is read for jumps)
+    std::vector<loop> top_loops(const cpu& chip8, const std::size_t& n) const;
+
+    //! @brief          Writes a text report of the hottest addresses, loops and call sites,
+    //!                 annotated with disassembly
+    void write_report(std::ostream& out, const cpu& chip8, const std::size_t& n = 32) const;
+
+private:
+    //! Most RAM a cpu has (XO-CHIP), addresses are masked with the RAM mask of the cpu sampled
+    static constexpr std::size_t max_addresses = 0x10000;
+
+    //! PC samples by address
+    std::vector<std::uint32_t> m_pc_samples = std::vector<std::uint32_t>(max_addresses);
+
+    //! Return address samples by address (these are the instructions after a CALL)
+    std::vector<std::uint32_t> m_stack_samples = std::vector<std::uint32_t>(max_addresses);
+
+    std::uint64_t m_samples = 0;
+    std::uint32_t m_period;
+    std::uint32_t m_countdown;
+
+    //! xorshift state for the period jitter
+    std::uint32_t m_jitter = 0x9E3779B9;
+
+    //! @brief Picks the next countdown, uniformly in [period/2, period*3/2)
+    void next_countdown();
+};
+
+}
+
+#endif //NCHIP8_PC_PROFILER_HPP
@@ -0,0 +1,71 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "photon_latency.hpp"
+
+namespace nchip8
+{
+
+void photon_latency::published(const trace& t)
+{
+    m_stages[queue].record(t.m_applied - t.m_arrival);
+    m_stages[consume].record(t.m_consumed - t.m_applied);
+    m_stages[draw].record(t.m_drawn - t.m_consumed);
+    m_stages[publish].record(t.m_published - t.m_drawn);
+
+    std::lock_guard<std::mutex> lock(m_unpresented_mutex);
+
+    if(m_unpresented.size() >= max_unpresented) m_unpresented.erase(m_unpresented.begin());
+    m_unpresented.push_back(t);
+}
+
+void photon_latency::presented(const std::uint64_t& frame, const std::chrono::steady_clock::time_point& time)
+{
+    std::lock_guard<std::mutex> lock(m_unpresented_mutex);
+
+    // frames are published in order, so are the traces
+    auto it = m_unpresented.begin();
+
+    for(; it != m_unpresented.end() && it->m_frame <= frame; it++)
+    {
+        m_stages[present].record(time - it->m_published);
+        m_stages[total].record(time - it->m_arrival);
+    }
+
+    m_unpresented.erase(m_unpresented.begin(), it);
+}
+
+const latency_histogram& photon_latency::get_stage(const stage& s) const
+{
+    return m_stages[s];
+}
+
+const char* photon_latency::stage_name(const stage& s)
+{
+    static const char* names[_last] = { "queue", "consume", "draw", "publish", "present", "total" };
+
+    return names[s];
+}
+
+void photon_latency::write_json(std::ostream& out) const
+{
+    out << std::dec << "{\n";
+    out << "  \"unit\": \"us\",\n";
+
+    out << "  \"stages\": [\n";
+    for(int s = 0; s < _last; s++)
+    {
+        const latency_histogram& h = m_stages[s];
+
+        out << "    { \"name\": \"" << stage_name(static_cast<stage>(s)) << "\", \"count\": " << h.get_count()
+            << ", \"mean\": " << h.get_mean() << ", \"p50\": " << h.get_percentile(0.5)
+            << ", \"p99\": " << h.get_percentile(0.99) << ", \"max\": " << h.get_max() << " }"
+            << (s + 1 < _last ? "," : "") << '\n';
+    }
+    out << "  ]\n";
+
+    out << "}\n";
+}
+
+}
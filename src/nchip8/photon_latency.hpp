@@ -0,0 +1,79 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_PHOTON_LATENCY_HPP
+#define NCHIP8_PHOTON_LATENCY_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Input-to-photon latency, split into the stages a key press goes through
+//! @details A trace follows one key press: the frontend reads it (arrival), the cpu thread applies it between
+//!          instructions, an instruction consumes it (SKP/SKNP/LD K), the first instruction after that changes
+//!          pixels (usually a DRW), the frame with the change is published, and the frontend finishes writing
+//!          that frame to the terminal. The cpu thread fills in a trace up to publication, the frontend
+//!          completes it with presented().
+class photon_latency
+{
+public:
+    enum stage
+    {
+        queue,      //! Arrival to applied by the cpu thread
+        consume,    //! Applied to the instruction that saw the key
+        draw,       //! That instruction to the first pixel change
+        publish,    //! Pixel change to the frame being published
+        present,    //! Publication to the terminal write completing
+        total,      //! Arrival to the terminal write completing
+        _last       // keep at end of enum
+    };
+
+    //! @brief A key press on its way to the screen
+    struct trace
+    {
+        std::chrono::steady_clock::time_point m_arrival;
+        std::chrono::steady_clock::time_point m_applied;
+        std::chrono::steady_clock::time_point m_consumed;
+        std::chrono::steady_clock::time_point m_drawn;
+        std::chrono::steady_clock::time_point m_published;
+        std::uint64_t m_frame = 0;  //! Number of the published frame showing the change
+    };
+
+    //! @brief  Records the stages up to publication and waits for the frame to be presented, cpu thread only
+    void published(const trace& t);
+
+    //! @brief  A frame (and every frame before it) finished writing to the terminal, frontend thread only
+    void presented(const std::uint64_t& frame, const std::chrono::steady_clock::time_point& time);
+
+    //! @brief Latencies of a stage
+    const latency_histogram& get_stage(const stage& s) const;
+
+    //! @brief Name of a stage, e.g. "queue"
+    static const char* stage_name(const stage& s);
+
+    //! @brief Writes count, mean, p50, p99 and max of every stage, in microseconds
+    void write_json(std::ostream& out) const;
+
+private:
+    std::array<latency_histogram, _last> m_stages;
+
+    //! Traces published but not presented yet, oldest first
+    std::vector<trace> m_unpresented;
+    std::mutex m_unpresented_mutex;
+
+    //! Without a frontend nothing gets presented, only keep this many traces waiting
+    static constexpr std::size_t max_unpresented = 64;
+};
+
+}
+
+#endif //NCHIP8_PHOTON_LATENCY_HPP
@@ -0,0 +1,102 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_PRNG_HPP
+#define NCHIP8_PRNG_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace nchip8
+{
+
+//! @brief  A small, fast, seedable pseudo random generator (xoshiro256**)
+//! @details 32 bytes of state and a handful of shifts and multiplies per 64 bits of output,
+//!          the same seed gives the same sequence on every host, so runs that draw from it replay exactly.
+//!          Not for anything cryptographic.
+class prng
+{
+public:
+    using state_type = std::array<std::uint64_t, 4>;
+
+    explicit prng(const std::uint64_t& seed = 0)
+    {
+        this->seed(seed);
+    }
+
+    //! @brief  Restarts the sequence of seed, the state is expanded from it with splitmix64
+    void seed(std::uint64_t seed)
+    {
+        for(auto& word : m_state)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    //! @brief  Next 64 random bits
+    std::uint64_t next()
+    {
+        const std::uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+        const std::uint64_t t = m_state[1] << 17;
+
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+
+        return result;
+    }
+
+    //! @brief  Next random byte (the top bits of next(), the best ones)
+    std::uint8_t next_u8()
+    {
+        return static_cast<std::uint8_t>(next() >> 56);
+    }
+
+    //! @brief  Fills count bytes with random bytes, 8 at a time (e.g. a batch of seeds or inputs up front)
+    void fill(std::uint8_t* out, std::size_t count)
+    {
+        while(count > 0)
+        {
+            std::uint64_t bits = next();
+
+            // little endian regardless of the host
+            for(int byte = 0; byte < 8 && count > 0; byte++, count--)
+            {
+                *out++ = static_cast<std::uint8_t>(bits);
+                bits >>= 8;
+            }
+        }
+    }
+
+    //! @brief  The whole state, for save states
+    const state_type& get_state() const { return m_state; }
+
+    //! @brief  Restores a state from get_state (an all zero state is stuck at zero, it is reseeded instead)
+    void set_state(const state_type& state)
+    {
+        if((state[0] | state[1] | state[2] | state[3]) == 0) this->seed(0);
+        else m_state = state;
+    }
+
+private:
+    static std::uint64_t rotl(const std::uint64_t& x, const int& k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    state_type m_state {};
+};
+
+}
+
+#endif //NCHIP8_PRNG_HPP
@@ -0,0 +1,27 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "quirks.hpp"
+
+namespace nchip8
+{
+
+const char* quirk_profile_name(const quirk_profile& profile)
+{
+    static const char* names[static_cast<int>(quirk_profile::_last)] = { "nchip8", "chip8", "schip", "xochip" };
+
+    return names[static_cast<int>(profile)];
+}
+
+std::optional<quirk_profile> parse_quirk_profile(const std::string& name)
+{
+    for(int p = 0; p < static_cast<int>(quirk_profile::_last); p++)
+    {
+        if(name == quirk_profile_name(static_cast<quirk_profile>(p))) return static_cast<quirk_profile>(p);
+    }
+
+    return std::nullopt;
+}
+
+}
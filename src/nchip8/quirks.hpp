@@ -0,0 +1,90 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_QUIRKS_HPP
+#define NCHIP8_QUIRKS_HPP
+
+#include <optional>
+#include <string>
+
+namespace nchip8
+{
+
+//! @brief  Behaviour that differs between CHIP-8 interpreters, as compile-time policies
+//! @details The op_handlers that depend on a quirk are templates on one of these policies, so each profile
+//!          gets its own handlers and none of them test a quirk while executing.
+//!          A profile is picked per ROM (see cpu::set_quirks), the cpu then builds its handler tree
+//!          from the handlers of that profile.
+namespace quirks
+{
+
+//! nchip8's own behaviour, what it always did
+struct nchip8
+{
+    static constexpr bool shift_vy = false;                 //! 8xy6/8xyE shift Vy into Vx, instead of shifting Vx
+    static constexpr bool load_store_increment_i = false;   //! Fx55/Fx65 leave I at I + x + 1
+    static constexpr bool clip_sprites = false;             //! DRW clips at the screen edges instead of wrapping
+    static constexpr bool jump_vx = false;                  //! Bxnn jumps to xnn + Vx instead of nnn + V0
+    static constexpr bool count_collision_rows = false;     //! Hires DRW sets VF to the rows that collided or were clipped
+    static constexpr bool schip_mode = false;               //! SUPER-CHIP: the hires screen, scrolling, Dxy0 and the SCHIP instructions
+    static constexpr bool xochip_mode = false;              //! XO-CHIP: 64K of RAM, two bitplanes and the XO-CHIP instructions
+};
+
+//! The original COSMAC VIP interpreter
+struct chip8
+{
+    static constexpr bool shift_vy = true;
+    static constexpr bool load_store_increment_i = true;
+    static constexpr bool clip_sprites = true;
+    static constexpr bool jump_vx = false;
+    static constexpr bool count_collision_rows = false;
+    static constexpr bool schip_mode = false;
+    static constexpr bool xochip_mode = false;
+};
+
+//! SUPER-CHIP 1.1 (HP48)
+struct schip
+{
+    static constexpr bool shift_vy = false;
+    static constexpr bool load_store_increment_i = false;
+    static constexpr bool clip_sprites = true;
+    static constexpr bool jump_vx = true;
+    static constexpr bool count_collision_rows = true;
+    static constexpr bool schip_mode = true;
+    static constexpr bool xochip_mode = false;
+};
+
+//! XO-CHIP (as Octo runs it)
+struct xochip
+{
+    static constexpr bool shift_vy = true;
+    static constexpr bool load_store_increment_i = true;
+    static constexpr bool clip_sprites = false;
+    static constexpr bool jump_vx = false;
+    static constexpr bool count_collision_rows = false;
+    static constexpr bool schip_mode = true;
+    static constexpr bool xochip_mode = true;
+};
+
+}
+
+//! @brief The quirk policies, by name
+enum class quirk_profile
+{
+    nchip8,     //! quirks::nchip8, the default
+    chip8,      //! quirks::chip8
+    schip,      //! quirks::schip
+    xochip,     //! quirks::xochip
+    _last       // keep at end of enum
+};
+
+//! @brief Name of a profile, e.g. "chip8"
+const char* quirk_profile_name(const quirk_profile& profile);
+
+//! @brief Parses a profile name, std::nullopt if it names none
+std::optional<quirk_profile> parse_quirk_profile(const std::string& name);
+
+}
+
+#endif //NCHIP8_QUIRKS_HPP
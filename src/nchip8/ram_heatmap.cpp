@@ -0,0 +1,43 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "ram_heatmap.hpp"
+
+#include <algorithm>
+
+namespace nchip8
+{
+
+void ram_heatmap::reset()
+{
+    std::fill(m_reads.begin(), m_reads.end(), 0);
+    std::fill(m_writes.begin(), m_writes.end(), 0);
+    std::fill(m_executes.begin(), m_executes.end(), 0);
+}
+
+// little endian regardless of the host
+static void write_u32(std::ostream& out, const std::uint32_t& value)
+{
+    char bytes[4] = {
+        static_cast<char>(value & 0xFF),
+        static_cast<char>((value >> 8) & 0xFF),
+        static_cast<char>((value >> 16) & 0xFF),
+        static_cast<char>((value >> 24) & 0xFF)
+    };
+
+    out.write(bytes, sizeof(bytes));
+}
+
+void ram_heatmap::write_dump(std::ostream& out) const
+{
+    out.write("NC8HEAT\0", 8);
+    write_u32(out, 2);
+    write_u32(out, get_size());
+
+    for(std::size_t i = 0; i < get_size(); i++) write_u32(out, m_reads[i]);
+    for(std::size_t i = 0; i < get_size(); i++) write_u32(out, m_writes[i]);
+    for(std::size_t i = 0; i < get_size(); i++) write_u32(out, m_executes[i]);
+}
+
+}
@@ -0,0 +1,50 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_RAM_HEATMAP_HPP
+#define NCHIP8_RAM_HEATMAP_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace nchip8
+{
+
+//! @brief  Read, write and execute counters for every byte of guest RAM
+//! @details Attached to a cpu with cpu::set_ram_heatmap, when none is attached the cpu only pays
+//!          for a null check. Reads come from DRW and Fx65, writes from Fx33 and Fx55,
+//!          executes from instruction fetch. The counters cover the RAM of the cpu's quirk profile
+//!          (4K, 64K with XO-CHIP) and addresses wrap around it like in the cpu.
+struct ram_heatmap
+{
+    static constexpr std::size_t max_size = 0x10000;
+
+    std::vector<std::uint32_t> m_reads = std::vector<std::uint32_t>(max_size);
+    std::vector<std::uint32_t> m_writes = std::vector<std::uint32_t>(max_size);
+    std::vector<std::uint32_t> m_executes = std::vector<std::uint32_t>(max_size);
+
+    //! Bytes of RAM counted minus one, set by the cpu it is attached to (see cpu::get_ram_mask)
+    std::uint16_t m_mask = 0xFFF;
+
+    void read(const std::uint16_t& address) { m_reads[address & m_mask]++; }
+    void write(const std::uint16_t& address) { m_writes[address & m_mask]++; }
+    void execute(const std::uint16_t& address) { m_executes[address & m_mask]++; }
+
+    //! @brief Bytes of RAM counted
+    std::size_t get_size() const { return static_cast<std::size_t>(m_mask) + 1; }
+
+    //! @brief Zero all counters
+    void reset();
+
+    //! @brief  Writes a binary dump
+    //! @details Layout (little endian): "NC8HEAT\0", u32 version (2), u32 size (get_size),
+    //!          then u32 reads[size], u32 writes[size], u32 executes[size].
+    //!          Version 1 was always 4096 bytes, with the higher addresses folded onto them
+    void write_dump(std::ostream& out) const;
+};
+
+}
+
+#endif //NCHIP8_RAM_HEATMAP_HPP
@@ -0,0 +1,362 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "regress.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace nchip8
+{
+
+static std::vector<std::uint8_t> read_file(const std::string& path)
+{
+    std::ifstream input_file(path, std::ios::binary | std::ios::in);
+
+    if(!input_file)
+    {
+        throw std::invalid_argument("Could not open " + path + "!");
+    }
+
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(input_file), std::istreambuf_iterator<char>());
+}
+
+std::vector<regress::test_case> regress::read_manifest(std::istream& in, const std::string& base)
+{
+    std::vector<test_case> cases;
+    std::vector<bench::rom_entry> builtin;
+    std::string line;
+    std::size_t line_number = 0;
+
+    auto path_of = [&base](const std::string& path)
+    {
+        return (base.empty() || path.empty() || path.front() == '/') ? path : base + "/" + path;
+    };
+
+    while(std::getline(in, line))
+    {
+        line_number++;
+
+        auto comment = line.find('#');
+        if(comment != std::string::npos) line.erase(comment);
+
+        std::stringstream fields(line);
+        test_case test;
+        std::string rom;
+
+        if(!(fields >> test.m_name)) continue;
+
+        auto malformed = [&line_number](const std::string& what)
+        {
+            return std::invalid_argument("Manifest line " + std::to_string(line_number) + ": " + what);
+        };
+
+        if(!(fields >> rom)) throw malformed("no rom for " + test.m_name);
+
+        if(rom.rfind("builtin:", 0) == 0)
+        {
+            if(builtin.empty()) builtin = bench::builtin_corpus();
+
+            auto entry = std::find_if(builtin.begin(), builtin.end(),
+                                      [&rom](const bench::rom_entry& e) { return e.m_name == rom.substr(8); });
+
+            if(entry == builtin.end()) throw malformed("no builtin rom " + rom.substr(8));
+
+            test.m_rom = entry->m_data;
+            test.m_quirks = entry->m_quirks.value_or(quirk_profile::nchip8);
+        }
+        else
+        {
+            test.m_rom = read_file(path_of(rom));
+        }
+
+        std::optional<std::uint32_t> frames;
+        std::string option;
+
+        while(fields >> option)
+        {
+            auto equals = option.find('=');
+            if(equals == std::string::npos) throw malformed("expected name=value, got " + option);
+
+            std::string name = option.substr(0, equals);
+            std::string value = option.substr(equals + 1);
+
+            if(name == "frames") frames = std::stoul(value);
+            else if(name == "cycles") test.m_cycles_per_frame = std::stoul(value);
+            else if(name == "seed") test.m_seed = std::stoull(value, nullptr, 0);
+            else if(name == "every") test.m_every = std::max<std::uint32_t>(std::stoul(value), 1);
+            else if(name == "quirks")
+            {
+                auto profile = parse_quirk_profile(value);
+                if(!profile.has_value()) throw malformed("unknown quirks " + value);
+
+                test.m_quirks = profile.value();
+            }
+            else if(name == "movie")
+            {
+                test.m_movie.emplace();
+
+                if(!test.m_movie->load(read_file(path_of(value)))) throw malformed(value + " is not a movie");
+                if(!test.m_movie->is_rom(test.m_rom)) throw malformed(value + " was not recorded with " + rom);
+            }
+            else throw malformed("unknown option " + name);
+        }
+
+        if(test.m_movie)
+        {
+            test.m_quirks = test.m_movie->get_quirks();
+            test.m_seed = test.m_movie->get_seed();
+            test.m_cycles_per_frame = test.m_movie->get_cycles_per_frame();
+            test.m_frames = test.m_movie->get_frames();
+        }
+
+        if(frames) test.m_frames = frames.value();
+        test.m_cycles_per_frame = std::max<std::uint32_t>(test.m_cycles_per_frame, 1);
+
+        // the RAM size is given by the final profile, a ROM that does not fit would run whatever RAM holds
+        cpu fits;
+        fits.set_quirks(test.m_quirks);
+
+        if(!fits.load_rom(test.m_rom, 0x200))
+        {
+            throw malformed(rom + " does not fit the RAM of " + quirk_profile_name(test.m_quirks));
+        }
+
+        cases.push_back(std::move(test));
+    }
+
+    return cases;
+}
+
+std::vector<regress::test_case> regress::builtin_manifest()
+{
+    std::vector<test_case> cases;
+
+    for(auto& entry : bench::builtin_corpus())
+    {
+        test_case test;
+        test.m_name = entry.m_name;
+        test.m_rom = std::move(entry.m_data);
+        test.m_quirks = entry.m_quirks.value_or(quirk_profile::nchip8);
+
+        cases.push_back(std::move(test));
+    }
+
+    return cases;
+}
+
+regress::result regress::run_case(const test_case& test)
+{
+    result res;
+    res.m_name = test.m_name;
+
+    cpu chip8;
+    chip8.set_trace(false);
+    chip8.set_quirks(test.m_quirks);
+    chip8.set_seed(test.m_seed);
+    chip8.reset();
+
+    // no checkpoints, which does not match a golden run of the ROM
+    if(!chip8.load_rom(test.m_rom, 0x200)) return res;
+
+    std::vector<std::uint8_t> bytes;
+    std::size_t next_event = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(std::uint32_t frame = 0; frame < test.m_frames; frame++)
+    {
+        for(std::uint32_t cycle = 0; cycle < test.m_cycles_per_frame; cycle++)
+        {
+            // a movie is played the way it was recorded, keys reach a halted cpu too
+            if(test.m_movie) next_event = test.m_movie->apply(chip8, frame, cycle, next_event);
+
+            if(chip8.execute_op_at_pc()) res.m_instructions++;
+            else if(!test.m_movie) break;
+        }
+
+        chip8.tick_timers();
+
+        const std::uint32_t frames = frame + 1;
+        if(frames % test.m_every != 0 && frames != test.m_frames) continue;
+
+        checkpoint c;
+        c.m_frame = frames;
+
+        // the screen on its own too, a state hash changes with any RAM write but a screen hash points at drawing
+        bytes.clear();
+
+        for(std::size_t row = 0; row < cpu::framebuffer::pages; row++)
+        {
+            for(auto word : chip8.get_screen_framebuffer().get_page(row))
+            {
+                for(int shift = 56; shift >= 0; shift -= 8) bytes.push_back(word >> shift);
+            }
+        }
+
+        c.m_screen = cpu::hash_state(bytes);
+
+        chip8.save_state(bytes);
+        c.m_state = cpu::hash_state(bytes);
+
+        res.m_checkpoints.push_back(c);
+    }
+
+    res.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return res;
+}
+
+std::vector<regress::result> regress::run(const std::vector<test_case>& cases, const std::size_t& threads)
+{
+    std::vector<result> results(cases.size());
+    std::atomic<std::size_t> next { 0 };
+
+    std::size_t count = threads ? threads : std::thread::hardware_concurrency();
+    count = std::max<std::size_t>(std::min(count, cases.size()), 1);
+
+    // every case has its own cpu, a thread just takes the next one
+    auto worker = [&]()
+    {
+        for(std::size_t n = next++; n < cases.size(); n = next++)
+        {
+            results[n] = run_case(cases[n]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(std::size_t t = 1; t < count; t++) pool.emplace_back(worker);
+    worker();
+    for(auto& thread : pool) thread.join();
+
+    return results;
+}
+
+void regress::write_golden(std::ostream& out, const std::vector<result>& results)
+{
+    out << "# " << std::left
+        << std::setw(14) << "case"
+        << std::setw(8) << "frame"
+        << std::setw(18) << "screen"
+        << "state" << '\n';
+
+    for(const auto& res : results)
+    {
+        for(const auto& c : res.m_checkpoints)
+        {
+            out << "  " << std::left << std::dec
+                << std::setw(14) << res.m_name
+                << std::setw(8) << c.m_frame
+                << std::hex << std::setfill('0') << std::right
+                << std::setw(16) << c.m_screen << "  "
+                << std::setw(16) << c.m_state
+                << std::setfill(' ') << std::dec << '\n';
+        }
+    }
+}
+
+std::vector<regress::result> regress::read_golden(std::istream& in)
+{
+    std::vector<result> results;
+    std::unordered_map<std::string, std::size_t> index;
+    std::string line;
+
+    while(std::getline(in, line))
+    {
+        // skip the header and blank lines
+        auto first = line.find_first_not_of(" \t");
+        if(first == std::string::npos || line[first] == '#') continue;
+
+        std::stringstream fields(line);
+        std::string name;
+        checkpoint c;
+
+        if(!(fields >> name >> std::dec >> c.m_frame >> std::hex >> c.m_screen >> c.m_state)) continue;
+
+        auto [it, inserted] = index.try_emplace(name, results.size());
+        if(inserted) results.push_back({ name, {}, 0, 0.0 });
+
+        results[it->second].m_checkpoints.push_back(c);
+    }
+
+    return results;
+}
+
+std::size_t regress::compare(const std::vector<result>& golden, const std::vector<result>& results,
+                             std::ostream& out)
+{
+    std::unordered_map<std::string, const result*> golden_by_name;
+
+    for(const auto& res : golden)
+    {
+        golden_by_name[res.m_name] = &res;
+    }
+
+    std::size_t failures = 0;
+
+    for(const auto& res : results)
+    {
+        out << std::left << std::dec << std::setw(6);
+
+        if(!golden_by_name.count(res.m_name))
+        {
+            out << "NEW" << std::setw(14) << res.m_name << "no golden checkpoints" << '\n';
+            failures++;
+            continue;
+        }
+
+        const auto& expected = golden_by_name.at(res.m_name)->m_checkpoints;
+        std::string failure;
+
+        // the first checkpoint that differs is where it went a different way, the rest follow from it
+        for(std::size_t n = 0; n < std::min(expected.size(), res.m_checkpoints.size()) && failure.empty(); n++)
+        {
+            const checkpoint& want = expected[n];
+            const checkpoint& got = res.m_checkpoints[n];
+
+            if(want.m_frame != got.m_frame)
+            {
+                failure = "checkpoint at frame " + std::to_string(got.m_frame)
+                          + ", golden at " + std::to_string(want.m_frame);
+            }
+            else if(want.m_screen != got.m_screen)
+            {
+                failure = "screen differs at frame " + std::to_string(got.m_frame);
+            }
+            else if(want.m_state != got.m_state)
+            {
+                failure = "state differs at frame " + std::to_string(got.m_frame);
+            }
+        }
+
+        if(failure.empty() && expected.size() != res.m_checkpoints.size())
+        {
+            failure = std::to_string(res.m_checkpoints.size()) + " checkpoints, golden has "
+                      + std::to_string(expected.size());
+        }
+
+        if(!failure.empty())
+        {
+            out << "FAIL" << std::setw(14) << res.m_name << failure << '\n';
+            failures++;
+            continue;
+        }
+
+        out << "ok" << std::setw(14) << res.m_name
+            << std::setw(8) << (res.m_checkpoints.empty() ? 0 : res.m_checkpoints.back().m_frame) << "frames "
+            << std::fixed << std::setprecision(1) << res.m_seconds * 1000.0 << " ms" << '\n';
+    }
+
+    return failures;
+}
+
+}
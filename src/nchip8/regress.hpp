@@ -0,0 +1,92 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_REGRESS_HPP
+#define NCHIP8_REGRESS_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+#include "movie.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Golden-frame regression suite: ROMs ran headless in virtual time, with a movie for their keys,
+//!         whose framebuffer and state hashes at checkpoints have to match the ones of a known good build
+//! @details A run only depends on the ROM, the quirks, the seed, the frame length and the movie (see movie),
+//!          so any change of a hash is a change of behaviour. The cases run concurrently, one per thread at a time.
+//!
+//!          Manifest, one case per line (# comments):
+//!              <name> <rom> [frames=<n>] [cycles=<per frame>] [quirks=<profile>] [seed=<n>] [every=<frames>]
+//!                           [movie=<path>]
+//!          rom is a path relative to the manifest, or builtin:<name> for a ROM of bench::builtin_corpus.
+//!          A movie sets the quirks, the seed and the frame length, and its frames unless frames= is given.
+//!
+//!          Golden file, one checkpoint per line: <name> <frame> <screen hash> <state hash> (hex)
+class regress
+{
+public:
+    struct test_case
+    {
+        std::string m_name;
+        std::vector<std::uint8_t> m_rom;
+        quirk_profile m_quirks = quirk_profile::nchip8;
+        std::uint64_t m_seed = 0;
+        std::uint32_t m_cycles_per_frame = 1000;
+        std::uint32_t m_frames = 600;
+        std::uint32_t m_every = 60;             //! Frames between checkpoints, the last frame is one too
+        std::optional<movie> m_movie;           //! The keys, none are pressed without one
+    };
+
+    //! @brief The hashes of a case after a frame
+    struct checkpoint
+    {
+        std::uint32_t m_frame = 0;
+        std::uint64_t m_screen = 0;     //! Hash of the framebuffer
+        std::uint64_t m_state = 0;      //! Hash of the save state (RAM, registers, timers, screen, ...)
+    };
+
+    struct result
+    {
+        std::string m_name;
+        std::vector<checkpoint> m_checkpoints;
+        std::uint64_t m_instructions = 0;
+        double m_seconds = 0.0;
+    };
+
+    //! @brief          Parses a manifest
+    //! @param base     Directory the ROM and movie paths are relative to
+    //! @throws         std::invalid_argument on a malformed line or a file that does not load
+    static std::vector<test_case> read_manifest(std::istream& in, const std::string& base);
+
+    //! @brief  Every ROM of bench::builtin_corpus for the default frames, no keys
+    static std::vector<test_case> builtin_manifest();
+
+    //! @brief  Runs a case and hashes its checkpoints, none if its ROM does not fit the RAM
+    static result run_case(const test_case& test);
+
+    //! @brief          Runs every case, threads at a time (0 = every core)
+    //! @returns        The results in the order of the cases
+    static std::vector<result> run(const std::vector<test_case>& cases, const std::size_t& threads);
+
+    //! @brief  Writes the checkpoints of results as a golden file
+    static void write_golden(std::ostream& out, const std::vector<result>& results);
+
+    //! @brief  Parses a golden file (a result per case, without timings)
+    static std::vector<result> read_golden(std::istream& in);
+
+    //! @brief      Compares results against golden ones, a line per case
+    //! @returns    The number of cases that do not match (or have no golden checkpoints)
+    static std::size_t compare(const std::vector<result>& golden, const std::vector<result>& results,
+                               std::ostream& out);
+};
+
+}
+
+#endif //NCHIP8_REGRESS_HPP
@@ -0,0 +1,178 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "rewind_buffer.hpp"
+#include "rle.hpp"
+
+#include <algorithm>
+
+namespace nchip8
+{
+
+rewind_buffer::rewind_buffer(const std::size_t& budget, const std::size_t& keyframe_interval) :
+    m_budget(budget),
+    m_keyframe_interval(std::max<std::size_t>(keyframe_interval, 1))
+{
+
+}
+
+void rewind_buffer::clear()
+{
+    m_segments.clear();
+    m_keyframe.clear();
+    m_bytes = 0;
+    m_next_frame = 0;
+}
+
+// bytes a segment accounts for in the budget
+static std::size_t segment_bytes(const std::vector<std::uint8_t>& data, const std::vector<std::uint32_t>& offsets)
+{
+    return data.size() + (offsets.size() * sizeof(std::uint32_t));
+}
+
+void rewind_buffer::push(const cpu& chip8)
+{
+    chip8.save_state(m_state);
+
+    bool new_segment = m_segments.empty()
+                       || m_segments.back().m_offsets.size() >= m_keyframe_interval
+                       || m_state.size() != m_keyframe.size()
+                       || chip8.get_quirks() != m_segments.back().m_quirks;
+
+    if(new_segment)
+    {
+        // the finished segment won't grow anymore, give back the slack of its vectors
+        if(!m_segments.empty())
+        {
+            m_segments.back().m_data.shrink_to_fit();
+            m_segments.back().m_offsets.shrink_to_fit();
+        }
+
+        m_segments.push_back({ {}, {}, m_next_frame, m_state.size(), chip8.get_quirks() });
+        m_keyframe = m_state;
+    }
+
+    segment& seg = m_segments.back();
+    std::size_t before = segment_bytes(seg.m_data, seg.m_offsets);
+
+    seg.m_offsets.push_back(static_cast<std::uint32_t>(seg.m_data.size()));
+
+    if(new_segment)
+    {
+        rle_encode(m_state.data(), m_state.size(), seg.m_data);
+    }
+    else
+    {
+        // unchanged bytes XOR to zero, which run-length encodes to almost nothing
+        m_delta.resize(m_state.size());
+        for(std::size_t i = 0; i < m_state.size(); i++) m_delta[i] = m_state[i] ^ m_keyframe[i];
+
+        rle_encode(m_delta.data(), m_delta.size(), seg.m_data);
+    }
+
+    m_bytes += segment_bytes(seg.m_data, seg.m_offsets) - before;
+    m_next_frame++;
+
+    // drop whole segments from the front, their deltas are useless without the keyframe
+    while(m_bytes > m_budget && m_segments.size() > 1)
+    {
+        m_bytes -= segment_bytes(m_segments.front().m_data, m_segments.front().m_offsets);
+        m_segments.pop_front();
+    }
+}
+
+bool rewind_buffer::decode_frame(const segment& seg, const std::size_t& index)
+{
+    auto frame_end = [&seg](const std::size_t& i)
+    {
+        return (i + 1 < seg.m_offsets.size()) ? seg.m_offsets[i + 1] : seg.m_data.size();
+    };
+
+    const std::uint8_t* data = seg.m_data.data();
+
+    const std::size_t state_size = seg.m_state_size;
+    m_state.resize(state_size);
+
+    if(!rle_decode(data, frame_end(0), m_state.data(), state_size)) return false;
+
+    if(index == 0) return true;
+
+    m_delta.resize(state_size);
+
+    if(!rle_decode(data + seg.m_offsets[index], frame_end(index) - seg.m_offsets[index], m_delta.data(), state_size))
+    {
+        return false;
+    }
+
+    for(std::size_t i = 0; i < state_size; i++) m_state[i] ^= m_delta[i];
+
+    return true;
+}
+
+std::size_t rewind_buffer::rewind(cpu& chip8, const std::size_t& frames)
+{
+    std::size_t total = get_frames();
+
+    if(total == 0) return 0;
+
+    std::size_t back = std::min(frames, total - 1);
+    std::uint64_t target = m_next_frame - 1 - back;
+
+    // the last segment that starts at or before the target, segments can be short so they are searched by frame
+    auto next = std::upper_bound(m_segments.begin(), m_segments.end(), target,
+                                 [](const std::uint64_t& frame, const segment& s) { return frame < s.m_first_frame; });
+
+    if(next == m_segments.begin()) return 0;
+
+    std::size_t segment_index = (next - m_segments.begin()) - 1;
+    segment& seg = m_segments[segment_index];
+
+    std::size_t frame_index = target - seg.m_first_frame;
+    if(frame_index >= seg.m_offsets.size()) return 0;
+
+    if(!decode_frame(seg, frame_index)) return 0;
+
+    // the state only loads into a cpu with the RAM size of its profile, and runs on with that profile
+    if(chip8.get_quirks() != seg.m_quirks) chip8.set_quirks(seg.m_quirks);
+    if(!chip8.load_state(m_state)) return 0;
+
+    // the target is now the newest frame, its segment becomes the one new frames are added to
+    while(m_segments.size() > segment_index + 1)
+    {
+        m_bytes -= segment_bytes(m_segments.back().m_data, m_segments.back().m_offsets);
+        m_segments.pop_back();
+    }
+
+    std::size_t before = segment_bytes(seg.m_data, seg.m_offsets);
+
+    if(frame_index + 1 < seg.m_offsets.size())
+    {
+        seg.m_data.resize(seg.m_offsets[frame_index + 1]);
+        seg.m_offsets.resize(frame_index + 1);
+    }
+
+    m_bytes -= before - segment_bytes(seg.m_data, seg.m_offsets);
+    m_next_frame = target + 1;
+
+    // deltas of new frames are taken against this segment's keyframe
+    m_keyframe.resize(seg.m_state_size);
+    rle_decode(seg.m_data.data(), (seg.m_offsets.size() > 1) ? seg.m_offsets[1] : seg.m_data.size(),
+               m_keyframe.data(), m_keyframe.size());
+
+    return back;
+}
+
+std::size_t rewind_buffer::get_frames() const
+{
+    if(m_segments.empty()) return 0;
+
+    return m_next_frame - m_segments.front().m_first_frame;
+}
+
+std::size_t rewind_buffer::get_bytes() const
+{
+    return m_bytes;
+}
+
+}
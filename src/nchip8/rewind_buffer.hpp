@@ -0,0 +1,88 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_REWIND_BUFFER_HPP
+#define NCHIP8_REWIND_BUFFER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  History of per-frame cpu states in a bounded memory budget
+//! @details States are grouped in segments of keyframe_interval frames (a segment ends early when the quirk
+//!          profile, and so the size of the state, changes). The first frame of a segment
+//!          (the keyframe) is stored run-length encoded, every other frame as the run-length encoded XOR
+//!          of its state against the keyframe. Between two frames little more than the registers change,
+//!          so a delta is a few dozen bytes. Restoring any frame decodes at most a keyframe and one delta,
+//!          so seeking takes the same time however far back it goes.
+//!          When the budget is exceeded the oldest segment is dropped.
+class rewind_buffer
+{
+public:
+    //! @brief                      Constructor
+    //! @param budget               Maximum bytes of encoded history (the newest segment is always kept)
+    //! @param keyframe_interval    Frames per segment, i.e. one keyframe every this many frames
+    explicit rewind_buffer(const std::size_t& budget = 4 * 1024 * 1024,
+                           const std::size_t& keyframe_interval = 60);
+
+    //! @brief  Drops the whole history
+    void clear();
+
+    //! @brief  Records the current state of the cpu as the newest frame
+    void push(const cpu& chip8);
+
+    //! @brief          Restores the state of frames ago, the newer frames are dropped
+    //! @details        The cpu is switched back to the quirk profile the frame was recorded with
+    //! @param frames   How many frames to go back, clamped to the oldest frame (0 = newest frame)
+    //! @returns        The number of frames actually gone back, 0 if the history is empty
+    std::size_t rewind(cpu& chip8, const std::size_t& frames);
+
+    //! @brief  Number of frames in the history
+    std::size_t get_frames() const;
+
+    //! @brief  Bytes used by the encoded history
+    std::size_t get_bytes() const;
+
+private:
+    //! A keyframe and the deltas against it, in one allocation
+    struct segment
+    {
+        std::vector<std::uint8_t> m_data;       //! The encoded frames back to back
+        std::vector<std::uint32_t> m_offsets;   //! Start of each frame in m_data
+        std::uint64_t m_first_frame;            //! Number of its keyframe, counted from the last clear
+        std::size_t m_state_size;               //! Bytes of each decoded state
+        quirk_profile m_quirks;                 //! Profile of the cpu its frames were recorded from
+    };
+
+    std::size_t m_budget;
+    std::size_t m_keyframe_interval;
+
+    //! Oldest segment first, a segment holds at most m_keyframe_interval frames
+    std::deque<segment> m_segments;
+
+    //! Number the next frame pushed gets
+    std::uint64_t m_next_frame = 0;
+
+    //! Encoded bytes in all segments
+    std::size_t m_bytes = 0;
+
+    //! The decoded keyframe of the newest segment, deltas are taken against it
+    std::vector<std::uint8_t> m_keyframe;
+
+    //! Scratch buffers, kept around so pushing a frame does not allocate
+    std::vector<std::uint8_t> m_state;
+    std::vector<std::uint8_t> m_delta;
+
+    //! @brief  Decodes frame index of a segment into m_state
+    bool decode_frame(const segment& seg, const std::size_t& index);
+};
+
+}
+
+#endif //NCHIP8_REWIND_BUFFER_HPP
@@ -0,0 +1,74 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "rle.hpp"
+
+#include <cstring>
+
+namespace nchip8
+{
+
+void rle_encode(const std::uint8_t* in, const std::size_t& size, std::vector<std::uint8_t>& out)
+{
+    std::size_t i = 0;
+
+    while(i < size)
+    {
+        // measure the run at i
+        std::size_t run = 1;
+        while(i + run < size && run < 130 && in[i + run] == in[i]) run++;
+
+        if(run >= 3)
+        {
+            out.push_back(static_cast<std::uint8_t>(run + 125));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+
+        // literals until the next run of 3 or the literal limit
+        std::size_t start = i;
+        while(i < size && (i - start) < 128)
+        {
+            if(i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2]) break;
+            i++;
+        }
+
+        out.push_back(static_cast<std::uint8_t>(i - start - 1));
+        out.insert(out.end(), in + start, in + i);
+    }
+}
+
+bool rle_decode(const std::uint8_t* in, const std::size_t& size, std::uint8_t* out, const std::size_t& out_size)
+{
+    std::size_t i = 0;
+    std::size_t o = 0;
+
+    while(i < size)
+    {
+        std::uint8_t control = in[i++];
+
+        if(control < 128)
+        {
+            std::size_t count = control + 1;
+            if(i + count > size || o + count > out_size) return false;
+
+            std::memcpy(out + o, in + i, count);
+            i += count;
+            o += count;
+        }
+        else
+        {
+            std::size_t count = control - 125;
+            if(i >= size || o + count > out_size) return false;
+
+            std::memset(out + o, in[i++], count);
+            o += count;
+        }
+    }
+
+    return o == out_size;
+}
+
+}
@@ -0,0 +1,27 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_RLE_HPP
+#define NCHIP8_RLE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace nchip8
+{
+
+//! @brief  PackBits style run-length encoding, used by save states and the rewind buffer
+//! @details A control byte c < 128 is followed by c+1 literal bytes,
+//!          c >= 128 is followed by one byte repeated c-125 times (3-130)
+
+//! @brief      Encodes size bytes of in, appending them to out
+void rle_encode(const std::uint8_t* in, const std::size_t& size, std::vector<std::uint8_t>& out);
+
+//! @brief      Decodes size bytes of in into exactly out_size bytes of out
+//! @returns    false if the data is malformed or does not decode to exactly out_size bytes
+bool rle_decode(const std::uint8_t* in, const std::size_t& size, std::uint8_t* out, const std::size_t& out_size);
+
+}
+
+#endif //NCHIP8_RLE_HPP
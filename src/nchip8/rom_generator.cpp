@@ -0,0 +1,371 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "rom_generator.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace nchip8
+{
+
+// scratch memory used by the memory, bcd and draw units, past the end of any generated rom
+static constexpr std::uint16_t scratch_address = 0xE00;
+
+// load_rom accepts roms smaller than 0xE00 bytes, in instructions
+static constexpr std::size_t max_words = (0xE00 / 2) - 1;
+
+// the stack has 16 entries
+static constexpr std::size_t max_call_depth = 16;
+
+rom_generator::rom_generator(const params& p) :
+    m_params(p),
+    m_random(p.m_seed)
+{
+
+}
+
+std::uint16_t rom_generator::encode(const cpu::op_handler& handler, const std::uint16_t& operands)
+{
+    std::uint16_t instruction = 0;
+
+    // fixed nibbles come from the encoding, operand data (std::nullopt) from the operands
+    for(int i = 0; i < 4; i++)
+    {
+        int shift = (3 - i) * 4;
+        const auto& nibble = handler.m_encoding[i];
+
+        instruction |= (nibble.has_value() ? nibble.value() : ((operands >> shift) & 0xF)) << shift;
+    }
+
+    return instruction;
+}
+
+std::size_t rom_generator::emit(const cpu::op_handler& handler, const std::uint16_t& operands)
+{
+    m_program.push_back(encode(handler, operands));
+    return m_program.size() - 1;
+}
+
+std::uint16_t rom_generator::next_address() const
+{
+    return 0x200 + (m_program.size() * 2);
+}
+
+// the standard distributions are implementation defined,
+// stick to the raw engine so a seed generates the same rom everywhere
+unsigned rom_generator::random(const unsigned& lo, const unsigned& hi)
+{
+    return lo + (m_random() % (hi - lo + 1));
+}
+
+bool rom_generator::chance(const double& p)
+{
+    return (m_random() / static_cast<double>(std::mt19937::max())) < p;
+}
+
+std::uint16_t rom_generator::random_reg()
+{
+    return random(0x0, 0xE);
+}
+
+// operand layout helpers, 0x0XKK, 0x0XY0, 0x0XYN
+static std::uint16_t xkk(const std::uint16_t& x, const std::uint16_t& kk) { return (x << 8) | (kk & 0xFF); }
+static std::uint16_t xy(const std::uint16_t& x, const std::uint16_t& y) { return (x << 8) | (y << 4); }
+static std::uint16_t xyn(const std::uint16_t& x, const std::uint16_t& y, const std::uint16_t& n)
+{
+    return (x << 8) | (y << 4) | n;
+}
+
+std::vector<std::uint8_t> rom_generator::generate()
+{
+    m_random.seed(m_params.m_seed);
+    m_program.clear();
+    m_call_fixups.clear();
+    m_patch_slots.clear();
+
+    std::size_t depth = std::clamp<std::size_t>(m_params.m_call_depth, 1, max_call_depth);
+
+    // each subroutine is at most 3 instructions, plus the jump back to the start of the body
+    std::size_t body_limit = max_words - (depth * 3) - 1;
+
+    unsigned total_weight = std::accumulate(m_params.m_mix.begin(), m_params.m_mix.end(), 0u);
+
+    for(std::size_t unit = 0; unit < m_params.m_length; unit++)
+    {
+        // the largest unit is 5 instructions, with a branch in front of it
+        if(m_program.size() + 6 > body_limit) break;
+
+        if(!m_patch_slots.empty() && chance(m_params.m_self_modify_rate))
+        {
+            emit_self_modify();
+            continue;
+        }
+
+        // weighted pick of the family
+        family f = family::alu;
+
+        if(total_weight > 0)
+        {
+            unsigned pick = random(0, total_weight - 1);
+
+            for(std::uint8_t i = 0; i < _family_count; i++)
+            {
+                if(pick < m_params.m_mix[i]) { f = static_cast<family>(i); break; }
+                pick -= m_params.m_mix[i];
+            }
+        }
+
+        if(chance(m_params.m_branch_density))
+        {
+            if(chance(0.5))
+            {
+                // conditional skip, these only skip one instruction so the unit must be an alu one
+                switch(random(0, 3))
+                {
+                    case 0: emit(cpu::SE_VX_KK<quirks::nchip8>, xkk(random_reg(), random(0, 255))); break;
+                    case 1: emit(cpu::SNE_VX_KK<quirks::nchip8>, xkk(random_reg(), random(0, 255))); break;
+                    case 2: emit(cpu::SE_VX_VY<quirks::nchip8>, xy(random_reg(), random_reg())); break;
+                    default: emit(cpu::SNE_VX_VY<quirks::nchip8>, xy(random_reg(), random_reg())); break;
+                }
+
+                emit_alu();
+                continue;
+            }
+
+            // jump over the unit, the target is only known once the unit is emitted
+            std::size_t jump = emit(cpu::JP);
+            emit_unit(f);
+            m_program[jump] = encode(cpu::JP, next_address());
+            continue;
+        }
+
+        emit_unit(f);
+    }
+
+    // loop forever
+    emit(cpu::JP, 0x200);
+
+    // every call unit enters the start of the chain
+    std::uint16_t chain_address = next_address();
+    emit_subroutine_chain();
+
+    for(auto index : m_call_fixups)
+    {
+        m_program[index] = encode(cpu::CALL, chain_address);
+    }
+
+    // big endian, like any other rom
+    std::vector<std::uint8_t> rom;
+    rom.reserve(m_program.size() * 2);
+
+    for(auto word : m_program)
+    {
+        rom.push_back(word >> 8);
+        rom.push_back(word & 0x00FF);
+    }
+
+    return rom;
+}
+
+void rom_generator::emit_unit(const family& f)
+{
+    switch(f)
+    {
+        case family::alu:    emit_alu(); break;
+        case family::draw:   emit_draw(); break;
+        case family::call:   emit_call(); break;
+        case family::memory: emit_memory(); break;
+        case family::bcd:    emit_bcd(); break;
+        case family::rnd:    emit_rnd(); break;
+        case family::timer:  emit_timer(); break;
+        default: break;
+    }
+}
+
+void rom_generator::emit_alu()
+{
+    std::uint16_t x = random_reg();
+    std::uint16_t y = random_reg();
+
+    switch(random(0, 10))
+    {
+        case 0:
+            // remember it, self modifying units rewrite these
+            m_patch_slots.push_back(next_address());
+            emit(cpu::LD_VX_KK, xkk(x, random(0, 255)));
+            break;
+        case 1: emit(cpu::ADD_VX_KK, xkk(x, random(0, 255))); break;
+        case 2: emit(cpu::LD_VX_VY, xy(x, y)); break;
+        case 3: emit(cpu::OR_VX_VY, xy(x, y)); break;
+        case 4: emit(cpu::AND_VX_VY, xy(x, y)); break;
+        case 5: emit(cpu::XOR_VX_VY, xy(x, y)); break;
+        case 6: emit(cpu::ADD_VX_VY, xy(x, y)); break;
+        case 7: emit(cpu::SUB_VX_VY, xy(x, y)); break;
+        case 8: emit(cpu::SHR_VX_VY<quirks::nchip8>, xy(x, y)); break;
+        case 9: emit(cpu::SUBN_VX_VY, xy(x, y)); break;
+        default: emit(cpu::SHL_VX_VY<quirks::nchip8>, xy(x, y)); break;
+    }
+}
+
+void rom_generator::emit_draw()
+{
+    std::uint16_t x = random_reg();
+    std::uint16_t y = random_reg();
+
+    // keep sprites in one corner of the screen, so they mostly overlap and collide
+    emit(cpu::LD_VX_KK, xkk(x, random(0, 15)));
+    emit(cpu::LD_VX_KK, xkk(y, random(0, 7)));
+
+    if(chance(0.5))
+    {
+        emit(cpu::LD_F_VX, xkk(random_reg(), 0));
+    }
+    else
+    {
+        emit(cpu::LD_I_NNN, scratch_address + random(0, 0xF0));
+    }
+
+    emit(cpu::DRW_VX_VY_N<quirks::nchip8>, xyn(x, y, random(1, 15)));
+}
+
+void rom_generator::emit_call()
+{
+    m_call_fixups.push_back(emit(cpu::CALL));
+}
+
+void rom_generator::emit_memory()
+{
+    emit(cpu::LD_I_NNN, scratch_address + random(0, 0xF0));
+
+    // a burst of up to the whole register file in each direction
+    if(chance(0.5))
+    {
+        emit(cpu::LD_imm_I_VX<quirks::nchip8>, xkk(random(0, 0xF), 0));
+        emit(cpu::LD_VX_imm_I<quirks::nchip8>, xkk(random(0, 0xF), 0));
+    }
+    else
+    {
+        emit(cpu::LD_VX_imm_I<quirks::nchip8>, xkk(random(0, 0xF), 0));
+        emit(cpu::LD_imm_I_VX<quirks::nchip8>, xkk(random(0, 0xF), 0));
+    }
+}
+
+void rom_generator::emit_bcd()
+{
+    emit(cpu::LD_I_NNN, scratch_address + random(0, 0xFC));
+    emit(cpu::LD_B_VX, xkk(random_reg(), 0));
+}
+
+void rom_generator::emit_rnd()
+{
+    emit(cpu::RND_VX_KK, xkk(random_reg(), random(0, 255)));
+}
+
+void rom_generator::emit_timer()
+{
+    switch(random(0, 2))
+    {
+        case 0: emit(cpu::LD_DT_VX, xkk(random_reg(), 0)); break;
+        case 1: emit(cpu::LD_VX_DT, xkk(random_reg(), 0)); break;
+        default: emit(cpu::LD_ST_VX, xkk(random_reg(), 0)); break;
+    }
+}
+
+void rom_generator::emit_self_modify()
+{
+    std::uint16_t slot = m_patch_slots.at(random(0, m_patch_slots.size() - 1));
+
+    // build a new LD Vx, kk in V0 and V1, and store it over the slot
+    std::uint16_t patch = encode(cpu::LD_VX_KK, xkk(random_reg(), random(0, 255)));
+
+    emit(cpu::LD_VX_KK, xkk(0x0, patch >> 8));
+    emit(cpu::LD_VX_KK, xkk(0x1, patch & 0xFF));
+    emit(cpu::LD_I_NNN, slot);
+    emit(cpu::LD_imm_I_VX<quirks::nchip8>, xkk(0x1, 0));
+}
+
+void rom_generator::emit_subroutine_chain()
+{
+    std::size_t depth = std::clamp<std::size_t>(m_params.m_call_depth, 1, max_call_depth);
+
+    // every subroutine does some work, calls the next one and returns
+    for(std::size_t level = 0; level < depth; level++)
+    {
+        emit(cpu::ADD_VX_KK, xkk(random_reg(), 1));
+
+        if(level + 1 < depth)
+        {
+            // the next subroutine starts after this CALL and the RET
+            emit(cpu::CALL, next_address() + 4);
+        }
+
+        emit(cpu::RET);
+    }
+}
+
+std::optional<rom_generator::params> rom_generator::preset(const std::string& name)
+{
+    params p;
+
+    //                 alu draw call memory bcd rnd timer
+    if(name == "mixed")
+    {
+        return p;
+    }
+
+    if(name == "alu")
+    {
+        p.m_mix = {{ 1, 0, 0, 0, 0, 0, 0 }};
+        return p;
+    }
+
+    if(name == "draw")
+    {
+        p.m_mix = {{ 1, 8, 0, 0, 0, 0, 0 }};
+        p.m_branch_density = 0.05;
+        return p;
+    }
+
+    if(name == "call")
+    {
+        p.m_mix = {{ 1, 0, 6, 0, 0, 0, 0 }};
+        p.m_call_depth = max_call_depth;
+        return p;
+    }
+
+    if(name == "memory")
+    {
+        p.m_mix = {{ 1, 0, 0, 8, 0, 0, 0 }};
+        return p;
+    }
+
+    if(name == "bcd")
+    {
+        p.m_mix = {{ 1, 0, 0, 0, 8, 0, 0 }};
+        return p;
+    }
+
+    if(name == "branchy")
+    {
+        p.m_branch_density = 0.5;
+        return p;
+    }
+
+    if(name == "selfmod")
+    {
+        p.m_mix = {{ 4, 0, 0, 1, 0, 0, 0 }};
+        p.m_self_modify_rate = 0.2;
+        return p;
+    }
+
+    return std::nullopt;
+}
+
+std::vector<std::string> rom_generator::preset_names()
+{
+    return { "mixed", "alu", "draw", "call", "memory", "bcd", "branchy", "selfmod" };
+}
+
+}
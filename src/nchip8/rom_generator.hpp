@@ -0,0 +1,125 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_ROM_GENERATOR_HPP
+#define NCHIP8_ROM_GENERATOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  Emits synthetic CHIP-8 programs with a chosen instruction mix,
+//!         used to stress a single engine path in benchmark and fuzz runs
+//! @details Instructions are built from the m_encoding of the cpu op_handlers,
+//!          so the generator can only emit what the cpu can decode.
+//!          Generated programs are an endless loop over a body of "units"
+//!          (short instruction sequences), followed by a chain of nested subroutines
+//!          and use 0xE00-0xEFF as scratch memory.
+class rom_generator
+{
+public:
+    //! @brief The kinds of units the body of a program is made from
+    enum family : std::uint8_t
+    {
+        alu,        //! 6xkk, 7xkk, 8xy0-8xyE
+        draw,       //! LD F/LD I + DRW, sprites overlap so collisions are frequent
+        call,       //! CALL into a chain of nested subroutines
+        memory,     //! Fx55/Fx65 bursts over the scratch area
+        bcd,        //! Fx33 into the scratch area
+        rnd,        //! Cxkk
+        timer,      //! Fx15/Fx07/Fx18
+        _family_count // keep at end of enum
+    };
+
+    //! @brief The shape of a generated program
+    struct params
+    {
+        //! Relative weight of each family in the body, indexed by family
+        std::array<unsigned, _family_count> m_mix {{ 1, 1, 1, 1, 1, 1, 1 }};
+
+        //! Chance (0-1) that a unit is preceded by a conditional skip or jumped over
+        double m_branch_density = 0.1;
+
+        //! Chance (0-1) that a unit rewrites an instruction in the body (a LD Vx, kk)
+        double m_self_modify_rate = 0.0;
+
+        //! Depth of the subroutine chain that call units enter (max 16, the size of the stack)
+        std::size_t m_call_depth = 4;
+
+        //! Number of units in the body
+        std::size_t m_length = 256;
+
+        //! Seed, the same params always generate the same program
+        std::uint32_t m_seed = 0;
+    };
+
+    //! @brief Constructor
+    explicit rom_generator(const params& p);
+
+    //! @brief      Generates a program
+    //! @returns    ROM data to be loaded at 0x200
+    std::vector<std::uint8_t> generate();
+
+    //! @brief      Returns the params of a named preset (e.g. "draw", "call", "mixed")
+    static std::optional<params> preset(const std::string& name);
+
+    //! @brief      Names of all presets
+    static std::vector<std::string> preset_names();
+
+private:
+    params m_params;
+    std::mt19937 m_random;
+
+    //! Program being generated, instruction i lives at 0x200 + 2*i
+    std::vector<std::uint16_t> m_program;
+
+    //! Indices of CALL instructions that still need the address of the subroutine chain
+    std::vector<std::size_t> m_call_fixups;
+
+    //! Addresses of LD Vx, kk instructions that self-modifying units may rewrite
+    std::vector<std::uint16_t> m_patch_slots;
+
+    //! @brief          Builds an instruction from the encoding of an op_handler
+    //! @param handler  One of the static cpu op_handlers
+    //! @param operands The operand nibbles, in the positions of the instruction (e.g. 0x0XKK)
+    static std::uint16_t encode(const cpu::op_handler& handler, const std::uint16_t& operands);
+
+    //! @brief Appends an instruction and returns its index
+    std::size_t emit(const cpu::op_handler& handler, const std::uint16_t& operands = 0);
+
+    //! @brief Address the next emitted instruction will have
+    std::uint16_t next_address() const;
+
+    //! @brief Random integer in [lo, hi]
+    unsigned random(const unsigned& lo, const unsigned& hi);
+
+    //! @brief Random chance of probability p
+    bool chance(const double& p);
+
+    //! @brief Random general purpose register, VF is left alone as it is the flag register
+    std::uint16_t random_reg();
+
+    void emit_unit(const family& f);
+    void emit_alu();
+    void emit_draw();
+    void emit_call();
+    void emit_memory();
+    void emit_bcd();
+    void emit_rnd();
+    void emit_timer();
+    void emit_self_modify();
+    void emit_subroutine_chain();
+};
+
+}
+
+#endif //NCHIP8_ROM_GENERATOR_HPP
@@ -0,0 +1,569 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "quirks.hpp"
+
+namespace nchip8
+{
+
+namespace
+{
+
+std::runtime_error system_error(const std::string& what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+sockaddr_un socket_address(const std::string& path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if(path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path " + path + " is too long!");
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    return address;
+}
+
+//! @brief  Resident set size of the process, in KB
+std::size_t resident_kb()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size = 0, resident = 0;
+
+    statm >> size >> resident;
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+//! @brief  Blocks SIGINT and SIGTERM and returns a signalfd for them
+//! @details Before the worker pool starts, its threads inherit the mask so the signals only reach the signalfd
+int stop_signal_fd()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    int fd = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(fd < 0) throw system_error("signalfd");
+
+    return fd;
+}
+
+}
+
+server::server(const params& p) :
+    m_params(p),
+    m_signal_fd(stop_signal_fd()),
+    m_pool(p.m_threads)
+{
+    auto address = socket_address(m_params.m_socket);
+
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_listen_fd < 0) throw system_error("socket");
+
+    // a socket left by a server that died is removed, one that still answers is not
+    if(::connect(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+    {
+        ::close(m_listen_fd);
+        throw std::runtime_error("A server is already listening on " + m_params.m_socket + "!");
+    }
+
+    ::close(m_listen_fd);
+    ::unlink(m_params.m_socket.c_str());
+
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_listen_fd < 0) throw system_error("socket");
+
+    if(::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+       || ::listen(m_listen_fd, 64) < 0)
+    {
+        auto error = system_error(m_params.m_socket);
+        ::close(m_listen_fd);
+        throw error;
+    }
+
+    // the 60Hz tick
+    m_timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(m_timer_fd < 0) throw system_error("timerfd_create");
+
+    itimerspec period {};
+    period.it_interval.tv_nsec = 1000000000 / 60;
+    period.it_value = period.it_interval;
+    ::timerfd_settime(m_timer_fd, 0, &period, nullptr);
+
+    // a client that goes away mid write is an EPIPE, not the end of the server
+    std::signal(SIGPIPE, SIG_IGN);
+}
+
+server::~server()
+{
+    for(auto& c : m_clients) ::close(c->m_fd);
+
+    if(m_signal_fd >= 0) ::close(m_signal_fd);
+    if(m_timer_fd >= 0) ::close(m_timer_fd);
+
+    if(m_listen_fd >= 0)
+    {
+        ::close(m_listen_fd);
+        ::unlink(m_params.m_socket.c_str());
+    }
+}
+
+int server::run()
+{
+    std::cerr << "nchip8d: listening on " << m_params.m_socket << " with " << m_pool.get_threads() << " threads"
+              << std::endl;
+
+    std::vector<pollfd> fds;
+
+    for(;;)
+    {
+        fds.clear();
+        fds.push_back({ m_signal_fd, POLLIN, 0 });
+        fds.push_back({ m_timer_fd, POLLIN, 0 });
+        fds.push_back({ m_listen_fd, POLLIN, 0 });
+
+        for(auto& c : m_clients)
+        {
+            fds.push_back({ c->m_fd, static_cast<short>(POLLIN | (c->m_out.empty() ? 0 : POLLOUT)), 0 });
+        }
+
+        if(::poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            throw system_error("poll");
+        }
+
+        if(fds[0].revents & POLLIN)
+        {
+            signalfd_siginfo info {};
+            if(::read(m_signal_fd, &info, sizeof(info)) == sizeof(info))
+            {
+                std::cerr << "nchip8d: " << ::strsignal(info.ssi_signo) << ", " << m_sessions.size()
+                          << " sessions ended" << std::endl;
+            }
+
+            return 0;
+        }
+
+        // the clients first, their keys and requests land before the frame they were sent for
+        for(std::size_t i = 0; i < m_clients.size(); i++)
+        {
+            auto& c = *m_clients[i];
+            const auto& revents = fds[3 + i].revents;
+
+            if(revents & (POLLIN | POLLHUP | POLLERR)) read_client(c);
+            if((revents & POLLOUT) && !c.m_closed) flush_client(c);
+        }
+
+        if(fds[1].revents & POLLIN)
+        {
+            std::uint64_t expirations = 0;
+            if(::read(m_timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations)
+            {
+                m_late_ticks += expirations - 1;
+                tick();
+            }
+        }
+
+        if(fds[2].revents & POLLIN) accept_clients();
+
+        for(auto it = m_clients.begin(); it != m_clients.end();)
+        {
+            if((*it)->m_closed)
+            {
+                ::close((*it)->m_fd);
+                it = m_clients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+void server::accept_clients()
+{
+    for(;;)
+    {
+        int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) return;
+
+        auto c = std::make_unique<client>();
+        c->m_fd = fd;
+        m_clients.push_back(std::move(c));
+    }
+}
+
+void server::read_client(client& c)
+{
+    std::uint8_t buffer[4096];
+
+    for(;;)
+    {
+        auto got = ::recv(c.m_fd, buffer, sizeof(buffer), 0);
+
+        if(got > 0)
+        {
+            c.m_in.insert(c.m_in.end(), buffer, buffer + got);
+            continue;
+        }
+
+        if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if(got < 0 && errno == EINTR) continue;
+
+        // closed, whatever it sent last is still handled
+        c.m_closed = true;
+        break;
+    }
+
+    try
+    {
+        server_message msg;
+        while(server_message::decode(c.m_in, msg)) handle(c, msg);
+    }
+    catch(const std::length_error& e)
+    {
+        std::cerr << "nchip8d: dropped a client that sent a " << e.what() << std::endl;
+        c.m_closed = true;
+    }
+
+    if(!c.m_closed) flush_client(c);
+}
+
+void server::flush_client(client& c)
+{
+    std::size_t sent = 0;
+
+    while(sent < c.m_out.size())
+    {
+        auto wrote = ::send(c.m_fd, c.m_out.data() + sent, c.m_out.size() - sent, MSG_NOSIGNAL);
+
+        if(wrote > 0)
+        {
+            sent += wrote;
+            continue;
+        }
+
+        if(wrote < 0 && errno == EINTR) continue;
+        if(wrote < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+        c.m_closed = true;
+        break;
+    }
+
+    c.m_out.erase(c.m_out.begin(), c.m_out.begin() + sent);
+}
+
+void server::send(client& c, const server_message& msg)
+{
+    msg.encode(c.m_out);
+}
+
+void server::handle(client& c, const server_message& msg)
+{
+    switch(msg.m_type)
+    {
+        case server_message_type::Create:
+            handle_create(c, msg);
+            break;
+
+        case server_message_type::List:
+            send(c, server_message::text(server_message_type::Text, list_sessions()));
+            break;
+
+        case server_message_type::Attach:
+            if(auto* s = find_session(c, msg))
+            {
+                c.m_attached = s->get_id();
+                c.m_full = true;
+
+                server_message attached { server_message_type::Attached, {} };
+                attached.put_u32(s->get_id());
+                send(c, attached);
+
+                send_frame(c, *s);
+            }
+            break;
+
+        case server_message_type::Detach:
+            c.m_attached.reset();
+            send(c, server_message::text(server_message_type::Ok, "detached"));
+            break;
+
+        case server_message_type::Key:
+            if(!c.m_attached || msg.m_data.size() < 2)
+            {
+                send(c, server_message::text(server_message_type::Error, "Not attached!"));
+                break;
+            }
+
+            m_sessions.at(*c.m_attached)->set_key(msg.m_data[0], msg.m_data[1]);
+            break;
+
+        case server_message_type::Kill:
+            if(auto* s = find_session(c, msg))
+            {
+                const auto id = s->get_id();
+
+                std::cerr << "nchip8d: session " << id << " (" << s->get_name() << ") killed" << std::endl;
+
+                m_sessions.erase(id);
+                notify_attached(id, "killed", true);
+
+                send(c, server_message::text(server_message_type::Ok, "killed " + std::to_string(id)));
+            }
+            break;
+
+        case server_message_type::Pause:
+        case server_message_type::Resume:
+            if(auto* s = find_session(c, msg))
+            {
+                const bool resume = msg.m_type == server_message_type::Resume;
+
+                if(resume && s->get_state() == session::state::halted)
+                {
+                    send(c, server_message::text(server_message_type::Error, "Session has halted!"));
+                    break;
+                }
+
+                s->set_running(resume);
+                send(c, server_message::text(server_message_type::Ok, session::state_name(s->get_state())));
+            }
+            break;
+
+        default:
+            send(c, server_message::text(server_message_type::Error,
+                                         "Unknown request " + std::to_string(static_cast<int>(msg.m_type)) + "!"));
+            break;
+    }
+}
+
+void server::handle_create(client& c, const server_message& msg)
+{
+    // u8 quirks, u64 seed, u32 cycles, u8 name length
+    constexpr std::size_t fixed = 1 + 8 + 4 + 1;
+
+    const auto& data = msg.m_data;
+
+    if(data.size() < fixed || data.size() < fixed + data[13])
+    {
+        send(c, server_message::text(server_message_type::Error, "Malformed Create!"));
+        return;
+    }
+
+    if(data[0] >= static_cast<std::uint8_t>(quirk_profile::_last))
+    {
+        send(c, server_message::text(server_message_type::Error, "Unknown quirk profile!"));
+        return;
+    }
+
+    if(m_sessions.size() >= m_params.m_max_sessions)
+    {
+        send(c, server_message::text(server_message_type::Error,
+                                     "Server is full (" + std::to_string(m_params.m_max_sessions) + " sessions)!"));
+        return;
+    }
+
+    const auto quirks = static_cast<quirk_profile>(data[0]);
+    const auto seed = msg.get_u64(1);
+
+    auto cycles = msg.get_u32(9);
+    if(cycles == 0) cycles = m_params.m_default_cycles;
+    cycles = std::min(cycles, m_params.m_max_cycles);
+
+    std::string name(data.begin() + fixed, data.begin() + fixed + data[13]);
+    std::vector<std::uint8_t> rom(data.begin() + fixed + data[13], data.end());
+
+    const auto id = m_next_id;
+    auto s = std::make_unique<session>(id, name.empty() ? "session" : name, cycles);
+
+    if(!s->load(rom, quirks, seed))
+    {
+        send(c, server_message::text(server_message_type::Error, "ROM does not fit in RAM!"));
+        return;
+    }
+
+    m_next_id++;
+
+    std::cerr << "nchip8d: session " << id << " (" << s->get_name() << ", " << quirk_profile_name(quirks) << ", "
+              << cycles << " cycles/frame) created" << std::endl;
+
+    m_sessions.emplace(id, std::move(s));
+
+    server_message created { server_message_type::Created, {} };
+    created.put_u32(id);
+    send(c, created);
+}
+
+std::string server::list_sessions() const
+{
+    std::size_t attached = 0;
+    for(auto& c : m_clients) attached += c->m_attached.has_value();
+
+    std::ostringstream out;
+
+    out << m_sessions.size() << " sessions, " << m_clients.size() << " clients (" << attached << " attached), "
+        << m_pool.get_threads() << " threads, " << m_late_ticks << " ticks skipped, RSS " << resident_kb() << " KB\n";
+
+    out << std::setw(5) << "id" << "  " << std::left << std::setw(20) << "name" << std::setw(10) << "state"
+        << std::right << std::setw(10) << "frames" << std::setw(8) << "cycles" << std::setw(10) << "us/frame"
+        << std::setw(10) << "state KB" << "\n";
+
+    for(auto& [id, s] : m_sessions)
+    {
+        out << std::setw(5) << id << "  " << std::left << std::setw(20) << s->get_name().substr(0, 19)
+            << std::setw(10) << session::state_name(s->get_state()) << std::right
+            << std::setw(10) << s->get_frames() << std::setw(8) << s->get_cycles_per_frame()
+            << std::setw(10) << std::fixed << std::setprecision(1) << s->get_frame_time().count() / 1000.0
+            << std::setw(10) << s->get_state_bytes() / 1024 << "\n";
+    }
+
+    return out.str();
+}
+
+session* server::find_session(client& c, const server_message& msg)
+{
+    auto it = (msg.m_data.size() >= 4) ? m_sessions.find(msg.get_u32(0)) : m_sessions.end();
+
+    if(it == m_sessions.end())
+    {
+        send(c, server_message::text(server_message_type::Error, "No such session!"));
+        return nullptr;
+    }
+
+    return it->second.get();
+}
+
+void server::tick()
+{
+    std::vector<session*> running;
+
+    for(auto& [id, s] : m_sessions)
+    {
+        if(s->get_state() == session::state::running) running.push_back(s.get());
+    }
+
+    // sessions are handed out one at a time, a slow one does not hold up the rest of a fixed range
+    std::atomic<std::size_t> next { 0 };
+    const auto limit = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_params.m_watchdog);
+
+    if(!running.empty())
+    {
+        m_pool.run([&](const std::size_t&)
+        {
+            for(auto i = next.fetch_add(1, std::memory_order_relaxed); i < running.size();
+                i = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                running[i]->run_frame(limit);
+            }
+        });
+    }
+
+    for(auto* s : running)
+    {
+        if(s->get_state() == session::state::running) continue;
+
+        const auto* why = session::state_name(s->get_state());
+
+        std::cerr << "nchip8d: session " << s->get_id() << " (" << s->get_name() << ") " << why
+                  << " after " << s->get_frames() << " frames" << std::endl;
+
+        notify_attached(s->get_id(), why, false);
+    }
+
+    for(auto& c : m_clients)
+    {
+        if(c->m_closed || !c->m_attached) continue;
+
+        send_frame(*c, *m_sessions.at(*c->m_attached));
+        flush_client(*c);
+    }
+}
+
+void server::send_frame(client& c, const session& s)
+{
+    // a client that is not reading gets no more frames until it does, the rows it misses are sent then
+    if(c.m_out.size() > max_pending) return;
+
+    const auto& screen = s.get_cpu().get_screen_framebuffer();
+    const auto mode = s.get_cpu().get_screen_mode();
+
+    if(mode != c.m_sent_mode) c.m_full = true;
+
+    server_message frame { server_message_type::Frame, {} };
+    frame.put_u32(static_cast<std::uint32_t>(s.get_frames()));
+    frame.m_data.push_back(mode);
+    frame.m_data.push_back(0);
+
+    std::uint8_t rows = 0;
+    const std::size_t used = (mode == cpu::screen_mode::lores_c8) ? 32 : 64;
+
+    for(std::size_t row = 0; row < used; row++)
+    {
+        const auto& page = screen.get_page(row);
+        const auto& sent = c.m_sent.get_page(row);
+
+        // a row the cpu has not written since it was sent is still the same page, most rows of most frames
+        if(!c.m_full && (&page == &sent || page == sent)) continue;
+
+        frame.m_data.push_back(static_cast<std::uint8_t>(row));
+
+        for(const auto& word : page)
+        {
+            for(int byte = 7; byte >= 0; byte--) frame.m_data.push_back(word >> (byte * 8));
+        }
+
+        rows++;
+    }
+
+    if(!rows && !c.m_full) return;
+
+    frame.m_data[5] = rows;
+    send(c, frame);
+
+    // shares the pages of the cpu, so the next frame only compares pointers
+    c.m_sent = screen;
+    c.m_sent_mode = mode;
+    c.m_full = false;
+}
+
+void server::notify_attached(const std::uint32_t& id, const std::string& why, const bool& ended)
+{
+    for(auto& c : m_clients)
+    {
+        if(c->m_attached != id) continue;
+
+        send(*c, server_message::text(ended ? server_message_type::Ended : server_message_type::Text,
+                                      "session " + std::to_string(id) + " " + why));
+
+        if(ended) c->m_attached.reset();
+    }
+}
+
+}
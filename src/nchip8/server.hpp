@@ -0,0 +1,115 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_SERVER_HPP
+#define NCHIP8_SERVER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+#include "gym.hpp"
+#include "server_message.hpp"
+#include "session.hpp"
+
+namespace nchip8
+{
+
+//! @brief  nchip8d: many emulator sessions in one process, clients attach to them over a Unix-domain socket
+//! @details One thread does all the I/O with poll(): the socket, the clients, a 60Hz timerfd and SIGINT/SIGTERM.
+//!          Every tick runs a frame of each running session on a fixed worker pool (see session), then sends each
+//!          attached client the rows of the screen that changed since the last frame it was sent.
+//!          A client that does not read its socket is skipped until it catches up, it never holds up a tick.
+//!          A session costs its cpu (a few KB of copy-on-write RAM and screen pages) and its share of a frame,
+//!          the threads, the terminal and the decode tables are shared.
+class server
+{
+public:
+    struct params
+    {
+        std::string m_socket;                       //! Path of the socket, see default_server_socket
+        std::size_t m_threads = 0;                  //! Workers including the server thread, 0 = every core
+        std::size_t m_max_sessions = 256;
+        std::uint32_t m_default_cycles = 8;         //! Cycles per frame of a session that asks for 0 (500Hz)
+        std::uint32_t m_max_cycles = 2000;          //! Cycles per frame a session can ask for at most
+        std::chrono::microseconds m_watchdog { 4000 };  //! Host time of a frame that is a strike, see session
+    };
+
+    //! @throws std::runtime_error if the socket cannot be made (e.g. another server is listening on it)
+    explicit server(const params& p);
+
+    //! @brief  Closes the clients and removes the socket
+    ~server();
+
+    server(const server&) = delete;
+    server& operator=(const server&) = delete;
+
+    //! @brief      Serves until SIGINT or SIGTERM
+    //! @returns    The return code for the process
+    int run();
+
+private:
+    struct client
+    {
+        int m_fd;
+        std::vector<std::uint8_t> m_in;
+        std::vector<std::uint8_t> m_out;
+        bool m_closed = false;
+
+        //! The session shown, the screen it was last sent and whether the next frame has to be whole
+        std::optional<std::uint32_t> m_attached;
+        cpu::framebuffer m_sent;
+        cpu::screen_mode m_sent_mode = cpu::screen_mode::lores_c8;
+        bool m_full = true;
+    };
+
+    //! @brief  Output a client has not read past which it is sent no frames
+    static constexpr std::size_t max_pending = 1 << 18;
+
+    params m_params;
+
+    int m_listen_fd = -1;
+    int m_timer_fd = -1;
+    int m_signal_fd = -1;
+
+    std::map<std::uint32_t, std::unique_ptr<session>> m_sessions;
+    std::uint32_t m_next_id = 1;
+
+    std::vector<std::unique_ptr<client>> m_clients;
+
+    gym_pool m_pool;
+
+    //! Ticks that came before the previous one was done, they are skipped (sessions slow down, never burst)
+    std::uint64_t m_late_ticks = 0;
+
+    void accept_clients();
+    void read_client(client& c);
+    void flush_client(client& c);
+    void send(client& c, const server_message& msg);
+
+    void handle(client& c, const server_message& msg);
+    void handle_create(client& c, const server_message& msg);
+    std::string list_sessions() const;
+
+    //! @brief  The session a message names, or nullptr after sending the client an Error
+    session* find_session(client& c, const server_message& msg);
+
+    //! @brief  Runs a frame of every running session and sends the screens
+    void tick();
+
+    //! @brief  Sends an attached client the rows that changed since the last frame it was sent
+    void send_frame(client& c, const session& s);
+
+    //! @brief  Tells the clients attached to a session why it stopped (detaching them if it is gone)
+    void notify_attached(const std::uint32_t& id, const std::string& why, const bool& ended);
+};
+
+}
+
+#endif //NCHIP8_SERVER_HPP
@@ -0,0 +1,332 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "server_client.hpp"
+
+#include <curses.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <clocale>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace nchip8
+{
+
+const std::unordered_map<int, std::uint8_t> server_client::key_mapping =
+{
+    {'1',0x1}, {'2',0x2}, {'3',0x3}, {'4', 0xC},
+    {'q',0x4}, {'w',0x5}, {'e',0x6}, {'r', 0xD},
+    {'a',0x7}, {'s',0x8}, {'d',0x9}, {'f', 0xE},
+    {'z',0xA}, {'x',0x0}, {'c',0xB}, {'v', 0xF},
+};
+
+server_client::server_client(const std::string& socket)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if(socket.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path " + socket + " is too long!");
+    std::memcpy(address.sun_path, socket.c_str(), socket.size() + 1);
+
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if(m_fd < 0 || ::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        std::string error = std::strerror(errno);
+        if(m_fd >= 0) ::close(m_fd);
+
+        throw std::runtime_error("Could not connect to nchip8d on " + socket + ": " + error
+                                 + " (is nchip8d serve running?)");
+    }
+}
+
+server_client::~server_client()
+{
+    ::close(m_fd);
+}
+
+void server_client::send(const server_message& msg)
+{
+    std::vector<std::uint8_t> out;
+    msg.encode(out);
+
+    std::size_t sent = 0;
+
+    while(sent < out.size())
+    {
+        auto wrote = ::send(m_fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+
+        if(wrote < 0 && errno == EINTR) continue;
+        if(wrote <= 0) throw std::runtime_error("nchip8d closed the connection!");
+
+        sent += wrote;
+    }
+}
+
+void server_client::read_some(const bool& block)
+{
+    std::uint8_t buffer[4096];
+
+    for(;;)
+    {
+        auto got = ::recv(m_fd, buffer, sizeof(buffer), block ? 0 : MSG_DONTWAIT);
+
+        if(got > 0)
+        {
+            m_in.insert(m_in.end(), buffer, buffer + got);
+            return;
+        }
+
+        if(got < 0 && errno == EINTR) continue;
+        if(got < 0 && !block && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        throw std::runtime_error("nchip8d closed the connection!");
+    }
+}
+
+bool server_client::poll_receive(server_message& out)
+{
+    if(server_message::decode(m_in, out)) return true;
+
+    read_some(false);
+    return server_message::decode(m_in, out);
+}
+
+server_message server_client::receive()
+{
+    server_message msg;
+
+    while(!server_message::decode(m_in, msg)) read_some(true);
+
+    return msg;
+}
+
+server_message server_client::request(const server_message& msg)
+{
+    send(msg);
+
+    for(;;)
+    {
+        auto answer = receive();
+
+        if(answer.m_type != server_message_type::Frame && answer.m_type != server_message_type::Text) return answer;
+
+        // a List is answered with Text, which is then the answer
+        if(msg.m_type == server_message_type::List && answer.m_type == server_message_type::Text) return answer;
+    }
+}
+
+void server_client::apply_frame(const server_message& frame)
+{
+    const auto& data = frame.m_data;
+    if(data.size() < 6) return;
+
+    m_screen_mode = static_cast<cpu::screen_mode>(data[4]);
+
+    constexpr std::size_t row_bytes = 1 + cpu::framebuffer::page_size * 8;
+
+    for(std::size_t offset = 6; offset + row_bytes <= data.size(); offset += row_bytes)
+    {
+        const std::size_t row = data[offset] & 0x3F;
+
+        for(std::size_t word = 0; word < cpu::framebuffer::page_size; word++)
+        {
+            std::uint64_t value = 0;
+            for(std::size_t byte = 0; byte < 8; byte++) value = (value << 8) | data[offset + 1 + word * 8 + byte];
+
+            m_screen.set(row * cpu::framebuffer::page_size + word, value);
+        }
+    }
+}
+
+void server_client::draw(const std::uint32_t& id, const std::uint32_t& frame, const std::string& status) const
+{
+    // both modes fit in 64x16 cells like in gui: half blocks in lores, braille in hires (the planes OR'd)
+    static constexpr unsigned int cols = 64;
+    static constexpr unsigned int lines = 16;
+
+    static const wchar_t half_blocks[4] = { L' ', L'▀', L'▄', L'█' };
+    static const std::uint8_t dots[4][2] = { {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80} };
+
+    for(unsigned int line = 0; line < lines; line++)
+    {
+        std::wstring text(cols, L' ');
+
+        for(unsigned int col = 0; col < cols; col++)
+        {
+            if(m_screen_mode == cpu::screen_mode::lores_c8)
+            {
+                const bool top = cpu::get_framebuffer_xy(m_screen, col, line * 2);
+                const bool bottom = cpu::get_framebuffer_xy(m_screen, col, line * 2 + 1);
+
+                text[col] = half_blocks[(top ? 0x1 : 0) | (bottom ? 0x2 : 0)];
+                continue;
+            }
+
+            std::uint8_t cell = 0;
+
+            for(unsigned int dy = 0; dy < 4; dy++)
+            {
+                for(unsigned int dx = 0; dx < 2; dx++)
+                {
+                    if(cpu::get_framebuffer_xy(m_screen, col * 2 + dx, line * 4 + dy)) cell |= dots[dy][dx];
+                }
+            }
+
+            if(cell) text[col] = static_cast<wchar_t>(0x2800 + cell);
+        }
+
+        mvaddwstr(line, 0, text.c_str());
+    }
+
+    std::string line = "session " + std::to_string(id) + "  frame " + std::to_string(frame) + "  Esc detaches";
+    if(!status.empty()) line += "  | " + status;
+
+    move(lines, 0);
+    clrtoeol();
+    mvaddnstr(lines, 0, line.c_str(), COLS);
+
+    refresh();
+}
+
+int server_client::attach(const std::uint32_t& id)
+{
+    server_message attach_msg { server_message_type::Attach, {} };
+    attach_msg.put_u32(id);
+
+    auto answer = request(attach_msg);
+
+    if(answer.m_type != server_message_type::Attached)
+    {
+        std::cerr << answer.get_text() << std::endl;
+        return 1;
+    }
+
+    ::setlocale(LC_ALL, "");
+    ::initscr();
+    ::nonl();
+    ::keypad(stdscr, TRUE);
+    ::curs_set(0);
+    ::set_escdelay(25);
+    ::cbreak();
+    ::nodelay(stdscr, TRUE);
+    ::noecho();
+
+    std::string status;
+    std::string ended;
+    std::uint32_t frame = 0;
+    bool quit = false;
+
+    const auto set_key = [&](const std::uint8_t& key, const bool& down)
+    {
+        send({ server_message_type::Key, { key, static_cast<std::uint8_t>(down) } });
+    };
+
+    try
+    {
+        while(!quit && ended.empty())
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            // wake up for the next key to bring up, like gui
+            auto wake = now + std::chrono::milliseconds(250);
+            for(const auto& [key, seen] : m_keys) wake = std::min(wake, seen + key_hold);
+
+            std::array<::pollfd, 2> fds {{ { m_fd, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } }};
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+
+            if(::poll(fds.data(), fds.size(), static_cast<int>(std::max<std::int64_t>(timeout, 0))) < 0
+               && errno != EINTR)
+            {
+                break;
+            }
+
+            now = std::chrono::steady_clock::now();
+
+            for(int c = getch(); c != ERR; c = getch())
+            {
+                if(c == 27)
+                {
+                    quit = true;
+                    break;
+                }
+
+                int lowered = std::tolower(c);
+
+                if(key_mapping.count(lowered) && !m_keys.count(lowered)) set_key(key_mapping.at(lowered), true);
+                m_keys[lowered] = now;
+            }
+
+            for(auto it = m_keys.begin(); it != m_keys.end(); )
+            {
+                if(now - it->second < key_hold)
+                {
+                    it++;
+                    continue;
+                }
+
+                if(key_mapping.count(it->first)) set_key(key_mapping.at(it->first), false);
+                it = m_keys.erase(it);
+            }
+
+            bool dirty = false;
+            server_message msg;
+
+            while(poll_receive(msg))
+            {
+                switch(msg.m_type)
+                {
+                    case server_message_type::Frame:
+                        apply_frame(msg);
+                        frame = msg.get_u32(0);
+                        dirty = true;
+                        break;
+
+                    case server_message_type::Ended:
+                        ended = msg.get_text();
+                        break;
+
+                    case server_message_type::Text:
+                    case server_message_type::Error:
+                        status = msg.get_text();
+                        dirty = true;
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+
+            if(dirty) draw(id, frame, status);
+        }
+
+        if(ended.empty()) send({ server_message_type::Detach, {} });
+    }
+    catch(const std::runtime_error& e)
+    {
+        ended = e.what();
+    }
+
+    ::curs_set(1);
+    ::endwin();
+
+    if(!ended.empty())
+    {
+        std::cerr << ended << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+}
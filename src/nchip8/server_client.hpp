@@ -0,0 +1,72 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_SERVER_CLIENT_HPP
+#define NCHIP8_SERVER_CLIENT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cpu.hpp"
+#include "server_message.hpp"
+
+namespace nchip8
+{
+
+//! @brief  A connection to nchip8d (see server), for the nchip8d subcommands
+class server_client
+{
+public:
+    //! @throws std::runtime_error if nothing listens on the socket
+    explicit server_client(const std::string& socket);
+    ~server_client();
+
+    server_client(const server_client&) = delete;
+    server_client& operator=(const server_client&) = delete;
+
+    void send(const server_message& msg);
+
+    //! @brief  Waits for the next message
+    //! @throws std::runtime_error if the server closed the connection
+    server_message receive();
+
+    //! @brief  Sends a request and waits for its answer (Frame and Text messages in between are skipped)
+    server_message request(const server_message& msg);
+
+    //! @brief      Shows a session in the terminal and sends it the keys until Esc, or until the session ends
+    //! @returns    The return code for the process
+    int attach(const std::uint32_t& id);
+
+private:
+    int m_fd = -1;
+    std::vector<std::uint8_t> m_in;
+
+    //! @brief  Takes a whole message off m_in, reading whatever the socket has first
+    //! @returns false if the socket has no whole message yet (without blocking)
+    bool poll_receive(server_message& out);
+
+    //! @brief  Reads the socket once, blocking or not
+    void read_some(const bool& block);
+
+    // the same keypad and key holding as gui
+    static const std::unordered_map<int, std::uint8_t> key_mapping;
+    static constexpr std::chrono::milliseconds key_hold { 3 * 1000 / 60 };
+    std::unordered_map<int, std::chrono::steady_clock::time_point> m_keys;
+
+    //! @brief  The screen of the attached session, as the Frame messages left it
+    cpu::framebuffer m_screen;
+    cpu::screen_mode m_screen_mode = cpu::screen_mode::lores_c8;
+
+    //! @brief  Applies the rows of a Frame message to m_screen
+    void apply_frame(const server_message& frame);
+
+    void draw(const std::uint32_t& id, const std::uint32_t& frame, const std::string& status) const;
+};
+
+}
+
+#endif //NCHIP8_SERVER_CLIENT_HPP
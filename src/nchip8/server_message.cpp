@@ -0,0 +1,89 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "server_message.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace nchip8
+{
+
+void server_message::encode(std::vector<std::uint8_t>& out) const
+{
+    const auto size = static_cast<std::uint32_t>(m_data.size());
+
+    for(int byte = 0; byte < 4; byte++) out.push_back(size >> (byte * 8));
+    out.push_back(static_cast<std::uint8_t>(m_type));
+    out.insert(out.end(), m_data.begin(), m_data.end());
+}
+
+bool server_message::decode(std::vector<std::uint8_t>& buffer, server_message& out)
+{
+    if(buffer.size() < header_size) return false;
+
+    std::uint32_t size = 0;
+    for(int byte = 3; byte >= 0; byte--) size = (size << 8) | buffer[byte];
+
+    if(size > max_data) throw std::length_error("message of " + std::to_string(size) + " bytes");
+    if(buffer.size() < header_size + size) return false;
+
+    out.m_type = static_cast<server_message_type>(buffer[4]);
+    out.m_data.assign(buffer.begin() + header_size, buffer.begin() + header_size + size);
+
+    buffer.erase(buffer.begin(), buffer.begin() + header_size + size);
+    return true;
+}
+
+void server_message::put_u32(const std::uint32_t& v)
+{
+    for(int byte = 0; byte < 4; byte++) m_data.push_back(v >> (byte * 8));
+}
+
+void server_message::put_u64(const std::uint64_t& v)
+{
+    for(int byte = 0; byte < 8; byte++) m_data.push_back(v >> (byte * 8));
+}
+
+std::uint32_t server_message::get_u32(const std::size_t& offset) const
+{
+    std::uint32_t v = 0;
+
+    // short data reads as zeroes, every field is checked against its size by the handler anyway
+    for(int byte = 3; byte >= 0; byte--)
+    {
+        v = (v << 8) | ((offset + byte < m_data.size()) ? m_data[offset + byte] : 0);
+    }
+
+    return v;
+}
+
+std::uint64_t server_message::get_u64(const std::size_t& offset) const
+{
+    return get_u32(offset) | (static_cast<std::uint64_t>(get_u32(offset + 4)) << 32);
+}
+
+std::string server_message::get_text() const
+{
+    return std::string(m_data.begin(), m_data.end());
+}
+
+server_message server_message::text(const server_message_type& type, const std::string& text)
+{
+    return { type, std::vector<std::uint8_t>(text.begin(), text.end()) };
+}
+
+std::string default_server_socket()
+{
+    if(const char* runtime = std::getenv("XDG_RUNTIME_DIR"))
+    {
+        if(*runtime) return std::string(runtime) + "/nchip8d.sock";
+    }
+
+    return "/tmp/nchip8d-" + std::to_string(::getuid()) + ".sock";
+}
+
+}
@@ -0,0 +1,81 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_SERVER_MESSAGE_HPP
+#define NCHIP8_SERVER_MESSAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nchip8
+{
+
+//! @brief Messages between nchip8d and its clients, over a Unix-domain stream socket
+enum class server_message_type : std::uint8_t
+{
+    // client to server
+    Create = 1,         //! Starts a session.                   m_data: u8 quirks, u64 seed, u32 cycles per frame,
+                        //!                                     u8 name length, name, the ROM
+    List,               //! Asks for a Text table of the sessions.  m_data: none
+    Attach,             //! Shows a session to this client.     m_data: u32 session
+    Detach,             //! Stops showing it.                   m_data: none
+    Key,                //! A key of the attached session.      m_data: u8 key, u8 down
+    Kill,               //! Ends a session.                     m_data: u32 session
+    Pause,              //! Stops scheduling a session.         m_data: u32 session
+    Resume,             //! Schedules it again (also after the watchdog stopped it).   m_data: u32 session
+
+    // server to client
+    Ok = 64,            //!                                     m_data: text
+    Error,              //! A request failed.                   m_data: text
+    Created,            //!                                     m_data: u32 session
+    Attached,           //! Frames of the session follow.       m_data: u32 session
+    Text,               //!                                     m_data: text
+    Frame,              //! The rows that changed since the last Frame sent to this client.
+                        //!                                     m_data: u32 frame, u8 screen mode, u8 rows,
+                        //!                                     rows * (u8 row, 32 bytes: the 4 words big endian)
+    Ended               //! The attached session ended.         m_data: text
+};
+
+//! @brief  A message and its framing: u32 length of the data (little endian), u8 type, the data
+struct server_message
+{
+    server_message_type m_type;
+    std::vector<std::uint8_t> m_data;
+
+    //! @brief  Bytes of the framing before the data
+    static constexpr std::size_t header_size = 5;
+
+    //! @brief  Largest data accepted, a 64K XO-CHIP ROM and its header fit
+    static constexpr std::size_t max_data = 1 << 17;
+
+    //! @brief  Appends the framed message to out
+    void encode(std::vector<std::uint8_t>& out) const;
+
+    //! @brief      Takes the first whole message off the front of buffer
+    //! @returns    false if buffer does not hold a whole message yet
+    //! @throws     std::length_error if the message is longer than max_data (the stream is of no more use)
+    static bool decode(std::vector<std::uint8_t>& buffer, server_message& out);
+
+    //! @brief  Appends little endian integers to m_data, and reads them back from offset on
+    void put_u32(const std::uint32_t& v);
+    void put_u64(const std::uint64_t& v);
+    std::uint32_t get_u32(const std::size_t& offset) const;
+    std::uint64_t get_u64(const std::size_t& offset) const;
+
+    //! @brief  m_data as text
+    std::string get_text() const;
+
+    //! @brief  A message of a type with text as its data
+    static server_message text(const server_message_type& type, const std::string& text);
+};
+
+//! @brief  The socket nchip8d listens on unless --socket=<path> is given:
+//!         $XDG_RUNTIME_DIR/nchip8d.sock, or /tmp/nchip8d-<uid>.sock
+std::string default_server_socket();
+
+}
+
+#endif //NCHIP8_SERVER_MESSAGE_HPP
@@ -0,0 +1,133 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "session.hpp"
+
+#include <algorithm>
+
+namespace nchip8
+{
+
+session::session(const std::uint32_t& id, const std::string& name, const std::uint32_t& cycles_per_frame) :
+    m_id(id),
+    m_name(name),
+    m_cycles_per_frame(std::max<std::uint32_t>(cycles_per_frame, 1))
+{
+    // nobody reads the trace of a hosted session
+    m_cpu.set_trace(false);
+}
+
+bool session::load(const std::vector<std::uint8_t>& rom, const quirk_profile& quirks, const std::uint64_t& seed)
+{
+    m_cpu.set_quirks(quirks);
+    m_cpu.set_seed(seed);
+    m_cpu.reset();
+
+    return m_cpu.load_rom(rom, 0x200);
+}
+
+void session::run_frame(const std::chrono::steady_clock::duration& watchdog_limit)
+{
+    if(m_state != state::running) return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(std::uint32_t cycle = 0; cycle < m_cycles_per_frame; cycle++)
+    {
+        if(!m_cpu.execute_op_at_pc()) break;
+        m_instructions++;
+    }
+
+    m_cpu.tick_timers();
+    m_frames++;
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    m_frame_time += (std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) - m_frame_time) / 16;
+
+    if(m_cpu.is_halted())
+    {
+        m_state = state::halted;
+        return;
+    }
+
+    m_strikes = (elapsed > watchdog_limit) ? m_strikes + 1 : 0;
+
+    if(m_strikes >= watchdog_strikes) m_state = state::watchdog;
+}
+
+void session::set_key(const std::uint8_t& key, const bool& down)
+{
+    if(down) m_cpu.set_key_down(key & 0xF);
+    else m_cpu.set_key_up(key & 0xF);
+}
+
+void session::set_running(const bool& running)
+{
+    if(m_state == state::halted) return;
+
+    m_state = running ? state::running : state::paused;
+    m_strikes = 0;
+}
+
+std::uint32_t session::get_id() const
+{
+    return m_id;
+}
+
+const std::string& session::get_name() const
+{
+    return m_name;
+}
+
+session::state session::get_state() const
+{
+    return m_state;
+}
+
+const char* session::state_name(const state& s)
+{
+    switch(s)
+    {
+        case state::running:  return "running";
+        case state::paused:   return "paused";
+        case state::halted:   return "halted";
+        case state::watchdog: return "watchdog";
+    }
+
+    return "?";
+}
+
+const cpu& session::get_cpu() const
+{
+    return m_cpu;
+}
+
+std::uint32_t session::get_cycles_per_frame() const
+{
+    return m_cycles_per_frame;
+}
+
+std::uint64_t session::get_frames() const
+{
+    return m_frames;
+}
+
+std::uint64_t session::get_instructions() const
+{
+    return m_instructions;
+}
+
+std::chrono::nanoseconds session::get_frame_time() const
+{
+    return m_frame_time;
+}
+
+std::size_t session::get_state_bytes() const
+{
+    const std::size_t ram = (m_cpu.get_quirks() == quirk_profile::xochip) ? 0x10000 : 0x1000;
+
+    return ram + cpu::framebuffer::size() * sizeof(std::uint64_t);
+}
+
+}
@@ -0,0 +1,89 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_SESSION_HPP
+#define NCHIP8_SESSION_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace nchip8
+{
+
+//! @brief  An emulator session hosted by nchip8d: a cpu and its schedule, without threads or a terminal of its own
+//! @details The server runs a frame of every running session per 60Hz tick on its worker pool, a frame is
+//!          cycles_per_frame instructions (the instruction budget) and one timer tick, so a session runs the same
+//!          whatever else is hosted. Keys and every other change happen on the server thread between ticks.
+class session
+{
+public:
+    enum class state
+    {
+        running,
+        paused,     //! By a client
+        halted,     //! The cpu hit an unhandled instruction
+        watchdog    //! Its frames took too long, see run_frame
+    };
+
+    //! @param id               Number clients refer to it by
+    //! @param name             Shown in the session list (usually the ROM file name)
+    //! @param cycles_per_frame Instructions per frame, the budget of the session
+    session(const std::uint32_t& id, const std::string& name, const std::uint32_t& cycles_per_frame);
+
+    //! @brief      Resets the cpu with a quirk profile and a seed and loads a ROM
+    //! @returns    false if the ROM does not fit
+    bool load(const std::vector<std::uint8_t>& rom, const quirk_profile& quirks, const std::uint64_t& seed);
+
+    //! @brief  Runs a frame, on a worker thread
+    //! @details The host time of a frame over watchdog_limit is a strike, watchdog_strikes strikes in a row
+    //!          (a second of slow frames) stop the session so it cannot take the frames of the others
+    void run_frame(const std::chrono::steady_clock::duration& watchdog_limit);
+
+    //! @brief  Strikes in a row that stop a session
+    static constexpr std::uint32_t watchdog_strikes = 60;
+
+    void set_key(const std::uint8_t& key, const bool& down);
+
+    //! @brief  Pauses it, or runs it again (which also clears the watchdog), a halted cpu stays halted
+    void set_running(const bool& running);
+
+    std::uint32_t get_id() const;
+    const std::string& get_name() const;
+    state get_state() const;
+    static const char* state_name(const state& s);
+
+    const cpu& get_cpu() const;
+    std::uint32_t get_cycles_per_frame() const;
+
+    //! @brief  Frames ran, instructions executed
+    std::uint64_t get_frames() const;
+    std::uint64_t get_instructions() const;
+
+    //! @brief  Host time of a frame, smoothed
+    std::chrono::nanoseconds get_frame_time() const;
+
+    //! @brief  Bytes of guest state it holds (RAM and screen pages), what a session costs on top of its object
+    std::size_t get_state_bytes() const;
+
+private:
+    std::uint32_t m_id;
+    std::string m_name;
+    std::uint32_t m_cycles_per_frame;
+
+    cpu m_cpu;
+    state m_state = state::running;
+
+    std::uint64_t m_frames = 0;
+    std::uint64_t m_instructions = 0;
+    std::chrono::nanoseconds m_frame_time {};
+    std::uint32_t m_strikes = 0;
+};
+
+}
+
+#endif //NCHIP8_SESSION_HPP
@@ -0,0 +1,102 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_SPSC_QUEUE_HPP
+#define NCHIP8_SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace nchip8
+{
+
+//! @brief  A fixed size lock-free queue with one producer thread and one consumer thread
+//! @details A ring buffer of Capacity slots (a power of two). The producer only writes the tail and the consumer
+//!          only writes the head, so neither ever waits on the other, a full queue drops the push instead.
+template<typename T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    //! @brief      Adds an element, producer thread only
+    //! @returns    false if the queue is full (the element is dropped)
+    bool push(const T& value)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if(tail - m_head.load(std::memory_order_acquire) == Capacity) return false;
+
+        m_slots[tail & (Capacity - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    //! @brief      Takes the oldest element, consumer thread only
+    //! @returns    false if the queue is empty
+    bool pop(T& out)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+
+        if(head == m_tail.load(std::memory_order_acquire)) return false;
+
+        out = m_slots[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    //! @brief      Adds up to count elements at once (one release for all of them), producer thread only
+    //! @returns    How many were added, the rest are dropped
+    std::size_t push(const T* values, const std::size_t& count)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        std::size_t free = Capacity - (tail - m_head.load(std::memory_order_acquire));
+        std::size_t n = count < free ? count : free;
+
+        for(std::size_t i = 0; i < n; i++) m_slots[(tail + i) & (Capacity - 1)] = values[i];
+        m_tail.store(tail + n, std::memory_order_release);
+
+        return n;
+    }
+
+    //! @brief      Takes up to count of the oldest elements at once, consumer thread only
+    //! @returns    How many were taken
+    std::size_t pop(T* out, const std::size_t& count)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        std::size_t used = m_tail.load(std::memory_order_acquire) - head;
+        std::size_t n = count < used ? count : used;
+
+        for(std::size_t i = 0; i < n; i++) out[i] = m_slots[(head + i) & (Capacity - 1)];
+        m_head.store(head + n, std::memory_order_release);
+
+        return n;
+    }
+
+    //! @brief  Elements queued, exact for the consumer (the producer may only add to it meanwhile)
+    std::size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed);
+    }
+
+    //! @brief  Whether there is nothing to pop, a cheap check for the consumer
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> m_slots {};
+
+    //! Next slot to pop and next slot to push, they only grow (wrapping is fine, Capacity divides 2^64)
+    alignas(64) std::atomic<std::size_t> m_head { 0 };
+    alignas(64) std::atomic<std::size_t> m_tail { 0 };
+};
+
+}
+
+#endif //NCHIP8_SPSC_QUEUE_HPP
@@ -0,0 +1,149 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "nchip8/quirks.hpp"
+#include "nchip8/server.hpp"
+#include "nchip8/server_client.hpp"
+
+static const char* usage =
+    "Usage: nchip8d serve [--socket=<path>] [--threads=<n>] [--max-sessions=<n>] [--max-cycles=<n>] [--watchdog-ms=<ms>]\n"
+    "       nchip8d new <rom> [--name=<name>] [--quirks=<profile>] [--seed=<n>] [--cycles=<per frame>] [--socket=<path>]\n"
+    "       nchip8d list [--socket=<path>]\n"
+    "       nchip8d attach|kill|pause|resume <session> [--socket=<path>]";
+
+static std::vector<std::uint8_t> read_rom_file(const std::string& path)
+{
+    std::ifstream input_file(path, std::ios::binary | std::ios::in);
+
+    if(!input_file) throw std::invalid_argument("Could not open " + path + "!");
+
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(input_file), std::istreambuf_iterator<char>());
+}
+
+// nchip8d <command> ...: serve runs the server, the other commands talk to it (see server)
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+
+    const std::string command = argv[1];
+
+    std::string socket = nchip8::default_server_socket();
+    std::vector<std::string> positional;
+
+    nchip8::server::params params;
+    std::string name;
+    nchip8::quirk_profile quirks = nchip8::quirk_profile::nchip8;
+    std::uint64_t seed = 0;
+    std::uint32_t cycles = 0;
+
+    try
+    {
+        for(int i = 2; i < argc; i++)
+        {
+            std::string arg = argv[i];
+
+            if(arg.rfind("--socket=", 0) == 0) socket = arg.substr(9);
+            else if(arg.rfind("--threads=", 0) == 0) params.m_threads = std::stoul(arg.substr(10));
+            else if(arg.rfind("--max-sessions=", 0) == 0) params.m_max_sessions = std::stoul(arg.substr(15));
+            else if(arg.rfind("--max-cycles=", 0) == 0) params.m_max_cycles = std::stoul(arg.substr(13));
+            else if(arg.rfind("--watchdog-ms=", 0) == 0)
+            {
+                params.m_watchdog = std::chrono::milliseconds(std::stoul(arg.substr(14)));
+            }
+            else if(arg.rfind("--name=", 0) == 0) name = arg.substr(7);
+            else if(arg.rfind("--seed=", 0) == 0) seed = std::stoull(arg.substr(7), nullptr, 0);
+            else if(arg.rfind("--cycles=", 0) == 0) cycles = std::stoul(arg.substr(9));
+            else if(arg.rfind("--quirks=", 0) == 0)
+            {
+                auto profile = nchip8::parse_quirk_profile(arg.substr(9));
+                if(!profile) throw std::invalid_argument("Unknown quirk profile " + arg.substr(9) + "!");
+
+                quirks = profile.value();
+            }
+            else if(arg.rfind("--", 0) != 0) positional.push_back(arg);
+            else throw std::invalid_argument("Unknown option " + arg + "!");
+        }
+
+        if(command == "serve" && positional.empty())
+        {
+            params.m_socket = socket;
+
+            nchip8::server server(params);
+            return server.run();
+        }
+
+        if(command == "new" && positional.size() == 1)
+        {
+            const auto& path = positional[0];
+            auto rom = read_rom_file(path);
+
+            if(name.empty()) name = path.substr(path.find_last_of('/') + 1);
+            name = name.substr(0, 255);
+
+            nchip8::server_message create { nchip8::server_message_type::Create, {} };
+            create.m_data.push_back(static_cast<std::uint8_t>(quirks));
+            create.put_u64(seed);
+            create.put_u32(cycles);
+            create.m_data.push_back(static_cast<std::uint8_t>(name.size()));
+            create.m_data.insert(create.m_data.end(), name.begin(), name.end());
+            create.m_data.insert(create.m_data.end(), rom.begin(), rom.end());
+
+            nchip8::server_client client(socket);
+            auto answer = client.request(create);
+
+            if(answer.m_type != nchip8::server_message_type::Created)
+            {
+                std::cerr << answer.get_text() << std::endl;
+                return 1;
+            }
+
+            std::cout << answer.get_u32(0) << std::endl;
+            return 0;
+        }
+
+        if(command == "list" && positional.empty())
+        {
+            nchip8::server_client client(socket);
+            std::cout << client.request({ nchip8::server_message_type::List, {} }).get_text();
+            return 0;
+        }
+
+        if((command == "attach" || command == "kill" || command == "pause" || command == "resume")
+           && positional.size() == 1)
+        {
+            const auto id = static_cast<std::uint32_t>(std::stoul(positional[0]));
+
+            nchip8::server_client client(socket);
+            if(command == "attach") return client.attach(id);
+
+            nchip8::server_message msg {
+                command == "kill" ? nchip8::server_message_type::Kill
+                : command == "pause" ? nchip8::server_message_type::Pause
+                : nchip8::server_message_type::Resume,
+                {}
+            };
+            msg.put_u32(id);
+
+            auto answer = client.request(msg);
+            (answer.m_type == nchip8::server_message_type::Ok ? std::cout : std::cerr) << answer.get_text() << std::endl;
+
+            return answer.m_type == nchip8::server_message_type::Ok ? 0 : 1;
+        }
+
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "nchip8/regress.hpp"
+
+// nchip8_regress [manifest] [--golden=<path>] [--update] [--threads=<n>]
+// runs the cases of the manifest (or the builtin corpus) and compares them with the golden file,
+// --update writes the golden file from this build instead.
+// The golden file defaults to the manifest's with .golden for .manifest, and to the checked in one for the builtin corpus
+int main(int argc, char** argv)
+{
+    std::string manifest_path;
+    std::string golden_path;
+    std::size_t threads = 0;
+    bool update = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if(arg == "--update") update = true;
+        else if(arg.rfind("--golden=", 0) == 0) golden_path = arg.substr(9);
+        else if(arg.rfind("--threads=", 0) == 0) threads = std::stoul(arg.substr(10));
+        else if(arg.rfind("--", 0) != 0 && manifest_path.empty()) manifest_path = arg;
+        else
+        {
+            std::cerr << "Usage: nchip8_regress [manifest] [--golden=<path>] [--update] [--threads=<n>]" << std::endl;
+            return 2;
+        }
+    }
+
+    if(golden_path.empty())
+    {
+        if(manifest_path.empty()) golden_path = std::string(NCHIP8_REGRESS_DIR) + "/builtin.golden";
+        else golden_path = manifest_path.substr(0, manifest_path.rfind(".manifest")) + ".golden";
+    }
+
+    try
+    {
+        std::vector<nchip8::regress::test_case> cases;
+
+        if(manifest_path.empty())
+        {
+            cases = nchip8::regress::builtin_manifest();
+        }
+        else
+        {
+            std::ifstream manifest(manifest_path);
+            if(!manifest) throw std::invalid_argument("Could not open " + manifest_path + "!");
+
+            auto slash = manifest_path.find_last_of('/');
+            cases = nchip8::regress::read_manifest(manifest, slash == std::string::npos ? "" : manifest_path.substr(0, slash));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = nchip8::regress::run(cases, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if(update)
+        {
+            std::ofstream golden(golden_path);
+            if(!golden) throw std::invalid_argument("Could not open " + golden_path + "!");
+
+            nchip8::regress::write_golden(golden, results);
+
+            std::cout << "wrote " << results.size() << " cases to " << golden_path
+                      << " in " << elapsed.count() << " s" << std::endl;
+            return 0;
+        }
+
+        std::ifstream golden(golden_path);
+        if(!golden) throw std::invalid_argument("Could not open " + golden_path + "! (make it with --update)");
+
+        std::size_t failures = nchip8::regress::compare(nchip8::regress::read_golden(golden), results, std::cout);
+
+        std::cout << results.size() - failures << " of " << results.size() << " cases ok in "
+                  << elapsed.count() << " s" << std::endl;
+
+        return failures ? 1 : 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
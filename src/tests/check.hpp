@@ -0,0 +1,60 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#ifndef NCHIP8_TESTS_CHECK_HPP
+#define NCHIP8_TESTS_CHECK_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../nchip8/cpu.hpp"
+#include "../nchip8/quirks.hpp"
+
+//! @brief  Reports a failed condition and counts it, the test keeps going (see tests::failures)
+#define CHECK(condition) nchip8::tests::check((condition), #condition, __FILE__, __LINE__)
+
+namespace nchip8::tests
+{
+
+//! @brief  Checks that failed so far, main returns it so ctest sees a failure
+inline int failures = 0;
+
+inline bool check(const bool& passed, const char* condition, const char* file, const int& line)
+{
+    if(!passed)
+    {
+        std::cerr << file << ':' << line << ": CHECK(" << condition << ") failed" << std::endl;
+        failures++;
+    }
+
+    return passed;
+}
+
+//! @brief  Resets the cpu with a quirk profile and loads the instructions as a ROM at 0x200, like the daemon does
+inline void load_words(cpu& chip8, const quirk_profile& quirks, const std::vector<std::uint16_t>& words)
+{
+    std::vector<std::uint8_t> rom;
+
+    for(const auto& word : words)
+    {
+        rom.push_back(word >> 8);
+        rom.push_back(word & 0xFF);
+    }
+
+    chip8.set_quirks(quirks);
+    chip8.set_seed(0);
+    chip8.reset();
+    chip8.load_rom(rom, 0x200);
+}
+
+//! @brief  Executes count instructions, or fewer if the cpu halts
+inline void run(cpu& chip8, const std::size_t& count)
+{
+    for(std::size_t i = 0; i < count && chip8.execute_op_at_pc(); i++) { }
+}
+
+}
+
+#endif //NCHIP8_TESTS_CHECK_HPP
@@ -0,0 +1,166 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include <algorithm>
+#include <thread>
+
+#include "check.hpp"
+#include "../nchip8/cow_array.hpp"
+
+using namespace nchip8;
+using namespace nchip8::tests;
+
+using array = cow_array<std::uint32_t, 4, 8>;
+
+//! @brief  An array whose pages are all its own, element i = i
+static array numbered()
+{
+    array a;
+    for(std::size_t i = 0; i < array::size(); i++) a.set(i, i);
+    return a;
+}
+
+static bool is_numbered(const array& a)
+{
+    for(std::size_t i = 0; i < array::size(); i++)
+    {
+        if(a[i] != i) return false;
+    }
+
+    return true;
+}
+
+// a copy shares every page and only reads the source
+static void sharing()
+{
+    array a;
+    CHECK(a[0] == 0 && a[array::size() - 1] == 0);
+
+    // a fill is one page shared by all
+    CHECK(&a.get_page(0) == &a.get_page(array::pages - 1));
+
+    const array source = numbered();
+    CHECK(source.get_private_pages() == array::pages);
+
+    const array copy = source;
+
+    for(std::size_t p = 0; p < array::pages; p++) CHECK(&copy.get_page(p) == &source.get_page(p));
+
+    CHECK(source.get_private_pages() == 0);
+    CHECK(copy.get_private_pages() == 0);
+    CHECK(is_numbered(source));
+    CHECK(is_numbered(copy));
+}
+
+// a write unshares the page it hits and nothing else, in whichever copy it is made
+static void copy_on_write()
+{
+    array a = numbered();
+    array b = a;
+
+    const auto* shared = &a.get_page(1);
+
+    b.set(5, 500);
+    CHECK(b[5] == 500);
+    CHECK(a[5] == 5);
+    CHECK(&a.get_page(1) == shared);
+    CHECK(&b.get_page(1) != shared);
+    CHECK(&a.get_page(0) == &b.get_page(0));
+    CHECK(b.get_private_pages() == 1);
+
+    // the source is written the same way, the copy keeps what it had
+    array c = a;
+    a.set(0, 100);
+    CHECK(a[0] == 100);
+    CHECK(c[0] == 0);
+    CHECK(&c.get_page(1) == shared);
+
+    // the last owner writes in place
+    array d = numbered();
+    const auto* own = &d.get_page(2);
+    d.set(8, 800);
+    CHECK(&d.get_page(2) == own);
+
+    // once a copy is gone its source owns the pages again, copying did not mark them shared for good
+    {
+        array gone = d;
+        CHECK(gone[8] == 800);
+    }
+
+    d.set(9, 900);
+    CHECK(&d.get_page(2) == own);
+
+    // writing what a page already holds leaves it shared
+    array e = c;
+    std::uint32_t same[4] = { 4, 5, 6, 7 };
+    e.write(4, same, 4);
+    CHECK(&e.get_page(1) == &c.get_page(1));
+
+    std::uint32_t other[6] = { 1, 2, 3, 4, 5, 6 };
+    e.write(2, other, 6);
+    CHECK(&e.get_page(1) != &c.get_page(1));
+
+    std::uint32_t out[6];
+    e.read(2, out, 6);
+    CHECK(std::equal(out, out + 6, other));
+    CHECK(is_numbered(c));
+
+    e.unshare();
+    CHECK(e.get_private_pages() == array::pages);
+}
+
+// pages past the used ones are released, and come back empty
+static void resize()
+{
+    array a = numbered();
+    a.resize(2);
+    CHECK(a[7] == 7);
+
+    a.resize(array::pages);
+    CHECK(a[7] == 7);
+    CHECK(a[8] == 0);
+    CHECK(a[array::size() - 1] == 0);
+}
+
+// many threads copy one array at once and write their copies, the source never changes
+static void threads()
+{
+    const array source = numbered();
+    std::vector<std::thread> workers;
+    std::vector<int> ok(8, 0);
+
+    for(std::size_t t = 0; t < ok.size(); t++)
+    {
+        workers.emplace_back([&source, &ok, t]()
+        {
+            bool all = true;
+
+            for(int round = 0; round < 1000; round++)
+            {
+                array copy = source;
+                for(std::size_t i = 0; i < array::size(); i += 3) copy.set(i, t + 1000);
+
+                all = all && copy[3] == t + 1000 && copy[4] == 4;
+            }
+
+            ok[t] = all;
+        });
+    }
+
+    for(auto& worker : workers) worker.join();
+
+    CHECK(std::all_of(ok.begin(), ok.end(), [](const int& all) { return all; }));
+    CHECK(is_numbered(source));
+    CHECK(source.get_private_pages() == array::pages);
+}
+
+int main()
+{
+    sharing();
+    copy_on_write();
+    resize();
+    threads();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "check.hpp"
+#include "../nchip8/ram_heatmap.hpp"
+
+using namespace nchip8;
+using namespace nchip8::tests;
+
+//! @brief  The instructions, then the sprite data at 0x300 (for A300)
+static std::vector<std::uint16_t> with_sprite(std::vector<std::uint16_t> code, const std::vector<std::uint16_t>& sprite)
+{
+    code.resize(0x80, 0x0000);
+    code.insert(code.end(), sprite.begin(), sprite.end());
+    return code;
+}
+
+// the SCHIP instructions are only decoded by the schip and xochip profiles
+static void schip_only()
+{
+    for(const auto& quirks : { quirk_profile::nchip8, quirk_profile::chip8 })
+    {
+        cpu chip8;
+        load_words(chip8, quirks, { 0x00FF });
+
+        CHECK(!chip8.dasm_op(0x200));
+        CHECK(!chip8.execute_op_at_pc());
+        CHECK(chip8.is_halted());
+        CHECK(chip8.get_screen_mode() == cpu::screen_mode::lores_c8);
+    }
+
+    // Dxy0 draws nothing without SCHIP
+    cpu chip8;
+    load_words(chip8, quirk_profile::chip8, with_sprite({ 0xA300, 0xD000 }, { 0xFFFF }));
+    run(chip8, 2);
+
+    CHECK(!chip8.is_halted());
+    CHECK(!chip8.get_screen_xy(0, 0));
+}
+
+// HIGH, then a 16x16 sprite at (0, 0)
+static void schip_big_sprite()
+{
+    std::vector<std::uint16_t> sprite(16, 0xFFFF);
+
+    cpu chip8;
+    load_words(chip8, quirk_profile::schip, with_sprite({ 0x00FF, 0xA300, 0xD000 }, sprite));
+    run(chip8, 3);
+
+    CHECK(chip8.get_screen_mode() == cpu::screen_mode::hires_sc8);
+    CHECK(chip8.get_screen_xy(0, 0));
+    CHECK(chip8.get_screen_xy(15, 15));
+    CHECK(!chip8.get_screen_xy(16, 0));
+    CHECK(!chip8.get_screen_xy(0, 16));
+    CHECK(chip8.get_gpr()[0xF] == 0);
+
+    // drawn again it erases itself, a collision
+    load_words(chip8, quirk_profile::schip, with_sprite({ 0x00FF, 0xA300, 0xD000, 0xD000 }, sprite));
+    run(chip8, 4);
+
+    CHECK(!chip8.get_screen_xy(15, 15));
+    CHECK(chip8.get_gpr()[0xF] != 0);
+}
+
+// a pixel at (0, 0) scrolled down 2 (SCD 2), right 4 (SCR), then left 4 (SCL)
+static void schip_scroll()
+{
+    const std::vector<std::uint16_t> code = { 0x00FF, 0xA300, 0xD001, 0x00C2, 0x00FB, 0x00FC };
+
+    cpu chip8;
+    load_words(chip8, quirk_profile::schip, with_sprite(code, { 0x8000 }));
+
+    run(chip8, 4);
+    CHECK(!chip8.get_screen_xy(0, 0));
+    CHECK(chip8.get_screen_xy(0, 2));
+
+    run(chip8, 1);
+    CHECK(!chip8.get_screen_xy(0, 2));
+    CHECK(chip8.get_screen_xy(4, 2));
+
+    run(chip8, 1);
+    CHECK(chip8.get_screen_xy(0, 2));
+    CHECK(!chip8.get_screen_xy(4, 2));
+
+    // the pixels leaving the first word of a hires row carry into the second one
+    load_words(chip8, quirk_profile::schip, with_sprite({ 0x00FF, 0x603E, 0xA300, 0xD011, 0x00FB }, { 0xF000 }));
+    run(chip8, 5);
+
+    CHECK(chip8.get_screen_xy(66, 0));
+    CHECK(chip8.get_screen_xy(69, 0));
+    CHECK(!chip8.get_screen_xy(62, 0));
+}
+
+// PLANE selects what DRW and CLS touch, the color of a pixel has a bit per plane
+static void xochip_planes()
+{
+    const std::vector<std::uint16_t> code =
+    {
+        0xA300,
+        0xF101, 0xD001,         // plane 0
+        0xF201, 0xD001,         // plane 1
+        0xF101, 0x00E0,         // clears plane 0 only
+        0xF301, 0xD001,         // both: the plane 0 row, then the plane 1 row
+    };
+
+    cpu chip8;
+    load_words(chip8, quirk_profile::xochip, with_sprite(code, { 0x8000, 0x0000 }));
+
+    run(chip8, 3);
+    CHECK(cpu::get_framebuffer_color(chip8.get_screen_framebuffer(), 0, 0) == 0x1);
+
+    run(chip8, 2);
+    CHECK(cpu::get_framebuffer_color(chip8.get_screen_framebuffer(), 0, 0) == 0x3);
+
+    run(chip8, 2);
+    CHECK(cpu::get_framebuffer_color(chip8.get_screen_framebuffer(), 0, 0) == 0x2);
+
+    run(chip8, 2);
+    CHECK(cpu::get_framebuffer_color(chip8.get_screen_framebuffer(), 0, 0) == 0x3);
+    CHECK(cpu::get_framebuffer_color(chip8.get_screen_framebuffer(), 1, 0) == 0x0);
+}
+
+// F000 nnnn is 4 bytes: it sets I, and a skip steps over all of it
+static void xochip_long_load()
+{
+    cpu chip8;
+    load_words(chip8, quirk_profile::xochip, { 0x6001, 0x3000, 0xF000, 0x1234, 0x6105 });
+    run(chip8, 3);
+
+    CHECK(chip8.get_i() == 0x1234);
+    CHECK(chip8.get_pc() == 0x208);
+
+    load_words(chip8, quirk_profile::xochip, { 0x6000, 0x3000, 0xF000, 0x1234, 0x6105 });
+    run(chip8, 3);
+
+    CHECK(chip8.get_i() != 0x1234);
+    CHECK(chip8.get_gpr()[1] == 0x05);
+    CHECK(chip8.get_pc() == 0x20A);
+    CHECK(!chip8.is_halted());
+
+    // only F000 and F002 are defined, the other Fx00 and Fx02 are not
+    load_words(chip8, quirk_profile::xochip, { 0xF000, 0x0000, 0xF100, 0xF002, 0xF102 });
+
+    CHECK(chip8.dasm_op(0x200) == std::optional<std::string>("LD I, long"));
+    CHECK(!chip8.dasm_op(0x204));
+    CHECK(chip8.dasm_op(0x206).has_value());
+    CHECK(!chip8.dasm_op(0x208));
+}
+
+// the heatmap counts the 64K of XO-CHIP, it does not fold the high addresses onto the first 4K
+static void xochip_heatmap()
+{
+    ram_heatmap heatmap;
+
+    cpu chip8;
+    chip8.set_ram_heatmap(&heatmap);
+
+    load_words(chip8, quirk_profile::xochip, { 0xF000, 0x8000, 0x6042, 0xF033, 0xF265 });
+    run(chip8, 4);
+
+    CHECK(heatmap.get_size() == 0x10000);
+    CHECK(heatmap.m_writes[0x8000] == 1 && heatmap.m_writes[0x8002] == 1);
+    CHECK(heatmap.m_reads[0x8001] == 1);
+    CHECK(heatmap.m_writes[0x0000] == 0);
+
+    load_words(chip8, quirk_profile::chip8, { 0xA123 });
+    CHECK(heatmap.get_size() == 0x1000);
+
+    chip8.set_ram_heatmap(nullptr);
+}
+
+int main()
+{
+    schip_only();
+    schip_big_sprite();
+    schip_scroll();
+    xochip_planes();
+    xochip_long_load();
+    xochip_heatmap();
+
+    return failures ? 1 : 0;
+}
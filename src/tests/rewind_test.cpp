@@ -0,0 +1,154 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "check.hpp"
+#include "../nchip8/rewind_buffer.hpp"
+
+using namespace nchip8;
+using namespace nchip8::tests;
+
+// draws digits from RND and counts in V2, so every frame has another state
+static const std::vector<std::uint16_t> busy = { 0xC0FF, 0xC11F, 0xF029, 0xD015, 0x7201, 0x1200 };
+
+//! @brief  Runs a frame, records it and keeps its state (history[n] is the state of frame n)
+static void frame(cpu& chip8, rewind_buffer& rewind, std::vector<std::vector<std::uint8_t>>& history)
+{
+    run(chip8, 10);
+    chip8.tick_timers();
+
+    rewind.push(chip8);
+    history.push_back(chip8.save_state(false));
+}
+
+// any frame back is restored exactly and becomes the newest, new frames go on from it
+static void arbitrary_frames()
+{
+    cpu chip8;
+    load_words(chip8, quirk_profile::nchip8, busy);
+
+    rewind_buffer rewind(64 * 1024 * 1024, 60);
+    std::vector<std::vector<std::uint8_t>> history;
+
+    CHECK(rewind.rewind(chip8, 10) == 0);
+
+    for(int i = 0; i < 300; i++) frame(chip8, rewind, history);
+    CHECK(rewind.get_frames() == 300);
+
+    // within a segment, onto a keyframe, just before one, and back to the first frame
+    for(std::size_t target : { 250, 240, 239, 119, 61, 60, 59, 1, 0 })
+    {
+        const std::size_t newest = history.size() - 1;
+
+        CHECK(rewind.rewind(chip8, newest - target) == newest - target);
+        CHECK(chip8.save_state(false) == history[target]);
+        CHECK(rewind.get_frames() == target + 1);
+
+        history.resize(target + 1);
+    }
+
+    // recording again from the first frame, the history is as if it never went further
+    for(int i = 0; i < 130; i++) frame(chip8, rewind, history);
+    CHECK(rewind.get_frames() == 131);
+
+    CHECK(rewind.rewind(chip8, 70) == 70);
+    CHECK(chip8.save_state(false) == history[60]);
+
+    // further back than the history goes stops at the oldest frame
+    CHECK(rewind.rewind(chip8, 1000) == 60);
+    CHECK(chip8.save_state(false) == history[0]);
+}
+
+// a change of state size ends a segment early, the segments after it start mid-interval
+static void short_segments()
+{
+    cpu chip8;
+    load_words(chip8, quirk_profile::nchip8, busy);
+
+    rewind_buffer rewind(64 * 1024 * 1024, 60);
+    std::vector<std::vector<std::uint8_t>> history;
+
+    for(int i = 0; i < 45; i++) frame(chip8, rewind, history);
+
+    load_words(chip8, quirk_profile::xochip, busy);
+    for(int i = 45; i < 200; i++) frame(chip8, rewind, history);
+
+    // segments start at 0, 45, 105 and 165
+    for(std::size_t target : { 170, 165, 164, 105, 104, 46, 45 })
+    {
+        const std::size_t newest = history.size() - 1;
+
+        CHECK(rewind.rewind(chip8, newest - target) == newest - target);
+        CHECK(chip8.save_state(false) == history[target]);
+
+        history.resize(target + 1);
+    }
+
+    // the frames before the change come back with their profile
+    CHECK(chip8.get_quirks() == quirk_profile::xochip);
+    CHECK(rewind.rewind(chip8, 1) == 1);
+    CHECK(chip8.get_quirks() == quirk_profile::nchip8);
+    CHECK(chip8.save_state(false) == history[44]);
+}
+
+// a profile with the same state size also ends a segment, a rewind across it restores the old profile
+static void quirk_change()
+{
+    cpu chip8;
+    load_words(chip8, quirk_profile::nchip8, busy);
+
+    rewind_buffer rewind(64 * 1024 * 1024, 60);
+    std::vector<std::vector<std::uint8_t>> history;
+
+    for(int i = 0; i < 30; i++) frame(chip8, rewind, history);
+
+    chip8.set_quirks(quirk_profile::schip);
+    for(int i = 30; i < 50; i++) frame(chip8, rewind, history);
+
+    CHECK(rewind.rewind(chip8, 5) == 5);
+    CHECK(chip8.get_quirks() == quirk_profile::schip);
+    CHECK(chip8.save_state(false) == history[44]);
+
+    CHECK(rewind.rewind(chip8, 20) == 20);
+    CHECK(chip8.get_quirks() == quirk_profile::nchip8);
+    CHECK(chip8.save_state(false) == history[24]);
+
+    // and it goes on recording with it
+    history.resize(25);
+    for(int i = 25; i < 40; i++) frame(chip8, rewind, history);
+
+    CHECK(rewind.get_frames() == 40);
+    CHECK(rewind.rewind(chip8, 10) == 10);
+    CHECK(chip8.get_quirks() == quirk_profile::nchip8);
+    CHECK(chip8.save_state(false) == history[29]);
+}
+
+// over the budget the oldest segments go, the oldest frame left is still restored exactly
+static void budget()
+{
+    cpu chip8;
+    load_words(chip8, quirk_profile::nchip8, busy);
+
+    rewind_buffer rewind(16 * 1024, 30);
+    std::vector<std::vector<std::uint8_t>> history;
+
+    for(int i = 0; i < 600; i++) frame(chip8, rewind, history);
+
+    const std::size_t frames = rewind.get_frames();
+    CHECK(frames < 600);
+    CHECK(frames % 30 == 0);
+    CHECK(rewind.get_bytes() <= 16 * 1024);
+
+    CHECK(rewind.rewind(chip8, 600) == frames - 1);
+    CHECK(chip8.save_state(false) == history[600 - frames]);
+}
+
+int main()
+{
+    arbitrary_frames();
+    short_segments();
+    quirk_change();
+    budget();
+
+    return failures ? 1 : 0;
+}
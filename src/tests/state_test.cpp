@@ -0,0 +1,116 @@
+//
+// Created by agent on 19/10/26.
+//
+
+#include "check.hpp"
+#include "../nchip8/rle.hpp"
+
+using namespace nchip8;
+using namespace nchip8::tests;
+
+static bool round_trips(const std::vector<std::uint8_t>& data)
+{
+    std::vector<std::uint8_t> encoded;
+    rle_encode(data.data(), data.size(), encoded);
+
+    std::vector<std::uint8_t> decoded(data.size());
+    return rle_decode(encoded.data(), encoded.size(), decoded.data(), decoded.size()) && decoded == data;
+}
+
+// runs at and just past the 3-130 a control byte covers, literals at and past 128
+static void rle()
+{
+    CHECK(round_trips({}));
+    CHECK(round_trips({ 0x42 }));
+    CHECK(round_trips({ 0x42, 0x42 }));
+
+    for(std::size_t size : { 3, 129, 130, 131, 260, 1000 })
+    {
+        CHECK(round_trips(std::vector<std::uint8_t>(size, 0xAA)));
+
+        std::vector<std::uint8_t> literal(size);
+        for(std::size_t i = 0; i < size; i++) literal[i] = i * 7 + (i >> 8);
+        CHECK(round_trips(literal));
+
+        // literals and runs alternating
+        std::vector<std::uint8_t> mixed;
+        for(std::size_t i = 0; i < size; i++) mixed.insert(mixed.end(), i % 5, i & 0xFF);
+        CHECK(round_trips(mixed));
+    }
+
+    // a run is a fraction of its size
+    std::vector<std::uint8_t> zeros(4096, 0), encoded;
+    rle_encode(zeros.data(), zeros.size(), encoded);
+    CHECK(encoded.size() < 100);
+
+    // not decoding to exactly the size asked for is an error, as is data cut short
+    std::vector<std::uint8_t> out(4097);
+    CHECK(!rle_decode(encoded.data(), encoded.size(), out.data(), 4097));
+    CHECK(!rle_decode(encoded.data(), encoded.size(), out.data(), 4095));
+    CHECK(!rle_decode(encoded.data(), encoded.size() - 1, out.data(), 4096));
+}
+
+// a cpu that drew, rolled RND and has a key down
+static void run_busy(cpu& chip8, const quirk_profile& quirks)
+{
+    load_words(chip8, quirks, { 0xC0FF, 0xC11F, 0xF029, 0xD015, 0x7201, 0xF215, 0x1200 });
+    run(chip8, 500);
+
+    chip8.tick_timers(3);
+    chip8.set_key_down(0x7);
+}
+
+// an NC8S save state restores the whole machine, raw or compressed, and is rejected by another profile
+static void save_state()
+{
+    for(const auto& quirks : { quirk_profile::nchip8, quirk_profile::xochip })
+    {
+        cpu chip8;
+        run_busy(chip8, quirks);
+
+        const auto raw = chip8.save_state(false);
+        const auto compressed = chip8.save_state(true);
+
+        CHECK(compressed.size() < raw.size());
+        CHECK(std::string(raw.begin(), raw.begin() + 4) == "NC8S");
+
+        for(const auto& state : { raw, compressed })
+        {
+            cpu restored;
+            restored.set_quirks(quirks);
+
+            CHECK(restored.load_state(state));
+            CHECK(restored.save_state(false) == raw);
+
+            // and it goes on the same, RND included
+            run(chip8, 1000);
+            run(restored, 1000);
+            CHECK(restored.save_state(false) == chip8.save_state(false));
+            CHECK(restored.get_screen_xy(0, 0) == chip8.get_screen_xy(0, 0));
+
+            CHECK(chip8.load_state(raw));
+        }
+
+        // another RAM size, a cut short state and a wrong magic
+        cpu other;
+        other.set_quirks(quirks == quirk_profile::xochip ? quirk_profile::nchip8 : quirk_profile::xochip);
+        CHECK(!other.load_state(raw));
+
+        cpu restored;
+        restored.set_quirks(quirks);
+        CHECK(!restored.load_state(std::vector<std::uint8_t>(compressed.begin(), compressed.end() - 1)));
+        CHECK(!restored.load_state(std::vector<std::uint8_t>(raw.begin(), raw.end() - 1)));
+
+        auto bad_magic = raw;
+        bad_magic[0] = 'X';
+        CHECK(!restored.load_state(bad_magic));
+    }
+}
+
+int main()
+{
+    rle();
+    save_state();
+
+    return failures ? 1 : 0;
+}